@@ -0,0 +1,118 @@
+/**
+ * @file end_to_end.cc
+ * @brief This file contains the main function for the end-to-end benchmarks
+ * of the CAF makers.
+ * @details The end-to-end benchmarks generate a synthetic input HDF5 file with
+ * "make_synthetic", then run "make_standalone" on it and "merge_sources" on
+ * the resulting CAF file and the same HDF5 file. Each executable is run as a
+ * separate process, so the measurements include the opening and closing of
+ * the files and the writing of the output. The "recTree" of each output CAF
+ * file is then read back in-process, so that the cost of the output profile
+ * (layout and compression) to the readers is measured as well.
+ * @author mueller@fnal.gov
+ */
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdexcept>
+
+#include "options.h"
+#include "harness.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+#include "TFile.h"
+#include "TTree.h"
+
+#ifdef MC_NOT_DATA
+const std::string flavor("simulation");
+#else
+const std::string flavor("data");
+#endif
+
+/**
+ * @brief Read back all entries of the "recTree" of a CAF file.
+ * @details All branches are read, so every basket of the TTree is read and
+ * decompressed, as for an analysis reading the whole record.
+ * @param name The name of the benchmark.
+ * @param path The path to the CAF file.
+ * @return The measurements of the benchmark.
+ * @throw std::runtime_error if the CAF file has no "recTree".
+ */
+dlp::benchmark::Result read_back(const std::string & name, const std::string & path)
+{
+    TFile file(path.c_str(), "read");
+    TTree * tree(file.Get<TTree>("recTree"));
+    if(tree == nullptr)
+        throw std::runtime_error("No recTree in " + path);
+    Long64_t entries(tree->GetEntries());
+    return dlp::benchmark::measure(name, entries, dlp::benchmark::file_size(path), [&]()
+    {
+        for(Long64_t entry(0); entry < entries; ++entry)
+            tree->GetEntry(entry);
+    });
+}
+
+int main(int argc, char const * argv[])
+{
+    /**
+     * @brief Check that the required arguments are present.
+     * @details The first argument is the directory holding the executables of
+     * this package (the build directory). The second argument is a directory
+     * for the generated fixtures and outputs. Any option not recognized here
+     * (e.g. "--compression" or "--flat") is passed on to the CAF makers.
+     */
+    dlp::Options options(argc, argv);
+    const std::vector<std::string> & args(options.positional());
+    if(args.size() < 2)
+    {
+        std::cerr << "Usage: ./end_to_end <build_directory> <work_directory> [--events=N] [--particles=min:max] [--output=<file>] [--baseline=<file>] [--threshold=<fraction>] [output options]" << std::endl;
+        return 0;
+    }
+    const std::string & bin(args[0]);
+    const std::string & work(args[1]);
+    int64_t nevents(options.get_int("events", 10000));
+    dlp::benchmark::Report report(options);
+
+    std::vector<std::string> passthrough;
+    for(const char * key : {"compression", "split-level", "basket-size", "autoflush-mb", "adaptive-baskets", "threads", "cache-mb"})
+    {
+        if(options.has(key))
+            passthrough.push_back("--" + std::string(key) + (options.get(key).empty() ? "" : "=" + options.get(key)));
+    }
+    if(options.has("flat"))
+        passthrough.push_back("--flat");
+
+    /**
+     * @brief Generate the input HDF5 file.
+     */
+    const std::string h5(work + "/synthetic_" + flavor + ".h5");
+    std::vector<std::string> generate{bin + "/make_synthetic_" + flavor, h5, "--events=" + std::to_string(nevents), "--seed=1"};
+    if(options.has("particles"))
+        generate.push_back("--particles=" + options.get("particles"));
+    report.add(dlp::benchmark::run_process("make_synthetic", nevents, 0, generate));
+    uint64_t h5_bytes(dlp::benchmark::file_size(h5));
+
+    /**
+     * @brief Run the standalone CAF maker.
+     * @details The output of the standalone CAF maker doubles as the input
+     * CAF file of the merging benchmark, as it holds one entry for each event
+     * of the HDF5 file.
+     */
+    const std::string standalone_caf(work + "/standalone_" + flavor + ".root");
+    std::vector<std::string> standalone{bin + "/make_standalone_" + flavor, standalone_caf, "0", h5};
+    standalone.insert(standalone.end(), passthrough.begin(), passthrough.end());
+    report.add(dlp::benchmark::run_process("make_standalone", nevents, h5_bytes, standalone));
+    report.add(read_back("read make_standalone", standalone_caf));
+
+    /**
+     * @brief Run the merging CAF maker.
+     */
+    const std::string merged_caf(work + "/merged_" + flavor + ".root");
+    std::vector<std::string> merge{bin + "/merge_sources_" + flavor, merged_caf, standalone_caf, h5};
+    merge.insert(merge.end(), passthrough.begin(), passthrough.end());
+    report.add(dlp::benchmark::run_process("merge_sources", nevents, h5_bytes + dlp::benchmark::file_size(standalone_caf), merge));
+    report.add(read_back("read merge_sources", merged_caf));
+
+    return report.finish();
+}
@@ -0,0 +1,239 @@
+/**
+ * @file harness.cc
+ * @brief Implementation of the utilities shared by the benchmark executables.
+ * @author mueller@fnal.gov
+*/
+#include <new>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "harness.h"
+
+namespace
+{
+    std::atomic<uint64_t> allocations(0);
+} // namespace
+
+/**
+ * @brief Replacements of the global allocation functions that count the
+ * number of allocations. The array and non-throwing forms call these by
+ * default, so they are counted as well.
+*/
+void * operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void * pointer = std::malloc(size > 0 ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void * pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void * pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+namespace dlp::benchmark
+{
+    /**
+     * @brief Get the number of heap allocations made by the process so far.
+     * @return The number of allocations.
+    */
+    uint64_t allocation_count()
+    {
+        return allocations.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Get the peak resident set size of the process so far.
+     * @return The peak resident set size (bytes).
+    */
+    int64_t peak_rss()
+    {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return int64_t(usage.ru_maxrss) * 1024;
+    }
+
+    /**
+     * @brief Get the size of a file.
+     * @param path The path to the file.
+     * @return The size of the file (bytes).
+    */
+    uint64_t file_size(const std::string & path)
+    {
+        struct stat info;
+        if(stat(path.c_str(), &info) != 0)
+            throw std::runtime_error("Cannot stat file: " + path);
+        return info.st_size;
+    }
+
+    /**
+     * @brief Run an executable as a child process and measure it.
+     * @param name The name of the benchmark.
+     * @param events The number of events processed by the executable.
+     * @param bytes The number of bytes processed by the executable.
+     * @param command The executable and its arguments.
+     * @return The measurements of the benchmark.
+     * @throw std::runtime_error if the executable cannot be run or fails.
+    */
+    Result run_process(const std::string & name, uint64_t events, uint64_t bytes, const std::vector<std::string> & command)
+    {
+        std::vector<char *> argv;
+        for(const std::string & argument : command)
+            argv.push_back(const_cast<char *>(argument.c_str()));
+        argv.push_back(nullptr);
+
+        Result result;
+        result.name = name;
+        result.events = events;
+        result.bytes = bytes;
+        std::cout.flush();
+        auto start(std::chrono::steady_clock::now());
+        pid_t pid(fork());
+        if(pid < 0)
+            throw std::runtime_error("Cannot fork to run " + command[0]);
+        if(pid == 0)
+        {
+            freopen("/dev/null", "w", stdout);
+            execv(argv[0], argv.data());
+            _exit(127);
+        }
+
+        int status(0);
+        struct rusage usage;
+        if(wait4(pid, &status, 0, &usage) < 0)
+            throw std::runtime_error("Cannot wait for " + command[0]);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            throw std::runtime_error("Benchmark " + name + " failed: " + command[0]);
+        result.peak_rss = int64_t(usage.ru_maxrss) * 1024;
+        return result;
+    }
+
+    /**
+     * @brief A constructor for the Report class.
+     * @param options The command line options.
+    */
+    Report::Report(const Options & options)
+        : fOutput(options.get("output", "")),
+          fBaseline(options.get("baseline", "")),
+          fThreshold(options.get_double("threshold", 0.1))
+    {
+        std::cout << std::left << std::setw(40) << "benchmark"
+                  << std::right << std::setw(14) << "events/s"
+                  << std::setw(14) << "MB/s"
+                  << std::setw(14) << "allocs/event"
+                  << std::setw(14) << "HDF5/event"
+                  << std::setw(14) << "peak RSS (MB)" << std::endl;
+    }
+
+    /**
+     * @brief Add the result of a benchmark to the report.
+     * @param result The measurements of the benchmark.
+    */
+    void Report::add(const Result & result)
+    {
+        fResults.push_back(result);
+        std::cout << std::left << std::setw(40) << result.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << result.events_per_second()
+                  << std::setw(14) << result.bytes_per_second() / (1024 * 1024);
+        if(result.allocations < 0)
+            std::cout << std::setw(14) << "-";
+        else
+            std::cout << std::setw(14) << result.allocations_per_event();
+        if(result.hdf5_allocations < 0)
+            std::cout << std::setw(14) << "-";
+        else
+            std::cout << std::setw(14) << result.hdf5_allocations_per_event();
+        std::cout << std::setw(14) << result.peak_rss / (1024.0 * 1024.0) << std::endl;
+    }
+
+    /**
+     * @brief Write the report and compare it to the baseline.
+     * @return The exit code of the job.
+    */
+    int Report::finish() const
+    {
+        if(!fOutput.empty())
+        {
+            std::ofstream output(fOutput);
+            output << std::setprecision(10) << "{\n  \"benchmarks\": [\n";
+            for(size_t i(0); i < fResults.size(); ++i)
+            {
+                const Result & result(fResults[i]);
+                output << "    {\"name\": \"" << result.name << "\""
+                       << ", \"seconds\": " << result.seconds
+                       << ", \"events\": " << result.events
+                       << ", \"bytes\": " << result.bytes
+                       << ", \"events_per_second\": " << result.events_per_second()
+                       << ", \"bytes_per_second\": " << result.bytes_per_second()
+                       << ", \"allocations_per_event\": " << result.allocations_per_event()
+                       << ", \"hdf5_allocations_per_event\": " << result.hdf5_allocations_per_event()
+                       << ", \"peak_rss_bytes\": " << result.peak_rss << "}"
+                       << (i + 1 < fResults.size() ? "," : "") << "\n";
+            }
+            output << "  ]\n}\n";
+        }
+
+        if(fBaseline.empty())
+            return 0;
+        std::map<std::string, double> baseline(read_baseline(fBaseline));
+        int status(0);
+        for(const Result & result : fResults)
+        {
+            auto entry(baseline.find(result.name));
+            if(entry == baseline.end() || entry->second <= 0)
+                continue;
+            double change(result.events_per_second() / entry->second - 1);
+            if(change < -fThreshold)
+            {
+                std::cerr << "Regression: " << result.name << " runs at " << result.events_per_second()
+                          << " events/s (baseline " << entry->second << " events/s, "
+                          << std::setprecision(1) << 100 * change << "%)." << std::endl;
+                status = 1;
+            }
+        }
+        if(status == 0)
+            std::cout << "No regression beyond " << 100 * fThreshold << "% with respect to " << fBaseline << "." << std::endl;
+        return status;
+    }
+
+    /**
+     * @brief Read the event rates of the benchmarks in a report.
+     * @param path The path to the report (JSON) written by @ref Report.
+     * @return The event rate of each benchmark, by name.
+     * @throw std::runtime_error if the file cannot be read.
+    */
+    std::map<std::string, double> read_baseline(const std::string & path)
+    {
+        std::ifstream input(path);
+        if(!input)
+            throw std::runtime_error("Cannot read baseline file: " + path);
+        std::map<std::string, double> rates;
+        const std::string name_key("\"name\": \""), rate_key("\"events_per_second\": ");
+        std::string line;
+        while(std::getline(input, line))
+        {
+            size_t name(line.find(name_key)), rate(line.find(rate_key));
+            if(name == std::string::npos || rate == std::string::npos)
+                continue;
+            name += name_key.size();
+            rates[line.substr(name, line.find('"', name) - name)] = std::stod(line.substr(rate + rate_key.size()));
+        }
+        return rates;
+    }
+} // namespace dlp::benchmark
@@ -0,0 +1,175 @@
+/**
+ * @file harness.h
+ * @brief Declaration of the utilities shared by the benchmark executables.
+ * @author mueller@fnal.gov
+*/
+#ifndef BENCHMARK_HARNESS_H
+#define BENCHMARK_HARNESS_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include "options.h"
+
+namespace dlp::benchmark
+{
+    /**
+     * @brief The measurements of a single benchmark.
+     *
+     * Each benchmark processes a known number of events and bytes, so the
+     * throughput can be compared between runs on the same inputs. The number
+     * of allocations is only known for benchmarks that run in-process (it is
+     * negative otherwise). The allocations made by the HDF5 library with
+     * malloc do not go through operator new; those of the variable-length
+     * arrays are only known for the benchmarks of the ProductReader, which
+     * counts the blocks allocated by its arenas.
+    */
+    struct Result
+    {
+        std::string name;                       //!< The name of the benchmark.
+        double seconds = 0;                     //!< The wall time of the benchmark.
+        uint64_t events = 0;                    //!< The number of events processed.
+        uint64_t bytes = 0;                     //!< The number of bytes processed.
+        int64_t allocations = -1;               //!< The number of heap allocations through operator new (negative if unknown).
+        int64_t hdf5_allocations = -1;          //!< The number of variable-length allocations of the HDF5 reads (negative if unknown).
+        int64_t peak_rss = 0;                   //!< The peak resident set size (bytes).
+
+        /**
+         * @brief Get the event rate of the benchmark.
+         * @return The number of events processed per second.
+        */
+        double events_per_second() const { return seconds > 0 ? events / seconds : 0; }
+
+        /**
+         * @brief Get the data rate of the benchmark.
+         * @return The number of bytes processed per second.
+        */
+        double bytes_per_second() const { return seconds > 0 ? bytes / seconds : 0; }
+
+        /**
+         * @brief Get the number of heap allocations per event.
+         * @return The number of allocations per event (negative if unknown).
+        */
+        double allocations_per_event() const { return allocations < 0 || events == 0 ? -1 : double(allocations) / events; }
+
+        /**
+         * @brief Get the number of variable-length allocations of the HDF5
+         * library per event.
+         * @return The number of allocations per event (negative if unknown).
+        */
+        double hdf5_allocations_per_event() const { return hdf5_allocations < 0 || events == 0 ? -1 : double(hdf5_allocations) / events; }
+    };
+
+    /**
+     * @brief Get the number of heap allocations made by the process so far.
+     * @details The global operator new is replaced by the harness, so every
+     * allocation made through it (including those of the standard library
+     * containers) is counted.
+     * @return The number of allocations.
+    */
+    uint64_t allocation_count();
+
+    /**
+     * @brief Get the peak resident set size of the process so far.
+     * @return The peak resident set size (bytes).
+    */
+    int64_t peak_rss();
+
+    /**
+     * @brief Get the size of a file.
+     * @param path The path to the file.
+     * @return The size of the file (bytes).
+    */
+    uint64_t file_size(const std::string & path);
+
+    /**
+     * @brief Run an in-process benchmark.
+     * @details The function is called once and timed. The allocations made by
+     * the function and the peak resident set size at its end are recorded.
+     * @param name The name of the benchmark.
+     * @param events The number of events processed by the function.
+     * @param bytes The number of bytes processed by the function.
+     * @param function The function to benchmark.
+     * @return The measurements of the benchmark.
+    */
+    template <class F>
+    Result measure(const std::string & name, uint64_t events, uint64_t bytes, F && function)
+    {
+        Result result;
+        result.name = name;
+        result.events = events;
+        result.bytes = bytes;
+        uint64_t allocations(allocation_count());
+        auto start(std::chrono::steady_clock::now());
+        function();
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.allocations = allocation_count() - allocations;
+        result.peak_rss = peak_rss();
+        return result;
+    }
+
+    /**
+     * @brief Run an executable as a child process and measure it.
+     * @details The wall time and the peak resident set size of the child
+     * process are recorded. The allocations of the child process are not
+     * known.
+     * @param name The name of the benchmark.
+     * @param events The number of events processed by the executable.
+     * @param bytes The number of bytes processed by the executable.
+     * @param command The executable and its arguments.
+     * @return The measurements of the benchmark.
+     * @throw std::runtime_error if the executable cannot be run or fails.
+    */
+    Result run_process(const std::string & name, uint64_t events, uint64_t bytes, const std::vector<std::string> & command);
+
+    /**
+     * @brief A class collecting the results of the benchmarks of a job.
+     *
+     * The results are printed as a table and may be written to a JSON file
+     * ("--output=<file>"). If a baseline file written by a previous run is
+     * given ("--baseline=<file>"), the event rate of each benchmark is
+     * compared to the baseline and the job fails if any benchmark is slower
+     * than the baseline by more than the threshold ("--threshold=<fraction>",
+     * default 0.1).
+    */
+    class Report
+    {
+        public:
+        /**
+         * @brief A constructor for the Report class.
+         * @param options The command line options.
+        */
+        explicit Report(const Options & options);
+
+        /**
+         * @brief Add the result of a benchmark to the report.
+         * @details The result is printed immediately.
+         * @param result The measurements of the benchmark.
+        */
+        void add(const Result & result);
+
+        /**
+         * @brief Write the report and compare it to the baseline.
+         * @return The exit code of the job: zero unless a benchmark regressed
+         * beyond the threshold.
+        */
+        int finish() const;
+
+        private:
+        std::vector<Result> fResults;
+        std::string fOutput;
+        std::string fBaseline;
+        double fThreshold;
+    };
+
+    /**
+     * @brief Read the event rates of the benchmarks in a report.
+     * @param path The path to the report (JSON) written by @ref Report.
+     * @return The event rate of each benchmark, by name.
+     * @throw std::runtime_error if the file cannot be read.
+    */
+    std::map<std::string, double> read_baseline(const std::string & path);
+} // namespace dlp::benchmark
+#endif // BENCHMARK_HARNESS_H
@@ -0,0 +1,314 @@
+/**
+ * @file micro_benchmarks.cc
+ * @brief This file contains the main function for the micro-benchmarks of
+ * the reading and filling of the SPINE data products.
+ * @details The micro-benchmarks measure the building blocks of the CAF
+ * makers in isolation on a single input HDF5 file (typically generated by
+ * "make_synthetic"): reading the events, reading each data product with
+ * get_product<T> and the ProductReader, iterating over the variable-length arrays (BufferView),
+ * each fill_* function, the recomputation of the reco/truth matches and
+ * package_event.
+ * @author mueller@fnal.gov
+ */
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "H5Cpp.h"
+
+#include "products.h"
+#include "product_reader.h"
+#include "event.h"
+#include "runinfo.h"
+#include "reco_interaction.h"
+#include "reco_particle.h"
+#include "true_interaction.h"
+#include "true_particle.h"
+#include "record_fillers.h"
+#include "matching.h"
+#include "options.h"
+#include "harness.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+using dlp::benchmark::Result;
+using dlp::benchmark::measure;
+
+/**
+ * @brief Benchmark get_product<T> over all events of the file.
+ * @param name The name of the benchmark.
+ * @param file The input HDF5 file.
+ * @param events The events of the file.
+ * @param repeat The number of passes over the events.
+ * @param strings The pool of the string fields of the products.
+ * @param products The products read in the last pass (output).
+ * @return The measurements of the benchmark.
+ */
+template <class T>
+Result benchmark_get_product(const std::string & name, H5::H5File & file, std::vector<dlp::types::Event> & events, int64_t repeat, dlp::StringPool & strings, std::vector<std::vector<T>> & products)
+{
+    uint64_t records(0);
+    Result result(measure(name, events.size() * repeat, 0, [&]()
+    {
+        for(int64_t r(0); r < repeat; ++r)
+        {
+            products.clear();
+            for(dlp::types::Event & evt : events)
+            {
+                products.push_back(get_product<T>(file, evt, strings));
+                records += products.back().size();
+            }
+        }
+    }));
+    result.bytes = records * dlp::types::BuildCompType<T>().getSize();
+    return result;
+}
+
+/**
+ * @brief Benchmark ProductReader::read<T> over all events of the file.
+ * @details The buffers of the reader and the arenas of their
+ * variable-length arrays are grown by two untimed passes over the events
+ * (the blocks of an arena are merged by the first read of the second pass),
+ * so the measured passes show the steady state, in which neither the output
+ * vectors nor the arenas allocate. The blocks allocated by the arenas during
+ * the measured passes are reported separately and must be zero. The DataSpace
+ * of the region referenced by each event is built inside the HDF5 library on
+ * every read and is not counted.
+ * @param name The name of the benchmark.
+ * @param file The input HDF5 file.
+ * @param events The events of the file.
+ * @param repeat The number of passes over the events.
+ * @return The measurements of the benchmark.
+ */
+template <class T>
+Result benchmark_product_reader(const std::string & name, H5::H5File & file, std::vector<dlp::types::Event> & events, int64_t repeat)
+{
+    dlp::ProductReader reader;
+    for(int pass(0); pass < 2; ++pass)
+    {
+        for(dlp::types::Event & evt : events)
+            reader.read<T>(file, evt);
+    }
+    uint64_t records(0);
+    uint64_t hdf5_allocations(reader.vlen_allocations());
+    Result result(measure(name, events.size() * repeat, 0, [&]()
+    {
+        for(int64_t r(0); r < repeat; ++r)
+        {
+            for(dlp::types::Event & evt : events)
+                records += reader.read<T>(file, evt).size();
+        }
+    }));
+    result.hdf5_allocations = reader.vlen_allocations() - hdf5_allocations;
+    result.bytes = records * dlp::types::BuildCompType<T>().getSize();
+    return result;
+}
+
+/**
+ * @brief Benchmark a fill_* function for all particles of the events.
+ * @param name The name of the benchmark.
+ * @param particles The particles of each event.
+ * @param repeat The number of passes over the events.
+ * @param fill The fill function.
+ * @param output The filled particles of each event in the last pass (output).
+ * @return The measurements of the benchmark.
+ */
+template <class T, class C>
+Result benchmark_fill_particles(const std::string & name, std::vector<std::vector<T>> & particles, int64_t repeat, C (*fill)(T &, uint64_t), std::vector<std::vector<C>> & output)
+{
+    return measure(name, particles.size() * repeat, 0, [&]()
+    {
+        for(int64_t r(0); r < repeat; ++r)
+        {
+            output.assign(particles.size(), std::vector<C>());
+            for(size_t e(0); e < particles.size(); ++e)
+            {
+                for(T & p : particles[e])
+                    output[e].push_back(fill(p, 0));
+            }
+        }
+    });
+}
+
+/**
+ * @brief Benchmark a fill_* function for all interactions of the events.
+ * @param name The name of the benchmark.
+ * @param interactions The interactions of each event.
+ * @param particles The filled particles of each event.
+ * @param repeat The number of passes over the events.
+ * @param fill The fill function.
+ * @return The measurements of the benchmark.
+ */
+template <class T, class P, class C>
+Result benchmark_fill_interactions(const std::string & name, std::vector<std::vector<T>> & interactions, std::vector<std::vector<P>> & particles, int64_t repeat, C (*fill)(T &, std::vector<P> &, uint64_t))
+{
+    return measure(name, interactions.size() * repeat, 0, [&]()
+    {
+        for(int64_t r(0); r < repeat; ++r)
+        {
+            for(size_t e(0); e < interactions.size(); ++e)
+            {
+                std::vector<C> output;
+                for(T & i : interactions[e])
+                    output.push_back(fill(i, particles[e], 0));
+            }
+        }
+    });
+}
+
+int main(int argc, char const * argv[])
+{
+    /**
+     * @brief Check that the required arguments are present.
+     * @details The only positional argument is the input HDF5 file. Each
+     * benchmark makes "--repeat" passes over all events of the file.
+     */
+    dlp::Options options(argc, argv);
+    const std::vector<std::string> & args(options.positional());
+    if(args.size() < 1)
+    {
+        std::cerr << "Usage: ./micro_benchmarks <input_h5_file> [--repeat=N] [--output=<file>] [--baseline=<file>] [--threshold=<fraction>]" << std::endl;
+        return 0;
+    }
+    int64_t repeat(std::max<int64_t>(1, options.get_int("repeat", 1)));
+    dlp::benchmark::Report report(options);
+
+    /**
+     * @brief Read the events and the data products of the file.
+     * @details The products read by the get_product<T> benchmarks are kept
+     * as the inputs of the BufferView and fill_* benchmarks.
+     */
+    H5::H5File file(args[0], H5F_ACC_RDONLY);
+    std::vector<dlp::types::Event> events;
+    Result reading(measure("get_all_events", 0, dlp::benchmark::file_size(args[0]), [&]() { events = get_all_events(file); }));
+    reading.events = events.size();
+    report.add(reading);
+    std::cout << "Read " << events.size() << " events from " << args[0] << std::endl;
+
+    dlp::StringPool strings;
+    std::vector<std::vector<dlp::types::RunInfo>> run_info;
+    std::vector<std::vector<dlp::types::RecoParticle>> reco_particles;
+    std::vector<std::vector<dlp::types::RecoInteraction>> reco_interactions;
+    report.add(benchmark_get_product("get_product<RunInfo>", file, events, repeat, strings, run_info));
+    report.add(benchmark_get_product("get_product<RecoParticle>", file, events, repeat, strings, reco_particles));
+    report.add(benchmark_get_product("get_product<RecoInteraction>", file, events, repeat, strings, reco_interactions));
+    #ifdef MC_NOT_DATA
+    std::vector<std::vector<dlp::types::TruthParticle>> truth_particles;
+    std::vector<std::vector<dlp::types::TruthInteraction>> truth_interactions;
+    report.add(benchmark_get_product("get_product<TruthParticle>", file, events, repeat, strings, truth_particles));
+    report.add(benchmark_get_product("get_product<TruthInteraction>", file, events, repeat, strings, truth_interactions));
+    #endif
+    /**
+     * @brief Benchmark the ProductReader.
+     * @details The job fails if the reader allocates variable-length memory
+     * once it has reached the steady state.
+     */
+    std::vector<Result> readers;
+    readers.push_back(benchmark_product_reader<dlp::types::RecoParticle>("ProductReader::read<RecoParticle>", file, events, repeat));
+    readers.push_back(benchmark_product_reader<dlp::types::RecoInteraction>("ProductReader::read<RecoInteraction>", file, events, repeat));
+    #ifdef MC_NOT_DATA
+    readers.push_back(benchmark_product_reader<dlp::types::TruthParticle>("ProductReader::read<TruthParticle>", file, events, repeat));
+    readers.push_back(benchmark_product_reader<dlp::types::TruthInteraction>("ProductReader::read<TruthInteraction>", file, events, repeat));
+    #endif
+    int status(0);
+    for(const Result & result : readers)
+    {
+        report.add(result);
+        if(result.hdf5_allocations != 0)
+        {
+            std::cerr << result.name << " allocated " << result.hdf5_allocations << " variable-length blocks in the steady state." << std::endl;
+            status = 1;
+        }
+    }
+    std::cout << "ProductReader::read<T> also builds the DataSpace of the referenced region inside the HDF5 library on every read (not counted above)." << std::endl;
+
+    /**
+     * @brief Benchmark the iteration over the variable-length arrays.
+     * @details The BufferView objects of each reconstructed particle are
+     * synchronized with their buffers and all of their elements are summed.
+     */
+    uint64_t nelements(0);
+    double sum(0);
+    Result iteration(measure("BufferView iteration", events.size() * repeat, 0, [&]()
+    {
+        for(int64_t r(0); r < repeat; ++r)
+        {
+            for(std::vector<dlp::types::RecoParticle> & particles : reco_particles)
+            {
+                for(dlp::types::RecoParticle & p : particles)
+                {
+                    p.SyncVectors();
+                    for(int32_t v : p.fragment_ids) sum += v;
+                    for(int64_t v : p.match_ids) sum += v;
+                    for(float v : p.match_overlaps) sum += v;
+                    for(int64_t v : p.module_ids) sum += v;
+                    for(int32_t v : p.ppn_ids) sum += v;
+                    nelements += p.fragment_ids.size() + p.match_ids.size() + p.match_overlaps.size() + p.module_ids.size() + p.ppn_ids.size();
+                }
+            }
+        }
+    }));
+    iteration.bytes = nelements * sizeof(int64_t);
+    report.add(iteration);
+
+    /**
+     * @brief Benchmark the fill_* functions.
+     */
+    std::vector<std::vector<caf::SRParticleDLP>> caf_reco_particles;
+    report.add(benchmark_fill_particles("fill_particle", reco_particles, repeat, &fill_particle, caf_reco_particles));
+    report.add(benchmark_fill_interactions("fill_interaction", reco_interactions, caf_reco_particles, repeat, &fill_interaction));
+    #ifdef MC_NOT_DATA
+    std::vector<std::vector<caf::SRParticleTruthDLP>> caf_truth_particles;
+    report.add(benchmark_fill_particles("fill_truth_particle", truth_particles, repeat, &fill_truth_particle, caf_truth_particles));
+    auto fill_truth(+[](dlp::types::TruthInteraction & in, std::vector<caf::SRParticleTruthDLP> & particles, uint64_t offset) { return fill_truth_interaction(in, particles, offset); });
+    report.add(benchmark_fill_interactions("fill_truth_interaction", truth_interactions, caf_truth_particles, repeat, fill_truth));
+
+    /**
+     * @brief Benchmark the recomputation of the reco/truth interaction
+     * matches, to be compared with the cost of reading the products.
+     * @details The products are passed as read by get_product<T>: the
+     * matcher reads the voxel index arrays through their handles. The block
+     * comparison selected for this CPU is reported with the result.
+     */
+    std::cout << "Matcher::match intersects the voxel sets with the " << dlp::intersection_kernel() << " block comparison." << std::endl;
+    dlp::MatchConfig match_config;
+    match_config.enabled = true;
+    dlp::Matcher matcher(match_config);
+    uint64_t nmatches(0);
+    report.add(measure("Matcher::match", events.size() * repeat, 0, [&]()
+    {
+        for(int64_t r(0); r < repeat; ++r)
+        {
+            for(size_t e(0); e < events.size(); ++e)
+            {
+                matcher.match(reco_particles[e], reco_interactions[e], truth_interactions[e]);
+                nmatches += matcher.record().dlp_match_ids.size();
+            }
+        }
+    }));
+    sum += nmatches;
+    #endif
+
+    /**
+     * @brief Benchmark package_event, which reads all products of an event
+     * and fills the StandardRecord.
+     */
+    caf::StandardRecord * rec = new caf::StandardRecord;
+    report.add(measure("package_event", events.size() * repeat, 0, [&]()
+    {
+        for(int64_t r(0); r < repeat; ++r)
+        {
+            for(dlp::types::Event & evt : events)
+            {
+                rec->dlp.clear();
+                rec->dlp_true.clear();
+                package_event(rec, file, evt);
+            }
+        }
+    }));
+    delete rec;
+
+    file.close();
+    std::cout << "Checksum: " << sum << std::endl;
+    return std::max(report.finish(), status);
+}
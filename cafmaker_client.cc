@@ -0,0 +1,67 @@
+/**
+ * @file cafmaker_client.cc
+ * @brief This file contains the main function of the client which runs a job
+ * on the CAF maker daemon.
+ * @details The client is a drop-in replacement for the CAF maker executables:
+ * "cafmaker_client merge_sources_simulation <args...>" behaves like
+ * "merge_sources_simulation <args...>", but the job is run by the warm daemon
+ * of the matching flavor (see cafmaker_daemon.cc). The arguments, working
+ * directory and standard streams of the client are passed to the job and the
+ * exit status of the job is returned. The socket of the daemon is taken from
+ * $CAFMAKER_SOCKET if set, otherwise the default socket of the flavor is used.
+ * @note The client does not link against ROOT or HDF5, so it starts
+ * immediately.
+ */
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <unistd.h>
+#include <climits>
+#include <stdexcept>
+
+#include "include/daemon_protocol.h"
+
+int main(int argc, char const * argv[])
+{
+    if(argc < 2)
+    {
+        std::cerr << "Usage: ./cafmaker_client <executable> [arguments...]" << std::endl;
+        return 0;
+    }
+
+    try
+    {
+        /**
+         * @brief Build the job request.
+         */
+        dlp::JobRequest request;
+        std::string job, flavor;
+        request.program = argv[1];
+        if(!dlp::split_program(request.program, job, flavor))
+            throw std::runtime_error("Unable to determine the flavor (simulation or data) of " + request.program);
+        request.arguments.assign(argv + 2, argv + argc);
+        char directory[PATH_MAX];
+        if(!getcwd(directory, sizeof(directory)))
+            throw std::runtime_error("Unable to determine the working directory.");
+        request.directory = directory;
+        for(int fd(0); fd < 3; ++fd)
+            request.descriptors[fd] = fd;
+
+        /**
+         * @brief Run the job and wait for its exit status.
+         */
+        const char * socket(std::getenv("CAFMAKER_SOCKET"));
+        std::string path(socket && *socket ? socket : dlp::default_socket_path(flavor));
+        int connection(dlp::connect_socket(path));
+        dlp::send_request(connection, request);
+        int status(dlp::receive_status(connection));
+        close(connection);
+        return status;
+    }
+    catch(const std::exception & e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
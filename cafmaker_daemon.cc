@@ -0,0 +1,432 @@
+/**
+ * @file cafmaker_daemon.cc
+ * @brief This file contains the main function of the daemon which runs the
+ * merging and standalone jobs in a single warm process.
+ * @details Starting one of the CAF maker executables spends a noticeable
+ * amount of time before the first event on loading ROOT, the sbnanaobj
+ * dictionaries and the HDF5 library. The daemon pays this cost once: it
+ * initializes everything, then listens on a local UNIX domain socket for job
+ * requests sent by "cafmaker_client". Each job is run in a child process
+ * forked from the warm daemon, so it starts with everything loaded but keeps
+ * the process-wide state of the executables (instrumentation, logging, ROOT
+ * and HDF5 globals) to itself. The standard streams and the working directory
+ * of the client are used by the job, and its exit status is returned to the
+ * client, so that a job behaves exactly like the corresponding executable. At
+ * most "--workers" jobs run concurrently; further requests wait in the queue
+ * of the socket. There are two versions of the daemon: one for data and one
+ * for simulation.
+ * @note SIGINT and SIGTERM stop the daemon from accepting new requests; it
+ * exits once the running jobs are finished. A job is terminated if its client
+ * disconnects. Jobs with the "--threads" or "--buffer-merger" options are
+ * rejected, since they start threads in a process forked from the warm
+ * daemon, whose ROOT and HDF5 globals are only meant for single-threaded use.
+ */
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "H5Cpp.h"
+
+#include "include/event.h"
+#include "include/options.h"
+#include "include/logger.h"
+#include "include/instrumentation.h"
+#include "include/daemon_protocol.h"
+#include "include/jobs.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+#include "TClass.h"
+#include "TMemFile.h"
+#include "TTree.h"
+
+#ifdef MC_NOT_DATA
+const char * kFlavor = "simulation";
+#else
+const char * kFlavor = "data";
+#endif
+
+/**
+ * @brief The jobs which can be run by the daemon.
+ */
+struct JobEntry
+{
+    const char * name;                          //!< The name of the job (executable name without the flavor).
+    int (*main)(int argc, char const * argv[]); //!< The entry point of the job.
+};
+const JobEntry kJobs[] = {{"merge_sources", merge_sources_main},
+                          {"merge_sources_multi", merge_sources_multi_main},
+                          {"merge_sources_batch", merge_sources_batch_main},
+                          {"make_standalone", make_standalone_main}};
+
+/**
+ * @brief A job running in a child process.
+ */
+struct RunningJob
+{
+    pid_t pid;                                  //!< The process ID of the child process.
+    int connection;                             //!< The connection to the client.
+    std::string program;                        //!< The name of the executable.
+    bool cancelled;                             //!< Whether the client disconnected.
+};
+
+/**
+ * @brief Set by SIGINT and SIGTERM to stop accepting requests.
+ */
+volatile sig_atomic_t stop_requested(0);
+
+/**
+ * @brief The handler of SIGINT and SIGTERM.
+ * @param signal The signal.
+ */
+void request_stop(int signal)
+{
+    stop_requested = 1;
+}
+
+/**
+ * @brief The handler of SIGCHLD (only interrupts the wait of the main loop).
+ * @param signal The signal.
+ */
+void child_exited(int signal) { }
+
+/**
+ * @brief Load the libraries, dictionaries and streamers used by the jobs.
+ * @details The HDF5 library is initialized and the compound types of the
+ * events are built, and a StandardRecord is written to a TTree in memory,
+ * which loads the sbnanaobj dictionaries and builds their streamers.
+ */
+void warm_up()
+{
+    H5open();
+    H5::CompType event_type(dlp::types::BuildCompType<dlp::types::Event>());
+
+    TClass::GetClass("caf::StandardRecord");
+    TMemFile file("warm_up.root", "recreate");
+    caf::StandardRecord * rec(new caf::StandardRecord);
+    {
+        TTree tree("recTree", "warm_up");
+        tree.Branch("rec", &rec);
+        tree.Fill();
+    }
+    delete rec;
+}
+
+/**
+ * @brief Find the job of an executable.
+ * @param program The name of the executable.
+ * @return The job, or nullptr if the daemon cannot run it.
+ */
+const JobEntry * find_job(const std::string & program)
+{
+    std::string job, flavor;
+    if(!dlp::split_program(program, job, flavor) || flavor != kFlavor)
+        return nullptr;
+    for(const JobEntry & entry : kJobs)
+    {
+        if(job == entry.name)
+            return &entry;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Find the first option of a job request which the daemon does not
+ * support.
+ * @details The "--threads" option enables the implicit multithreading of
+ * ROOT and the "--buffer-merger" option starts worker threads. The job
+ * processes are forked from the warm daemon, in which ROOT and the HDF5
+ * library have been initialized for a single thread, so these jobs must be
+ * run with the executables directly.
+ * @param request The job request.
+ * @return The option (without the leading "--"), or nullptr if all of the
+ * options are supported.
+ */
+const char * unsupported_option(const dlp::JobRequest & request)
+{
+    std::vector<char const *> argv{request.program.c_str()};
+    for(const std::string & argument : request.arguments)
+        argv.push_back(argument.c_str());
+    dlp::Options options(argv.size(), argv.data());
+    for(const char * option : {"threads", "buffer-merger"})
+    {
+        if(options.has(option))
+            return option;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Run a job in the child process.
+ * @details The signal handlers and mask of the daemon are restored, all
+ * sockets of the daemon are closed, the logger and the instrumentation
+ * inherited from the daemon are reset and the standard streams and working
+ * directory of the client are adopted before the entry point of the job is
+ * called. The process exits with the status returned by the job, or with 1
+ * if the job throws (including the H5::Exception of the HDF5 library, which
+ * does not derive from std::exception).
+ * @param entry The job.
+ * @param request The job request.
+ * @param mask The signal mask to restore.
+ * @param sockets The sockets of the daemon.
+ */
+[[noreturn]] void run_job(const JobEntry & entry, const dlp::JobRequest & request, const sigset_t & mask, const std::vector<int> & sockets)
+{
+    for(int signal : {SIGINT, SIGTERM, SIGCHLD, SIGPIPE})
+        std::signal(signal, SIG_DFL);
+    sigprocmask(SIG_SETMASK, &mask, nullptr);
+    for(int fd : sockets)
+        close(fd);
+    for(int fd(0); fd < 3; ++fd)
+        dup2(request.descriptors[fd], fd);
+    for(int fd : request.descriptors)
+    {
+        if(fd > 2)
+            close(fd);
+    }
+    dlp::Logger::get().reset();
+    dlp::Instrumentation::get().reset();
+    if(chdir(request.directory.c_str()) != 0)
+    {
+        std::cerr << request.program << ": unable to change to directory " << request.directory << ": " << std::strerror(errno) << std::endl;
+        std::exit(1);
+    }
+
+    std::vector<char const *> argv;
+    argv.push_back(request.program.c_str());
+    for(const std::string & argument : request.arguments)
+        argv.push_back(argument.c_str());
+    argv.push_back(nullptr);
+    int status(1);
+    try
+    {
+        status = entry.main(argv.size() - 1, argv.data());
+    }
+    catch(const std::exception & e)
+    {
+        std::cerr << request.program << ": " << e.what() << std::endl;
+    }
+    catch(const H5::Exception & e)
+    {
+        std::cerr << request.program << ": " << e.getDetailMsg() << std::endl;
+    }
+    std::exit(status);
+}
+
+/**
+ * @brief Accept a job request and start the job.
+ * @details Requests from other users, malformed requests and requests for
+ * jobs which the daemon cannot run are answered immediately (with an error
+ * message on the standard error of the client).
+ * @param listener The listening socket.
+ * @param running The running jobs.
+ * @param mask The signal mask of the job processes.
+ */
+void start_job(int listener, std::vector<RunningJob> & running, const sigset_t & mask)
+{
+    int connection(accept(listener, nullptr, nullptr));
+    if(connection < 0)
+        return;
+    fcntl(connection, F_SETFD, FD_CLOEXEC);
+    if(!dlp::trusted_peer(connection))
+    {
+        dlp::Logger::get().log(dlp::LogLevel::kWarning, "daemon_untrusted", "Rejected a connection from another user.");
+        close(connection);
+        return;
+    }
+
+    /**
+     * @brief Receive the request.
+     * @details The client sends the request right after connecting, so a
+     * short timeout keeps a stuck client from blocking the daemon.
+     */
+    timeval timeout{5, 0};
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    dlp::JobRequest request;
+    try
+    {
+        dlp::receive_request(connection, request);
+    }
+    catch(const std::exception & e)
+    {
+        dlp::Logger::get().log(dlp::LogLevel::kWarning, "daemon_request", e.what());
+        close(connection);
+        return;
+    }
+    auto reject([&](const std::string & message, int status)
+    {
+        std::string line(request.program + ": " + message + "\n");
+        if(write(request.descriptors[2], line.data(), line.size()) < 0) { }
+        dlp::send_status(connection, status);
+        for(int fd : request.descriptors)
+            close(fd);
+        close(connection);
+    });
+    const JobEntry * entry(find_job(request.program));
+    if(!entry)
+    {
+        reject(std::string("not a job of the ") + kFlavor + " daemon.", 127);
+        return;
+    }
+    const char * option(unsupported_option(request));
+    if(option)
+    {
+        reject(std::string("the --") + option + " option is not supported by the daemon; run the executable directly.", 1);
+        return;
+    }
+
+    /**
+     * @brief Fork the job process.
+     * @details The buffered output of the daemon is flushed first so that it
+     * is not duplicated by the child.
+     */
+    std::vector<int> sockets{listener, connection};
+    for(const RunningJob & job : running)
+        sockets.push_back(job.connection);
+    dlp::Logger::get().flush();
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+    pid_t pid(fork());
+    if(pid == 0)
+        run_job(*entry, request, mask, sockets);
+    if(pid < 0)
+    {
+        reject(std::string("unable to start the job: ") + std::strerror(errno), 1);
+        return;
+    }
+    for(int fd : request.descriptors)
+        close(fd);
+    running.push_back(RunningJob{pid, connection, request.program, false});
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "daemon_job", "Started ", request.program, " (pid ", pid, ") with ", request.arguments.size(), " argument(s) in ", request.directory, ".");
+}
+
+/**
+ * @brief Report the exit status of the finished jobs to their clients.
+ * @param running The running jobs (the finished jobs are removed).
+ */
+void reap_jobs(std::vector<RunningJob> & running)
+{
+    for(auto job(running.begin()); job != running.end(); )
+    {
+        int status(0);
+        pid_t pid(waitpid(job->pid, &status, WNOHANG));
+        if(pid == 0 || (pid < 0 && errno == EINTR))
+        {
+            ++job;
+            continue;
+        }
+        int code(1);
+        if(pid > 0 && WIFEXITED(status))
+            code = WEXITSTATUS(status);
+        else if(pid > 0 && WIFSIGNALED(status))
+            code = 128 + WTERMSIG(status);
+        dlp::Logger::get().log(dlp::LogLevel::kInfo, "daemon_job", "Finished ", job->program, " (pid ", job->pid, ") with status ", code, job->cancelled ? " (client disconnected)." : ".");
+        dlp::send_status(job->connection, code);
+        close(job->connection);
+        job = running.erase(job);
+    }
+}
+
+int main(int argc, char const * argv[])
+{
+    /**
+     * @brief Check the arguments.
+     * @details The daemon has no positional arguments. The socket defaults to
+     * a per-user path for the flavor of the daemon (see
+     * @ref dlp::default_socket_path), which is also where the client looks
+     * for it.
+     */
+    dlp::Options options(argc, argv);
+    if(!options.positional().empty())
+    {
+        std::cerr << "Usage: ./cafmaker_daemon_" << kFlavor << " [--socket=<path>] [--workers=N]" << std::endl;
+        return 0;
+    }
+    std::string path(options.get("socket", dlp::default_socket_path(kFlavor)));
+    int64_t workers(options.get_int("workers", std::max(1u, std::thread::hardware_concurrency())));
+    if(workers < 1)
+    {
+        std::cerr << "The number of workers must be positive." << std::endl;
+        return 1;
+    }
+
+    /**
+     * @brief Load everything used by the jobs and start listening.
+     * @details The signals are blocked except while waiting for events, so
+     * that a signal is never missed between two waits.
+     */
+    warm_up();
+    int listener(dlp::listen_socket(path));
+    sigset_t blocked, mask;
+    sigemptyset(&blocked);
+    for(int signal : {SIGINT, SIGTERM, SIGCHLD})
+        sigaddset(&blocked, signal);
+    sigprocmask(SIG_BLOCK, &blocked, &mask);
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    action.sa_handler = child_exited;
+    sigaction(SIGCHLD, &action, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "daemon_start", "Listening on ", path, " with ", workers, " worker(s).");
+
+    /**
+     * @brief Main loop.
+     * @details New requests are only accepted while fewer than "workers"
+     * jobs are running. The connections of the running jobs are watched to
+     * terminate the jobs whose client has disconnected.
+     */
+    std::vector<RunningJob> running;
+    while(true)
+    {
+        reap_jobs(running);
+        if(stop_requested && running.empty())
+            break;
+
+        std::vector<pollfd> fds;
+        std::vector<RunningJob *> watched;
+        bool accepting(!stop_requested && running.size() < size_t(workers));
+        if(accepting)
+            fds.push_back(pollfd{listener, POLLIN, 0});
+        for(RunningJob & job : running)
+        {
+            if(job.cancelled)
+                continue;
+            fds.push_back(pollfd{job.connection, POLLIN, 0});
+            watched.push_back(&job);
+        }
+        if(ppoll(fds.data(), fds.size(), nullptr, &mask) < 0)
+            continue;
+
+        size_t first(accepting ? 1 : 0);
+        for(size_t w(0); w < watched.size(); ++w)
+        {
+            char byte;
+            if(fds[first + w].revents != 0 && recv(watched[w]->connection, &byte, 1, MSG_DONTWAIT) <= 0)
+            {
+                watched[w]->cancelled = true;
+                kill(watched[w]->pid, SIGTERM);
+            }
+        }
+        if(accepting && (fds[0].revents & POLLIN))
+            start_job(listener, running, mask);
+    }
+
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "daemon_stop", "Stopped listening on ", path, ".");
+    close(listener);
+    unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,419 @@
+/**
+ * @file combine_cafs.cc
+ * @brief This file contains the main function for combining many (sharded)
+ * output CAF files into a single CAF file.
+ * @details The combiner is aware of the layout of the CAF files written by
+ * the other executables. The "recTree" and "GenieEvtRecTree" TTrees (and the
+ * "dlpMatchTree" and "dlpXrefTree" TTrees, which have the same entries as
+ * "recTree", if present) are concatenated at the basket level (without decompressing or recompressing
+ * the baskets), the "TotalPOT" and "TotalEvents" histograms are summed, and
+ * the key/value pairs of the "env" and "metadata" directories are combined
+ * without duplicates. The remaining objects are copied from the first input
+ * CAF file. The input CAF files are opened one at a time, so the number of
+ * open files does not depend on the number of inputs.
+ *
+ * Each shard of a CAF file carries the whole "GenieEvtRecTree" of its source
+ * CAF file. A "GenieEvtRecTree" which has already been concatenated (from
+ * another shard of the same source) is therefore not concatenated again. The
+ * GENIE indices ("rec.mc.nu[].genieIdx") of the records of each input are
+ * shifted to the entries of its "GenieEvtRecTree" in the combined TTree. The
+ * records whose indices are shifted are rewritten (decompressed and
+ * recompressed) rather than concatenated at the basket level, which is only
+ * supported for the nested (non-flat) CAF layout.
+ * @note The combiner is intended to replace "hadd" for the outputs of jobs
+ * using the "--shard" option.
+ */
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <set>
+#include <utility>
+#include <cstdint>
+#include <unordered_set>
+#include <unordered_map>
+
+#include "include/options.h"
+#include "include/instrumentation.h"
+#include "include/logger.h"
+#include "include/output_profile.h"
+#include "include/aux_copier.h"
+#include "include/merge.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+#include "TFile.h"
+#include "TDirectory.h"
+#include "TTree.h"
+#include "TBranch.h"
+#include "TObjArray.h"
+#include "TH1.h"
+
+/**
+ * @brief The (Run, Subrun, Event No.) key of a record.
+ */
+struct EventKey
+{
+    unsigned int run;
+    unsigned int subrun;
+    unsigned int event;
+
+    bool operator==(const EventKey & other) const
+    {
+        return run == other.run && subrun == other.subrun && event == other.event;
+    }
+};
+
+/**
+ * @brief Hash function for the @ref EventKey struct.
+ */
+struct EventKeyHash
+{
+    size_t operator()(const EventKey & key) const
+    {
+        uint64_t h((uint64_t(key.run) << 32) ^ (uint64_t(key.subrun) << 16) ^ key.event);
+        h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdULL;
+        return h ^ (h >> 33);
+    }
+};
+
+/**
+ * @brief Check the records of a "recTree" for (Run, Subrun, Event No.) keys
+ * which have already been seen.
+ * @details Only the three branches of the key are read. The branch statuses
+ * and addresses are reset afterwards, so the TTree can then be copied.
+ * @param tree The "recTree" of the input CAF file.
+ * @param seen The keys seen so far (updated).
+ * @param path The path of the input CAF file (for the warnings).
+ * @return The number of duplicate records.
+ */
+size_t check_duplicates(TTree * tree, std::unordered_set<EventKey, EventKeyHash> & seen, const std::string & path)
+{
+    dlp::ScopedTimer timer("check_duplicates");
+    EventKey key{0, 0, 0};
+    tree->SetBranchStatus("*", false);
+    tree->SetBranchStatus("rec.hdr.run", true);
+    tree->SetBranchStatus("rec.hdr.subrun", true);
+    tree->SetBranchStatus("rec.hdr.evt", true);
+    tree->SetBranchAddress("rec.hdr.run", &key.run);
+    tree->SetBranchAddress("rec.hdr.subrun", &key.subrun);
+    tree->SetBranchAddress("rec.hdr.evt", &key.event);
+
+    size_t duplicates(0);
+    for(Long64_t n(0); n < tree->GetEntries(); ++n)
+    {
+        tree->GetEntry(n);
+        if(!seen.insert(key).second)
+        {
+            ++duplicates;
+            dlp::Logger::get().log(dlp::LogLevel::kWarning, "duplicate_event", "Duplicate (Run, Subrun, Event No.) = (", key.run, ", ", key.subrun, ", ", key.event, ") at entry ", n, " of ", path, ".");
+        }
+    }
+    tree->ResetBranchAddresses();
+    tree->SetBranchStatus("*", true);
+    return duplicates;
+}
+
+/**
+ * @brief Read the list of input CAF files from a file.
+ * @details Each non-empty line of the file is the path of an input CAF file.
+ * Lines beginning with '#' are treated as comments.
+ * @param path The path of the list file.
+ * @param inputs The list to which the input CAF files are appended.
+ * @return True if the list was read successfully, false otherwise.
+ */
+bool read_input_list(const std::string & path, std::vector<std::string> & inputs)
+{
+    std::ifstream list(path);
+    if(!list.is_open())
+    {
+        dlp::Logger::get().log(dlp::LogLevel::kError, "input_list", "Unable to open input list: ", path);
+        return false;
+    }
+    std::string line;
+    while(std::getline(list, line))
+    {
+        size_t begin(line.find_first_not_of(" \t"));
+        if(begin == std::string::npos || line[begin] == '#')
+            continue;
+        size_t end(line.find_last_not_of(" \t\r"));
+        inputs.push_back(line.substr(begin, end - begin + 1));
+    }
+    return true;
+}
+
+/**
+ * @brief Concatenate a TTree of an input CAF file to the output CAF file.
+ * @details The baskets are copied without being decompressed. The first call
+ * for a given TTree clones it into the output CAF file.
+ * @param output The output CAF file.
+ * @param combined The combined output TTree (created on the first call).
+ * @param tree The input TTree.
+ */
+void append_tree(TFile & output, TTree *& combined, TTree * tree)
+{
+    dlp::ScopedTimer timer("append_tree");
+    output.cd();
+    if(!combined)
+    {
+        combined = tree->CloneTree(-1, "fast");
+        combined->ResetBranchAddresses();
+    }
+    else
+        combined->CopyEntries(tree, -1, "fast");
+}
+
+/**
+ * @brief Add the basket layout of a branch (and its sub-branches) to a
+ * fingerprint.
+ * @param hash The fingerprint (updated).
+ * @param branches The branches.
+ */
+void hash_baskets(uint64_t & hash, TObjArray * branches)
+{
+    auto mix([&hash](uint64_t value)
+    {
+        hash = (hash ^ value) * 0x100000001b3ULL;
+    });
+    for(int b(0); branches && b < branches->GetEntriesFast(); ++b)
+    {
+        TBranch * branch(static_cast<TBranch *>(branches->UncheckedAt(b)));
+        mix(branch->GetWriteBasket());
+        Int_t * bytes(branch->GetBasketBytes());
+        for(Int_t i(0); bytes && i < branch->GetWriteBasket(); ++i)
+            mix(bytes[i]);
+        hash_baskets(hash, branch->GetListOfBranches());
+    }
+}
+
+/**
+ * @brief Compute a fingerprint of a "GenieEvtRecTree".
+ * @details The shards of a CAF file carry basket-level copies of the
+ * "GenieEvtRecTree" of their source CAF file, so copies of the same TTree
+ * have the same number of entries, bytes and compressed bytes of every
+ * basket. The fingerprint is built from these, without reading any basket.
+ * @param tree The "GenieEvtRecTree" of an input CAF file.
+ * @return The fingerprint of the TTree.
+ */
+uint64_t genie_fingerprint(TTree * tree)
+{
+    uint64_t hash(0xcbf29ce484222325ULL);
+    for(Long64_t value : {tree->GetEntries(), tree->GetTotBytes(), tree->GetZipBytes()})
+        hash = (hash ^ uint64_t(value)) * 0x100000001b3ULL;
+    hash_baskets(hash, tree->GetListOfBranches());
+    return hash;
+}
+
+/**
+ * @brief Concatenate the records of an input CAF file to the output CAF
+ * file, shifting their GENIE indices.
+ * @details Without a shift, the baskets are concatenated without being
+ * decompressed (see @ref append_tree). Otherwise, each record is read, its
+ * GENIE indices are shifted (see @ref dlp::shift_genie_index) and it is
+ * written to the combined TTree.
+ * @param output The output CAF file.
+ * @param combined The combined "recTree" (created on the first call).
+ * @param tree The "recTree" of the input CAF file.
+ * @param genie_offset The offset added to the GENIE indices.
+ * @return True if the records were concatenated, false if the GENIE indices
+ * of the records cannot be shifted (flat CAF layout).
+ */
+bool append_records(TFile & output, TTree *& combined, TTree * tree, Long64_t genie_offset)
+{
+    if(genie_offset == 0)
+    {
+        append_tree(output, combined, tree);
+        return true;
+    }
+    if(!tree->GetBranch("rec") || (combined && !combined->GetBranch("rec")))
+        return false;
+
+    dlp::ScopedTimer timer("append_records");
+    output.cd();
+    caf::StandardRecord * rec(nullptr);
+    tree->SetBranchAddress("rec", &rec);
+    if(!combined)
+        combined = tree->CloneTree(0);
+    combined->SetBranchAddress("rec", &rec);
+    for(Long64_t n(0); n < tree->GetEntries(); ++n)
+    {
+        tree->GetEntry(n);
+        dlp::shift_genie_index(rec, genie_offset);
+        combined->Fill();
+    }
+    combined->ResetBranchAddresses();
+    tree->ResetBranchAddresses();
+    delete rec;
+    return true;
+}
+
+int main(int argc, char const * argv[])
+{
+    /**
+     * @brief Check that the required arguments are present.
+     * @details The first argument is the output CAF file. The remaining
+     * arguments are the input CAF files, which may also (or instead) be listed
+     * in the file passed with "--input-list".
+     */
+    dlp::Options options(argc, argv);
+    const std::vector<std::string> & args(options.positional());
+    if(args.size() < 1 || (args.size() < 2 && !options.has("input-list")))
+    {
+        std::cerr << "Usage: ./combine_cafs <output_caf_file> <input_caf_file(s)> [--input-list=<file>] [--allow-duplicates] [output options] [--report=<file>] [--progress=<seconds>] [logging options]" << std::endl;
+        return 0;
+    }
+
+    /**
+     * @brief Configure the instrumentation (if requested) and the logging of
+     * the job.
+     */
+    dlp::Instrumentation::get().configure(options);
+    dlp::Logger::get().configure(options);
+
+    std::vector<std::string> inputs(args.begin() + 1, args.end());
+    if(options.has("input-list") && !read_input_list(options.get("input-list"), inputs))
+        return 1;
+    bool allow_duplicates(options.has("allow-duplicates"));
+
+    /**
+     * @brief Configure the output CAF file.
+     * @details The compression setting of the output profile applies to the
+     * objects written by the combiner (histograms and key/value TTrees). The
+     * baskets of the concatenated TTrees keep the compression of the inputs.
+     */
+    TFile output(args[0].c_str(), "recreate");
+    dlp::apply_output_profile(output, dlp::parse_output_profile(options));
+
+    /**
+     * @brief Begin main loop over the input CAF files.
+     * @details Each input CAF file is closed before the next one is opened.
+     */
+    TTree * combined_rec(nullptr);
+    TTree * combined_genie(nullptr);
+    std::unordered_map<uint64_t, Long64_t> genie_offsets;
+    const std::vector<std::string> concatenated{"dlpMatchTree", "dlpXrefTree"};
+    std::vector<TTree *> combined_trees(concatenated.size(), nullptr);
+    TH1 * combined_pot(nullptr);
+    TH1 * combined_events(nullptr);
+    dlp::KeyValueTable env("env", "envtree");
+    dlp::KeyValueTable metadata("metadata", "metatree");
+    std::unordered_set<EventKey, EventKeyHash> seen;
+    size_t duplicates(0);
+    size_t combined_inputs(0);
+    for(size_t i(0); i < inputs.size(); ++i)
+    {
+        TFile input(inputs[i].c_str(), "read");
+        if(input.IsZombie())
+        {
+            dlp::Logger::get().log(dlp::LogLevel::kError, "open_file", "Unable to open input CAF file: ", inputs[i]);
+            continue;
+        }
+        TTree * rec_tree(input.Get<TTree>("recTree"));
+        if(!rec_tree)
+        {
+            dlp::Logger::get().log(dlp::LogLevel::kError, "open_file", "No recTree in input CAF file: ", inputs[i]);
+            continue;
+        }
+
+        duplicates += check_duplicates(rec_tree, seen, inputs[i]);
+
+        /**
+         * @brief Concatenate the "GenieEvtRecTree" (unless a copy of it has
+         * already been concatenated) and the records.
+         * @details The GENIE indices of the records are shifted by the
+         * first entry of their "GenieEvtRecTree" in the combined TTree.
+         */
+        Long64_t genie_offset(0);
+        if(TTree * genie_tree = input.Get<TTree>("GenieEvtRecTree"))
+        {
+            auto [it, inserted] = genie_offsets.emplace(genie_fingerprint(genie_tree), combined_genie ? combined_genie->GetEntries() : 0);
+            genie_offset = it->second;
+            if(inserted)
+                append_tree(output, combined_genie, genie_tree);
+            else
+                dlp::Logger::get().log(dlp::LogLevel::kInfo, "genie_tree", "The GenieEvtRecTree of ", inputs[i], " has already been combined (from another shard of the same CAF file).");
+        }
+        if(!append_records(output, combined_rec, rec_tree, genie_offset))
+        {
+            dlp::Logger::get().log(dlp::LogLevel::kError, "genie_tree", "Unable to shift the GENIE indices of the records of ", inputs[i], " (flat CAF layout). Combine the CAF files of each GenieEvtRecTree separately.");
+            return 1;
+        }
+        for(size_t t(0); t < concatenated.size(); ++t)
+        {
+            if(TTree * tree = input.Get<TTree>(concatenated[t].c_str()))
+                append_tree(output, combined_trees[t], tree);
+        }
+
+        /**
+         * @brief Sum the exposure histograms.
+         * @details The histograms are read as TH1, as "make_standalone"
+         * writes them as TH1F and "merge_sources" copies the TH1D of its
+         * input CAF file.
+         */
+        TH1 * total_pot(input.Get<TH1>("TotalPOT"));
+        TH1 * total_events(input.Get<TH1>("TotalEvents"));
+        if(!total_pot || !total_events)
+        {
+            dlp::Logger::get().log(dlp::LogLevel::kError, "exposure", "No TotalPOT or TotalEvents histogram in ", inputs[i], ". Its exposure is missing from the combined CAF file.");
+        }
+        else
+        {
+            if(!combined_pot)
+            {
+                combined_pot = (TH1*)total_pot->Clone();
+                combined_pot->SetDirectory(&output);
+                combined_events = (TH1*)total_events->Clone();
+                combined_events->SetDirectory(&output);
+            }
+            else
+            {
+                combined_pot->Add(total_pot);
+                combined_events->Add(total_events);
+            }
+        }
+
+        /**
+         * @brief Combine the key/value pairs and copy the remaining objects
+         * of the first input CAF file.
+         */
+        env.add(output, input);
+        metadata.add(output, input);
+        if(combined_inputs == 0)
+            dlp::copy_directory(&output, &input, {"recTree", "GenieEvtRecTree", "dlpMatchTree", "dlpXrefTree", "TotalPOT", "TotalEvents", "env", "metadata"});
+        ++combined_inputs;
+
+        dlp::Logger::get().log(dlp::LogLevel::kInfo, "combined", "Combined ", rec_tree->GetEntries(), " records of ", inputs[i], " (", i+1, "/", inputs.size(), ").");
+        input.Close();
+    }
+
+    /**
+     * @brief Write and close the output CAF file.
+     */
+    output.cd();
+    if(combined_rec)
+        combined_rec->Write();
+    if(combined_genie)
+        combined_genie->Write();
+    for(TTree * tree : combined_trees)
+    {
+        if(tree)
+            tree->Write();
+    }
+    if(combined_pot)
+    {
+        combined_pot->Write();
+        combined_events->Write();
+    }
+    env.Write(output);
+    metadata.Write(output);
+    Long64_t records(combined_rec ? combined_rec->GetEntries() : 0);
+    output.Close();
+
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "combined", "Combined ", records, " records from ", combined_inputs, " / ", inputs.size(), " input CAF file(s) with ", duplicates, " duplicate (Run, Subrun, Event No.) key(s).");
+    if(duplicates > 0 && !allow_duplicates)
+    {
+        dlp::Logger::get().log(dlp::LogLevel::kError, "duplicate_event", "Found duplicate records. Pass --allow-duplicates to accept them.");
+        return 1;
+    }
+    return combined_inputs == inputs.size() ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file aux_copier.h
+ * @brief Declaration of the AuxCopier class for copying the auxiliary objects
+ * of an input CAF file to the output CAF file.
+ * @author mueller@fnal.gov
+*/
+#ifndef AUX_COPIER_H
+#define AUX_COPIER_H
+
+#include <set>
+#include <string>
+#include <memory>
+#include <future>
+
+#include "TFile.h"
+#include "TDirectory.h"
+
+namespace dlp
+{
+    /**
+     * @brief Copy all objects of a directory (except the skipped ones) to
+     * another directory.
+     * @details Sub-directories are copied recursively and TTrees are cloned
+     * at the basket level (without decompressing and deserializing their
+     * entries). All other objects (e.g. the "TotalPOT" and "TotalEvents"
+     * histograms) are read and written as-is. Only the highest cycle of each
+     * key is copied.
+     * @param output The output directory.
+     * @param input The input directory.
+     * @param skip The names of the objects which are not copied.
+    */
+    void copy_directory(TDirectory * output, TDirectory * input, const std::set<std::string> & skip = {});
+
+    /**
+     * @brief A class copying the auxiliary objects of an input CAF file to the
+     * output CAF file while the job sets up its inputs.
+     *
+     * Everything in an input CAF file other than the "recTree" TTree (the
+     * "env" and "metadata" key/value trees, the "TotalPOT" and "TotalEvents"
+     * histograms and, for simulation, the "globalTree" and "GenieEvtRecTree"
+     * TTrees) is copied unchanged to the output CAF file, once, with
+     * basket-level clones written directly into the output CAF file. The
+     * copy runs on a separate thread (with its own handle on the input file)
+     * from the construction of the copier until @ref Wait, so it overlaps
+     * with whatever the job does in between, e.g. building the index of the
+     * input HDF5 files. A TFile cannot be written from two threads, so the
+     * output CAF file must not be used by the caller until @ref Wait has
+     * returned, which also means that the copy cannot overlap with the event
+     * loop.
+    */
+    class AuxCopier
+    {
+        public:
+        /**
+         * @brief A constructor for the AuxCopier class.
+         * @details The copy starts immediately on a separate thread.
+         * @param input_path The path of the input CAF file.
+         * @param output The output CAF file (must outlive the copy).
+         * @param skip The names of additional top-level objects which are not
+         * copied (the "recTree" TTree is never copied).
+        */
+        AuxCopier(const std::string & input_path, TFile & output, const std::set<std::string> & skip = {});
+
+        /**
+         * @brief A destructor for the AuxCopier class.
+         * @details Waits for the copy to finish if @ref Wait was not called.
+        */
+        ~AuxCopier();
+
+        /**
+         * @brief Wait for the copy to finish.
+         * @details The output CAF file is made the current directory again,
+         * so that the caller may create its own objects in it.
+         * @throw std::runtime_error if the input CAF file could not be read.
+        */
+        void Wait();
+
+        private:
+        TFile & fOutput;
+        std::future<void> fResult;
+    };
+} // namespace dlp
+#endif // AUX_COPIER_H
@@ -0,0 +1,253 @@
+/**
+ * @file caf_fields.h
+ * @brief The lists of the fields copied from the SPINE data products into the
+ * ML reconstruction classes of the StandardRecord.
+ * @details Each list is an "X macro" which expands its argument once for each
+ * field of the CAF class, with the name of the field. The field has the same
+ * name in the SPINE data product. The record fillers (see record_fillers.h)
+ * and the flat CAF writer (see flat_writer.h) are both generated from these
+ * lists, so a field added to a list is written in both output layouts.
+ * @author mueller@fnal.gov
+ */
+#ifndef CAF_FIELDS_H
+#define CAF_FIELDS_H
+
+/**
+ * @brief The fields of the caf::SRInteractionDLP class (reconstructed
+ * interactions). The "particles" collection is filled separately.
+ */
+#define DLP_RECO_INTERACTION_FIELDS(X) \
+    X(cathode_offset) \
+    X(depositions_sum) \
+    X(flash_hypo_pe) \
+    X(flash_ids) \
+    X(flash_scores) \
+    X(flash_times) \
+    X(flash_total_pe) \
+    X(flash_volume_ids) \
+    X(id) \
+    X(is_cathode_crosser) \
+    X(is_contained) \
+    X(is_fiducial) \
+    X(is_flash_matched) \
+    X(is_matched) \
+    X(is_time_contained) \
+    X(is_truth) \
+    X(match_ids) \
+    X(match_overlaps) \
+    X(module_ids) \
+    X(num_particles) \
+    X(num_primary_particles) \
+    X(particle_counts) \
+    X(particle_ids) \
+    X(primary_particle_counts) \
+    X(primary_particle_ids) \
+    X(size) \
+    X(topology) \
+    X(vertex)
+
+/**
+ * @brief The fields of the caf::SRParticleDLP class (reconstructed
+ * particles).
+ */
+#define DLP_RECO_PARTICLE_FIELDS(X) \
+    X(axial_spread) \
+    X(calo_ke) \
+    X(cathode_offset) \
+    X(chi2_per_pid) \
+    X(chi2_pid) \
+    X(csda_ke) \
+    X(csda_ke_per_pid) \
+    X(depositions_sum) \
+    X(directional_spread) \
+    X(end_dir) \
+    X(end_point) \
+    X(fragment_ids) \
+    X(id) \
+    X(interaction_id) \
+    X(is_cathode_crosser) \
+    X(is_contained) \
+    X(is_matched) \
+    X(is_primary) \
+    X(is_time_contained) \
+    X(is_truth) \
+    X(is_valid) \
+    X(ke) \
+    X(length) \
+    X(mass) \
+    X(match_ids) \
+    X(match_overlaps) \
+    X(mcs_ke) \
+    X(mcs_ke_per_pid) \
+    X(module_ids) \
+    X(momentum) \
+    X(num_fragments) \
+    X(p) \
+    X(pdg_code) \
+    X(pid) \
+    X(pid_scores) \
+    X(ppn_ids) \
+    X(primary_scores) \
+    X(shape) \
+    X(size) \
+    X(start_dedx) \
+    X(start_dir) \
+    X(start_point) \
+    X(start_straightness) \
+    X(vertex_distance)
+
+/**
+ * @brief The fields of the caf::SRInteractionTruthDLP class (true
+ * interactions). The "particles" collection is filled separately.
+ */
+#define DLP_TRUE_INTERACTION_FIELDS(X) \
+    X(bjorken_x) \
+    X(cathode_offset) \
+    X(creation_process) \
+    X(current_type) \
+    X(depositions_adapt_q_sum) \
+    X(depositions_adapt_sum) \
+    X(depositions_g4_sum) \
+    X(depositions_q_sum) \
+    X(depositions_sum) \
+    X(distance_travel) \
+    X(energy_init) \
+    X(energy_transfer) \
+    X(flash_hypo_pe) \
+    X(flash_ids) \
+    X(flash_scores) \
+    X(flash_times) \
+    X(flash_total_pe) \
+    X(flash_volume_ids) \
+    X(hadronic_invariant_mass) \
+    X(id) \
+    X(inelasticity) \
+    X(interaction_mode) \
+    X(interaction_type) \
+    X(is_cathode_crosser) \
+    X(is_contained) \
+    X(is_fiducial) \
+    X(is_flash_matched) \
+    X(is_matched) \
+    X(is_time_contained) \
+    X(is_truth) \
+    X(lepton_p) \
+    X(lepton_pdg_code) \
+    X(lepton_track_id) \
+    X(match_ids) \
+    X(match_overlaps) \
+    X(mct_index) \
+    X(module_ids) \
+    X(momentum) \
+    X(momentum_transfer) \
+    X(momentum_transfer_mag) \
+    X(nu_id) \
+    X(nucleon) \
+    X(num_particles) \
+    X(num_primary_particles) \
+    X(orig_id) \
+    X(particle_counts) \
+    X(particle_ids) \
+    X(pdg_code) \
+    X(position) \
+    X(primary_particle_counts) \
+    X(primary_particle_ids) \
+    X(quark) \
+    X(reco_vertex) \
+    X(size) \
+    X(size_adapt) \
+    X(size_g4) \
+    X(target) \
+    X(theta) \
+    X(topology) \
+    X(track_id) \
+    X(vertex)
+
+/**
+ * @brief The fields of the caf::SRParticleTruthDLP class (true particles).
+ */
+#define DLP_TRUE_PARTICLE_FIELDS(X) \
+    X(ancestor_creation_process) \
+    X(ancestor_pdg_code) \
+    X(ancestor_position) \
+    X(ancestor_t) \
+    X(ancestor_track_id) \
+    X(calo_ke) \
+    X(cathode_offset) \
+    X(children_counts) \
+    X(children_id) \
+    X(creation_process) \
+    X(csda_ke) \
+    X(csda_ke_per_pid) \
+    X(depositions_adapt_q_sum) \
+    X(depositions_adapt_sum) \
+    X(depositions_g4_sum) \
+    X(depositions_q_sum) \
+    X(depositions_sum) \
+    X(distance_travel) \
+    X(end_dir) \
+    X(end_momentum) \
+    X(end_p) \
+    X(end_point) \
+    X(end_position) \
+    X(end_t) \
+    X(energy_deposit) \
+    X(energy_init) \
+    X(first_step) \
+    X(fragment_ids) \
+    X(group_id) \
+    X(group_primary) \
+    X(id) \
+    X(interaction_id) \
+    X(interaction_primary) \
+    X(is_cathode_crosser) \
+    X(is_contained) \
+    X(is_matched) \
+    X(is_primary) \
+    X(is_time_contained) \
+    X(is_truth) \
+    X(is_valid) \
+    X(ke) \
+    X(last_step) \
+    X(length) \
+    X(mass) \
+    X(match_ids) \
+    X(match_overlaps) \
+    X(mcs_ke) \
+    X(mcs_ke_per_pid) \
+    X(mcst_index) \
+    X(mct_index) \
+    X(module_ids) \
+    X(momentum) \
+    X(nu_id) \
+    X(num_fragments) \
+    X(num_voxels) \
+    X(orig_children_id) \
+    X(orig_group_id) \
+    X(orig_id) \
+    X(orig_interaction_id) \
+    X(orig_parent_id) \
+    X(p) \
+    X(parent_creation_process) \
+    X(parent_id) \
+    X(parent_pdg_code) \
+    X(parent_position) \
+    X(parent_t) \
+    X(parent_track_id) \
+    X(pdg_code) \
+    X(pid) \
+    X(position) \
+    X(reco_end_dir) \
+    X(reco_ke) \
+    X(reco_length) \
+    X(reco_momentum) \
+    X(reco_start_dir) \
+    X(shape) \
+    X(size) \
+    X(size_adapt) \
+    X(size_g4) \
+    X(start_dir) \
+    X(start_point) \
+    X(t) \
+    X(track_id)
+#endif // CAF_FIELDS_H
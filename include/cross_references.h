@@ -0,0 +1,140 @@
+/**
+ * @file cross_references.h
+ * @brief Declaration of the CrossReferenceBuilder class for resolving the ID
+ * references between the ML objects of a StandardRecord into positions.
+ * @author mueller@fnal.gov
+*/
+#ifndef CROSS_REFERENCES_H
+#define CROSS_REFERENCES_H
+
+#include <vector>
+#include <cstdint>
+
+#include "particle_hierarchy.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+namespace dlp
+{
+    /**
+     * @brief A flat (open addressing) hash map from object IDs to positions.
+     * @details The keys and values are stored in two flat arrays with a
+     * power-of-two size at least twice the number of keys, and collisions are
+     * resolved by linear probing. The arrays are reused when the map is reset,
+     * so no memory is allocated once the map has reached its largest size.
+    */
+    class FlatIdMap
+    {
+        public:
+        /**
+         * @brief Remove all keys and prepare the map for a number of keys.
+         * @param count The number of keys which will be inserted.
+        */
+        void reset(size_t count);
+
+        /**
+         * @brief Insert a key (the first position of a key is kept).
+         * @param id The key.
+         * @param position The value.
+        */
+        void insert(int64_t id, int32_t position);
+
+        /**
+         * @brief Find a key.
+         * @param id The key.
+         * @return The value of the key, or -1 if the key is not in the map.
+        */
+        int32_t find(int64_t id) const;
+
+        private:
+        std::vector<int64_t> fKeys;
+        std::vector<int32_t> fValues;
+        size_t fMask = 0;
+    };
+
+    /**
+     * @brief The resolved cross-references of the ML objects of one record.
+     *
+     * The interactions are identified by their position in "rec.dlp" or
+     * "rec.dlp_true". The particles are identified by their position in the
+     * concatenation of the particles of all interactions (the order of the
+     * flat CAF layout): particle k of the reconstructed interactions is
+     * "rec.dlp[i].particles[k - dlp_particle_offset[i]]" with
+     * i = "dlp_particle_interaction[k]". Each "*_index" vector is parallel to
+     * the concatenation of the corresponding ID lists (e.g. "dlp_match_index"
+     * to the "match_ids" of all reconstructed interactions) and holds the
+     * position of each referenced object, or -1 if it is not in the record.
+     * Each "*_begin" vector holds the offset of the list of each object in
+     * the corresponding "*_index" vector, followed by the size of that vector
+     * as an end sentinel, so that the list of object k is
+     * [begin[k], begin[k + 1]).
+    */
+    struct CrossReferenceRecord
+    {
+        std::vector<int32_t> dlp_particle_offset;               //!< The position of the first particle of each reconstructed interaction.
+        std::vector<int32_t> dlp_particle_interaction;          //!< The position of the interaction of each reconstructed particle.
+        std::vector<int32_t> dlp_match_begin;                   //!< The offset of the matches of each reconstructed interaction in "dlp_match_index" (with end sentinel).
+        std::vector<int32_t> dlp_match_index;                   //!< The positions of the "match_ids" of the reconstructed interactions.
+        std::vector<int32_t> dlp_particle_match_begin;          //!< The offset of the matches of each reconstructed particle in "dlp_particle_match_index" (with end sentinel).
+        std::vector<int32_t> dlp_particle_match_index;          //!< The positions of the "match_ids" of the reconstructed particles.
+        std::vector<int32_t> dlp_true_particle_offset;          //!< The position of the first particle of each true interaction.
+        std::vector<int32_t> dlp_true_particle_interaction;     //!< The position of the interaction of each true particle.
+        std::vector<int32_t> dlp_true_match_begin;              //!< The offset of the matches of each true interaction in "dlp_true_match_index" (with end sentinel).
+        std::vector<int32_t> dlp_true_match_index;              //!< The positions of the "match_ids" of the true interactions.
+        std::vector<int32_t> dlp_true_particle_match_begin;     //!< The offset of the matches of each true particle in "dlp_true_particle_match_index" (with end sentinel).
+        std::vector<int32_t> dlp_true_particle_match_index;     //!< The positions of the "match_ids" of the true particles.
+        std::vector<int32_t> dlp_true_particle_parent_index;    //!< The position of the "parent_id" of each true particle.
+        std::vector<int32_t> dlp_true_particle_children_begin;  //!< The offset of the children of each true particle in "dlp_true_particle_children_index" (with end sentinel).
+        std::vector<int32_t> dlp_true_particle_children_index;  //!< The positions of the "children_id" of the true particles.
+
+        /**
+         * @brief Remove all cross-references.
+        */
+        void clear();
+    };
+
+    /**
+     * @brief A class resolving the ID references between the ML objects of a
+     * StandardRecord into positions.
+     * @details The ID to position maps of the interactions and particles are
+     * built once per record (see @ref FlatIdMap), so that every reference is
+     * resolved in constant time. The hierarchy of the true particles (see
+     * @ref ParticleHierarchy) is then built from the resolved parents. The
+     * builder reuses its buffers from record to record, so it must not be
+     * shared between threads.
+    */
+    class CrossReferenceBuilder
+    {
+        public:
+        /**
+         * @brief Resolve the cross-references of a StandardRecord.
+         * @param rec The StandardRecord.
+        */
+        void Build(const caf::StandardRecord & rec);
+
+        /**
+         * @brief Get the cross-references of the last record.
+         * @return The cross-references of the last record.
+        */
+        const CrossReferenceRecord & record() const { return fRecord; }
+
+        /**
+         * @brief Get the hierarchy of the true particles of the last record.
+         * @details A particle is visible if it has at least one voxel
+         * ("size").
+         * @return The hierarchy of the true particles of the last record.
+        */
+        const ParticleHierarchy & hierarchy() const { return fHierarchy; }
+
+        private:
+        CrossReferenceRecord fRecord;
+        ParticleHierarchy fHierarchy;
+        std::vector<uint8_t> fPrimary;
+        std::vector<uint8_t> fVisible;
+        FlatIdMap fRecoInteractions;
+        FlatIdMap fRecoParticles;
+        FlatIdMap fTrueInteractions;
+        FlatIdMap fTrueParticles;
+    };
+} // namespace dlp
+#endif // CROSS_REFERENCES_H
@@ -0,0 +1,116 @@
+/**
+ * @file daemon_protocol.h
+ * @brief Declaration of the functions for exchanging job requests between the
+ * CAF maker daemon and its client over a local UNIX domain socket.
+ * @author mueller@fnal.gov
+*/
+#ifndef DAEMON_PROTOCOL_H
+#define DAEMON_PROTOCOL_H
+
+#include <string>
+#include <vector>
+
+namespace dlp
+{
+    /**
+     * @brief A job request sent by the client to the daemon.
+     *
+     * A request is the equivalent of one invocation of a CAF maker
+     * executable: the name of the executable, its command line arguments and
+     * the working directory and standard streams of the caller. The standard
+     * streams are passed as file descriptors (SCM_RIGHTS), so the output of
+     * the job appears exactly where the output of the executable would.
+    */
+    struct JobRequest
+    {
+        std::string program;                    //!< The name of the executable (e.g. "merge_sources_simulation").
+        std::string directory;                  //!< The working directory of the caller.
+        std::vector<std::string> arguments;     //!< The command line arguments (without the program name).
+        int descriptors[3] = {-1, -1, -1};      //!< The standard input, output and error of the caller.
+    };
+
+    /**
+     * @brief Split the name of an executable into the job and the flavor.
+     * @details The flavor ("simulation" or "data") is removed from the name,
+     * e.g. "merge_sources_simulation_multi" is the job "merge_sources_multi"
+     * of the "simulation" flavor. Leading directories are ignored.
+     * @param program The name (or path) of the executable.
+     * @param job The name of the job (output).
+     * @param flavor The flavor of the executable (output).
+     * @return True if the name contains a flavor.
+    */
+    bool split_program(const std::string & program, std::string & job, std::string & flavor);
+
+    /**
+     * @brief Get the default path of the socket of the daemon of a flavor.
+     * @details The socket is "sbn_ml_cafmaker_<flavor>_<uid>.sock" in
+     * $CAFMAKER_SOCKET_DIR, $XDG_RUNTIME_DIR or /tmp (the first one which is
+     * set).
+     * @param flavor The flavor of the daemon ("simulation" or "data").
+     * @return The path of the socket.
+    */
+    std::string default_socket_path(const std::string & flavor);
+
+    /**
+     * @brief Create the listening socket of the daemon.
+     * @details A stale socket file (no daemon listening) is replaced. The
+     * socket is only accessible to the owner.
+     * @param path The path of the socket.
+     * @return The file descriptor of the listening socket.
+     * @throw std::runtime_error if the socket cannot be created or another
+     * daemon is already listening on it.
+    */
+    int listen_socket(const std::string & path);
+
+    /**
+     * @brief Connect to the daemon.
+     * @param path The path of the socket.
+     * @return The file descriptor of the connection.
+     * @throw std::runtime_error if no daemon is listening on the socket.
+    */
+    int connect_socket(const std::string & path);
+
+    /**
+     * @brief Check that the peer of a connection is the owner of the process.
+     * @details This is only checked on systems with SO_PEERCRED (the socket
+     * file permissions apply everywhere).
+     * @param connection The file descriptor of the connection.
+     * @return True if the peer is run by the same user.
+    */
+    bool trusted_peer(int connection);
+
+    /**
+     * @brief Send a job request to the daemon.
+     * @param connection The file descriptor of the connection.
+     * @param request The job request.
+     * @throw std::runtime_error if the request cannot be sent.
+    */
+    void send_request(int connection, const JobRequest & request);
+
+    /**
+     * @brief Receive a job request from a client.
+     * @details The received file descriptors are owned by the caller.
+     * @param connection The file descriptor of the connection.
+     * @param request The job request (output).
+     * @throw std::runtime_error if the request is malformed or incomplete.
+    */
+    void receive_request(int connection, JobRequest & request);
+
+    /**
+     * @brief Send the exit status of a job to the client.
+     * @param connection The file descriptor of the connection.
+     * @param status The exit status of the job.
+     * @return True if the status was sent (the client may be gone).
+    */
+    bool send_status(int connection, int status);
+
+    /**
+     * @brief Wait for the exit status of the job.
+     * @param connection The file descriptor of the connection.
+     * @return The exit status of the job.
+     * @throw std::runtime_error if the connection is closed before the status
+     * is received.
+    */
+    int receive_status(int connection);
+} // namespace dlp
+#endif // DAEMON_PROTOCOL_H
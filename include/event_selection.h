@@ -0,0 +1,98 @@
+/**
+ * @file event_selection.h
+ * @brief Declaration of the EventSelection struct for processing a range,
+ * a shard or a deterministic sample of the input events.
+ * @author mueller@fnal.gov
+*/
+#ifndef EVENT_SELECTION_H
+#define EVENT_SELECTION_H
+
+#include <set>
+#include <string>
+#include <limits>
+#include <cstdint>
+#include <utility>
+#include "options.h"
+
+namespace dlp
+{
+    /**
+     * @brief A struct describing which input entries a job processes.
+     *
+     * The selection is applied in three steps to the (global) entry numbers
+     * of the input: the entries are first restricted to the range given by
+     * "--entries", this range is then split into "nshards" contiguous
+     * shards of (nearly) equal size of which only shard "shard" is kept, and
+     * finally each remaining entry is kept with probability "fraction".
+     * Since the shards are contiguous and the sampling of an entry depends
+     * only on its entry number and the seed, concatenating the outputs of all
+     * shards (in order) gives the same entries, in the same order, as a
+     * single job over the whole range. The skipped entries are never read.
+    */
+    struct EventSelection
+    {
+        uint64_t first = 0;                     //!< The first entry of the range.
+        uint64_t last = std::numeric_limits<uint64_t>::max(); //!< One past the last entry of the range.
+        uint64_t shard = 0;                     //!< The index of the shard to process.
+        uint64_t nshards = 1;                   //!< The number of shards.
+        double fraction = 1;                    //!< The fraction of entries to sample.
+        uint64_t seed = 0;                      //!< The seed of the sampling.
+        bool requested = false;                 //!< True if any selection option was passed.
+
+        /**
+         * @brief Check if the selection may skip any entry.
+         * @return True if any selection option was passed.
+        */
+        bool active() const { return requested; }
+
+        /**
+         * @brief Get the range of entries of the shard.
+         * @param nentries The total number of entries of the input.
+         * @return The first and one past the last entry of the shard.
+        */
+        std::pair<uint64_t, uint64_t> range(uint64_t nentries) const;
+
+        /**
+         * @brief Check if an entry is kept by the sampling.
+         * @details The decision is a pure function of the entry number and
+         * the seed, so it does not depend on the shard being processed.
+         * @param entry The (global) entry number.
+         * @return True if the entry is kept.
+        */
+        bool sampled(uint64_t entry) const;
+    };
+
+    /**
+     * @brief Build the event selection from the command line options.
+     * @details The following options are recognized:
+     * - "--entries=<first>:<last>" processes the entries [first, last).
+     * Either bound may be omitted.
+     * - "--shard=<i>/<N>" processes the i-th (zero-based) of N contiguous
+     * shards of the entries.
+     * - "--sample=<fraction>" keeps each entry with probability <fraction>.
+     * - "--seed=<seed>" sets the seed of the sampling (default 0).
+     * @param options The command line options.
+     * @return The event selection.
+     * @throw std::runtime_error if an option has an invalid value.
+    */
+    EventSelection parse_event_selection(const Options & options);
+
+    /**
+     * @brief Get the names of the auxiliary objects of the input CAF file
+     * which must be recomputed for the selected entries.
+     * @details If the selection is active, the "TotalPOT" and "TotalEvents"
+     * histograms describe the exposure of the whole input, so they are not
+     * copied but recomputed from the selected records.
+     * @param selection The event selection.
+     * @return The names of the objects (empty if the selection is inactive).
+    */
+    std::set<std::string> recomputed_objects(const EventSelection & selection);
+
+    /**
+     * @brief Get a human-readable description of the event selection.
+     * @param selection The event selection.
+     * @return The description of the event selection.
+    */
+    std::string describe_event_selection(const EventSelection & selection);
+} // namespace dlp
+#endif // EVENT_SELECTION_H
@@ -0,0 +1,106 @@
+/**
+ * @file event_validation.h
+ * @brief Declaration of the EventValidity class and the function for
+ * validating the region references of the events of an HDF5 file.
+ * @author mueller@fnal.gov
+*/
+#ifndef EVENT_VALIDATION_H
+#define EVENT_VALIDATION_H
+
+#include <vector>
+#include <cstdint>
+#include "H5Cpp.h"
+#include "event.h"
+
+namespace dlp
+{
+    /**
+     * @brief The bits identifying each data product in an @ref EventValidity
+     * bitmap.
+    */
+    enum ProductBit : uint8_t
+    {
+        kRunInfoBit = 1 << 0,                   //!< The "run_info" reference.
+        kRecoInteractionBit = 1 << 1,           //!< The "reco_interactions" reference.
+        kRecoParticleBit = 1 << 2,              //!< The "reco_particles" reference.
+        kTruthInteractionBit = 1 << 3,          //!< The "truth_interactions" reference.
+        kTruthParticleBit = 1 << 4              //!< The "truth_particles" reference.
+    };
+
+    /**
+     * @brief A class holding the validity of the region references of the
+     * events of a file.
+     *
+     * Each event has one byte in which the bit of each data product (see
+     * @ref ProductBit) is set if the reference to that product is invalid. An
+     * event is valid if none of its bits is set, in which case all of its
+     * products can be read by get_product<T> without an exception.
+    */
+    class EventValidity
+    {
+        public:
+        /**
+         * @brief A constructor for the EventValidity class.
+         * @param nevents The number of events (all initially valid).
+        */
+        explicit EventValidity(size_t nevents = 0) : fInvalid(nevents, 0) {}
+
+        /**
+         * @brief Mark the reference of a product of an event as invalid.
+         * @param e The index of the event.
+         * @param bit The bit of the product.
+        */
+        void invalidate(size_t e, ProductBit bit) { fInvalid[e] |= bit; }
+
+        /**
+         * @brief Check if all references of an event are valid.
+         * @param e The index of the event.
+         * @return True if the event is valid.
+        */
+        bool valid(size_t e) const { return fInvalid[e] == 0; }
+
+        /**
+         * @brief Get the bits of the products with invalid references.
+         * @param e The index of the event.
+         * @return The bits of the invalid products of the event.
+        */
+        uint8_t invalid_products(size_t e) const { return fInvalid[e]; }
+
+        /**
+         * @brief Get the number of events.
+         * @return The number of events.
+        */
+        size_t size() const { return fInvalid.size(); }
+
+        /**
+         * @brief Append the validity of the events following the current
+         * ones (e.g. the events appended to a followed file).
+         * @param other The validity of the following events.
+        */
+        void append(const EventValidity & other) { fInvalid.insert(fInvalid.end(), other.fInvalid.begin(), other.fInvalid.end()); }
+
+        /**
+         * @brief Get the number of invalid events.
+         * @return The number of events with at least one invalid reference.
+        */
+        size_t invalid_count() const;
+
+        private:
+        std::vector<uint8_t> fInvalid;
+    };
+
+    /**
+     * @brief Validate the region references of all events of a file.
+     * @details Each reference is checked in a single pass, without reading
+     * the referenced records and without exceptions: a reference is invalid if
+     * it is null, if its region cannot be retrieved, or if its selection is
+     * outside of the extent of the referenced dataset. The number of invalid
+     * references of each product is added to the counters of the
+     * @ref Instrumentation (e.g. "invalid_ref<RecoParticle>").
+     * @param file The HDF5 file.
+     * @param events The events of the file.
+     * @return The validity of the events.
+    */
+    EventValidity validate_events(H5::H5File & file, const std::vector<types::Event> & events);
+} // namespace dlp
+#endif // EVENT_VALIDATION_H
@@ -0,0 +1,275 @@
+/**
+ * @file file_pool.h
+ * @brief Declaration of the FilePool and EventIndex classes for managing a
+ * large number of input HDF5 files.
+ * @author mueller@fnal.gov
+*/
+#ifndef FILE_POOL_H
+#define FILE_POOL_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "H5Cpp.h"
+#include "event.h"
+#include "event_validation.h"
+#include "product_reader.h"
+#include "options.h"
+
+namespace dlp
+{
+    /**
+     * @brief A compact record locating a single event within a set of input
+     * HDF5 files.
+    */
+    struct EventLocation
+    {
+        uint32_t file;                          //!< Index of the file in the FilePool.
+        uint32_t entry;                         //!< Index of the event within the file.
+    };
+
+    /**
+     * @brief A class representing a global (Run, Subrun, Event No.) index over
+     * a set of input HDF5 files.
+     *
+     * The index is stored as a single flat vector of 20-byte records which is
+     * sorted once after all events have been inserted. Lookups are performed
+     * by binary search. This keeps the memory footprint of the index small and
+     * independent of the number of files, which is not the case for a node-
+     * based map of per-file event vectors.
+    */
+    class EventIndex
+    {
+        public:
+        /**
+         * @brief Insert an event into the index.
+         * @details The index must be finalized with @ref build() after all
+         * events have been inserted. If the same (Run, Subrun, Event No.) is
+         * inserted more than once, the first insertion takes precedence.
+         * @param run The run number of the event.
+         * @param subrun The subrun number of the event.
+         * @param event The event number of the event.
+         * @param location The location of the event in the input files.
+        */
+        void insert(int64_t run, int64_t subrun, int64_t event, EventLocation location);
+
+        /**
+         * @brief Sort the index so that it may be searched.
+        */
+        void build();
+
+        /**
+         * @brief Find the location of an event in the index.
+         * @param run The run number of the event.
+         * @param subrun The subrun number of the event.
+         * @param event The event number of the event.
+         * @return A pointer to the location of the event, or nullptr if the
+         * event is not present in the index.
+        */
+        const EventLocation * find(int64_t run, int64_t subrun, int64_t event) const;
+
+        /**
+         * @brief Check if the index holds an event which comes after the
+         * given one.
+         * @details SPINE writes the events of a file in order, so an event
+         * of a followed file which is missing once a later event has been
+         * indexed is not going to be appended anymore.
+         * @param run The run number of the event.
+         * @param subrun The subrun number of the event.
+         * @param event The event number of the event.
+         * @return True if an event with a larger (Run, Subrun, Event No.) is
+         * present in the index.
+        */
+        bool passed(int64_t run, int64_t subrun, int64_t event) const;
+
+        /**
+         * @brief Get the number of events in the index.
+         * @return The number of events in the index.
+        */
+        size_t size() const;
+
+        private:
+        struct Record
+        {
+            uint32_t run;
+            uint32_t subrun;
+            uint32_t event;
+            EventLocation location;
+        };
+        std::vector<Record> fRecords;
+    };
+
+    /**
+     * @brief A class managing a bounded pool of open input HDF5 files.
+     *
+     * Input files are opened on demand when first requested and are kept
+     * open in least-recently-used order. When the number of open files would
+     * exceed the configured maximum, the least-recently-used file is closed
+     * and its list of dlp::types::Event objects is released. This bounds both
+     * the number of open file descriptors and the memory used by the event
+     * lists, regardless of the number of input files. The region references
+     * of the events of each file are validated when the file is first opened
+     * (see @ref validate_events) and the (small) validity bitmap is kept for
+     * the lifetime of the pool, so that invalid events can be skipped without
+     * reading them. The products of the files are read with the
+     * ProductReader of the pool (see @ref reader), which is cleared whenever
+     * a file is closed or reopened, as its open datasets would otherwise keep
+     * the file open past the bound on the number of open files.
+    */
+    class FilePool
+    {
+        public:
+        /**
+         * @brief A constructor for the FilePool class.
+         * @param paths The list of input HDF5 files.
+         * @param max_open The maximum number of files to keep open at once.
+         * @param access The access flags of the files (see
+         * @ref input_access_flags).
+        */
+        FilePool(const std::vector<std::string> & paths, size_t max_open = 16, unsigned int access = H5F_ACC_RDONLY);
+
+        /**
+         * @brief Get the handle to the requested file, opening it if needed.
+         * @param f The index of the file in the pool.
+         * @return The handle to the open H5 file.
+        */
+        H5::H5File & file(size_t f);
+
+        /**
+         * @brief Get the list of events in the requested file, opening it if
+         * needed.
+         * @param f The index of the file in the pool.
+         * @return The list of dlp::types::Event objects in the file.
+        */
+        std::vector<types::Event> & events(size_t f);
+
+        /**
+         * @brief Get the validity of the events in the requested file,
+         * opening it if it has not been validated yet.
+         * @param f The index of the file in the pool.
+         * @return The validity of the events in the file.
+        */
+        const EventValidity & validity(size_t f);
+
+        /**
+         * @brief Read the events appended to the requested file since its
+         * events were last read, opening it if needed.
+         * @details The new events are validated and appended to the list of
+         * events and to the validity of the file (see @ref get_new_events).
+         * @param f The index of the file in the pool.
+         * @return The number of new events.
+        */
+        size_t refresh(size_t f);
+
+        /**
+         * @brief Get the path of the requested file.
+         * @param f The index of the file in the pool.
+         * @return The path of the file.
+        */
+        const std::string & path(size_t f) const;
+
+        /**
+         * @brief Get the number of files managed by the pool.
+         * @return The number of files managed by the pool.
+        */
+        size_t size() const;
+
+        /**
+         * @brief Get the number of files that are currently open.
+         * @return The number of files that are currently open.
+        */
+        size_t open_count() const;
+
+        /**
+         * @brief Get the number of times any file has been opened.
+         * @details A value much larger than @ref size() indicates that the
+         * access pattern is thrashing the pool and that the maximum number of
+         * open files should be increased.
+         * @return The number of times any file has been opened.
+        */
+        size_t open_calls() const;
+
+        /**
+         * @brief Get the reader of the products of the files of the pool.
+         * @details The reader is cleared when a file is evicted, refreshed
+         * or closed, so the products it returned must not be used past the
+         * next call of the pool which may open a file.
+         * @return The reader of the pool.
+        */
+        ProductReader & reader();
+
+        /**
+         * @brief Close all open files and release their event lists.
+        */
+        void close_all();
+
+        private:
+        struct Handle
+        {
+            H5::H5File file;
+            std::vector<types::Event> events;
+            std::list<size_t>::iterator position;
+        };
+
+        /**
+         * @brief Retrieve the handle for the requested file, opening it and
+         * evicting the least-recently-used file if needed.
+         * @param f The index of the file in the pool.
+         * @return The handle for the file.
+        */
+        Handle & acquire(size_t f);
+
+        /**
+         * @brief Validate the events of a file which have not been validated
+         * yet.
+         * @param f The index of the file in the pool.
+         * @param handle The handle for the file.
+        */
+        void validate(size_t f, Handle & handle);
+
+        std::vector<std::string> fPaths;
+        size_t fMaxOpen;
+        unsigned int fAccess;
+        size_t fOpenCalls;
+        std::list<size_t> fRecent;
+        std::unordered_map<size_t, std::unique_ptr<Handle>> fOpen;
+        std::unordered_map<size_t, EventValidity> fValidity;
+        ProductReader fReader;
+    };
+
+    /**
+     * @brief Build the global event index over all files in the pool.
+     * @details Each file is visited once in order, so at most one file needs
+     * to be open at a time while the index is built.
+     * @param pool The pool of input HDF5 files.
+     * @return The global event index.
+    */
+    EventIndex build_event_index(FilePool & pool);
+
+    /**
+     * @brief Add the events appended to the files of the pool to the global
+     * event index.
+     * @details Each file is refreshed (see @ref FilePool::refresh) and its new
+     * events are inserted into the index, which is then sorted again. This is
+     * used to follow input files which are still being written (see
+     * @ref FollowConfig).
+     * @param index The global event index (updated).
+     * @param pool The pool of input HDF5 files.
+     * @return The number of new events.
+    */
+    size_t refresh_event_index(EventIndex & index, FilePool & pool);
+
+    /**
+     * @brief Read the maximum number of open files of a @ref FilePool from the
+     * command line options.
+     * @details The value is given by "--max-open-files=N" (default 16).
+     * @param options The command line options.
+     * @return The maximum number of files to keep open at once.
+     * @throw std::runtime_error if the value is less than 1.
+    */
+    size_t parse_max_open_files(const Options & options);
+} // namespace dlp
+#endif // FILE_POOL_H
@@ -0,0 +1,63 @@
+/**
+ * @file flat_writer.h
+ * @brief Declaration of the FlatMLRecord class for writing the ML
+ * reconstruction branches of the StandardRecord in the flat CAF layout.
+ * @author mueller@fnal.gov
+*/
+#ifndef FLAT_WRITER_H
+#define FLAT_WRITER_H
+
+#include <memory>
+#include <string>
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+#include "TTree.h"
+
+namespace dlp
+{
+    /**
+     * @brief A class writing the ML reconstruction outputs of the
+     * StandardRecord ("dlp" and "dlp_true") as flat branches.
+     *
+     * Each field copied by the record fillers is registered in a field table
+     * for its CAF class, which creates one branch per field. Both are
+     * generated from the same field lists (see caf_fields.h). Vector-valued
+     * fields and nested collections follow the flat CAF convention of a
+     * "..length" and "..idx" branch alongside the values, which are
+     * concatenated over all objects in the event. Fixed-size arrays are
+     * concatenated with an implicit stride equal to the array size.
+    */
+    class FlatMLRecord
+    {
+        public:
+        /**
+         * @brief A constructor for the FlatMLRecord class.
+         * @param tree The output TTree on which to create the branches.
+         * @param prefix The prefix of the branch names (e.g. "rec").
+        */
+        FlatMLRecord(TTree * tree, const std::string & prefix = "rec");
+
+        /**
+         * @brief A destructor for the FlatMLRecord class.
+        */
+        ~FlatMLRecord();
+
+        /**
+         * @brief Clear the contents of all branches.
+        */
+        void Clear();
+
+        /**
+         * @brief Fill the branches with the ML reconstruction outputs of the
+         * StandardRecord.
+         * @param rec The StandardRecord containing the ML outputs.
+        */
+        void Fill(const caf::StandardRecord & rec);
+
+        private:
+        struct Tables;
+        std::unique_ptr<Tables> fTables;
+    };
+} // namespace dlp
+#endif // FLAT_WRITER_H
@@ -0,0 +1,151 @@
+/**
+ * @file follow.h
+ * @brief Declaration of the FollowConfig struct and the Follower class for
+ * converting the events of input HDF5 files while they are being written.
+ * @author mueller@fnal.gov
+*/
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#include <string>
+#include <chrono>
+#include <functional>
+#include "H5Cpp.h"
+#include "options.h"
+
+namespace dlp
+{
+    /**
+     * @brief A struct describing how the input HDF5 files are followed.
+     *
+     * In follow mode, the input HDF5 files are opened as SWMR (single writer,
+     * multiple readers) readers, so that they can be read while SPINE is
+     * still appending events to them. The files must be written in SWMR
+     * mode. The input is polled for new events, which are converted as they
+     * arrive, and the output CAF file is saved periodically so that it can
+     * be read while the job is running. The job ends once no new event has
+     * appeared for the idle timeout.
+    */
+    struct FollowConfig
+    {
+        bool active = false;                    //!< True if the input files are followed.
+        double poll = 1;                        //!< The interval between two polls of the input (seconds).
+        double idle = 60;                       //!< The time without new events after which the job ends (seconds).
+        double autosave = 10;                   //!< The minimum interval between two saves of the output (seconds).
+    };
+
+    /**
+     * @brief Build the follow configuration from the command line options.
+     * @details The following options are recognized:
+     * - "--follow[=<seconds>]" follows the input HDF5 files until no event
+     * has been appended for <seconds> seconds (default 60).
+     * - "--poll=<seconds>" sets the interval between two polls of the input
+     * (default 1 s).
+     * - "--autosave=<seconds>" sets the minimum interval between two saves
+     * of the output CAF file (default 10 s).
+     * @param options The command line options.
+     * @return The follow configuration.
+     * @throw std::runtime_error if an option has an invalid value.
+    */
+    FollowConfig parse_follow_config(const Options & options);
+
+    /**
+     * @brief Describe the follow configuration.
+     * @param config The follow configuration.
+     * @return A short description of the follow configuration.
+    */
+    std::string describe_follow_config(const FollowConfig & config);
+
+    /**
+     * @brief Get the access flags of the input HDF5 files.
+     * @param config The follow configuration.
+     * @return The flags passed to H5::H5File (read-only, and SWMR reader in
+     * follow mode).
+    */
+    unsigned int input_access_flags(const FollowConfig & config);
+
+    /**
+     * @brief A class waiting for new events in the followed input and
+     * pacing the saves of the output.
+     *
+     * The follower does not read the input or write the output itself: the
+     * caller provides a function which refreshes the input and returns the
+     * number of new events (e.g. get_new_events()), and a function which
+     * saves the output (e.g. RecordWriter::AutoSave()). The output is saved
+     * at most once per autosave interval, but the entries filled before the
+     * follower starts waiting are saved within one interval even if no new
+     * event arrives. Once the input has been idle for the idle timeout, the
+     * follower is finished: @ref wait() does not wait anymore, and
+     * @ref wait_for() polls the input once per call without sleeping, so
+     * that the events appended later are still found (and the follower
+     * resumes waiting if the input grows again).
+    */
+    class Follower
+    {
+        public:
+        /**
+         * @brief A constructor for the Follower class.
+         * @param config The follow configuration.
+         * @param refresh The function refreshing the input and returning the
+         * number of new events.
+         * @param save The function saving the output.
+        */
+        Follower(const FollowConfig & config, std::function<size_t()> refresh, std::function<void()> save);
+
+        /**
+         * @brief Wait for new events.
+         * @details The input is refreshed every poll interval until new events
+         * appear or the idle timeout expires. The unsaved entries of the
+         * output are saved when the autosave interval has elapsed.
+         * @return True if new events have appeared, false if the input has
+         * been idle for the idle timeout.
+        */
+        bool wait();
+
+        /**
+         * @brief Wait for new events until a condition holds.
+         * @details The condition is checked first and again after each
+         * refresh which adds new events, so the wait ends as soon as the
+         * input holds what the caller waits for (or shows that it is not
+         * going to arrive). Otherwise the input is refreshed every poll
+         * interval until the idle timeout expires. Once the follower is
+         * finished, the input is refreshed once and the call returns at
+         * once, so a condition which never holds (e.g. a missing event)
+         * costs one idle timeout in total, not one per call.
+         * @param condition The condition, evaluated after each refresh.
+         * @return True if the condition holds, false if the input has been
+         * idle for the idle timeout.
+        */
+        bool wait_for(const std::function<bool()> & condition);
+
+        /**
+         * @brief Record that an entry has been filled into the output.
+         * @details The output is saved if the autosave interval has elapsed
+         * since the last save.
+        */
+        void filled();
+
+        /**
+         * @brief Check if the follower is finished.
+         * @return True if the input has been idle for the idle timeout.
+        */
+        bool finished() const;
+
+        private:
+        /**
+         * @brief Save the unsaved entries of the output if the autosave
+         * interval has elapsed since the last save.
+        */
+        void save_if_due();
+
+        using Clock = std::chrono::steady_clock;
+        FollowConfig fConfig;
+        std::function<size_t()> fRefresh;
+        std::function<void()> fSave;
+        Clock::time_point fLastGrowth;
+        Clock::time_point fLastSave;
+        bool fUnsaved;
+        bool fFinished;
+    };
+} // namespace dlp
+#endif // FOLLOW_H
@@ -0,0 +1,70 @@
+/**
+ * @file input_profile.h
+ * @brief Declaration of the InputProfile struct for configuring the reading of
+ * the input CAF file.
+ * @author mueller@fnal.gov
+*/
+#ifndef INPUT_PROFILE_H
+#define INPUT_PROFILE_H
+
+#include <cstdint>
+#include "options.h"
+
+#include "TFile.h"
+#include "TTree.h"
+
+namespace dlp
+{
+    /**
+     * @brief A struct describing how the "recTree" TTree of an input CAF file
+     * is read.
+     *
+     * The entries of the input CAF file are read sequentially and copied to
+     * the output CAF file. Without an explicit cache, each basket is fetched
+     * with its own read call, which is slow on network-mounted storage. The
+     * profile configures a TTreeCache which prefetches the baskets of all
+     * needed branches for a whole cluster of entries in a few large reads.
+     * The ML reconstruction branches ("rec.dlp" and "rec.dlp_true") are always
+     * replaced by the merging code, so they are neither read nor cached.
+    */
+    struct InputProfile
+    {
+        int64_t cache_bytes = 64 * 1024 * 1024; //!< Size of the TTreeCache (bytes).
+        int64_t learn_entries = 0;              //!< Entries in the learning phase (zero to add the branches explicitly).
+        bool parallel_unzip = false;            //!< Decompress the cached baskets in parallel (TTreeCacheUnzip).
+    };
+
+    /**
+     * @brief Build the input profile from the command line options.
+     * @details The following options are recognized:
+     * - "--cache-mb=<MB>" sets the size of the TTreeCache (default 64 MB).
+     * - "--cache-learn-entries=<entries>" lets the TTreeCache learn the used
+     * branches over the first <entries> entries instead of adding all needed
+     * branches up front.
+     * - "--parallel-unzip" decompresses the cached baskets in parallel. This
+     * requires ROOT implicit multithreading (see "--threads").
+     * @param options The command line options.
+     * @return The input profile.
+     * @throw std::runtime_error if an option has an invalid value.
+    */
+    InputProfile parse_input_profile(const Options & options);
+
+    /**
+     * @brief Configure the reading of the "recTree" TTree of an input CAF
+     * file.
+     * @details This disables the ML reconstruction branches and sets up the
+     * TTreeCache. It must be called after the branch addresses are set and
+     * before the first entry is read.
+     * @param tree The "recTree" TTree of the input CAF file.
+     * @param profile The input profile.
+    */
+    void apply_input_profile(TTree * tree, const InputProfile & profile);
+
+    /**
+     * @brief Print the number of read calls and bytes read from an input
+     * file.
+     * @param file The input file.
+    */
+    void print_read_statistics(TFile & file);
+} // namespace dlp
+#endif // INPUT_PROFILE_H
@@ -0,0 +1,155 @@
+/**
+ * @file instrumentation.h
+ * @brief Declaration of the Instrumentation class and the ScopedTimer class
+ * for measuring the time spent in each stage of a job.
+ * @author mueller@fnal.gov
+*/
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include "options.h"
+
+namespace dlp
+{
+    /**
+     * @brief A class collecting the timers and counters of a job.
+     *
+     * The instrumentation is disabled by default, in which case every timer
+     * and counter reduces to a single check of a boolean flag. It is enabled
+     * by the "--report=<file>" option, in which case a JSON report with the
+     * total time and number of calls of each stage and the value of each
+     * counter is written to <file> when the program exits, and/or by the
+     * "--progress=<seconds>" option, in which case a progress line is printed
+     * at most every <seconds> seconds. Stages and counters are identified by
+     * name and created on first use. The class is thread-safe.
+    */
+    class Instrumentation
+    {
+        public:
+        /**
+         * @brief Get the instrumentation of the job.
+         * @return The (single) instance of the Instrumentation class.
+        */
+        static Instrumentation & get();
+
+        /**
+         * @brief Configure the instrumentation from the command line options.
+         * @details If enabled, the report is written automatically when the
+         * program exits.
+         * @param options The command line options.
+        */
+        void configure(const Options & options);
+
+        /**
+         * @brief Check if the instrumentation is enabled.
+         * @return True if the instrumentation is enabled.
+        */
+        bool enabled() const { return fEnabled; }
+
+        /**
+         * @brief Add the time spent in one call of a stage.
+         * @param stage The name of the stage.
+         * @param seconds The time spent in the stage.
+        */
+        void add_time(const char * stage, double seconds);
+
+        /**
+         * @brief Add to the value of a counter.
+         * @param counter The name of the counter.
+         * @param value The value to add to the counter.
+        */
+        void add_count(const char * counter, uint64_t value = 1);
+
+        /**
+         * @brief Count one processed event.
+         * @details This also prints the progress line if the configured
+         * interval has elapsed since the last one.
+        */
+        void count_event();
+
+        /**
+         * @brief Write the JSON report (if configured).
+        */
+        void write_report();
+
+        /**
+         * @brief Reset the instrumentation to its unconfigured (disabled)
+         * state.
+         * @details All timers and counters are dropped. This is used by a
+         * process forked from a configured process (e.g. a job of the
+         * daemon) to start with an instrumentation of its own.
+        */
+        void reset();
+
+        private:
+        /**
+         * @brief The accumulated time and number of calls of a stage.
+        */
+        struct Stage
+        {
+            uint64_t calls = 0;                 //!< The number of calls of the stage.
+            double seconds = 0;                 //!< The total time spent in the stage.
+        };
+
+        using Clock = std::chrono::steady_clock;
+
+        Instrumentation() = default;
+        double elapsed() const;
+
+        bool fEnabled = false;
+        bool fRegistered = false;
+        bool fWritten = false;
+        std::string fReportPath;
+        double fProgressInterval = 0;
+        Clock::time_point fStart;
+        Clock::time_point fLastProgress;
+        uint64_t fEvents = 0;
+        std::map<std::string, Stage> fStages;
+        std::map<std::string, uint64_t> fCounters;
+        std::mutex fMutex;
+    };
+
+    /**
+     * @brief A class measuring the time spent in a scope.
+     *
+     * The time between the construction and the destruction of the timer is
+     * added to the named stage of the @ref Instrumentation. If the
+     * instrumentation is disabled, the clock is never read.
+    */
+    class ScopedTimer
+    {
+        public:
+        /**
+         * @brief A constructor for the ScopedTimer class.
+         * @param stage The name of the stage (must outlive the timer).
+        */
+        explicit ScopedTimer(const char * stage)
+            : fStage(Instrumentation::get().enabled() ? stage : nullptr)
+        {
+            if(fStage)
+                fStart = std::chrono::steady_clock::now();
+        }
+
+        /**
+         * @brief A destructor for the ScopedTimer class.
+        */
+        ~ScopedTimer()
+        {
+            if(fStage)
+                Instrumentation::get().add_time(fStage, std::chrono::duration<double>(std::chrono::steady_clock::now() - fStart).count());
+        }
+
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer & operator=(const ScopedTimer &) = delete;
+
+        private:
+        const char * fStage;
+        std::chrono::steady_clock::time_point fStart;
+    };
+} // namespace dlp
+#endif // INSTRUMENTATION_H
@@ -0,0 +1,45 @@
+/**
+ * @file jobs.h
+ * @brief Declaration of the entry points of the CAF maker executables.
+ * @details Each executable implements its job in an entry point with the
+ * signature of main(). The executables call it from main(), and the daemon
+ * (see "cafmaker_daemon.cc"), which is built from the same sources with
+ * "DLP_DAEMON" defined, calls it for each job request.
+ * @author mueller@fnal.gov
+*/
+#ifndef JOBS_H
+#define JOBS_H
+
+/**
+ * @brief The entry point of the "merge_sources" executables.
+ * @param argc The number of command line arguments.
+ * @param argv The command line arguments (including the program name).
+ * @return The exit status of the job.
+*/
+int merge_sources_main(int argc, char const * argv[]);
+
+/**
+ * @brief The entry point of the "merge_sources_*_multi" executables.
+ * @param argc The number of command line arguments.
+ * @param argv The command line arguments (including the program name).
+ * @return The exit status of the job.
+*/
+int merge_sources_multi_main(int argc, char const * argv[]);
+
+/**
+ * @brief The entry point of the "merge_sources_*_batch" executables.
+ * @param argc The number of command line arguments.
+ * @param argv The command line arguments (including the program name).
+ * @return The exit status of the job.
+*/
+int merge_sources_batch_main(int argc, char const * argv[]);
+
+/**
+ * @brief The entry point of the "make_standalone" executables.
+ * @param argc The number of command line arguments.
+ * @param argv The command line arguments (including the program name).
+ * @return The exit status of the job.
+*/
+int make_standalone_main(int argc, char const * argv[]);
+
+#endif // JOBS_H
@@ -0,0 +1,148 @@
+/**
+ * @file logger.h
+ * @brief Declaration of the Logger class for buffered, leveled and
+ * rate-limited logging.
+ * @author mueller@fnal.gov
+*/
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <sstream>
+#include "options.h"
+
+namespace dlp
+{
+    /**
+     * @brief The verbosity levels of the log messages.
+    */
+    enum class LogLevel
+    {
+        kError = 0,                             //!< Errors (always printed).
+        kWarning = 1,                           //!< Warnings (counted and rate-limited by type).
+        kInfo = 2,                              //!< Per-job and per-file messages (the default verbosity).
+        kDebug = 3                              //!< Per-event messages.
+    };
+
+    /**
+     * @brief A class collecting the log messages of a job.
+     *
+     * Messages are written to an in-memory buffer that is flushed to the sink
+     * (stdout, or the file given by "--log-file=<file>") when it is full, when
+     * an error or informational message is logged and when the program exits,
+     * so that the (frequent) per-event messages do not flush the sink. Messages above the
+     * verbosity ("--verbosity=error|warning|info|debug", default "info") are
+     * dropped before they are formatted. Warnings are identified by a type
+     * (e.g. "unmatched_event") and counted: only the first "--log-limit=<N>"
+     * (default 10) warnings of each type are printed, and a summary of the
+     * number of warnings of each type is printed when the program exits. The
+     * counts are also added to the counters of the @ref Instrumentation.
+     * Configuring the logger disables the automatic printing of the HDF5
+     * error stack, since the HDF5 errors are reported as counted warnings
+     * instead. The class is thread-safe.
+    */
+    class Logger
+    {
+        public:
+        /**
+         * @brief Get the logger of the job.
+         * @return The (single) instance of the Logger class.
+        */
+        static Logger & get();
+
+        /**
+         * @brief Configure the logger from the command line options.
+         * @details The buffer is flushed and the summary is printed
+         * automatically when the program exits.
+         * @param options The command line options.
+         * @throw std::runtime_error if an option has an invalid value.
+        */
+        void configure(const Options & options);
+
+        /**
+         * @brief Check if messages of a level are printed.
+         * @param level The level of the messages.
+         * @return True if the messages are printed.
+        */
+        bool enabled(LogLevel level) const { return level <= fVerbosity; }
+
+        /**
+         * @brief Log a message.
+         * @details The arguments are streamed into the message only if it is
+         * printed.
+         * @param level The level of the message.
+         * @param type The type of the message (used to count warnings).
+         * @param args The parts of the message.
+        */
+        template <class... Args>
+        void log(LogLevel level, const char * type, const Args & ... args)
+        {
+            if(level == LogLevel::kWarning && !count(type))
+                return;
+            if(!enabled(level))
+                return;
+            std::ostringstream message;
+            (message << ... << args);
+            write(level, message.str());
+        }
+
+        /**
+         * @brief Flush the buffered messages to the sink.
+        */
+        void flush();
+
+        /**
+         * @brief Print the number of warnings of each type and flush.
+         * @details The summary is printed only once, even if this is called
+         * explicitly before the program exits.
+        */
+        void summarize();
+
+        /**
+         * @brief Reset the logger to its unconfigured state.
+         * @details The buffered messages and the warning counts are dropped,
+         * and the verbosity, the limit and the sink (closed if it is a file)
+         * are restored to their defaults. This is used by a process forked
+         * from a configured process (e.g. a job of the daemon) to start with
+         * a logger of its own.
+        */
+        void reset();
+
+        /**
+         * @brief A destructor for the Logger class.
+         * @details Any remaining buffered messages are flushed to the sink.
+        */
+        ~Logger();
+
+        private:
+        Logger() = default;
+
+        /**
+         * @brief Count a warning and check whether it should be printed.
+         * @param type The type of the warning.
+         * @return True if the warning is within the limit of its type.
+        */
+        bool count(const char * type);
+
+        /**
+         * @brief Write a formatted message to the buffer.
+         * @param level The level of the message.
+         * @param message The message.
+        */
+        void write(LogLevel level, const std::string & message);
+
+        LogLevel fVerbosity = LogLevel::kInfo;
+        uint64_t fLimit = 10;
+        bool fConfigured = false;
+        bool fSummarized = false;
+        std::FILE * fSink = stdout;
+        std::string fBuffer;
+        std::map<std::string, uint64_t> fCounts;
+        std::mutex fMutex;
+    };
+} // namespace dlp
+#endif // LOGGER_H
@@ -0,0 +1,161 @@
+/**
+ * @file matching.h
+ * @brief Declaration of the Matcher class for recomputing the matches between
+ * the reconstructed and the true interactions from their voxel index arrays.
+ * @author mueller@fnal.gov
+*/
+#ifndef MATCHING_H
+#define MATCHING_H
+
+#include <span>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "options.h"
+#include "reco_particle.h"
+#include "reco_interaction.h"
+#include "true_interaction.h"
+
+namespace dlp
+{
+    /**
+     * @brief The overlap metric used for the recomputed matches.
+    */
+    enum class MatchMetric
+    {
+        kIoU,                                   //!< Intersection over union.
+        kEfficiency,                            //!< Intersection over the size of the true interaction.
+        kPurity                                 //!< Intersection over the size of the reconstructed interaction.
+    };
+
+    /**
+     * @brief A struct describing how the matches are recomputed.
+    */
+    struct MatchConfig
+    {
+        bool enabled = false;                   //!< True if the matches are recomputed.
+        MatchMetric metric = MatchMetric::kIoU; //!< The overlap metric.
+        double threshold = 0;                   //!< The minimum overlap of a match.
+
+        /**
+         * @brief Check if the matches are recomputed.
+         * @return True if the matches are recomputed.
+        */
+        bool active() const { return enabled; }
+    };
+
+    /**
+     * @brief Build the match configuration from the command line options.
+     * @details The matches are recomputed if "--rematch=<metric>[:<threshold>]"
+     * is passed, where <metric> is one of "iou", "efficiency" or "purity". Only
+     * the pairs with an overlap of at least <threshold> (default = any non-zero
+     * overlap) are kept.
+     * @param options The command line options.
+     * @return The match configuration.
+     * @throw std::runtime_error if the option has an invalid value or if the
+     * executable was built for data.
+    */
+    MatchConfig parse_match_config(const Options & options);
+
+    /**
+     * @brief Get a human-readable description of the match configuration.
+     * @param config The match configuration.
+     * @return The description of the match configuration.
+    */
+    std::string describe_match_config(const MatchConfig & config);
+
+    /**
+     * @brief Count the common values of two sorted sets.
+     * @details The sets are intersected block by block: each block of four
+     * values of one set is compared against each block of four values of the
+     * other (all sixteen pairs at once), and the block with the smaller last
+     * value is advanced. The comparisons use AVX2 instructions if the CPU
+     * supports them (checked at run time, so the build does not need to
+     * enable AVX2) and otherwise a fixed-size loop which the compiler
+     * vectorizes.
+     * @param a The first set (sorted, no duplicates).
+     * @param b The second set (sorted, no duplicates).
+     * @return The number of values in both sets.
+    */
+    size_t intersection_size(std::span<const int64_t> a, std::span<const int64_t> b);
+
+    /**
+     * @brief Get the name of the block comparison used by
+     * @ref intersection_size on this CPU.
+     * @return "avx2" or "scalar".
+    */
+    const char * intersection_kernel();
+
+    /**
+     * @brief The recomputed matches of one event.
+     * @details The match lists of all interactions are concatenated: the
+     * "nmatch" vectors hold the number of matches of each interaction (in the
+     * order of the "dlp" and "dlp_true" vectors of the StandardRecord), and
+     * the matches of each interaction are sorted by decreasing overlap.
+    */
+    struct MatchRecord
+    {
+        std::vector<int32_t> dlp_nmatch;                //!< The number of matches of each reconstructed interaction.
+        std::vector<int64_t> dlp_match_ids;             //!< The IDs of the matched true interactions.
+        std::vector<float> dlp_match_overlaps;          //!< The overlaps of the matched true interactions.
+        std::vector<int32_t> dlp_true_nmatch;           //!< The number of matches of each true interaction.
+        std::vector<int64_t> dlp_true_match_ids;        //!< The IDs of the matched reconstructed interactions.
+        std::vector<float> dlp_true_match_overlaps;     //!< The overlaps of the matched reconstructed interactions.
+
+        /**
+         * @brief Remove all matches.
+        */
+        void clear();
+    };
+
+    /**
+     * @brief A class recomputing the matches between the reconstructed and
+     * the true interactions of an event.
+     *
+     * The voxel set of a reconstructed interaction is the union of the "index"
+     * arrays of its particles, and the voxel set of a true interaction is its
+     * "index_adapt" array (the true voxels expressed in the reconstructed
+     * point cloud). The overlap of every pair with intersecting voxel ranges
+     * is computed with @ref intersection_size. The match lists written by
+     * SPINE ("match_ids" and "match_overlaps") are not modified. The buffers
+     * of the matcher are reused from event to event, so a matcher must not be
+     * shared between threads.
+    */
+    class Matcher
+    {
+        public:
+        /**
+         * @brief A constructor for the Matcher class.
+         * @param config The match configuration.
+        */
+        explicit Matcher(const MatchConfig & config);
+
+        /**
+         * @brief Remove the matches of the previous event.
+        */
+        void clear();
+
+        /**
+         * @brief Recompute the matches of an event.
+         * @param reco_particles The reconstructed particles of the event.
+         * @param reco_interactions The reconstructed interactions of the event.
+         * @param true_interactions The true interactions of the event.
+        */
+        void match(const std::vector<types::RecoParticle> & reco_particles, const std::vector<types::RecoInteraction> & reco_interactions, const std::vector<types::TruthInteraction> & true_interactions);
+
+        /**
+         * @brief Get the matches of the current event.
+         * @return The matches of the current event.
+        */
+        const MatchRecord & record() const { return fRecord; }
+
+        private:
+        MatchConfig fConfig;
+        MatchRecord fRecord;
+        std::vector<std::vector<int64_t>> fRecoVoxels;
+        std::vector<std::vector<int64_t>> fTrueVoxels;
+        std::vector<float> fOverlaps;
+        std::vector<size_t> fOrder;
+    };
+} // namespace dlp
+#endif // MATCHING_H
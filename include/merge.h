@@ -0,0 +1,190 @@
+/**
+ * @file merge.h
+ * @brief Declaration of the functions used for merging the SPINE
+ * reconstruction outputs into existing CAF files.
+ * @details This file contains the declaration of the functions that are
+ * shared between the various merging executables. These handle the main loop
+ * over the records of an input CAF file and the copying of the auxiliary
+ * objects (histograms, key/value trees, etc.) into the output CAF file.
+ * @author mueller@fnal.gov
+ */
+#ifndef MERGE_H
+#define MERGE_H
+
+#include <set>
+#include <string>
+#include <vector>
+#include <utility>
+#include "file_pool.h"
+#include "record_writer.h"
+#include "event_selection.h"
+#include "skim.h"
+#include "truth_pruning.h"
+#include "voxel_index.h"
+#include "matching.h"
+#include "follow.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+#include "TFile.h"
+#include "TDirectory.h"
+#include "TTree.h"
+#include "TH1D.h"
+
+namespace dlp
+{
+    /**
+     * @brief Counters summarizing the result of merging a CAF file.
+    */
+    struct MergeResult
+    {
+        size_t matched = 0;                     //!< Number of CAF records matched to an HDF5 event.
+        size_t unmatched = 0;                   //!< Number of CAF records with no matching HDF5 event.
+        size_t selected = 0;                    //!< Number of CAF records selected (see @ref EventSelection).
+        double selected_pot = 0;                //!< Sum of "hdr.pot" over the selected records (see @ref set_selected_exposure).
+        bool holds_first = false;               //!< Whether the (active) selection holds the first record of the input CAF file.
+        size_t records = 0;                     //!< Number of records of the input CAF file (only if @ref holds_first).
+        double record_pot = 0;                  //!< Sum of "hdr.pot" over all records of the input CAF file (only if @ref holds_first).
+        size_t skimmed = 0;                     //!< Number of CAF records dropped by the skim (see @ref Skim).
+    };
+
+    /**
+     * @brief Copy the key/val products from an event in the CAF file to the
+     * output CAF file.
+     * @details This function is used to copy the key/val products from the
+     * input TDirectory to the output TDirectory. Specifically, this represents
+     * metadata and environment variables that are stored in the input CAF file.
+     * The TTree is cloned at the basket level.
+     * @param output The output TDirectory to copy to.
+     * @param input The input TDirectory to copy from.
+     * @param name The name of the TTree to copy.
+     */
+    void copy_keyval_tree(TDirectory * output, TDirectory * input, const char * name);
+
+    /**
+     * @brief A class collecting the distinct key/value pairs of the "env" or
+     * "metadata" directories of several input CAF files.
+     * @details The key/value TTrees have a "key" and a "value" string branch.
+     * The pairs are kept in the order in which they are first seen, so that
+     * combining identical directories gives back the same TTree. The inputs
+     * adding new pairs are logged. If the TTree of the first input does not
+     * have the expected branches, it is copied verbatim and the TTrees of the
+     * other inputs are dropped (which is logged for each of them).
+     */
+    class KeyValueTable
+    {
+        public:
+        /**
+         * @brief Constructor of the @ref KeyValueTable class.
+         * @param directory The name of the directory (e.g. "env").
+         * @param tree The name of the key/value TTree (e.g. "envtree").
+         */
+        KeyValueTable(const std::string & directory, const std::string & tree);
+
+        /**
+         * @brief Add the key/value pairs of an input CAF file.
+         * @param output The output CAF file (for a verbatim copy).
+         * @param input The input CAF file.
+         */
+        void add(TFile & output, TFile & input);
+
+        /**
+         * @brief Write the combined key/value TTree to the output CAF file.
+         * @param output The output CAF file.
+         */
+        void Write(TFile & output);
+
+        private:
+        std::string fDirectory;
+        std::string fTree;
+        size_t fInputs;
+        bool fVerbatim;
+        std::vector<std::pair<std::string, std::string>> fPairs;
+        std::set<std::pair<std::string, std::string>> fSeen;
+    };
+
+    /**
+     * @brief Loop over the records of an input CAF file and merge the matching
+     * SPINE reconstruction outputs into them.
+     * @details The StandardRecord object pointed to by @p rec must be the
+     * object attached to both the input TTree and the output writer. Each
+     * record is read, its ML reconstruction branches are replaced by the
+     * products of the matching HDF5 event (if any), and it is then written
+     * to the output CAF file.
+     * @param input_tree The "recTree" of the input CAF file.
+     * @param writer The writer of the output CAF file.
+     * @param rec The StandardRecord attached to the input and output.
+     * @param index The global (Run, Subrun, Event No.) index of HDF5 events.
+     * @param pool The pool of input HDF5 files.
+     * @param keep_unmatched Whether to write records with no matching event.
+     * @param selection The selection of the records to process. Records
+     * outside of the selection are not read.
+     * @param skim The skim applied to the merged records. Records which do
+     * not pass it are counted in the exposure but not written.
+     * @param pruning The policy for pruning the true particles.
+     * @param voxels The sidecar file to which the voxel index arrays of the
+     * matched events are written (optional).
+     * @param matcher The matcher recomputing the reco/truth interaction
+     * matches of each record (optional). It is cleared for the records
+     * without a matching event.
+     * @param follower The follower of the input HDF5 files (optional). If
+     * the matching event of a record is not in the index, the follower waits
+     * for it to be appended to the input until a later event is appended or
+     * the input is idle (see @ref Follower::wait_for), and it
+     * is notified of each written record.
+     * @param genie_offset The offset added to the GENIE indices of the
+     * records (see @ref shift_genie_index), for outputs in which the
+     * "GenieEvtRecTree" TTrees of several input CAF files are concatenated.
+     * @return The number of matched and unmatched records.
+     */
+    MergeResult merge_records(TTree * input_tree, RecordWriter & writer, caf::StandardRecord * rec, const EventIndex & index, FilePool & pool, bool keep_unmatched, const EventSelection & selection = EventSelection(), const Skim & skim = Skim(), const TruthPruning & pruning = TruthPruning(), VoxelIndexWriter * voxels = nullptr, Matcher * matcher = nullptr, Follower * follower = nullptr, Long64_t genie_offset = 0);
+
+    /**
+     * @brief Shift the GENIE indices of the true neutrino interactions of a
+     * record.
+     * @details The "genieIdx" of each interaction in "rec.mc.nu" is the
+     * entry of the interaction in the "GenieEvtRecTree" of the same file.
+     * When the "GenieEvtRecTree" TTrees of several input CAF files are
+     * concatenated, the indices of the records of each input must be
+     * shifted by the number of GENIE entries preceding its TTree. Negative
+     * indices (interactions without a GENIE entry) are left unchanged.
+     * @param rec The record.
+     * @param offset The offset added to the GENIE indices.
+     */
+    void shift_genie_index(caf::StandardRecord * rec, Long64_t offset);
+
+    /**
+     * @brief Set the exposure histograms to the exposure of the selected
+     * records.
+     * @details The POT of a subrun ("hdr.pot") is only stored in its first
+     * record, so the POT of each subrun is assigned whole to the selection
+     * which holds that record: the "TotalPOT" histogram is set to the sum of
+     * "hdr.pot" over the selected records, which the merge loop reads anyway.
+     * The "TotalEvents" histogram is set to the number of selected records.
+     * The exposure of the input which is not carried by any record (e.g. the
+     * POT of subruns without any record, or events without a record) is
+     * assigned to the selection holding the first record of the input, which
+     * is the only one reading the "hdr.pot" of the records it skips. Both
+     * exposures are therefore additive and exact: the histograms of the
+     * shards of a full partition add up to those of the input CAF file,
+     * which an unsharded job copies unchanged.
+     * @param total_pot The "TotalPOT" histogram.
+     * @param total_events The "TotalEvents" histogram.
+     * @param result The result of merging the selected records.
+     */
+    void set_selected_exposure(TH1 * total_pot, TH1 * total_events, const MergeResult & result);
+
+    /**
+     * @brief Write the exposure histograms of the selected records.
+     * @details The "TotalPOT" and "TotalEvents" histograms of the input CAF
+     * file are set to the exposure of the selected records (see
+     * @ref set_selected_exposure) and written to the output CAF file. This
+     * replaces the copy of these histograms by the @ref AuxCopier when an
+     * event selection is active (see @ref recomputed_objects).
+     * @param output The output CAF file.
+     * @param input The input CAF file.
+     * @param result The result of merging the selected records.
+     */
+    void write_selected_exposure(TFile & output, TFile & input, const MergeResult & result);
+} // namespace dlp
+#endif // MERGE_H
@@ -0,0 +1,81 @@
+/**
+ * @file options.h
+ * @brief Declaration of the Options class for parsing command line arguments.
+ * @author mueller@fnal.gov
+*/
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace dlp
+{
+    /**
+     * @brief A class representing the command line arguments of an executable.
+     *
+     * This class splits the command line arguments into positional arguments
+     * and optional flags. Flags are of the form "--key=value" or "--key" (for
+     * boolean switches) and may appear anywhere on the command line. All other
+     * arguments are treated as positional arguments and retain their relative
+     * order. This allows the existing positional interfaces of the executables
+     * to remain unchanged while allowing for optional configuration.
+    */
+    class Options
+    {
+        public:
+        /**
+         * @brief A constructor for the Options class.
+         * @param argc The number of command line arguments.
+         * @param argv The command line arguments (including the program name).
+        */
+        Options(int argc, char const * argv[]);
+
+        /**
+         * @brief Get the list of positional arguments.
+         * @details The program name is not included in the list.
+         * @return The list of positional arguments.
+        */
+        const std::vector<std::string> & positional() const;
+
+        /**
+         * @brief Check if a flag was passed on the command line.
+         * @param key The name of the flag (without the leading "--").
+         * @return True if the flag was passed, false otherwise.
+        */
+        bool has(const std::string & key) const;
+
+        /**
+         * @brief Get the value of a flag as a string.
+         * @param key The name of the flag (without the leading "--").
+         * @param def The default value to return if the flag is not present.
+         * @return The value of the flag, or the default value.
+        */
+        std::string get(const std::string & key, const std::string & def = "") const;
+
+        /**
+         * @brief Get the value of a flag as an integer.
+         * @param key The name of the flag (without the leading "--").
+         * @param def The default value to return if the flag is not present.
+         * @return The value of the flag, or the default value.
+         * @throw std::runtime_error if the value cannot be parsed.
+        */
+        int64_t get_int(const std::string & key, int64_t def) const;
+
+        /**
+         * @brief Get the value of a flag as a floating point number.
+         * @param key The name of the flag (without the leading "--").
+         * @param def The default value to return if the flag is not present.
+         * @return The value of the flag, or the default value.
+         * @throw std::runtime_error if the value cannot be parsed.
+        */
+        double get_double(const std::string & key, double def) const;
+
+        private:
+        std::vector<std::string> fPositional;
+        std::map<std::string, std::string> fFlags;
+    };
+} // namespace dlp
+#endif // OPTIONS_H
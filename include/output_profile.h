@@ -0,0 +1,98 @@
+/**
+ * @file output_profile.h
+ * @brief Declaration of the OutputProfile struct for configuring the layout
+ * and compression of the output CAF file.
+ * @author mueller@fnal.gov
+*/
+#ifndef OUTPUT_PROFILE_H
+#define OUTPUT_PROFILE_H
+
+#include <string>
+#include <cstdint>
+#include <optional>
+#include "options.h"
+#include "precision.h"
+
+#include "TFile.h"
+
+namespace dlp
+{
+    /**
+     * @brief A struct describing how the output CAF file is written.
+     *
+     * The profile collects the settings of the output file (compression) and
+     * of the "recTree" TTree (layout, split level, basket size and auto-flush
+     * interval). The default values reproduce the ROOT defaults, so that an
+     * executable run without any output options writes the same output as
+     * before. The compression setting is only applied if it is given, so
+     * that the output file otherwise keeps the default of the ROOT build. The profile is built once from the command line and shared by
+     * the output TFile and the @ref RecordWriter.
+    */
+    struct OutputProfile
+    {
+        bool flat = false;                      //!< Write the flat CAF layout.
+        std::optional<int> compression;         //!< ROOT compression setting (100 * algorithm + level), unset for the ROOT default.
+        int split_level = 99;                   //!< Split level of the "rec" branch (non-flat layout only).
+        int basket_size = 32000;                //!< Initial basket size (bytes) of each branch.
+        int64_t autoflush_bytes = 0;            //!< Auto-flush interval (bytes, zero for the ROOT default).
+        int64_t adaptive_entries = 0;           //!< Entries after which basket sizes are optimized (zero to disable).
+        int threads = 0;                        //!< Number of ROOT implicit multithreading threads (zero to disable, -1 for all cores).
+        PrecisionPolicy precision;              //!< Precision of the floating point ML fields.
+        bool cross_references = false;          //!< Write the resolved cross-references of the ML objects.
+    };
+
+    /**
+     * @brief Build the output profile from the command line options.
+     * @details The following options are recognized:
+     * - "--flat" writes the flat CAF layout.
+     * - "--compression=<algorithm>[:<level>]" with algorithm one of "zlib",
+     * "lzma", "lz4", "zstd" or "none". If the level is omitted, the level
+     * recommended by ROOT for the algorithm is used.
+     * - "--split-level=<level>" sets the split level of the "rec" branch.
+     * - "--basket-size=<bytes>" sets the initial basket size of each branch.
+     * - "--autoflush-mb=<MB>" flushes the baskets every <MB> of (uncompressed)
+     * data, which also sets the cluster size seen by readers.
+     * - "--adaptive-baskets=<entries>" resizes the baskets of each branch
+     * from the observed per-branch entry sizes once <entries> entries have
+     * been written.
+     * - "--threads=<N>" enables ROOT implicit multithreading with <N> threads
+     * (zero for all available cores), which compresses the baskets of
+     * different branches in parallel.
+     * - "--precision=<policy>" stores the floating point ML fields with a
+     * reduced precision (see @ref parse_precision_policy).
+     * - "--xref" writes the resolved cross-references of the ML objects
+     * (see @ref CrossReferenceBuilder).
+     * @param options The command line options.
+     * @return The output profile.
+     * @throw std::runtime_error if an option has an invalid value.
+    */
+    OutputProfile parse_output_profile(const Options & options);
+
+    /**
+     * @brief Apply the file-level settings of the output profile.
+     * @details This must be called before any object is written to the file.
+     * The compression setting of the file is left untouched unless the
+     * profile has one.
+     * @param file The output CAF file.
+     * @param profile The output profile.
+    */
+    void apply_output_profile(TFile & file, const OutputProfile & profile);
+
+    /**
+     * @brief Enable ROOT implicit multithreading if requested by the output
+     * profile.
+     * @details This must be called before any TTree is created, as each
+     * TTree checks whether implicit multithreading is enabled when it is
+     * constructed.
+     * @param profile The output profile.
+    */
+    void enable_implicit_mt(const OutputProfile & profile);
+
+    /**
+     * @brief Get a human-readable description of the output profile.
+     * @param profile The output profile.
+     * @return The description of the output profile.
+    */
+    std::string describe_output_profile(const OutputProfile & profile);
+} // namespace dlp
+#endif // OUTPUT_PROFILE_H
@@ -0,0 +1,62 @@
+/**
+ * @file particle_hierarchy.h
+ * @brief Declaration of the ParticleHierarchy class for flattening the
+ * parent/child hierarchy of the true particles of an event.
+ * @author mueller@fnal.gov
+*/
+#ifndef PARTICLE_HIERARCHY_H
+#define PARTICLE_HIERARCHY_H
+
+#include <vector>
+#include <cstdint>
+
+namespace dlp
+{
+    /**
+     * @brief A class flattening the parent/child hierarchy of the particles
+     * of an event.
+     *
+     * The particles are identified by their position (see
+     * @ref CrossReferenceRecord). The hierarchy is a forest whose roots are
+     * the particles without a (known) parent. The particles are listed in
+     * depth-first order, with the roots and the children of each particle in
+     * increasing order of position, so the descendants of a particle are the
+     * contiguous range of the order which follows it. The hierarchy is built
+     * in a single linear pass over the particles. The buffers are reused from
+     * event to event, so an instance must not be shared between threads.
+    */
+    class ParticleHierarchy
+    {
+        public:
+        std::vector<int32_t> order;             //!< The positions of the particles in depth-first order.
+        std::vector<int32_t> rank;              //!< The index of each particle in @ref order.
+        std::vector<int32_t> subtree_end;       //!< One past the index in @ref order of the last descendant of each particle.
+        std::vector<int32_t> depth;             //!< The number of ancestors of each particle.
+        std::vector<int32_t> primary;           //!< The position of the nearest primary ancestor (or self) of each particle, or -1.
+        std::vector<int32_t> visible;           //!< The position of the nearest visible (strict) ancestor of each particle, or -1.
+
+        /**
+         * @brief Build the hierarchy of an event.
+         * @details The descendants of particle k are the particles
+         * order[rank[k] + 1] to order[subtree_end[k] - 1]. A parent which
+         * would close a cycle is ignored.
+         * @param parent The position of the parent of each particle (-1 if
+         * none).
+         * @param is_primary Whether each particle is a primary particle.
+         * @param is_visible Whether each particle is visible (left energy
+         * depositions in the detector).
+        */
+        void Build(const std::vector<int32_t> & parent, const std::vector<uint8_t> & is_primary, const std::vector<uint8_t> & is_visible);
+
+        /**
+         * @brief Remove all particles.
+        */
+        void clear();
+
+        private:
+        std::vector<int32_t> fChildBegin;
+        std::vector<int32_t> fChildren;
+        std::vector<int32_t> fStack;
+    };
+} // namespace dlp
+#endif // PARTICLE_HIERARCHY_H
@@ -0,0 +1,179 @@
+/**
+ * @file precision.h
+ * @brief Declaration of the PrecisionPolicy struct and the classes for
+ * storing the floating point ML fields with a reduced precision and for
+ * validating the result.
+ * @author mueller@fnal.gov
+*/
+#ifndef PRECISION_H
+#define PRECISION_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+namespace dlp
+{
+    /**
+     * @brief A struct describing the precision with which each floating
+     * point ML field is stored.
+     *
+     * The precision of a field is the number of explicit mantissa bits kept
+     * (out of 23 for single precision). The values are rounded to the
+     * nearest representable value, so the relative error of each value is at
+     * most 2^-(bits+1). The zeroed low-order mantissa bits compress very well,
+     * so the output is smaller and faster to read and write, while the type
+     * of the fields (and therefore the layout of the CAF file) is unchanged.
+     * The policy applies to every CAF class with a field of the given name.
+    */
+    struct PrecisionPolicy
+    {
+        std::map<std::string, int> bits;        //!< The number of mantissa bits kept for each field.
+
+        /**
+         * @brief Check if the policy reduces the precision of any field.
+         * @return True if any field has a reduced precision.
+        */
+        bool active() const { return !bits.empty(); }
+    };
+
+    /**
+     * @brief Build a precision policy from the value of the "--precision"
+     * option.
+     * @details The value is a comma-separated list of entries, applied in
+     * order. Each entry is either "reduced" (the default policy for
+     * positions, directions, momenta, per-PID arrays and scores),
+     * "<field>:<bits>" (keep <bits> mantissa bits of the field) or
+     * "<field>:full" (store the field at full precision).
+     * @param value The value of the "--precision" option.
+     * @return The precision policy.
+     * @throw std::runtime_error if an entry is invalid or names an unknown
+     * field.
+    */
+    PrecisionPolicy parse_precision_policy(const std::string & value);
+
+    /**
+     * @brief Get a human-readable description of the precision policy.
+     * @param policy The precision policy.
+     * @return The description of the precision policy.
+    */
+    std::string describe_precision_policy(const PrecisionPolicy & policy);
+
+    /**
+     * @brief Round a value to a given number of mantissa bits.
+     * @details The value is rounded to the nearest representable value (ties
+     * to even). Non-finite values are returned unchanged, as are values which
+     * would round to infinity.
+     * @param value The value.
+     * @param bits The number of explicit mantissa bits to keep.
+     * @return The rounded value.
+    */
+    float reduce_precision(float value, int bits);
+
+    /**
+     * @brief Round a value to a given number of mantissa bits.
+     * @param value The value.
+     * @param bits The number of explicit mantissa bits to keep (out of 52).
+     * @return The rounded value.
+    */
+    double reduce_precision(double value, int bits);
+
+    /**
+     * @brief A class applying a precision policy to the ML reconstruction
+     * outputs of a StandardRecord.
+     * @details The policy is resolved against the field tables of the CAF
+     * classes once, at construction.
+    */
+    class PrecisionReducer
+    {
+        public:
+        /**
+         * @brief A constructor for the PrecisionReducer class.
+         * @param policy The precision policy.
+        */
+        explicit PrecisionReducer(const PrecisionPolicy & policy);
+
+        /**
+         * @brief A destructor for the PrecisionReducer class.
+        */
+        ~PrecisionReducer();
+
+        /**
+         * @brief Reduce the precision of the ML fields of the StandardRecord
+         * (in place).
+         * @param rec The StandardRecord.
+        */
+        void Apply(caf::StandardRecord & rec) const;
+
+        private:
+        struct Fields;
+        std::unique_ptr<Fields> fFields;
+    };
+
+    /**
+     * @brief The deviation observed for one field by the
+     * @ref PrecisionValidator.
+    */
+    struct FieldDeviation
+    {
+        std::string name;                       //!< The name of the field (e.g. "dlp.particles.start_point").
+        uint64_t values = 0;                    //!< The number of values compared.
+        double max_abs = 0;                     //!< The maximum absolute deviation.
+        double max_rel = 0;                     //!< The maximum relative deviation (non-zero reference values only).
+        uint64_t mismatched = 0;                //!< The number of objects with different vector lengths.
+    };
+
+    /**
+     * @brief A class comparing the ML fields of two StandardRecords (e.g. at
+     * full and at reduced precision) and collecting the maximum deviation of
+     * each field.
+    */
+    class PrecisionValidator
+    {
+        public:
+        /**
+         * @brief A constructor for the PrecisionValidator class.
+        */
+        PrecisionValidator();
+
+        /**
+         * @brief A destructor for the PrecisionValidator class.
+        */
+        ~PrecisionValidator();
+
+        /**
+         * @brief Compare the ML fields of two StandardRecords.
+         * @details The interactions and particles are compared pairwise. If
+         * the records do not have the same number of interactions (or an
+         * interaction the same number of particles), the record is counted as
+         * mismatched and the extra objects are ignored.
+         * @param reference The reference StandardRecord.
+         * @param reduced The StandardRecord to validate.
+        */
+        void Compare(const caf::StandardRecord & reference, const caf::StandardRecord & reduced);
+
+        /**
+         * @brief Get the deviation of each field.
+         * @return The deviation of each field (fields with no values are
+         * omitted).
+        */
+        std::vector<FieldDeviation> Deviations() const;
+
+        /**
+         * @brief Get the number of records with a different number of ML
+         * objects.
+         * @return The number of mismatched records.
+        */
+        uint64_t mismatched() const { return fMismatched; }
+
+        private:
+        struct Fields;
+        std::unique_ptr<Fields> fFields;
+        uint64_t fMismatched;
+    };
+} // namespace dlp
+#endif // PRECISION_H
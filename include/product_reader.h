@@ -0,0 +1,191 @@
+/**
+ * @file product_reader.h
+ * @brief Declaration of the ProductReader class for reading the data products
+ * of consecutive events into reused buffers.
+ * @author mueller@fnal.gov
+*/
+#ifndef PRODUCT_READER_H
+#define PRODUCT_READER_H
+
+#include <tuple>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include "H5Cpp.h"
+#include "event.h"
+#include "string_pool.h"
+
+namespace dlp
+{
+    /**
+     * @brief An arena holding the variable-length memory of the products of
+     * one buffer of a ProductReader.
+     *
+     * The arena is installed as the allocator of the dataset transfer
+     * property list of its buffer (see H5Pset_vlen_mem_manager), so the
+     * variable-length arrays and strings read by HDF5 are carved out of its
+     * blocks instead of being allocated one by one. Freeing a single array
+     * does nothing: all of the memory is released at once by @ref reset when
+     * the next event is read into the buffer. If an event does not fit in
+     * the current block, another block (at least as large as all of the
+     * previous ones) is allocated, and the blocks are merged into one by the
+     * next reset. Once the arena has grown to the largest event, reading an
+     * event therefore does not allocate any variable-length memory.
+    */
+    class VlenArena
+    {
+        public:
+        /**
+         * @brief Allocate memory from the arena.
+         * @param size The size of the allocation (bytes).
+         * @return The allocated memory (aligned for any type).
+        */
+        void * allocate(size_t size);
+
+        /**
+         * @brief Release all of the memory allocated from the arena.
+         * @details The capacity is kept (in a single block).
+        */
+        void reset();
+
+        /**
+         * @brief Get the number of blocks allocated by the arena so far.
+         * @return The number of blocks.
+        */
+        uint64_t allocations() const { return fAllocations; }
+
+        /**
+         * @brief The allocation function of H5Pset_vlen_mem_manager.
+         * @param size The size of the allocation (bytes).
+         * @param info The arena.
+         * @return The allocated memory.
+        */
+        static void * hdf5_allocate(size_t size, void * info);
+
+        /**
+         * @brief The free function of H5Pset_vlen_mem_manager.
+         * @details The memory is released by @ref reset, so this does
+         * nothing.
+         * @param pointer The memory to free.
+         * @param info The arena.
+        */
+        static void hdf5_free(void * pointer, void * info);
+
+        private:
+        struct Block
+        {
+            std::unique_ptr<std::max_align_t[]> data;
+            size_t size;
+        };
+        std::vector<Block> fBlocks;
+        size_t fUsed = 0;
+        uint64_t fAllocations = 0;
+    };
+
+    /**
+     * @brief The reused buffer of one type of product of a ProductReader.
+     * @tparam T the type of product.
+    */
+    template <class T>
+    struct ProductBuffer
+    {
+        std::vector<T> products;                //!< The products of the last event.
+        std::optional<H5::CompType> ctype;      //!< The compound type of the product (built on first use).
+        std::optional<H5::DataSpace> memspace;  //!< The memory DataSpace of the last read.
+        std::optional<H5::DataSet> dataset;     //!< The dataset of the product in the file of the last read.
+        std::optional<H5::DSetMemXferPropList> transfer; //!< The transfer property list allocating from the arena.
+        VlenArena arena;                        //!< The variable-length memory of the products.
+        hid_t file = H5I_INVALID_HID;           //!< The HDF5 identifier of the file of the last read.
+        bool loaded = false;                    //!< Whether the products hold variable-length memory.
+
+        /**
+         * @brief Reclaim the variable-length memory of the products.
+        */
+        void reclaim();
+    };
+
+    /**
+     * @brief A class reading the data products of consecutive events into
+     * reused buffers.
+     *
+     * Unlike get_product<T>, which builds the HDF5 compound type, the memory
+     * DataSpace and the output vector and opens the dataset of the product on
+     * every call, the ProductReader keeps one buffer per type of product
+     * whose capacity, compound type, memory DataSpace and open dataset are
+     * reused from event to event. The dataset is reopened when the products
+     * are read from another file. The variable-length arrays of the products
+     * are allocated from an arena of the buffer (see VlenArena), which is
+     * reset when the next event is read into the buffer. Once the buffers
+     * and their arenas have grown to the largest event, neither the output
+     * vectors nor the variable-length arrays are allocated again. The DataSpace
+     * of the region referenced by the event is still built inside the HDF5
+     * library on each read (it cannot be reused, as each event references its
+     * own region). The string fields of the products are interned in the
+     * string pool of the reader, which is emptied by clear(), so that it
+     * only holds the strings of the file being read. The products returned
+     * by read() are only valid until the next call of read() for the same
+     * type or of clear(). The open datasets keep their
+     * file open, so the reader must be cleared before a file it has read is
+     * closed or reopened (see FilePool and get_new_events). The reader calls
+     * the HDF5 library, so it must only be used (and destroyed) while holding
+     * the HDF5 lock of the job, if any.
+    */
+    class ProductReader
+    {
+        public:
+        /**
+         * @brief A default constructor for the ProductReader class.
+         * @details No HDF5 object is created until the first read.
+        */
+        ProductReader() = default;
+
+        /**
+         * @brief A destructor for the ProductReader class.
+         * @details The HDF5 objects of all buffers are released.
+        */
+        ~ProductReader();
+
+        ProductReader(const ProductReader &) = delete;
+        ProductReader & operator=(const ProductReader &) = delete;
+
+        /**
+         * @brief Read all products of a certain type of an event.
+         * @tparam T the type of product to retrieve.
+         * @param file the input H5 file.
+         * @param evt the dlp::types::Event object containing the references
+         * to the requested products.
+         * @return the products of the event (valid until the next read of the
+         * same type). The vector must not be resized by the caller.
+        */
+        template <class T>
+        std::vector<T> & read(H5::H5File & file, types::Event & evt);
+
+        /**
+         * @brief Reclaim the variable-length memory of all buffers and
+         * release their HDF5 objects (including the open datasets).
+         * @details The string pool is emptied. The capacity of the buffers
+         * and of their arenas is kept.
+        */
+        void clear();
+
+        /**
+         * @brief Get the number of blocks allocated by the arenas of the
+         * buffers so far.
+         * @details This stays constant once the arenas have grown to the
+         * largest event.
+         * @return The number of blocks.
+        */
+        uint64_t vlen_allocations() const;
+
+        private:
+        std::tuple<ProductBuffer<types::RunInfo>,
+                   ProductBuffer<types::RecoInteraction>,
+                   ProductBuffer<types::RecoParticle>,
+                   ProductBuffer<types::TruthInteraction>,
+                   ProductBuffer<types::TruthParticle>> fBuffers;
+        StringPool fStrings;
+    };
+} // namespace dlp
+#endif // PRODUCT_READER_H
@@ -10,6 +10,7 @@
 #include <vector>
 #include "H5Cpp.h"
 #include "event.h"
+#include "string_pool.h"
 
 /**
  * @brief Checks the dimensions of the H5 DataSpace and calculates the number
@@ -34,14 +35,70 @@ dlp::types::Event get_single_event(H5::H5File & file, int64_t index);
 */
 std::vector<dlp::types::Event> get_all_events(H5::H5File & file);
 
+/**
+ * @brief Appends the dlp::types::Event objects written to the H5 file since
+ * they were last read.
+ * @details This is used to follow a file which is still being written (see
+ * dlp::FollowConfig). The "events" dataset is refreshed to check for new
+ * events. If there are any, the file is reopened, so that all of the records
+ * appended by a SWMR writer become visible, and only the new events are
+ * read. No other object of the file may be open.
+ * @param file the input H5 file (reopened if there are new events).
+ * @param events the events already read from the file (extended).
+ * @return the number of new events.
+*/
+size_t get_new_events(H5::H5File & file, std::vector<dlp::types::Event> & events);
+
 /**
  * @brief Retrieves all products of a certain type from the H5 file.
  * @tparam T the type of product to retrieve.
  * @param file the input H5 file.
  * @param evt the dlp::types::Event object containing the references to the
  * requested products.
+ * @param strings the pool of the string fields of the products, which must
+ * outlive them (see dlp::StringPool).
+*/
+template <class T>
+std::vector<T> get_product(H5::H5File & file, dlp::types::Event & evt, dlp::StringPool & strings);
+
+/**
+ * @brief Opens the dataset holding the products of a certain type.
+ * @details The dataset is dereferenced from the reference of the event. All
+ * references to a type of product of a file point into the same dataset, so
+ * the dataset may be reused for the other events of the file.
+ * @tparam T the type of product.
+ * @param file the input H5 file.
+ * @param evt the dlp::types::Event object containing a reference to the
+ * products.
+ * @return the dataset referenced by the event.
+*/
+template <class T>
+H5::DataSet open_product_dataset(H5::H5File & file, dlp::types::Event & evt);
+
+/**
+ * @brief Reads all products of a certain type from the H5 file into a
+ * caller-owned buffer.
+ * @details The buffer and the memory DataSpace are reused, so the output
+ * vector is not reallocated once it has reached the largest number of
+ * products. The DataSpace of the referenced region is still built for each
+ * call. The variable-length memory of the previous contents of the buffer is
+ * not reclaimed (see dlp::ProductReader). The variable-length arrays are
+ * allocated through the transfer property list, so a caller may route them
+ * to its own allocator (H5Pset_vlen_mem_manager), in which case they must be
+ * reclaimed with the same property list. The variable-length strings are
+ * interned and released through the free function of the property list.
+ * @tparam T the type of product to retrieve.
+ * @param file the input H5 file.
+ * @param dataset the dataset holding the products (see open_product_dataset).
+ * @param evt the dlp::types::Event object containing the references to the
+ * requested products.
+ * @param ctype the HDF5 compound type of the product.
+ * @param memspace the memory DataSpace (reset by the call).
+ * @param data_product the buffer receiving the products (resized).
+ * @param strings the pool of the string fields of the products.
+ * @param transfer the dataset transfer property list of the read.
 */
 template <class T>
-std::vector<T> get_product(H5::H5File & file, dlp::types::Event & evt);
+void read_product(H5::H5File & file, const H5::DataSet & dataset, dlp::types::Event & evt, const H5::CompType & ctype, H5::DataSpace & memspace, std::vector<T> & data_product, dlp::StringPool & strings, const H5::DSetMemXferPropList & transfer = H5::DSetMemXferPropList::DEFAULT);
 
 #endif // PRODUCTS_H
\ No newline at end of file
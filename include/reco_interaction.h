@@ -8,6 +8,7 @@
 
 #include <array>
 #include "buffer.h"
+#include "string_pool.h"
 #include "composites.h"
 
 namespace dlp::types
@@ -48,8 +49,8 @@ namespace dlp::types
         int64_t primary_particle_counts[6];                 //!< The number of primary particles of each type in the interaction.
         BufferView<int64_t> primary_particle_ids;           //!< Primary particle IDs in the interaction.
         int64_t size;                                       //!< The size of the interaction (number of voxels).
-        std::string topology;                               //!< Topology of the interaction (e.g. "0g0e1mu0pi2p") considering only primaries.
-        std::string units;                                  //!< Units in which the position coordinates are expressed.
+        InternedString topology;                            //!< Topology of the interaction (e.g. "0g0e1mu0pi2p") considering only primaries.
+        InternedString units;                               //!< Units in which the position coordinates are expressed.
         float vertex[3];                                    //!< Vertex of the interaction in detector coordinates.
 
         /**
@@ -63,6 +64,20 @@ namespace dlp::types
         */
         void SyncVectors();
 
+        /**
+         * @brief Intern the string fields.
+         *
+         * The variable-length strings are read by HDF5 into the char* handles.
+         * The InternStrings() method replaces each of them by its (shared)
+         * copy in the StringPool of the reader and releases the buffer
+         * allocated by HDF5. It must be called exactly once after the object
+         * has been read.
+         * @param pool The string pool of the reader.
+         * @param release The function releasing the strings read by HDF5
+         * (see VlenRelease).
+        */
+        void InternStrings(StringPool & pool, const VlenRelease & release);
+
         hvl_t flash_ids_handle;
         hvl_t flash_scores_handle;
         hvl_t flash_times_handle;
@@ -72,6 +87,8 @@ namespace dlp::types
         hvl_t module_ids_handle;
         hvl_t particle_ids_handle;
         hvl_t primary_particle_ids_handle;
+        char * topology_handle;
+        char * units_handle;
     };
 
     /**
@@ -8,6 +8,7 @@
 
 #include <array>
 #include "buffer.h"
+#include "string_pool.h"
 #include "composites.h"
 #include "enums.h"
 
@@ -65,7 +66,7 @@ namespace dlp::types
         float start_dir[3];                                 //!< Unit direction vector calculated at the particle start point.
         float start_point[3];                               //!< Start point (vector) of the particle.
         float start_straightness;                           //!< Straightness at the start of the particle.
-        std::string units;                                  //!< Units in which the position coordinates are expressed.
+        InternedString units;                               //!< Units in which the position coordinates are expressed.
         float vertex_distance;                              //!< Distance from the vertex.
     
         /**
@@ -79,12 +80,27 @@ namespace dlp::types
         */
         void SyncVectors();
 
+        /**
+         * @brief Intern the string fields.
+         *
+         * The variable-length strings are read by HDF5 into the char* handles.
+         * The InternStrings() method replaces each of them by its (shared)
+         * copy in the StringPool of the reader and releases the buffer
+         * allocated by HDF5. It must be called exactly once after the object
+         * has been read.
+         * @param pool The string pool of the reader.
+         * @param release The function releasing the strings read by HDF5
+         * (see VlenRelease).
+        */
+        void InternStrings(StringPool & pool, const VlenRelease & release);
+
         hvl_t fragment_ids_handle;
         hvl_t index_handle;
         hvl_t match_ids_handle;
         hvl_t match_overlaps_handle;
         hvl_t module_ids_handle;
         hvl_t ppn_ids_handle;
+        char * units_handle;
     };
     /**
      * @brief Build the HDF5 compound type for the RecoParticle class.
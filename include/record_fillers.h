@@ -18,6 +18,10 @@
 #include "reco_particle.h"
 #include "true_interaction.h"
 #include "true_particle.h"
+#include "truth_pruning.h"
+#include "voxel_index.h"
+#include "matching.h"
+#include "product_reader.h"
 
 #include "sbnanaobj/StandardRecord/StandardRecord.h"
 
@@ -49,6 +53,19 @@ caf::SRParticleTruthDLP fill_truth_particle(dlp::types::TruthParticle &p, uint64
  */
 caf::SRParticleDLP fill_particle(dlp::types::RecoParticle &p, uint64_t offset=0);
 
+/**
+ * @brief Find the nearest kept ancestor of a true particle after pruning.
+ * @details The chain of parents of the particle is walked up until a particle
+ * that was kept is found. The walk stops at a missing or invalid parent, and
+ * is bounded by the number of particles in case of a cyclic hierarchy.
+ * @param particles the true particles of the event, with their original
+ * identifiers.
+ * @param remap the new index of each true particle (-1 if it was pruned).
+ * @param i the original index of the particle.
+ * @return the new index of the nearest kept ancestor, or -1 if there is none.
+ */
+int64_t kept_ancestor(const std::vector<dlp::types::TruthParticle> &particles, const std::vector<int64_t> &remap, size_t i);
+
 /**
  * @brief Constructs an instance of the caf::SRInteractionTruthDLP class from
  * the data in the dlp::types::TruthInteraction data product and the input
@@ -58,11 +75,15 @@ caf::SRParticleDLP fill_particle(dlp::types::RecoParticle &p, uint64_t offset=0)
  * @param particles the vector of caf::SRParticleTruthDLP objects to copy to
  * the SRTruthInteractionDLP object.
  * @param offset to add to the image_id of the interaction (default = 0).
+ * @param remap the new index of each true particle (-1 if it was pruned), or
+ * nullptr if no particle was pruned (default = nullptr).
+ * @details If particles were pruned, the particle counters of the interaction
+ * are recomputed from the kept particles.
  * @return an instance of the caf::SRInteractionTruthDLP class that contains
  * the data copied from the input dlp::types::TruthInteraction object and the
  * vector of caf::SRParticleTruthDLP.
  */
-caf::SRInteractionTruthDLP fill_truth_interaction(dlp::types::TruthInteraction &in, std::vector<caf::SRParticleTruthDLP> &particles, uint64_t offset=0);
+caf::SRInteractionTruthDLP fill_truth_interaction(dlp::types::TruthInteraction &in, std::vector<caf::SRParticleTruthDLP> &particles, uint64_t offset=0, const std::vector<int64_t> * remap=nullptr);
 
 /**
  * @brief Constructs an instance of the caf::SRInteractionDLP class from the
@@ -91,7 +112,16 @@ caf::SRInteractionDLP fill_interaction(dlp::types::RecoInteraction &in, std::vec
  * @param evt the dlp::types::Event that contains references to the ML data.
  * products within the H5 file.
  * @param offset to add to each image_id in the ML data products (default = 0).
+ * @param pruning the policy for pruning the true particles (default = keep
+ * all true particles).
+ * @param voxels the sidecar file to which the voxel index arrays of the
+ * event are written, keyed by the (Run, Subrun, Event No.) of the
+ * StandardRecord header (default = no sidecar file).
+ * @param matcher the matcher recomputing the reco/truth interaction matches
+ * of the event (default = no recomputed matches).
+ * @param reader the reader whose buffers are reused to read the data
+ * products (default = a reader local to the call).
  */
-void package_event(caf::StandardRecord * rec, H5::H5File & file, dlp::types::Event & evt, uint64_t offset=0);
+void package_event(caf::StandardRecord * rec, H5::H5File & file, dlp::types::Event & evt, uint64_t offset=0, const dlp::TruthPruning & pruning=dlp::TruthPruning(), dlp::VoxelIndexWriter * voxels=nullptr, dlp::Matcher * matcher=nullptr, dlp::ProductReader * reader=nullptr);
 
 #endif
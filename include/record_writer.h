@@ -0,0 +1,137 @@
+/**
+ * @file record_writer.h
+ * @brief Declaration of the RecordWriter class for writing StandardRecord
+ * entries to the output CAF file.
+ * @author mueller@fnal.gov
+*/
+#ifndef RECORD_WRITER_H
+#define RECORD_WRITER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "flat_writer.h"
+#include "output_profile.h"
+#include "precision.h"
+#include "matching.h"
+#include "cross_references.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+#include "TTree.h"
+
+namespace flat
+{
+    template <class T> class Flat;
+    class IBranchPolicy;
+}
+
+namespace dlp
+{
+    /**
+     * @brief A class managing the "recTree" TTree of the output CAF file.
+     *
+     * The writer creates the "recTree" TTree in the current directory and
+     * attaches it to the StandardRecord used by the caller. By default, the
+     * StandardRecord is written as a single "rec" branch (the standard CAF
+     * layout). In flat mode, the StandardRecord is instead written directly
+     * in the flat CAF layout: the non-ML branches are written by the flat
+     * record classes of sbnanaobj and the ML branches ("dlp" and "dlp_true")
+     * are written from the field tables of the record fillers. This removes
+     * the need for a separate flattening pass over the output CAF file. The
+     * split level, basket sizes and auto-flush interval of the TTree are
+     * taken from the @ref OutputProfile. In adaptive mode, the basket sizes
+     * are recomputed from the observed per-branch entry sizes once the
+     * configured number of entries has been written. If the profile has a
+     * precision policy, the ML fields of the StandardRecord are rounded (in
+     * place) before each entry is written. If the profile requests the
+     * cross-references, the ID references between the ML objects of each
+     * entry are resolved into positions and written to a "dlpXrefTree"
+     * TTree with the same entries as the output TTree.
+    */
+    class RecordWriter
+    {
+        public:
+        /**
+         * @brief A constructor for the RecordWriter class.
+         * @param rec The address of the pointer to the StandardRecord. The
+         * pointer must remain valid for the lifetime of the writer.
+         * @param profile The output profile.
+         * @param title The title of the output TTree.
+        */
+        RecordWriter(caf::StandardRecord ** rec, const OutputProfile & profile, const char * title = "records");
+
+        /**
+         * @brief A destructor for the RecordWriter class.
+         * @details The TTree is owned by the output file and is not deleted.
+        */
+        ~RecordWriter();
+
+        /**
+         * @brief Write the recomputed matches alongside the records.
+         * @details A "dlpMatchTree" TTree is created next to the output TTree
+         * and filled with the contents of @p matches each time a record is
+         * written, so the two TTrees have the same entries and can be read
+         * together (e.g. as friends).
+         * @param matches The recomputed matches. They must remain valid for
+         * the lifetime of the writer.
+        */
+        void AttachMatches(const MatchRecord * matches);
+
+        /**
+         * @brief Write the current contents of the StandardRecord to the
+         * output TTree.
+        */
+        void Fill();
+
+        /**
+         * @brief Write the output TTree to its directory.
+         * @details A copy saved by @ref AutoSave() is replaced.
+        */
+        void Write();
+
+        /**
+         * @brief Save the output TTree (and the TTrees filled with it) to the
+         * output file.
+         * @details The baskets filled so far are flushed and the headers of
+         * the TTrees and of their directory are written, so that the entries
+         * filled so far can be read while the job is still running (see
+         * @ref FollowConfig).
+        */
+        void AutoSave();
+
+        /**
+         * @brief Get the output TTree.
+         * @return The output TTree.
+        */
+        TTree * tree() const;
+
+        /**
+         * @brief Check if the writer is writing the flat CAF layout.
+         * @return True if the writer is writing the flat CAF layout.
+        */
+        bool flat() const;
+
+        private:
+        caf::StandardRecord ** fRecord;
+        OutputProfile fProfile;
+        TTree * fTree;
+        std::unique_ptr<flat::IBranchPolicy> fPolicy;
+        std::unique_ptr<flat::Flat<caf::StandardRecord>> fFlatRecord;
+        std::unique_ptr<FlatMLRecord> fFlatML;
+        std::unique_ptr<PrecisionReducer> fPrecision;
+        std::unique_ptr<CrossReferenceBuilder> fCrossReferences;
+        std::vector<TTree *> fCompanions;
+
+        /**
+         * @brief Create a TTree filled and written together with the output
+         * TTree.
+         * @param name The name of the TTree.
+         * @param title The title of the TTree.
+         * @return The TTree (owned by the directory of the output TTree).
+        */
+        TTree * AddCompanion(const char * name, const char * title);
+    };
+} // namespace dlp
+#endif // RECORD_WRITER_H
@@ -0,0 +1,111 @@
+/**
+ * @file skim.h
+ * @brief Declaration of the Skim class for dropping the events which do not
+ * pass a selection on their ML reconstruction outputs.
+ * @author mueller@fnal.gov
+*/
+#ifndef SKIM_H
+#define SKIM_H
+
+#include <set>
+#include <string>
+#include <vector>
+#include "options.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+namespace dlp
+{
+    /**
+     * @brief A single cut on an ML interaction.
+    */
+    struct SkimCut
+    {
+        /**
+         * @brief The quantity on which the cut is applied.
+        */
+        enum Kind
+        {
+            kContained,                         //!< The interaction is contained.
+            kFiducial,                          //!< The interaction is fiducial.
+            kFlashMatched,                      //!< The interaction is matched to a flash.
+            kTopology,                          //!< The topology is one of a list.
+            kMinPrimaries,                      //!< At least N primary particles.
+            kMaxPrimaries,                      //!< At most N primary particles.
+            kMinFlashPE                         //!< At least X PE in the matched flash(es).
+        };
+
+        Kind kind;                              //!< The quantity on which the cut is applied.
+        double value = 0;                       //!< The threshold (numerical cuts only).
+        std::set<std::string> topologies;       //!< The accepted topologies (topology cut only).
+    };
+
+    /**
+     * @brief The signature of the event predicate of a skim plugin.
+     * @details A plugin is a shared library exporting a function with C
+     * linkage named "dlp_skim_event" with this signature. The function is
+     * called after the ML reconstruction outputs of the record have been
+     * filled, and may be called concurrently from several threads.
+    */
+    typedef bool (*SkimPlugin)(const caf::StandardRecord * rec);
+
+    /**
+     * @brief A class deciding which records are written to the output.
+     *
+     * A record passes the built-in cuts if at least one of its ML
+     * interactions (reconstructed, or true if "--skim-truth" is passed) passes
+     * all of them. If a plugin is loaded, the record must also pass its
+     * predicate. Records are skimmed after they have been counted in the
+     * exposure, so the "TotalPOT" and "TotalEvents" histograms still describe
+     * all of the processed records.
+    */
+    class Skim
+    {
+    public:
+        /**
+         * @brief Check if the skim may drop any record.
+         * @return True if any cut or plugin is configured.
+        */
+        bool active() const { return !fCuts.empty() || fPlugin; }
+
+        /**
+         * @brief Check if a record passes the skim.
+         * @param rec The StandardRecord with its ML reconstruction outputs.
+         * @return True if the record is kept.
+        */
+        bool pass(const caf::StandardRecord * rec) const;
+
+        /**
+         * @brief Get a human-readable description of the skim.
+         * @return The description of the skim.
+        */
+        std::string describe() const;
+
+        friend Skim parse_skim(const Options & options);
+
+    private:
+        std::vector<SkimCut> fCuts;             //!< The built-in cuts.
+        bool fTruth = false;                    //!< Apply the cuts to the true interactions.
+        SkimPlugin fPlugin = nullptr;           //!< The predicate of the plugin (if any).
+        std::string fPluginPath;                //!< The path of the plugin (if any).
+    };
+
+    /**
+     * @brief Build the skim from the command line options.
+     * @details The following options are recognized:
+     * - "--skim=<cut>[,<cut>...]" applies the listed built-in cuts, where
+     * each cut is one of "contained", "fiducial", "flash-matched",
+     * "topology=<t>[|<t>...]", "min-primaries=<N>", "max-primaries=<N>" or
+     * "min-flash-pe=<X>".
+     * - "--skim-truth" applies the cuts to the true interactions (simulation
+     * only).
+     * - "--skim-plugin=<library>" loads the predicate of a skim plugin (see
+     * @ref SkimPlugin).
+     * @param options The command line options.
+     * @return The skim.
+     * @throw std::runtime_error if an option has an invalid value or the
+     * plugin cannot be loaded.
+    */
+    Skim parse_skim(const Options & options);
+} // namespace dlp
+#endif // SKIM_H
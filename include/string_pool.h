@@ -0,0 +1,164 @@
+/**
+ * @file string_pool.h
+ * @brief Declaration of the StringPool class and the InternedString class for
+ * deduplicating the variable-length string fields read from the HDF5 files.
+ * @author mueller@fnal.gov
+*/
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <deque>
+#include <string>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include "H5Cpp.h"
+
+namespace dlp
+{
+    class StringPool;
+
+    /**
+     * @brief A handle to a string stored in the StringPool.
+     *
+     * An InternedString is a small ID and a pointer to the single copy of its
+     * value in the pool, so copying it never allocates. It converts
+     * implicitly to a const std::string reference, so it can be assigned
+     * directly to the std::string fields of the StandardRecord. Two
+     * InternedStrings of the same pool are equal if and only if their IDs are
+     * equal. A default-constructed InternedString is the empty string (ID 0).
+     * An InternedString is only valid until its pool is cleared.
+    */
+    class InternedString
+    {
+        public:
+        /**
+         * @brief A default constructor for the InternedString class.
+        */
+        InternedString();
+
+        /**
+         * @brief Get the ID of the string in the pool.
+         * @return The ID of the string.
+        */
+        uint32_t id() const { return fId; }
+
+        /**
+         * @brief Get the value of the string.
+         * @return The value of the string.
+        */
+        const std::string & str() const { return *fValue; }
+
+        /**
+         * @brief Get the value of the string.
+         * @return The value of the string.
+        */
+        operator const std::string & () const { return *fValue; }
+
+        /**
+         * @brief Compare two interned strings.
+         * @param other The other interned string.
+         * @return True if both strings have the same value.
+        */
+        bool operator==(const InternedString & other) const { return fId == other.fId; }
+
+        private:
+        friend class StringPool;
+        static const std::string & empty();
+
+        InternedString(uint32_t id, const std::string * value)
+            : fId(id), fValue(value) { }
+
+        uint32_t fId;
+        const std::string * fValue;
+    };
+
+    /**
+     * @brief The function releasing the variable-length strings read by HDF5.
+     *
+     * The strings are allocated by the allocator of the dataset transfer
+     * property list of the read (see H5Pset_vlen_mem_manager), so they must
+     * be released by its free function, or by H5free_memory if the property
+     * list has none.
+    */
+    class VlenRelease
+    {
+        public:
+        /**
+         * @brief A constructor for the VlenRelease class.
+         * @param transfer The dataset transfer property list of the read.
+        */
+        explicit VlenRelease(const H5::DSetMemXferPropList & transfer);
+
+        /**
+         * @brief Release a string read by HDF5.
+         * @param pointer The string.
+        */
+        void operator()(void * pointer) const;
+
+        private:
+        H5MM_free_t fFree;
+        void * fInfo;
+    };
+
+    /**
+     * @brief A class storing a single copy of each distinct string read from
+     * an HDF5 file.
+     *
+     * The string fields of the HDF5 products (topology, units and the Geant4
+     * creation processes) take only a handful of distinct values, but are
+     * stored once per object. The pool maps each distinct value to a small
+     * ID, so each object keeps an InternedString instead of its own copy.
+     * The empty string has ID 0 and is not stored. Each reader of a file owns
+     * its pool (see ProductReader), which is cleared when the file is closed,
+     * so the pool does not grow across the files of a job. The class is not
+     * thread-safe: a pool is only used by the thread reading its file.
+    */
+    class StringPool
+    {
+        public:
+        /**
+         * @brief A default constructor for the StringPool class.
+        */
+        StringPool() = default;
+
+        StringPool(const StringPool &) = delete;
+        StringPool & operator=(const StringPool &) = delete;
+
+        /**
+         * @brief Intern a string.
+         * @param value The value of the string (nullptr is the empty string).
+         * @return The interned string.
+        */
+        InternedString intern(const char * value);
+
+        /**
+         * @brief Intern a variable-length string read by HDF5 and release it.
+         * @details The buffer allocated by the HDF5 library is released and
+         * the handle is reset to nullptr.
+         * @param handle The handle to the string read by HDF5.
+         * @param release The function releasing the string.
+         * @return The interned string.
+        */
+        InternedString adopt(char *& handle, const VlenRelease & release);
+
+        /**
+         * @brief Get the number of distinct strings in the pool.
+         * @return The number of distinct strings (including the empty
+         * string).
+        */
+        size_t size() const;
+
+        /**
+         * @brief Remove all strings from the pool.
+         * @details The InternedStrings handed out by the pool are no longer
+         * valid.
+        */
+        void clear();
+
+        private:
+        std::deque<std::string> fStrings;
+        std::unordered_map<std::string_view, uint32_t> fIds;
+    };
+} // namespace dlp
+#endif // STRING_POOL_H
@@ -8,6 +8,7 @@
 
 #include <array>
 #include "buffer.h"
+#include "string_pool.h"
 #include "composites.h"
 #include "enums.h"
 
@@ -25,7 +26,7 @@ namespace dlp::types
     {
         double bjorken_x;                                   //!< Bjorken x of the neutrino interaction.
         double cathode_offset;                              //!< Distance from the cathode.
-        std::string creation_process;                       //!< Creation process of the neutrino.
+        InternedString creation_process;                    //!< Creation process of the neutrino.
         BufferView<int32_t> crt_ids;                        //!< CRT IDs associated with the interaction.
         BufferView<int32_t> crt_times;                      //!< CRT times associated with the interaction.
         CurrentType current_type;                           //!< Current type of the neutrino.
@@ -89,9 +90,9 @@ namespace dlp::types
         double t;                                           //!< Time of the interaction.
         int64_t target;                                     //!< Target in the neutrino interaction.
         double theta;                                       //!< Angle of the neutrino interaction.
-        std::string topology;                               //!< Topology of the interaction (e.g. "0g0e1mu0pi2p") considering only primaries.
+        InternedString topology;                            //!< Topology of the interaction (e.g. "0g0e1mu0pi2p") considering only primaries.
         int64_t track_id;                                   //!< Track ID of the neutrino interaction.
-        std::string units;                                  //!< Units in which the position coordinates are expressed.
+        InternedString units;                               //!< Units in which the position coordinates are expressed.
         float vertex[3];                                    //!< Vertex of the interaction in detector coordinates (truth).
 
         /**
@@ -105,6 +106,20 @@ namespace dlp::types
         */
         void SyncVectors();
 
+        /**
+         * @brief Intern the string fields.
+         *
+         * The variable-length strings are read by HDF5 into the char* handles.
+         * The InternStrings() method replaces each of them by its (shared)
+         * copy in the StringPool of the reader and releases the buffer
+         * allocated by HDF5. It must be called exactly once after the object
+         * has been read.
+         * @param pool The string pool of the reader.
+         * @param release The function releasing the strings read by HDF5
+         * (see VlenRelease).
+        */
+        void InternStrings(StringPool & pool, const VlenRelease & release);
+
         hvl_t flash_ids_handle;
         hvl_t flash_scores_handle;
         hvl_t flash_times_handle;
@@ -119,6 +134,9 @@ namespace dlp::types
         hvl_t index_handle;
         hvl_t index_adapt_handle;
         hvl_t index_g4_handle;
+        char * creation_process_handle;
+        char * topology_handle;
+        char * units_handle;
     };
 
     /**
@@ -8,6 +8,7 @@
 
 #include <array>
 #include "buffer.h"
+#include "string_pool.h"
 #include "composites.h"
 #include "enums.h"
 
@@ -21,7 +22,7 @@ namespace dlp::types
     */
     struct TruthParticle
     {
-        std::string ancestor_creation_process;              //!< Geant4 creation process of the ancestor particle.
+        InternedString ancestor_creation_process;           //!< Geant4 creation process of the ancestor particle.
         int64_t ancestor_pdg_code;                          //!< PDG code of the ancestor particle.
         float ancestor_position[3];                         //!< Position of the ancestor particle.
         double ancestor_t;                                  //!< Time of the ancestor particle.
@@ -30,7 +31,7 @@ namespace dlp::types
         double cathode_offset;                              //!< Distance from the cathode.
         BufferView<int64_t> children_counts;                //!< Number of children of the particle.
         BufferView<int64_t> children_id;                    //!< List of particle ID of children particles.
-        std::string creation_process;                       //!< Geant4 creation process of the particle.
+        InternedString creation_process;                    //!< Geant4 creation process of the particle.
         double csda_ke;                                     //!< Continuous-slowing-down-approximation kinetic energy.
         double csda_ke_per_pid[6];                          //!< CSDA kinetic energy per PID.
         float depositions_adapt_q_sum;                      //!< Total tagged (reco non-ghost) charge deposited [ADC].
@@ -82,7 +83,7 @@ namespace dlp::types
         int64_t orig_interaction_id;                        //!< Interaction ID as it was stored in the parent LArCV file under the interaction_id attribute.
         int64_t orig_parent_id;                             //!< Parent ID as it was stored in the parent LArCV file under the parent_id attribute.
         float p;                                            //!< Momentum magnitude.
-        std::string parent_creation_process;                //!< Geant4 creation process of the parent particle.
+        InternedString parent_creation_process;             //!< Geant4 creation process of the parent particle.
         int64_t parent_id;                                  //!< Parent particle ID.
         int64_t parent_pdg_code;                            //!< PDG code of the parent particle.
         float parent_position[3];                           //!< Position of the parent particle.
@@ -104,7 +105,7 @@ namespace dlp::types
         float start_point[3];                               //!< Start point (vector) of the particle.
         double t;                                           //!< Time of the particle.
         int64_t track_id;                                   //!< Track ID of the particle.
-        std::string units;                                  //!< Units in which the position coordinates are expressed.
+        InternedString units;                               //!< Units in which the position coordinates are expressed.
         
         /**
          * @brief Synchronize the BufferView objects.
@@ -117,6 +118,20 @@ namespace dlp::types
         */
         void SyncVectors();
 
+        /**
+         * @brief Intern the string fields.
+         *
+         * The variable-length strings are read by HDF5 into the char* handles.
+         * The InternStrings() method replaces each of them by its (shared)
+         * copy in the StringPool of the reader and releases the buffer
+         * allocated by HDF5. It must be called exactly once after the object
+         * has been read.
+         * @param pool The string pool of the reader.
+         * @param release The function releasing the strings read by HDF5
+         * (see VlenRelease).
+        */
+        void InternStrings(StringPool & pool, const VlenRelease & release);
+
         hvl_t children_counts_handle;
         hvl_t children_id_handle;
         hvl_t fragment_ids_handle;
@@ -124,6 +139,10 @@ namespace dlp::types
         hvl_t match_overlaps_handle;
         hvl_t module_ids_handle;
         hvl_t orig_children_id_handle;
+        char * ancestor_creation_process_handle;
+        char * creation_process_handle;
+        char * parent_creation_process_handle;
+        char * units_handle;
     };
     /**
      * @brief Build the HDF5 compound type for the TruthParticle class.
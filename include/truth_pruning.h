@@ -0,0 +1,93 @@
+/**
+ * @file truth_pruning.h
+ * @brief Declaration of the TruthPruning struct for dropping the true
+ * particles which are not needed downstream.
+ * @author mueller@fnal.gov
+*/
+#ifndef TRUTH_PRUNING_H
+#define TRUTH_PRUNING_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "options.h"
+#include "true_particle.h"
+
+namespace dlp
+{
+    /**
+     * @brief A struct describing which true particles are converted.
+     *
+     * A true particle is kept only if it passes all of the enabled criteria.
+     * Pruned particles are never converted, and the remaining particles are
+     * renumbered consecutively (in their original order) so that the "id" of
+     * each particle is again its index in the event. All of the references to
+     * true particles ("particle_ids" and "primary_particle_ids" of the true
+     * interactions, "parent_id" and "children_id" of the true particles and
+     * "match_ids" of the reconstructed particles) are remapped accordingly.
+     * References to pruned particles are dropped. The "parent_id" of a kept
+     * particle whose parent was pruned points to its nearest kept ancestor
+     * (-1 if there is none), and the "children_id" of the kept particles are
+     * rebuilt from these parents. The particle counters of the interactions
+     * are recomputed from the kept particles, while the original identifiers
+     * ("orig_id", "orig_parent_id", etc.) are left unchanged.
+    */
+    struct TruthPruning
+    {
+        bool primaries_only = false;            //!< Keep only the primary particles.
+        bool valid_only = false;                //!< Keep only the valid particles ("is_valid").
+        double min_energy_deposit = 0;          //!< Minimum deposited energy (MeV) of the kept particles.
+        bool energy_cut = false;                //!< True if the deposited energy threshold is enabled.
+
+        /**
+         * @brief Check if the pruning may drop any particle.
+         * @return True if any criterion is enabled.
+        */
+        bool active() const { return primaries_only || valid_only || energy_cut; }
+
+        /**
+         * @brief Check if a true particle is kept.
+         * @param particle The true particle.
+         * @return True if the particle passes all of the enabled criteria.
+        */
+        bool keep(const types::TruthParticle & particle) const;
+
+        /**
+         * @brief Build the new index of each true particle of an event.
+         * @param particles The true particles of the event.
+         * @return The new index of each particle, or -1 if it is pruned.
+        */
+        std::vector<int64_t> index(const std::vector<types::TruthParticle> & particles) const;
+    };
+
+    /**
+     * @brief Remap a list of true particle identifiers.
+     * @details The identifiers of pruned particles are dropped. If @p weights
+     * is not null, the entries of the associated list (e.g. the overlaps of
+     * "match_ids") are dropped along with them.
+     * @param ids The list of identifiers (updated).
+     * @param index The new index of each particle (see @ref TruthPruning::index).
+     * @param weights The associated list (optional, updated).
+    */
+    void remap_ids(std::vector<int64_t> & ids, const std::vector<int64_t> & index, std::vector<float> * weights = nullptr);
+
+    /**
+     * @brief Build the truth pruning from the command line options.
+     * @details The "--prune-truth=<policy>[,<policy>...]" option enables the
+     * listed policies, each of which is one of "primaries", "valid" or
+     * "energy=<MeV>" (minimum deposited energy). The option is only accepted
+     * by the simulation version of the executables.
+     * @param options The command line options.
+     * @return The truth pruning.
+     * @throw std::runtime_error if the option has an invalid value.
+    */
+    TruthPruning parse_truth_pruning(const Options & options);
+
+    /**
+     * @brief Get a human-readable description of the truth pruning.
+     * @param pruning The truth pruning.
+     * @return The description of the truth pruning.
+    */
+    std::string describe_truth_pruning(const TruthPruning & pruning);
+} // namespace dlp
+#endif // TRUTH_PRUNING_H
@@ -0,0 +1,183 @@
+/**
+ * @file voxel_index.h
+ * @brief Declaration of the codec and of the sidecar file writer and reader
+ * for the voxel index arrays of the ML data products.
+ * @author mueller@fnal.gov
+*/
+#ifndef VOXEL_INDEX_H
+#define VOXEL_INDEX_H
+
+#include <span>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "H5Cpp.h"
+#include "buffer.h"
+
+namespace dlp
+{
+    /**
+     * @brief The voxel index arrays stored in the sidecar file.
+    */
+    enum VoxelIndexKind : uint8_t
+    {
+        kRecoParticleIndex = 0,                 //!< "index" of a RecoParticle.
+        kTruthInteractionIndex = 1,             //!< "index" of a TruthInteraction.
+        kTruthInteractionIndexAdapt = 2,        //!< "index_adapt" of a TruthInteraction.
+        kTruthInteractionIndexG4 = 3            //!< "index_g4" of a TruthInteraction.
+    };
+
+    /**
+     * @brief The number of values (deltas) in each bit-packed block.
+    */
+    constexpr size_t kVoxelBlockSize = 128;
+
+    /**
+     * @brief The number of readable bytes which must follow the encoded data
+     * passed to @ref decode_voxel_index.
+    */
+    constexpr size_t kVoxelPadding = 8;
+
+    /**
+     * @brief Encode a voxel index array.
+     * @details The values are sorted, and the differences between
+     * consecutive values are bit-packed in blocks of @ref kVoxelBlockSize.
+     * Each block starts with one byte holding the bit width of its values,
+     * followed by the values packed with that width (least significant bit
+     * first). The first value is returned separately. The fixed width of
+     * each block keeps the packing and unpacking loops free of data-dependent
+     * branches.
+     * @param values The values (sorted in place).
+     * @param out The buffer to which the encoded bytes are appended.
+     * @return The first (smallest) value, or zero if there are no values.
+    */
+    int64_t encode_voxel_index(std::vector<int64_t> & values, std::vector<uint8_t> & out);
+
+    /**
+     * @brief Decode a voxel index array.
+     * @param data The encoded bytes, followed by at least
+     * @ref kVoxelPadding readable bytes.
+     * @param count The number of values.
+     * @param first The first value (see @ref encode_voxel_index).
+     * @param out The decoded (sorted) values (at least @p count elements).
+    */
+    void decode_voxel_index(const uint8_t * data, size_t count, int64_t first, int64_t * out);
+
+    /**
+     * @brief The description of one encoded voxel index array in the sidecar
+     * file.
+    */
+    struct VoxelIndexRecord
+    {
+        uint32_t run;                           //!< The run number of the event.
+        uint32_t subrun;                        //!< The subrun number of the event.
+        uint32_t event;                         //!< The event number of the event.
+        uint8_t kind;                           //!< The kind of array (see @ref VoxelIndexKind).
+        int64_t id;                             //!< The "id" of the particle or interaction.
+        int64_t first;                          //!< The first (smallest) value of the array.
+        uint64_t count;                         //!< The number of values of the array.
+        uint64_t offset;                        //!< The offset of the encoded bytes in the "data" dataset.
+        uint64_t bytes;                         //!< The number of encoded bytes.
+    };
+
+    /**
+     * @brief Build the HDF5 compound type for the VoxelIndexRecord struct.
+     * @return The HDF5 compound type.
+    */
+    H5::CompType voxel_index_type();
+
+    /**
+     * @brief A class writing the voxel index arrays to a sidecar HDF5 file.
+     *
+     * The sidecar file holds two extendible datasets: "objects", with one
+     * @ref VoxelIndexRecord per array, and "data", the concatenated encoded
+     * bytes of all arrays. The arrays are identified by the (Run, Subrun,
+     * Event No.) of their event, their kind and the "id" of their particle
+     * or interaction. The arrays are buffered in memory and appended to the
+     * datasets in batches.
+    */
+    class VoxelIndexWriter
+    {
+        public:
+        /**
+         * @brief A constructor for the VoxelIndexWriter class.
+         * @param path The path of the sidecar file (overwritten).
+        */
+        explicit VoxelIndexWriter(const std::string & path);
+
+        /**
+         * @brief A destructor for the VoxelIndexWriter class.
+         * @details The buffered arrays are written and the file is closed.
+        */
+        ~VoxelIndexWriter();
+
+        /**
+         * @brief Add a voxel index array.
+         * @param run The run number of the event.
+         * @param subrun The subrun number of the event.
+         * @param event The event number of the event.
+         * @param kind The kind of array.
+         * @param id The "id" of the particle or interaction.
+         * @param values The values of the array.
+        */
+        void add(uint32_t run, uint32_t subrun, uint32_t event, VoxelIndexKind kind, int64_t id, const BufferView<int64_t> & values);
+
+        /**
+         * @brief Append the buffered arrays to the datasets.
+        */
+        void flush();
+
+        private:
+        H5::H5File fFile;
+        H5::CompType fType;
+        H5::DataSet fObjects;
+        H5::DataSet fData;
+        hsize_t fObjectsSize;
+        hsize_t fDataSize;
+        std::vector<VoxelIndexRecord> fRecords;
+        std::vector<uint8_t> fBytes;
+        std::vector<int64_t> fScratch;
+    };
+
+    /**
+     * @brief A class reading the voxel index arrays from a sidecar HDF5 file.
+     * @details All of the @ref VoxelIndexRecord entries are read (and sorted)
+     * when the file is opened. The encoded bytes of an array are only read
+     * when the array is requested.
+    */
+    class VoxelIndexReader
+    {
+        public:
+        /**
+         * @brief A constructor for the VoxelIndexReader class.
+         * @param path The path of the sidecar file.
+        */
+        explicit VoxelIndexReader(const std::string & path);
+
+        /**
+         * @brief Get a voxel index array.
+         * @param run The run number of the event.
+         * @param subrun The subrun number of the event.
+         * @param event The event number of the event.
+         * @param kind The kind of array.
+         * @param id The "id" of the particle or interaction.
+         * @return The (sorted) values of the array, or an empty span if the
+         * array is not in the file. The span is valid until the next call.
+        */
+        std::span<const int64_t> get(uint32_t run, uint32_t subrun, uint32_t event, VoxelIndexKind kind, int64_t id);
+
+        /**
+         * @brief Get the number of arrays in the file.
+         * @return The number of arrays.
+        */
+        size_t size() const { return fRecords.size(); }
+
+        private:
+        H5::H5File fFile;
+        H5::DataSet fData;
+        std::vector<VoxelIndexRecord> fRecords;
+        std::vector<uint8_t> fBytes;
+        std::vector<int64_t> fValues;
+    };
+} // namespace dlp
+#endif // VOXEL_INDEX_H
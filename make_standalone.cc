@@ -13,16 +13,38 @@
  */
 #include <iostream>
 #include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 #include <ctype.h>
 #include "H5Cpp.h"
 
 #include "include/record_fillers.h"
 #include "include/products.h"
+#include "include/product_reader.h"
 #include "include/event.h"
 #include "include/reco_interaction.h"
 #include "include/reco_particle.h"
 #include "include/true_interaction.h"
 #include "include/true_particle.h"
+#include "include/record_writer.h"
+#include "include/options.h"
+#include "include/instrumentation.h"
+#include "include/logger.h"
+#include "include/event_validation.h"
+#include "include/event_selection.h"
+#include "include/skim.h"
+#include "include/truth_pruning.h"
+#include "include/voxel_index.h"
+#include "include/matching.h"
+#include "include/output_profile.h"
+#include "include/follow.h"
+#include "include/jobs.h"
 
 #include "sbnanaobj/StandardRecord/StandardRecord.h"
 #include "sbnanaobj/StandardRecord/SRInteractionDLP.h"
@@ -33,8 +55,220 @@
 #include "TFile.h"
 #include "TTree.h"
 #include "TH1F.h"
+#include "TROOT.h"
+#include "Compression.h"
+#include "ROOT/TBufferMerger.hxx"
 
-int main(int argc, char const *argv[])
+/**
+ * @brief The events of an input HDF5 file selected for conversion.
+ */
+struct FileSelection
+{
+    uint64_t first_entry;                       //!< The global entry number of the first event of the file.
+    uint64_t begin;                             //!< The first selected event of the file.
+    uint64_t end;                               //!< One past the last selected event of the file.
+};
+
+/**
+ * @brief Select the events of each input HDF5 file.
+ * @details The events of all input files are numbered globally, in the order
+ * of the files, and the range of the @ref dlp::EventSelection is applied to
+ * the global entry numbers. If the selection is active, the number of events
+ * of each file is needed, so each file is opened once to read the extent of
+ * its "events" dataset (but not the events themselves).
+ * @param paths The paths of the input HDF5 files.
+ * @param selection The event selection.
+ * @return The selected events of each file.
+ */
+std::vector<FileSelection> select_files(const std::vector<std::string> & paths, const dlp::EventSelection & selection)
+{
+    std::vector<FileSelection> files(paths.size(), FileSelection{0, 0, std::numeric_limits<uint64_t>::max()});
+    if(!selection.active())
+        return files;
+
+    std::vector<uint64_t> sizes;
+    uint64_t nentries(0);
+    for(const std::string & path : paths)
+    {
+        H5::H5File file(path, H5F_ACC_RDONLY);
+        H5::DataSpace space(file.openDataSet("events").getSpace());
+        sizes.push_back(get_nevents(space));
+        file.close();
+        nentries += sizes.back();
+    }
+
+    auto [first, last] = selection.range(nentries);
+    uint64_t first_entry(0);
+    for(size_t f(0); f < paths.size(); ++f)
+    {
+        files[f].first_entry = first_entry;
+        files[f].begin = std::min(sizes[f], first > first_entry ? first - first_entry : 0);
+        files[f].end = std::max(files[f].begin, std::min(sizes[f], last > first_entry ? last - first_entry : 0));
+        first_entry += sizes[f];
+    }
+    return files;
+}
+
+/**
+ * @brief Convert the selected events of an input HDF5 file into
+ * StandardRecord entries.
+ * @details The HDF5 library is not thread-safe, so all accesses to the input
+ * file are made while holding @p hdf5_mutex. The filling (and compression) of
+ * the output TTree takes place outside of the lock, which allows several
+ * workers to write in parallel.
+ * @param path The path of the input HDF5 file.
+ * @param range The selected events of the file.
+ * @param selection The event selection (used for the sampling).
+ * @param skim The skim applied to the converted events.
+ * @param pruning The policy for pruning the true particles.
+ * @param voxels The sidecar file for the voxel index arrays (optional). It is
+ * only accessed while holding @p hdf5_mutex.
+ * @param matcher The matcher recomputing the reco/truth matches (optional).
+ * @param writer The writer of the output TTree.
+ * @param rec The StandardRecord attached to the writer.
+ * @param offset The offset to add to each image_id.
+ * @param pot The total POT histogram.
+ * @param nevt The total events histogram.
+ * @param hdf5_mutex The mutex guarding the HDF5 library.
+ * @param follow The follow configuration. In follow mode, the file is opened
+ * as a SWMR reader and the events appended to it are converted as they
+ * arrive, until no event has been appended for the idle timeout. The output
+ * TTree and the histograms are saved periodically.
+ * @return The number of events of the file.
+ */
+uint64_t convert_file(const std::string & path, const FileSelection & range, const dlp::EventSelection & selection, const dlp::Skim & skim, const dlp::TruthPruning & pruning, dlp::VoxelIndexWriter * voxels, dlp::Matcher * matcher, dlp::RecordWriter & writer, caf::StandardRecord * rec, uint64_t offset, TH1F * pot, TH1F * nevt, std::mutex & hdf5_mutex, const dlp::FollowConfig & follow = dlp::FollowConfig())
+{
+    if(range.begin >= range.end)
+        return 0;
+
+    /**
+     * @brief Open the input HDF5 file.
+     * @details Configure the input HDF5 file and retrieve the list of all
+     * events. The dlp::types::Event class contains only references to the
+     * actual ML data products, so it is not overly heavy. The references of
+     * all events are validated up front (see @ref dlp::validate_events).
+     */
+    std::unique_ptr<H5::H5File> file;
+    std::vector<dlp::types::Event> events;
+    dlp::EventValidity validity;
+    dlp::ProductReader reader;
+    {
+        std::lock_guard<std::mutex> lock(hdf5_mutex);
+        dlp::ScopedTimer timer("hdf5_open");
+        file.reset(new H5::H5File(path, dlp::input_access_flags(follow)));
+        dlp::Logger::get().log(dlp::LogLevel::kInfo, "open_file", "Opened file: ", path);
+        events = get_all_events(*file);
+        validity = dlp::validate_events(*file, events);
+    }
+
+    /**
+     * @brief Follow the input HDF5 file (if requested).
+     * @details The events appended to the file are read and validated when
+     * the loop has converted all known events. The output is saved with
+     * @ref dlp::RecordWriter::AutoSave, after the histograms, so that it can
+     * be read while the file is followed.
+     */
+    std::unique_ptr<dlp::Follower> follower;
+    if(follow.active)
+    {
+        dlp::Logger::get().log(dlp::LogLevel::kInfo, "follow", "Following file: ", path);
+        follower = std::make_unique<dlp::Follower>(follow, [&]() -> size_t
+        {
+            std::lock_guard<std::mutex> lock(hdf5_mutex);
+            reader.clear();
+            size_t first(events.size());
+            size_t added(get_new_events(*file, events));
+            if(added > 0)
+            {
+                std::vector<dlp::types::Event> appended(events.begin() + first, events.end());
+                validity.append(dlp::validate_events(*file, appended));
+            }
+            return added;
+        }, [&]()
+        {
+            pot->Write("", TObject::kOverwrite);
+            nevt->Write("", TObject::kOverwrite);
+            writer.AutoSave();
+        });
+    }
+
+    /**
+     * @brief Loop over all events in the current HDF5 file.
+    */
+    for(size_t e(range.begin); e < range.end; ++e)
+    {
+        if(e >= events.size() && !(follower && follower->wait()))
+            break;
+        if(!selection.sampled(range.first_entry + e))
+            continue;
+
+        /**
+         * @brief Skip the events with invalid references.
+         * @details These events would otherwise throw an exception after
+         * some of their products have already been read.
+        */
+        if(!validity.valid(e))
+        {
+            dlp::Logger::get().log(dlp::LogLevel::kWarning, "invalid_event", "Skipping event ", e, " of ", path, " with invalid references.");
+            continue;
+        }
+        dlp::types::Event &evt(events[e]);
+
+        /**
+         * @brief Reset the ML reconstruction output branches.
+         * @details It is safest to reset the ML reconstruction output
+         * branches to prevent old products from remaining in the case
+         * where something unexpected happens.
+        */
+        rec->dlp.clear();
+        rec->ndlp = 0;
+        rec->dlp_true.clear();
+        rec->ndlp_true = 0;
+        if(matcher)
+            matcher->clear();
+        try
+        {
+            /**
+             * @brief Package the event data products.
+             * @details The @ref package_event() function is responsible
+             * for copying the data products from the event into the proper
+             * CAF class within the StandardRecord.
+            */
+            std::unique_lock<std::mutex> lock(hdf5_mutex);
+            dlp::Instrumentation::get().count_event();
+            std::vector<dlp::types::RunInfo> & run_info(reader.read<dlp::types::RunInfo>(*file, evt));
+            rec->hdr.run = run_info[0].run;
+            rec->hdr.subrun = run_info[0].subrun;
+            rec->hdr.evt = run_info[0].event;
+            package_event(rec, *file, evt, offset, pruning, voxels, matcher, &reader);
+            lock.unlock();
+            rec->hdr.pot = 1;
+            rec->hdr.first_in_subrun = true;
+            pot->Fill(1);
+            nevt->Fill(1);
+            if(skim.active() && !skim.pass(rec))
+            {
+                dlp::Instrumentation::get().add_count("skimmed_event");
+                continue;
+            }
+            writer.Fill();
+            if(follower)
+                follower->filled();
+        }
+        catch(const H5::ReferenceException & e)
+        {
+            dlp::Logger::get().log(dlp::LogLevel::kWarning, "incomplete_event", "Found incomplete entry for event in ", path, ".");
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(hdf5_mutex);
+    reader.clear();
+    file->close();
+    file.reset();
+    return events.size();
+}
+
+int make_standalone_main(int argc, char const * argv[])
 {
     /**
      * @brief Check that the required arguments are present.
@@ -43,9 +277,171 @@ int main(int argc, char const *argv[])
      * useful in the case where each file has a separate indexing of images (from
      * batch processing). The final argument(s) is/are a list of input H5 files.
      */
-    if(argc < 4)
+    dlp::Options options(argc, argv);
+    const std::vector<std::string> & args(options.positional());
+    if(args.size() < 3)
+    {
+        std::cerr << "Usage: ./make_standalone <output file> <event offset> <input file(s)> [--flat] [--threads=N] [--buffer-merger] [--entries=<first>:<last>] [--shard=<i>/<N>] [--sample=<fraction>] [--seed=<seed>] [--skim=<cut>[,<cut>...]] [--skim-truth] [--skim-plugin=<library>] [--prune-truth=<policy>[,<policy>...]] [--voxel-sidecar=<file>] [--rematch=<metric>[:<threshold>]] [--follow[=<seconds>]] [--poll=<seconds>] [--autosave=<seconds>] [output options] [--report=<file>] [--progress=<seconds>] [logging options]" << std::endl;
+        return 0;
+    }
+
+    /**
+     * @brief Configure the instrumentation (if requested) and the logging of
+     * the job.
+     */
+    dlp::Instrumentation::get().configure(options);
+    dlp::Logger::get().configure(options);
+    uint64_t offset(std::stoll(args[1]));
+    std::mutex hdf5_mutex;
+
+    /**
+     * @brief Configure the output profile.
+     * @details The output profile holds the compression and layout settings
+     * of the output CAF file. ROOT implicit multithreading (if requested) is
+     * enabled before any TTree is created.
+     */
+    dlp::OutputProfile profile(dlp::parse_output_profile(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "output_profile", "Output profile: ", dlp::describe_output_profile(profile));
+    dlp::enable_implicit_mt(profile);
+
+    /**
+     * @brief Configure the selection of the input events.
+     * @details The events of all input files are numbered in the order of
+     * the files. Only the events in the selected range, shard and sample (see
+     * @ref EventSelection) are converted, and the files without any selected
+     * event are not opened for conversion.
+     */
+    dlp::EventSelection selection(dlp::parse_event_selection(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "selection", "Event selection: ", dlp::describe_event_selection(selection));
+
+    /**
+     * @brief Configure the skim of the converted events.
+     * @details Events which do not pass the skim (see @ref Skim) are not
+     * written, but remain counted in the exposure.
+     */
+    dlp::Skim skim(dlp::parse_skim(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "skim", "Skim: ", skim.describe());
+
+    /**
+     * @brief Configure the pruning of the true particles.
+     * @details Pruned particles (see @ref TruthPruning) are never converted.
+     */
+    dlp::TruthPruning pruning(dlp::parse_truth_pruning(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "pruning", "Truth pruning: ", dlp::describe_truth_pruning(pruning));
+
+    /**
+     * @brief Configure the voxel index sidecar file.
+     * @details If "--voxel-sidecar" is passed, the voxel index arrays of the
+     * converted events are written (encoded) to a separate HDF5 file, keyed
+     * by (Run, Subrun, Event No.). See @ref VoxelIndexWriter.
+     */
+    std::unique_ptr<dlp::VoxelIndexWriter> voxels;
+    if(options.has("voxel-sidecar"))
+        voxels = std::make_unique<dlp::VoxelIndexWriter>(options.get("voxel-sidecar"));
+
+    /**
+     * @brief Configure the recomputation of the reco/truth matches.
+     * @details If "--rematch" is passed, the interaction matches are
+     * recomputed from the voxel index arrays of the converted events with the
+     * requested metric (see @ref Matcher) and written to the "dlpMatchTree"
+     * TTree of the output CAF file.
+     */
+    dlp::MatchConfig match_config(dlp::parse_match_config(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "rematch", "Recomputed matches: ", dlp::describe_match_config(match_config));
+
+    /**
+     * @brief Configure the following of the input files.
+     * @details If "--follow" is passed, the input files are opened as SWMR
+     * readers and converted while they are being written (see
+     * @ref FollowConfig). The files are followed one at a time, in order, so
+     * the number of events of each file is only known once it has been
+     * followed: the range and shard of the selection cannot be applied, and
+     * the events are numbered for the sampling as the files are converted.
+     */
+    dlp::FollowConfig follow(dlp::parse_follow_config(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "follow", "Follow mode: ", dlp::describe_follow_config(follow));
+    if(follow.active && options.has("buffer-merger"))
+        throw std::runtime_error("The --follow option cannot be combined with --buffer-merger.");
+    if(follow.active && (selection.first != 0 || selection.last != std::numeric_limits<uint64_t>::max() || selection.nshards != 1))
+        throw std::runtime_error("The --follow option cannot be combined with --entries or --shard.");
+
+    std::vector<FileSelection> files;
+    if(follow.active)
+        files.assign(args.size() - 2, FileSelection{0, 0, std::numeric_limits<uint64_t>::max()});
+    else
+        files = select_files(std::vector<std::string>(args.begin() + 2, args.end()), selection);
+
+    if(options.has("buffer-merger"))
     {
-        std::cerr << "Usage: ./make_standalone <output file> <event offset> <input file(s)>" << std::endl;
+        /**
+         * @brief Convert the input files in parallel.
+         * @details Each worker thread takes the next unprocessed input file,
+         * converts it into its own TTree in a file provided by the
+         * TBufferMerger, and hands the file to the merger once the input file
+         * is done. The merger appends the TTrees of all workers into the
+         * single output CAF file in the background. The order of the entries
+         * in the output therefore depends on the order in which the workers
+         * finish their input files. The workers create their TTrees and
+         * histograms concurrently, so the thread safety of ROOT (including a
+         * per-thread gDirectory) is enabled even without "--threads", which
+         * is the only option enabling it otherwise.
+         */
+        ROOT::EnableThreadSafety();
+        size_t nworkers(profile.threads > 0 ? profile.threads : std::thread::hardware_concurrency());
+        nworkers = std::max<size_t>(1, std::min(nworkers, args.size() - 2));
+        dlp::Logger::get().log(dlp::LogLevel::kInfo, "converting", "Converting ", args.size() - 2, " file(s) with ", nworkers, " worker(s).");
+
+        TH1F * pot = new TH1F("TotalPOT", "TotalPOT", 1, 0, 1);
+        TH1F * nevt = new TH1F("TotalEvents", "TotalEvents", 1, 0, 1);
+        pot->SetDirectory(nullptr);
+        nevt->SetDirectory(nullptr);
+
+        ROOT::TBufferMerger merger(args[0].c_str(), "recreate", profile.compression.value_or(ROOT::RCompressionSetting::EDefaults::kUseCompiledDefault));
+        std::atomic<size_t> next(2);
+        std::mutex histogram_mutex;
+        std::vector<std::thread> workers;
+        for(size_t w(0); w < nworkers; ++w)
+        {
+            workers.emplace_back([&]()
+            {
+                std::shared_ptr<ROOT::TBufferMergerFile> output(merger.GetFile());
+                output->cd();
+                caf::StandardRecord *rec = new caf::StandardRecord;
+                dlp::RecordWriter rec_tree(&rec, profile, "Event tree for ML reconstruction");
+                std::unique_ptr<dlp::Matcher> matcher;
+                if(match_config.active())
+                {
+                    matcher = std::make_unique<dlp::Matcher>(match_config);
+                    rec_tree.AttachMatches(&matcher->record());
+                }
+                TH1F worker_pot("worker_pot", "worker_pot", 1, 0, 1);
+                TH1F worker_nevt("worker_nevt", "worker_nevt", 1, 0, 1);
+                worker_pot.SetDirectory(nullptr);
+                worker_nevt.SetDirectory(nullptr);
+                for(size_t n(next++); n < args.size(); n = next++)
+                {
+                    convert_file(args[n], files[n - 2], selection, skim, pruning, voxels.get(), matcher.get(), rec_tree, rec, offset, &worker_pot, &worker_nevt, hdf5_mutex);
+                    output->Write();
+                }
+                std::lock_guard<std::mutex> lock(histogram_mutex);
+                pot->Add(&worker_pot);
+                nevt->Add(&worker_nevt);
+                delete rec;
+            });
+        }
+        for(std::thread & worker : workers)
+            worker.join();
+
+        /**
+         * @brief Write the histograms to the output CAF file.
+         * @details The histograms are summed over all workers and written
+         * through one last file of the merger.
+         */
+        std::shared_ptr<ROOT::TBufferMergerFile> output(merger.GetFile());
+        output->cd();
+        pot->SetDirectory(output.get());
+        nevt->SetDirectory(output.get());
+        output->Write();
         return 0;
     }
 
@@ -54,12 +450,20 @@ int main(int argc, char const *argv[])
      * @details There must be a TTree with a specific name for holding the
      * StandardRecord entries. The "rec" object is used as the connection
      * between a locally-populated StandardRecord and the entries populating
-     * the TTree.
+     * the TTree. If the "--flat" option is passed, the entries are written
+     * directly in the flat CAF layout. The compression and layout of the
+     * output are configured by the output options (see @ref OutputProfile).
      */
-    TFile caf(argv[1], "recreate");
-    TTree rec_tree("recTree", "Event tree for ML reconstruction");
+    TFile caf(args[0].c_str(), "recreate");
+    dlp::apply_output_profile(caf, profile);
     caf::StandardRecord *rec = new caf::StandardRecord;
-    rec_tree.Branch("rec", &rec);
+    dlp::RecordWriter rec_tree(&rec, profile, "Event tree for ML reconstruction");
+    std::unique_ptr<dlp::Matcher> matcher;
+    if(match_config.active())
+    {
+        matcher = std::make_unique<dlp::Matcher>(match_config);
+        rec_tree.AttachMatches(&matcher->record());
+    }
 
     /**
      * @brief Create total POT and total event histograms.
@@ -76,66 +480,21 @@ int main(int argc, char const *argv[])
      * @details Each HDF5 file will be opened and copied into the same output
      * CAF file.
      */
-    for(size_t n(3); n < argc; ++n)
+    uint64_t first_entry(0);
+    for(size_t n(2); n < args.size(); ++n)
     {
-        /**
-         * @brief Open the input HDF5 file.
-         * @details Configure the input HDF5 file and retrieve the list of all
-         * events. The dlp::types::Event class contains only references to the
-         * actual ML data products, so it is not overly heavy.
-         */
-        H5::H5File file(argv[n], H5F_ACC_RDONLY);
-        std::cout << "Opened file: " << argv[n] << std::endl;    
-        std::vector<dlp::types::Event> events(get_all_events(file));
-
-        /**
-         * @brief Loop over all events in the current HDF5 file.
-        */
-        for(dlp::types::Event &evt : events)
-        {
-            /**
-             * @brief Reset the ML reconstruction output branches.
-             * @details It is safest to reset the ML reconstruction output
-             * branches to prevent old products from remaining in the case
-             * where something unexpected happens.
-            */ 
-            rec->dlp.clear();
-            rec->ndlp = 0;
-            rec->dlp_true.clear();
-            rec->ndlp_true = 0;
-            try
-            {
-                /**
-                 * @brief Package the event data products.
-                 * @details The @ref package_event() function is responsible
-                 * for copying the data products from the event into the proper
-                 * CAF class within the StandardRecord.
-                */
-                package_event(rec, file, evt, std::atoi(argv[2]));
-                std::vector<dlp::types::RunInfo> run_info(get_product<dlp::types::RunInfo>(file, evt));
-                rec->hdr.run = run_info[0].run;
-                rec->hdr.subrun = run_info[0].subrun;
-                rec->hdr.evt = run_info[0].event;
-                rec->hdr.pot = 1;
-                rec->hdr.first_in_subrun = true;
-                pot->Fill(1);
-                nevt->Fill(1);
-                rec_tree.Fill();
-            }
-            catch(const H5::ReferenceException & e)
-            {
-                std::cerr << "Found incomplete entry for event." << std::endl;
-            }
-        }
-        file.close();
+        if(follow.active)
+            files[n - 2].first_entry = first_entry;
+        first_entry += convert_file(args[n], files[n - 2], selection, skim, pruning, voxels.get(), matcher.get(), rec_tree, rec, offset, pot, nevt, hdf5_mutex, follow);
     }
+
     /**
      * @brief Write the output CAF file.
      * @details Write the "rec" TTree, the POT, and the number events
      * histograms to the output CAF file.
     */
-    pot->Write();
-    nevt->Write();
+    pot->Write("", TObject::kOverwrite);
+    nevt->Write("", TObject::kOverwrite);
     rec_tree.Write();
 
     /**
@@ -144,4 +503,11 @@ int main(int argc, char const *argv[])
     caf.Close();
 
     return 0;
-}
\ No newline at end of file
+}
+
+#ifndef DLP_DAEMON
+int main(int argc, char const * argv[])
+{
+    return make_standalone_main(argc, argv);
+}
+#endif
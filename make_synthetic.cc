@@ -0,0 +1,575 @@
+/**
+ * @file make_synthetic.cc
+ * @brief This file contains the main function for the synthetic SPINE HDF5
+ * file generator.
+ * @details The synthetic file generator writes HDF5 files with the same layout
+ * as the SPINE reconstruction outputs: an "events" dataset of region
+ * references into the "index", "meta", "run_info", "reco_interactions",
+ * "reco_particles" and (for simulation) "truth_interactions" and
+ * "truth_particles" datasets. The records are built from the same compound
+ * types (see @ref dlp::types::BuildCompType) that are used to read the files,
+ * so the generated files can be read by all of the executables of this
+ * package. The contents of the records are random, except for the fields that
+ * link particles and interactions together, which are kept consistent.
+ * With "--swmr", the file is written in SWMR (single writer, multiple
+ * readers) mode and "--interval" paces the batches, so that the generator
+ * acts like a SPINE job which is still writing its output. This is used to
+ * exercise the follow mode of the CAF makers (see "--follow").
+ * @note The synthetic file generator is intended for benchmarking and testing
+ * purposes only. The generated files do not contain physically meaningful
+ * values.
+ * @author mueller@fnal.gov
+ */
+#include <iostream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <random>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
+#include "H5Cpp.h"
+
+#include "include/event.h"
+#include "include/runinfo.h"
+#include "include/reco_interaction.h"
+#include "include/reco_particle.h"
+#include "include/true_interaction.h"
+#include "include/true_particle.h"
+#include "include/options.h"
+
+/**
+ * @brief A range of values of the form "<min>:<max>" (or "<value>").
+ */
+struct Range
+{
+    int64_t min;                                //!< The minimum value (inclusive).
+    int64_t max;                                //!< The maximum value (inclusive).
+};
+
+/**
+ * @brief Parse a range of values from a command line option.
+ * @param options The command line options.
+ * @param key The name of the option.
+ * @param def The default range.
+ * @return The range of values.
+ * @throw std::runtime_error if the value is not a valid range.
+ */
+Range get_range(const dlp::Options & options, const std::string & key, Range def)
+{
+    if(!options.has(key))
+        return def;
+    std::string value(options.get(key));
+    size_t colon(value.find(':'));
+    Range range;
+    try
+    {
+        range.min = std::stoll(value.substr(0, colon));
+        range.max = colon == std::string::npos ? range.min : std::stoll(value.substr(colon + 1));
+    }
+    catch(const std::exception & e)
+    {
+        throw std::runtime_error("Invalid range for --" + key + ": " + value);
+    }
+    if(range.min < 0 || range.max < range.min)
+        throw std::runtime_error("Invalid range for --" + key + ": " + value);
+    return range;
+}
+
+/**
+ * @brief A class generating the random contents of the records.
+ * @details The memory of the variable-length arrays is owned by the
+ * generator and is released by @ref release once the records have been
+ * written to the file.
+ */
+class RecordGenerator
+{
+    public:
+    /**
+     * @brief A constructor for the RecordGenerator class.
+     * @param seed The seed of the random number generator.
+     * @param vlen The range of lengths of the variable-length arrays.
+     */
+    RecordGenerator(uint64_t seed, Range vlen) : fEngine(seed), fVlen(vlen) {}
+
+    /**
+     * @brief Get a random integer in a range.
+     * @param range The range of values.
+     * @return The random integer.
+     */
+    int64_t uniform(Range range)
+    {
+        return std::uniform_int_distribution<int64_t>(range.min, range.max)(fEngine);
+    }
+
+    /**
+     * @brief Fill a record with random values.
+     * @param record The record (of size type.getSize()).
+     * @param type The compound type of the record.
+     */
+    void randomize(char * record, const H5::CompType & type)
+    {
+        for(int m(0); m < type.getNmembers(); ++m)
+        {
+            char * field(record + type.getMemberOffset(m));
+            switch(type.getMemberClass(m))
+            {
+                case H5T_ARRAY:
+                {
+                    H5::ArrayType array(type.getMemberArrayType(m));
+                    H5::DataType super(array.getSuper());
+                    for(size_t i(0); i < array.getSize() / super.getSize(); ++i)
+                        randomize_value(field + i * super.getSize(), super);
+                    break;
+                }
+                case H5T_VLEN:
+                {
+                    H5::DataType super(type.getMemberVarLenType(m).getSuper());
+                    size_t length(uniform(fVlen));
+                    char * data(allocate(length * super.getSize()));
+                    for(size_t i(0); i < length; ++i)
+                        randomize_value(data + i * super.getSize(), super);
+                    hvl_t handle{length, data};
+                    std::memcpy(field, &handle, sizeof(hvl_t));
+                    break;
+                }
+                case H5T_ENUM:
+                {
+                    H5::EnumType enumtype(type.getMemberEnumType(m));
+                    enumtype.getMemberValue(uniform(Range{0, enumtype.getNmembers() - 1}), field);
+                    break;
+                }
+                case H5T_STRING:
+                {
+                    H5::StrType strtype(type.getMemberStrType(m));
+                    if(strtype.isVariableStr())
+                    {
+                        const char * value(fString);
+                        std::memcpy(field, &value, sizeof(const char *));
+                    }
+                    else
+                        std::strncpy(field, fString, strtype.getSize());
+                    break;
+                }
+                default:
+                    randomize_value(field, type.getMemberDataType(m));
+            }
+        }
+    }
+
+    /**
+     * @brief Set an integer field of a record (if the field exists).
+     * @param record The record.
+     * @param type The compound type of the record.
+     * @param name The name of the field.
+     * @param value The value of the field.
+     */
+    void set_integer(char * record, const H5::CompType & type, const char * name, int64_t value)
+    {
+        int m(find(type, name));
+        if(m < 0)
+            return;
+        store_integer(record + type.getMemberOffset(m), type.getMemberDataType(m).getSize(), value);
+    }
+
+    /**
+     * @brief Set a variable-length integer array field of a record (if the
+     * field exists).
+     * @param record The record.
+     * @param type The compound type of the record.
+     * @param name The name of the field.
+     * @param values The values of the field.
+     */
+    void set_integers(char * record, const H5::CompType & type, const char * name, const std::vector<int64_t> & values)
+    {
+        int m(find(type, name));
+        if(m < 0 || type.getMemberClass(m) != H5T_VLEN)
+            return;
+        size_t size(type.getMemberVarLenType(m).getSuper().getSize());
+        char * data(allocate(values.size() * size));
+        for(size_t i(0); i < values.size(); ++i)
+            store_integer(data + i * size, size, values[i]);
+        hvl_t handle{values.size(), data};
+        std::memcpy(record + type.getMemberOffset(m), &handle, sizeof(hvl_t));
+    }
+
+    /**
+     * @brief Release the memory of the variable-length arrays.
+     */
+    void release()
+    {
+        fArena.clear();
+    }
+
+    private:
+    /**
+     * @brief Find the index of a field in a compound type.
+     * @param type The compound type.
+     * @param name The name of the field.
+     * @return The index of the field, or -1 if the field does not exist.
+     */
+    static int find(const H5::CompType & type, const char * name)
+    {
+        for(int m(0); m < type.getNmembers(); ++m)
+        {
+            if(type.getMemberName(m) == name)
+                return m;
+        }
+        return -1;
+    }
+
+    /**
+     * @brief Store an integer of a given size.
+     * @param field The location of the integer.
+     * @param size The size of the integer (bytes).
+     * @param value The value of the integer.
+     */
+    static void store_integer(char * field, size_t size, int64_t value)
+    {
+        if(size == 1) { int8_t v(value); std::memcpy(field, &v, 1); }
+        else if(size == 2) { int16_t v(value); std::memcpy(field, &v, 2); }
+        else if(size == 4) { int32_t v(value); std::memcpy(field, &v, 4); }
+        else { std::memcpy(field, &value, 8); }
+    }
+
+    /**
+     * @brief Fill a single (atomic) value with a random value.
+     * @details Single-byte integers are booleans, so they are set to zero or
+     * one. Other integers are set to small non-negative values and floating
+     * point values are set uniformly in [0, 100).
+     * @param field The location of the value.
+     * @param type The type of the value.
+     */
+    void randomize_value(char * field, const H5::DataType & type)
+    {
+        if(type.getClass() == H5T_FLOAT)
+        {
+            double value(std::uniform_real_distribution<double>(0, 100)(fEngine));
+            if(type.getSize() == 4) { float v(value); std::memcpy(field, &v, 4); }
+            else std::memcpy(field, &value, 8);
+        }
+        else if(type.getClass() == H5T_INTEGER)
+            store_integer(field, type.getSize(), uniform(Range{0, type.getSize() == 1 ? 1 : 9}));
+    }
+
+    /**
+     * @brief Allocate memory for a variable-length array.
+     * @param bytes The number of bytes to allocate.
+     * @return The allocated memory.
+     */
+    char * allocate(size_t bytes)
+    {
+        fArena.emplace_back(new char[std::max<size_t>(bytes, 1)]);
+        return fArena.back().get();
+    }
+
+    std::mt19937_64 fEngine;
+    Range fVlen;
+    std::vector<std::unique_ptr<char[]>> fArena;
+    static constexpr const char * fString = "cm";
+};
+
+/**
+ * @brief A class managing one (extendible) dataset of the output file.
+ * @details The records of a batch of events are collected in memory and
+ * appended to the dataset by @ref flush, which also creates the region
+ * reference of each event of the batch.
+ */
+class SyntheticDataset
+{
+    public:
+    /**
+     * @brief A constructor for the SyntheticDataset class.
+     * @param file The output file.
+     * @param name The name of the dataset.
+     * @param type The type of the records.
+     * @param plist The creation properties (chunking and compression).
+     * @param ref The member of the Event class referencing this dataset.
+     */
+    SyntheticDataset(H5::H5File & file, const std::string & name, const H5::DataType & type, const H5::DSetCreatPropList & plist, hdset_reg_ref_t dlp::types::Event::* ref)
+        : fFile(file), fName(name), fType(type), fRef(ref), fSize(0)
+    {
+        hsize_t dims(0), max_dims(H5S_UNLIMITED);
+        H5::DataSpace space(1, &dims, &max_dims);
+        fDataset = fFile.createDataSet(fName, fType, space, plist);
+    }
+
+    /**
+     * @brief Start a new event.
+     */
+    void begin_event()
+    {
+        fCounts.push_back(0);
+    }
+
+    /**
+     * @brief Append a zero-initialized record to the current event.
+     * @return The record.
+     */
+    char * append()
+    {
+        fRecords.resize(fRecords.size() + fType.getSize(), 0);
+        ++fCounts.back();
+        return &fRecords[fRecords.size() - fType.getSize()];
+    }
+
+    /**
+     * @brief Get a record of the current batch.
+     * @param r The index of the record in the batch.
+     * @return The record.
+     */
+    char * record(size_t r)
+    {
+        return &fRecords[r * fType.getSize()];
+    }
+
+    /**
+     * @brief Get the number of records in the current batch.
+     * @return The number of records.
+     */
+    size_t size() const
+    {
+        return fRecords.size() / fType.getSize();
+    }
+
+    /**
+     * @brief Append the records of the batch to the dataset and set the
+     * region references of the events of the batch.
+     * @param events The events of the batch.
+     */
+    void flush(std::vector<dlp::types::Event> & events)
+    {
+        hsize_t count(size());
+        hsize_t start(fSize);
+        if(count > 0)
+        {
+            fSize += count;
+            fDataset.extend(&fSize);
+            H5::DataSpace file_space(fDataset.getSpace());
+            file_space.selectHyperslab(H5S_SELECT_SET, &count, &start);
+            H5::DataSpace memory_space(1, &count);
+            fDataset.write(fRecords.data(), fType, memory_space, file_space);
+        }
+
+        H5::DataSpace space(fDataset.getSpace());
+        for(size_t e(0); e < events.size(); ++e)
+        {
+            hsize_t n(fCounts[e]);
+            if(n > 0)
+                space.selectHyperslab(H5S_SELECT_SET, &n, &start);
+            else
+                space.selectNone();
+            fFile.reference(&(events[e].*fRef), ("/" + fName).c_str(), space, H5R_DATASET_REGION);
+            start += n;
+        }
+        fRecords.clear();
+        fCounts.clear();
+    }
+
+    private:
+    H5::H5File & fFile;
+    std::string fName;
+    H5::DataType fType;
+    hdset_reg_ref_t dlp::types::Event::* fRef;
+    H5::DataSet fDataset;
+    hsize_t fSize;
+    std::vector<char> fRecords;
+    std::vector<hsize_t> fCounts;
+};
+
+/**
+ * @brief Generate the particles and interactions of one event.
+ * @details Each interaction owns at least one particle and the remaining
+ * particles are assigned to random interactions. The "id", "interaction_id",
+ * "particle_ids" and "primary_particle_ids" fields are set consistently, so
+ * that the record fillers can associate particles with interactions.
+ * @param generator The record generator.
+ * @param interactions The interaction dataset.
+ * @param interaction_type The compound type of the interactions.
+ * @param particles The particle dataset.
+ * @param particle_type The compound type of the particles.
+ * @param nparticles The range of the number of particles per event.
+ * @param ninteractions The range of the number of interactions per event.
+ */
+void generate_event(RecordGenerator & generator, SyntheticDataset & interactions, const H5::CompType & interaction_type, SyntheticDataset & particles, const H5::CompType & particle_type, Range nparticles, Range ninteractions)
+{
+    int64_t np(generator.uniform(nparticles));
+    int64_t ni(np == 0 ? 0 : generator.uniform(Range{std::min(ninteractions.min, np), std::min(ninteractions.max, np)}));
+    std::vector<std::vector<int64_t>> members(ni);
+    interactions.begin_event();
+    particles.begin_event();
+    for(int64_t p(0); p < np && ni > 0; ++p)
+    {
+        int64_t owner(p < ni ? p : generator.uniform(Range{0, ni - 1}));
+        members[owner].push_back(p);
+        char * record(particles.append());
+        generator.randomize(record, particle_type);
+        generator.set_integer(record, particle_type, "id", p);
+        generator.set_integer(record, particle_type, "interaction_id", owner);
+        generator.set_integer(record, particle_type, "is_primary", p < ni);
+    }
+    for(int64_t i(0); i < ni; ++i)
+    {
+        char * record(interactions.append());
+        generator.randomize(record, interaction_type);
+        generator.set_integer(record, interaction_type, "id", i);
+        generator.set_integer(record, interaction_type, "num_particles", members[i].size());
+        generator.set_integer(record, interaction_type, "num_primary_particles", 1);
+        generator.set_integers(record, interaction_type, "particle_ids", members[i]);
+        generator.set_integers(record, interaction_type, "primary_particle_ids", std::vector<int64_t>{members[i].front()});
+    }
+}
+
+int main(int argc, char const * argv[])
+{
+    /**
+     * @brief Check that the required arguments are present.
+     * @details The only positional argument is the name and path of the
+     * output HDF5 file. Everything else is configured by options.
+     */
+    dlp::Options options(argc, argv);
+    const std::vector<std::string> & args(options.positional());
+    if(args.size() < 1)
+    {
+        std::cerr << "Usage: ./make_synthetic <output_file> [--events=N] [--particles=min:max] [--interactions=min:max] [--vlen=min:max] [--chunk=N] [--deflate=L] [--shuffle] [--batch=N] [--seed=S] [--run=R] [--events-per-subrun=N] [--swmr] [--interval=<seconds>]" << std::endl;
+        return 0;
+    }
+    int64_t nevents(options.get_int("events", 1000));
+    Range nparticles(get_range(options, "particles", Range{1, 20}));
+    Range ninteractions(get_range(options, "interactions", Range{1, 5}));
+    Range vlen(get_range(options, "vlen", Range{0, 8}));
+    hsize_t chunk(options.get_int("chunk", 1024));
+    int64_t deflate(options.get_int("deflate", 0));
+    int64_t batch(std::max<int64_t>(1, options.get_int("batch", 1000)));
+    int64_t run(options.get_int("run", 1));
+    int64_t events_per_subrun(std::max<int64_t>(1, options.get_int("events-per-subrun", 100)));
+    bool swmr(options.has("swmr"));
+    double interval(options.get_double("interval", 0));
+
+    /**
+     * @brief Configure the output file and its datasets.
+     * @details All datasets are one-dimensional, chunked and extendible, so
+     * that the records can be appended one batch of events at a time. The
+     * "index" and "meta" datasets are placeholders: they hold the index of
+     * each event and a single record, respectively. SWMR writing requires
+     * the latest file format.
+     */
+    H5::FileAccPropList fapl;
+    if(swmr)
+        fapl.setLibverBounds(H5F_LIBVER_LATEST, H5F_LIBVER_LATEST);
+    H5::H5File file(args[0], H5F_ACC_TRUNC, H5::FileCreatPropList::DEFAULT, fapl);
+    H5::DSetCreatPropList plist;
+    plist.setChunk(1, &chunk);
+    if(options.has("shuffle"))
+        plist.setShuffle();
+    if(deflate > 0)
+        plist.setDeflate(deflate);
+
+    using dlp::types::Event;
+    H5::CompType run_info_type(dlp::types::BuildCompType<dlp::types::RunInfo>());
+    H5::CompType reco_interaction_type(dlp::types::BuildCompType<dlp::types::RecoInteraction>());
+    H5::CompType reco_particle_type(dlp::types::BuildCompType<dlp::types::RecoParticle>());
+    SyntheticDataset index(file, "index", H5::PredType::STD_I64LE, plist, &Event::index);
+    SyntheticDataset meta(file, "meta", H5::PredType::STD_I64LE, plist, &Event::meta);
+    SyntheticDataset run_info(file, "run_info", run_info_type, plist, &Event::run_info);
+    SyntheticDataset reco_interactions(file, "reco_interactions", reco_interaction_type, plist, &Event::reco_interactions);
+    SyntheticDataset reco_particles(file, "reco_particles", reco_particle_type, plist, &Event::reco_particles);
+    #ifdef MC_NOT_DATA
+    H5::CompType truth_interaction_type(dlp::types::BuildCompType<dlp::types::TruthInteraction>());
+    H5::CompType truth_particle_type(dlp::types::BuildCompType<dlp::types::TruthParticle>());
+    SyntheticDataset truth_interactions(file, "truth_interactions", truth_interaction_type, plist, &Event::truth_interactions);
+    SyntheticDataset truth_particles(file, "truth_particles", truth_particle_type, plist, &Event::truth_particles);
+    #endif
+
+    H5::CompType event_type(dlp::types::BuildCompType<Event>());
+    hsize_t nwritten(0), max_dims(H5S_UNLIMITED);
+    H5::DataSpace event_space(1, &nwritten, &max_dims);
+    H5::DataSet events_dataset(file.createDataSet("events", event_type, event_space, plist));
+
+    /**
+     * @brief Start writing in SWMR mode (if requested).
+     * @details No object can be created from now on, but the datasets can be
+     * extended while readers have the file open.
+     */
+    if(swmr && H5Fstart_swmr_write(file.getId()) < 0)
+        throw std::runtime_error("Unable to start SWMR writing to " + args[0]);
+
+    /**
+     * @brief Begin the main loop over batches of events.
+     */
+    RecordGenerator generator(options.get_int("seed", 12345), vlen);
+    for(int64_t first(0); first < nevents; first += batch)
+    {
+        int64_t last(std::min(nevents, first + batch));
+        for(int64_t e(first); e < last; ++e)
+        {
+            index.begin_event();
+            int64_t value(e);
+            std::memcpy(index.append(), &value, sizeof(int64_t));
+            meta.begin_event();
+            if(e == 0)
+                std::memset(meta.append(), 0, sizeof(int64_t));
+
+            run_info.begin_event();
+            char * info(run_info.append());
+            generator.set_integer(info, run_info_type, "run", run);
+            generator.set_integer(info, run_info_type, "subrun", 1 + e / events_per_subrun);
+            generator.set_integer(info, run_info_type, "event", 1 + e);
+
+            generate_event(generator, reco_interactions, reco_interaction_type, reco_particles, reco_particle_type, nparticles, ninteractions);
+            #ifdef MC_NOT_DATA
+            generate_event(generator, truth_interactions, truth_interaction_type, truth_particles, truth_particle_type, nparticles, ninteractions);
+            #endif
+        }
+
+        /**
+         * @brief Write the batch of events.
+         * @details The "meta" record is shared by all events, so every event
+         * references the first (and only) record of the dataset.
+         */
+        std::vector<Event> events(last - first);
+        index.flush(events);
+        meta.flush(events);
+        H5::DataSpace meta_space(file.openDataSet("meta").getSpace());
+        hsize_t meta_start(0), meta_count(1);
+        meta_space.selectHyperslab(H5S_SELECT_SET, &meta_count, &meta_start);
+        for(Event & evt : events)
+            file.reference(&evt.meta, "/meta", meta_space, H5R_DATASET_REGION);
+        run_info.flush(events);
+        reco_interactions.flush(events);
+        reco_particles.flush(events);
+        #ifdef MC_NOT_DATA
+        truth_interactions.flush(events);
+        truth_particles.flush(events);
+        #endif
+        generator.release();
+
+        /**
+         * @brief Make the products visible before the events.
+         * @details A SWMR reader may see the new events as soon as they are
+         * written, so the products which they reference must be flushed
+         * first.
+         */
+        if(swmr)
+            file.flush(H5F_SCOPE_GLOBAL);
+
+        hsize_t count(events.size());
+        hsize_t size(nwritten + count);
+        events_dataset.extend(&size);
+        H5::DataSpace file_space(events_dataset.getSpace());
+        file_space.selectHyperslab(H5S_SELECT_SET, &count, &nwritten);
+        H5::DataSpace memory_space(1, &count);
+        events_dataset.write(events.data(), event_type, memory_space, file_space);
+        nwritten = size;
+        if(swmr)
+            file.flush(H5F_SCOPE_GLOBAL);
+        std::cout << "Wrote " << nwritten << " / " << nevents << " events." << std::endl;
+        if(interval > 0 && nwritten < hsize_t(nevents))
+            std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+    }
+
+    file.close();
+    return 0;
+}
@@ -11,7 +11,8 @@
  */
 #include <iostream>
 #include <vector>
-#include <tuple>
+#include <string>
+#include <memory>
 #include <ctype.h>
 #include "H5Cpp.h"
 
@@ -22,6 +23,22 @@
 #include "include/true_interaction.h"
 #include "include/true_particle.h"
 #include "include/record_fillers.h"
+#include "include/file_pool.h"
+#include "include/merge.h"
+#include "include/record_writer.h"
+#include "include/options.h"
+#include "include/instrumentation.h"
+#include "include/logger.h"
+#include "include/output_profile.h"
+#include "include/input_profile.h"
+#include "include/aux_copier.h"
+#include "include/event_selection.h"
+#include "include/skim.h"
+#include "include/truth_pruning.h"
+#include "include/voxel_index.h"
+#include "include/matching.h"
+#include "include/follow.h"
+#include "include/jobs.h"
 
 #include "sbnanaobj/StandardRecord/StandardRecord.h"
 #include "sbnanaobj/StandardRecord/SRInteractionDLP.h"
@@ -33,47 +50,8 @@
 #include "TDirectoryFile.h"
 #include "TTree.h"
 #include "TH1D.h"
-#include "TKey.h"
 
-typedef std::tuple<size_t, size_t, size_t> index_t;
-
-/**
- * @brief Copy the key/val products from an event in the CAF file to the output
- * CAF file.
- * @details This function is used to copy the key/val products from the
- * input TDirectory to the output TDirectory. Specifically, this represents
- * metadata and environment variables that are stored in the input CAF file.
- * @param output The output TDirectory to copy to.
- * @param input The input TDirectory to copy from.
- * @param name The name of the TTree to copy.
- */
-void copy_keyval_tree(TDirectory * output, TDirectory * input, const char * name)
-{
-    output->cd();
-    if(input)
-    {
-        TDirectory * dir = output->mkdir(input->GetName());
-        dir->cd();
-        TTree * tree = static_cast<TTree *>(input->Get(name));
-        TTree * new_tree = new TTree(name, tree->GetTitle());
-        
-        std::string key, value;
-        std::string * pkey = &key;
-        std::string * pvalue = &value;
-        new_tree->Branch("key", &pkey);
-        new_tree->Branch("value", &pvalue);
-        tree->SetBranchAddress("key", &pkey);
-        tree->SetBranchAddress("value", &pvalue);
-        for(Long64_t i(0); i < tree->GetEntries(); ++i)
-        {
-            tree->GetEntry(i);
-            new_tree->Fill();
-        }
-        new_tree->Write();
-        output->cd();
-    }
-}
-int main(int argc, char const * argv[])
+int merge_sources_main(int argc, char const * argv[])
 {
     /**
      * @brief Check that the required arguments are present.
@@ -86,54 +64,124 @@ int main(int argc, char const * argv[])
      * set of events. The merging code will match the events in the input CAF
      * file to the events in the input HDF5 file by (Run, Subrun, Event No.).
      */
-    if(argc < 3)
+    dlp::Options options(argc, argv);
+    const std::vector<std::string> & args(options.positional());
+    if(args.size() < 3)
     {
-        std::cerr << "Usage: ./merge_sources <output_file> <input_caf_file> <input_h5_file>" << std::endl;
+        std::cerr << "Usage: ./merge_sources <output_file> <input_caf_file> <input_h5_file> [--flat] [--threads=N] [--entries=<first>:<last>] [--shard=<i>/<N>] [--sample=<fraction>] [--seed=<seed>] [--skim=<cut>[,<cut>...]] [--skim-truth] [--skim-plugin=<library>] [--prune-truth=<policy>[,<policy>...]] [--voxel-sidecar=<file>] [--rematch=<metric>[:<threshold>]] [--follow[=<seconds>]] [--poll=<seconds>] [--autosave=<seconds>] [input options] [output options] [--report=<file>] [--progress=<seconds>] [logging options]" << std::endl;
         return 0;
     }
 
     /**
-     * @brief Configure the output CAF file.
+     * @brief Configure the instrumentation (if requested) and the logging of
+     * the job.
+     */
+    dlp::Instrumentation::get().configure(options);
+    dlp::Logger::get().configure(options);
+
+    /**
+     * @brief Configure the output profile.
+     * @details The output profile holds the compression and layout settings
+     * of the output CAF file. ROOT implicit multithreading (if requested) is
+     * enabled before any TTree is created so that both the input and output
+     * TTrees make use of it.
+     */
+    dlp::OutputProfile profile(dlp::parse_output_profile(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "output_profile", "Output profile: ", dlp::describe_output_profile(profile));
+    dlp::enable_implicit_mt(profile);
+
+    /**
+     * @brief Configure the selection of the input CAF records.
+     * @details Only the records in the selected range, shard and sample (see
+     * @ref EventSelection) are read and merged.
+     */
+    dlp::EventSelection selection(dlp::parse_event_selection(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "selection", "Event selection: ", dlp::describe_event_selection(selection));
+
+    /**
+     * @brief Configure the skim of the merged records.
+     * @details Records which do not pass the skim (see @ref Skim) are not
+     * written, but remain counted in the exposure.
+     */
+    dlp::Skim skim(dlp::parse_skim(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "skim", "Skim: ", skim.describe());
+
+    /**
+     * @brief Configure the pruning of the true particles.
+     * @details Pruned particles (see @ref TruthPruning) are never converted.
+     */
+    dlp::TruthPruning pruning(dlp::parse_truth_pruning(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "pruning", "Truth pruning: ", dlp::describe_truth_pruning(pruning));
+
+    /**
+     * @brief Configure the voxel index sidecar file.
+     * @details If "--voxel-sidecar" is passed, the voxel index arrays of the
+     * matched events are written (encoded) to a separate HDF5 file, keyed by
+     * (Run, Subrun, Event No.). See @ref VoxelIndexWriter.
+     */
+    std::unique_ptr<dlp::VoxelIndexWriter> voxels;
+    if(options.has("voxel-sidecar"))
+        voxels = std::make_unique<dlp::VoxelIndexWriter>(options.get("voxel-sidecar"));
+
+    /**
+     * @brief Configure the recomputation of the reco/truth matches.
+     * @details If "--rematch" is passed, the interaction matches are
+     * recomputed from the voxel index arrays of the matched events with the
+     * requested metric (see @ref Matcher) and written to the "dlpMatchTree"
+     * TTree of the output CAF file.
+     */
+    dlp::MatchConfig match_config(dlp::parse_match_config(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "rematch", "Recomputed matches: ", dlp::describe_match_config(match_config));
+    std::unique_ptr<dlp::Matcher> matcher;
+    if(match_config.active())
+        matcher = std::make_unique<dlp::Matcher>(match_config);
+
+    /**
+     * @brief Open the output CAF file and start copying the auxiliary objects
+     * of the input CAF file.
+     * @details Everything other than the "recTree" TTree is copied as-is by
+     * the @ref AuxCopier on a separate thread while the input files are
+     * opened and indexed, which does not touch the output CAF file. If an
+     * event selection is active, the exposure histograms are recomputed from
+     * the selected records instead of being copied.
+     */
+    TFile output_caf(args[0].c_str(), "recreate");
+    dlp::apply_output_profile(output_caf, profile);
+    dlp::AuxCopier aux(args[1], output_caf, dlp::recomputed_objects(selection));
+
+    /**
+     * @brief Configure the following of the input HDF5 file.
+     * @details If "--follow" is passed, the input HDF5 file is opened as a
+     * SWMR reader and the records of the input CAF file wait for their
+     * matching event to be appended to it (see @ref FollowConfig).
+     */
+    dlp::FollowConfig follow(dlp::parse_follow_config(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "follow", "Follow mode: ", dlp::describe_follow_config(follow));
+
+    /**
+     * @brief Configure the input HDF5 file.
      * @details The merging code will need to access the event records in the
      * file once it has been matched to an event from the input CAF file. This
-     * is done by building a map between (Run, Event No.) and the @ref 
-     * dlp::types::Event object. This class contains only references to the
-     * actual SPINE data products, so it is not overly heavy.
-     */
-    H5::H5File input_h5(argv[3], H5F_ACC_RDONLY);
-    std::map<index_t, size_t> event_map;
-    std::vector<dlp::types::Event> events(get_all_events(input_h5));
-    for(size_t e(0); e < events.size(); ++e)
-    {
-        try
-        {
-            /**
-             * @brief Retrieve the run info for the event.
-             * @details For each event in the input HDF5 file, the run info is
-             * retrieved and emplaced in a map that will allow for efficient
-             * lookup later when copying data into the output CAF file.
-             * @note The index is a tuple of (Run, Subrun, Event No.).
-             */
-            std::vector<dlp::types::RunInfo> run_info(get_product<dlp::types::RunInfo>(input_h5, events.at(e)));
-            index_t index(run_info.back().run, run_info.back().subrun, run_info.back().event);
-            event_map.insert(std::make_pair(index, e));
-        }
-        catch(const H5::ReferenceException & e)
-        {
-            std::cerr << "Found incomplete entry for event." << std::endl;
-        }
-    }
+     * is done by building an index between (Run, Subrun, Event No.) and the
+     * @ref dlp::types::Event object. This class contains only references to
+     * the actual SPINE data products, so it is not overly heavy.
+     */
+    dlp::FilePool pool(std::vector<std::string>{args[2]}, 1, dlp::input_access_flags(follow));
+    dlp::EventIndex event_map(dlp::build_event_index(pool));
 
     /**
      * @brief Configure the output CAF file.
      * @details The merging code will need to attach to the "recTree.rec"
      * branch (StandardRecord) in order to copy them over to a new file and
-     * simultaneously copy in the SPINE reconstruction outputs.
+     * simultaneously copy in the SPINE reconstruction outputs. The read
+     * caching of the input TTree is configured by the input options (see
+     * @ref InputProfile).
      */
-    TFile input_caf(argv[2], "read");
+    TFile input_caf(args[1].c_str(), "read");
     TTree *input_tree = (TTree*)input_caf.Get("recTree");
     caf::StandardRecord *rec = new caf::StandardRecord;
     input_tree->SetBranchAddress("rec", &rec);
+    dlp::apply_input_profile(input_tree, dlp::parse_input_profile(options));
 
     /**
      * @brief Configure the output CAF file.
@@ -141,99 +189,67 @@ int main(int argc, char const * argv[])
      * StandardRecord entries. Since the code is modifying in-place the "rec"
      * object, the output TTree is set to track this same object. This means
      * that calling TTree::GetEntry() and TTree::Fill() with no intermediate
-     * changes will effectively copy the StandardRecord entry.
+     * changes will effectively copy the StandardRecord entry. If the "--flat"
+     * option is passed, the entries are written directly in the flat CAF
+     * layout. The compression and layout of the output are configured by
+     * the output options (see @ref OutputProfile). The output TTree is only
+     * created once the auxiliary objects have been copied.
      */
-    TFile output_caf(argv[1], "recreate");
-    TTree *output_tree = new TTree("recTree", "records");
-    output_tree->Branch("rec", &rec);
+    aux.Wait();
+    dlp::RecordWriter writer(&rec, profile);
+    if(matcher)
+        writer.AttachMatches(&matcher->record());
 
     /**
-     * @brief Begin main loop over records within the input CAF file.
-     * @details At each step, check that there is a matching event in the HDF5
-     * input file.
+     * @brief Start following the input HDF5 file (if requested).
+     * @details The events appended to the input HDF5 file are added to the
+     * index while the records wait for them, and the output TTree is saved
+     * periodically so that it can be read while the job is running.
      */
-    for(size_t n(0); n < input_tree->GetEntries(); ++n)
+    std::unique_ptr<dlp::Follower> follower;
+    if(follow.active)
     {
-        input_tree->GetEntry(n);
-        /**
-         * @brief Reset the ML reconstruction output branches.
-         * @details It is safest to reset the ML reconstruction output
-         * branches to prevent old products from remaining in the case
-         * where something unexpected happens.
-         */  
-        rec->dlp.clear();
-        rec->ndlp = 0;
-        rec->dlp_true.clear();
-        rec->ndlp_true = 0;
-
-        index_t index(rec->hdr.run, rec->hdr.subrun, rec->hdr.evt);
-        if(event_map.find(index) != event_map.end())
-        {
-	        std::cout << "Matched Event " << std::get<2>(index) << " in (Run, Subrun) = (" << std::get<0>(index) << ", " << std::get<1>(index) << ") of CAF input to HDF5 event." << std::endl;
-            try
-            {
-                /**
-                 * @brief Package the event data products.
-                 * @details The @ref package_event() function is responsible
-                 * for copying the data products from the event into the proper
-                 * CAF class within the StandardRecord.
-                 */
-                package_event(rec, input_h5, events[event_map[index]]);
-            }
-            catch(const H5::ReferenceException & e)
-            {
-                std::cerr << "Found incomplete entry for event." << std::endl;
-            }
-        }
-        output_tree->Fill();
+        follower = std::make_unique<dlp::Follower>(follow, [&]() { return dlp::refresh_event_index(event_map, pool); }, [&]() { writer.AutoSave(); });
+        dlp::Logger::get().log(dlp::LogLevel::kInfo, "follow", "Following file: ", args[2]);
     }
 
+    /**
+     * @brief Begin main loop over records within the input CAF file.
+     * @details At each step, check that there is a matching event in the HDF5
+     * input file. Records without a matching event are still written to the
+     * output CAF file (without ML reconstruction outputs).
+     */
+    dlp::MergeResult result(dlp::merge_records(input_tree, writer, rec, event_map, pool, true, selection, skim, pruning, voxels.get(), matcher.get(), follower.get()));
+
     /**
      * @brief Write the data into the output CAF file.
      * @details In addition to the TTree containing the StandardRecord entries,
      * there are also histograms for storing the total POT and the total number
-     * of events and some other TTrees storing environment stuff and metadata.
-     * The order probably doesn't matter, but this maintains the same exact
-     * order as in the input CAF file.
-     */
-    TDirectoryFile * env = (TDirectoryFile *)input_caf.Get("env");
-    copy_keyval_tree(&output_caf, env, "envtree");
-    TH1D * total_pot = (TH1D*)input_caf.Get("TotalPOT");
-    total_pot->Write();
-    TH1D * total_events = (TH1D*)input_caf.Get("TotalEvents");
-    total_events->Write();
-    output_tree->Write();
-    TDirectoryFile * metadata = (TDirectoryFile *)input_caf.Get("metadata");
-    copy_keyval_tree(&output_caf, metadata, "metatree");
-    
-    #ifdef MC_NOT_DATA
-    /**
-     * @brief Copy the globalTree and the GenieEvtRecTree
-     */
-    TTree * global_tree = (TTree*)input_caf.Get("globalTree");
-    if(global_tree)
-    {
-        output_caf.cd();
-        TTree * clone = global_tree->CloneTree(-1, "fast");
-        clone->Write();
-        delete clone;
-    }
-    TTree * genie_tree = (TTree*)input_caf.Get("GenieEvtRecTree");
-    if(genie_tree)
-    {
-        output_caf.cd();
-        TTree * clone = genie_tree->CloneTree(-1, "fast");
-        clone->Write();
-        delete clone;
-    }
-    #endif
-    
+     * of events and some other TTrees storing environment stuff, metadata and
+     * (for simulation) the "globalTree" and "GenieEvtRecTree". These have
+     * already been written by the @ref AuxCopier.
+     */
+    writer.Write();
+    if(selection.active())
+        dlp::write_selected_exposure(output_caf, input_caf, result);
+    if(skim.active())
+        dlp::Logger::get().log(dlp::LogLevel::kInfo, "skim", "Dropped ", result.skimmed, " record(s) which did not pass the skim.");
+
     /**
      * @brief Close the input and output files. 
      */
-    input_h5.close();
+    dlp::print_read_statistics(input_caf);
+    voxels.reset();
+    pool.close_all();
     input_caf.Close();
     output_caf.Close();
 
     return 0;
 }
+
+#ifndef DLP_DAEMON
+int main(int argc, char const * argv[])
+{
+    return merge_sources_main(argc, argv);
+}
+#endif
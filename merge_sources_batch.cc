@@ -0,0 +1,471 @@
+/**
+ * @file merge_sources_batch.cc
+ * @brief This file contains the main function for merging many CAF files with
+ * many HDF5 files in a single process.
+ * @details The batch merging code acts on a manifest listing any number of
+ * input CAF files (standard reconstruction outputs) and any number of input
+ * HDF5 files (SPINE reconstruction outputs). A single global event index is
+ * built over all HDF5 files, and each CAF file is then merged against it. By
+ * default, one output CAF file is written per input CAF file, but the outputs
+ * may instead be combined into a single output CAF file. The ROOT dictionaries,
+ * the HDF5 library, the event index and the pool of open HDF5 files are all
+ * initialized only once for the whole job.
+ * @note The batch merging code is intended to replace many invocations of
+ * the single-file merging code in grid workflows.
+ */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <map>
+#include <set>
+#include "H5Cpp.h"
+
+#include "include/products.h"
+#include "include/event.h"
+#include "include/record_fillers.h"
+#include "include/file_pool.h"
+#include "include/merge.h"
+#include "include/options.h"
+#include "include/instrumentation.h"
+#include "include/logger.h"
+#include "include/output_profile.h"
+#include "include/input_profile.h"
+#include "include/aux_copier.h"
+#include "include/event_selection.h"
+#include "include/skim.h"
+#include "include/truth_pruning.h"
+#include "include/voxel_index.h"
+#include "include/matching.h"
+#include "include/record_writer.h"
+#include "include/jobs.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TBranch.h"
+#include "TLeaf.h"
+#include "TClass.h"
+#include "TBufferFile.h"
+#include "TH1D.h"
+
+/**
+ * @brief Read the list of input CAF and HDF5 files from a manifest file.
+ * @details Each non-empty line of the manifest has the form "caf <path>" or
+ * "hdf5 <path>". Lines beginning with '#' are treated as comments.
+ * @param path The path of the manifest file.
+ * @param cafs The list to which the input CAF files are appended.
+ * @param hdf5s The list to which the input HDF5 files are appended.
+ * @return True if the manifest was read successfully, false otherwise.
+ */
+bool read_manifest(const std::string & path, std::vector<std::string> & cafs, std::vector<std::string> & hdf5s)
+{
+    std::ifstream manifest(path);
+    if(!manifest.is_open())
+    {
+        dlp::Logger::get().log(dlp::LogLevel::kError, "manifest", "Unable to open manifest file: ", path);
+        return false;
+    }
+    std::string line;
+    size_t line_number(0);
+    while(std::getline(manifest, line))
+    {
+        ++line_number;
+        std::istringstream tokens(line);
+        std::string type, file;
+        if(!(tokens >> type) || type[0] == '#')
+            continue;
+        if(!(tokens >> file) || (type != "caf" && type != "hdf5"))
+        {
+            dlp::Logger::get().log(dlp::LogLevel::kError, "manifest", "Malformed manifest line ", line_number, ": ", line);
+            return false;
+        }
+        (type == "caf" ? cafs : hdf5s).push_back(file);
+    }
+    return true;
+}
+
+/**
+ * @brief Get the name of the file (without the directory) from a path.
+ * @param path The path of the file.
+ * @return The name of the file.
+ */
+std::string base_name(const std::string & path)
+{
+    size_t slash(path.find_last_of('/'));
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+/**
+ * @brief Serialize the entries of a TTree, so that the contents of two TTrees
+ * can be compared.
+ * @details Each entry of each top-level branch is streamed into a buffer:
+ * object branches with the streamer of their class and leaf-list branches as
+ * the raw values of their leaves.
+ * @param tree The TTree to serialize.
+ * @return The serialized entries of the TTree.
+ */
+std::string serialize_entries(TTree * tree)
+{
+    TBufferFile buffer(TBuffer::kWrite);
+    for(TObject * object : *tree->GetListOfBranches())
+    {
+        TBranch * branch(static_cast<TBranch *>(object));
+        TClass * type(TClass::GetClass(branch->GetClassName()));
+        void * data(type ? type->New() : nullptr);
+        if(type)
+            branch->SetAddress(&data);
+        for(Long64_t n(0); n < tree->GetEntries(); ++n)
+        {
+            branch->GetEntry(n);
+            if(type)
+                type->Streamer(data, buffer);
+            else
+            {
+                for(TObject * l : *branch->GetListOfLeaves())
+                {
+                    TLeaf * leaf(static_cast<TLeaf *>(l));
+                    buffer.WriteFastArray(static_cast<const char *>(leaf->GetValuePointer()), leaf->GetLen() * leaf->GetLenType());
+                }
+            }
+        }
+        if(type)
+        {
+            branch->ResetAddress();
+            type->Destructor(data);
+        }
+    }
+    tree->ResetBranchAddresses();
+    return std::string(buffer.Buffer(), buffer.Length());
+}
+
+int merge_sources_batch_main(int argc, char const * argv[])
+{
+    /**
+     * @brief Check that the required arguments are present.
+     * @details The first argument is the manifest listing the input CAF and
+     * HDF5 files. The second argument is the directory in which the output CAF
+     * files are written (one per input CAF file, with the same name). If the
+     * "--combined" option is passed, the second argument is not required and
+     * all records are written to the single output CAF file instead.
+     */
+    dlp::Options options(argc, argv);
+    const std::vector<std::string> & args(options.positional());
+    bool combined(options.has("combined"));
+    if(args.size() < 1 || (!combined && args.size() < 2))
+    {
+        std::cerr << "Usage: ./merge_sources_batch <manifest> <output_directory> [--combined=<output_file>] [--keep-unmatched] [--max-open-files=N] [--flat] [--threads=N] [--entries=<first>:<last>] [--shard=<i>/<N>] [--sample=<fraction>] [--seed=<seed>] [--skim=<cut>[,<cut>...]] [--skim-truth] [--skim-plugin=<library>] [--prune-truth=<policy>[,<policy>...]] [--voxel-sidecar=<file>] [--rematch=<metric>[:<threshold>]] [input options] [output options] [--report=<file>] [--progress=<seconds>] [logging options]" << std::endl;
+        return 0;
+    }
+
+    /**
+     * @brief Configure the instrumentation (if requested) and the logging of
+     * the job.
+     */
+    dlp::Instrumentation::get().configure(options);
+    dlp::Logger::get().configure(options);
+
+    std::vector<std::string> cafs, hdf5s;
+    if(!read_manifest(args[0], cafs, hdf5s))
+        return 1;
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "manifest", "Read manifest with ", cafs.size(), " CAF file(s) and ", hdf5s.size(), " HDF5 file(s).");
+
+    /**
+     * @brief Check that the output CAF files have distinct names.
+     * @details Each output CAF file has the name of its input CAF file, so
+     * two input CAF files with the same name (in different directories)
+     * would write the same output CAF file.
+     */
+    if(!combined)
+    {
+        std::map<std::string, std::string> outputs;
+        for(const std::string & caf : cafs)
+        {
+            auto [it, inserted] = outputs.emplace(base_name(caf), caf);
+            if(!inserted)
+            {
+                dlp::Logger::get().log(dlp::LogLevel::kError, "manifest", "Input CAF files ", it->second, " and ", caf, " would both be written to ", args[1], "/", it->first, ". Rename one of them or use --combined.");
+                return 1;
+            }
+        }
+    }
+
+    /**
+     * @brief Configure the input HDF5 files.
+     * @details A single global index between (Run, Subrun, Event No.) and the
+     * location of the @ref dlp::types::Event object is built over all of the
+     * input HDF5 files. The files are managed by a pool which keeps at most
+     * "--max-open-files" files open at once.
+     */
+    dlp::FilePool pool(hdf5s, dlp::parse_max_open_files(options));
+    dlp::EventIndex event_map(dlp::build_event_index(pool));
+    bool keep_unmatched(options.has("keep-unmatched"));
+    dlp::OutputProfile profile(dlp::parse_output_profile(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "output_profile", "Output profile: ", dlp::describe_output_profile(profile));
+    dlp::enable_implicit_mt(profile);
+    dlp::InputProfile input_profile(dlp::parse_input_profile(options));
+
+    /**
+     * @brief Configure the selection of the input CAF records.
+     * @details The selection (see @ref EventSelection) is applied to the
+     * records of each input CAF file separately.
+     */
+    dlp::EventSelection selection(dlp::parse_event_selection(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "selection", "Event selection: ", dlp::describe_event_selection(selection));
+
+    /**
+     * @brief Configure the skim of the merged records.
+     * @details Records which do not pass the skim (see @ref Skim) are not
+     * written, but remain counted in the exposure.
+     */
+    dlp::Skim skim(dlp::parse_skim(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "skim", "Skim: ", skim.describe());
+
+    /**
+     * @brief Configure the pruning of the true particles.
+     * @details Pruned particles (see @ref TruthPruning) are never converted.
+     */
+    dlp::TruthPruning pruning(dlp::parse_truth_pruning(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "pruning", "Truth pruning: ", dlp::describe_truth_pruning(pruning));
+
+    /**
+     * @brief Configure the voxel index sidecar file.
+     * @details If "--voxel-sidecar" is passed, the voxel index arrays of the
+     * matched events are written (encoded) to a separate HDF5 file, keyed by
+     * (Run, Subrun, Event No.). See @ref VoxelIndexWriter.
+     */
+    std::unique_ptr<dlp::VoxelIndexWriter> voxels;
+    if(options.has("voxel-sidecar"))
+        voxels = std::make_unique<dlp::VoxelIndexWriter>(options.get("voxel-sidecar"));
+
+    /**
+     * @brief Configure the recomputation of the reco/truth matches.
+     * @details If "--rematch" is passed, the interaction matches are
+     * recomputed from the voxel index arrays of the matched events with the
+     * requested metric (see @ref Matcher) and written to the "dlpMatchTree"
+     * TTree of the output CAF file.
+     */
+    dlp::MatchConfig match_config(dlp::parse_match_config(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "rematch", "Recomputed matches: ", dlp::describe_match_config(match_config));
+    std::unique_ptr<dlp::Matcher> matcher;
+    if(match_config.active())
+        matcher = std::make_unique<dlp::Matcher>(match_config);
+
+    /**
+     * @brief Configure the StandardRecord object shared by all input and
+     * output TTrees.
+     * @details The same object is attached to every input and output TTree, so
+     * it is allocated only once for the whole job.
+     */
+    caf::StandardRecord *rec = new caf::StandardRecord;
+
+    /**
+     * @brief Configure the combined output CAF file (if requested).
+     * @details In combined mode, the "TotalPOT" and "TotalEvents" histograms
+     * are summed over all input CAF files and the "GenieEvtRecTree" TTree is
+     * concatenated. The GENIE indices of the records of each input CAF file
+     * are shifted by the number of GENIE entries of the preceding input CAF
+     * files, so that they still point to their own GENIE entries. The
+     * key/value pairs of the "env" and "metadata" directories are combined
+     * without duplicates (see @ref KeyValueTable). The "globalTree" TTree is
+     * copied from the first input CAF file holding one; the "globalTree" of
+     * every other input is compared to it, and those which differ are
+     * dropped with a warning naming the input.
+     */
+    TFile * combined_caf(nullptr);
+    std::unique_ptr<dlp::RecordWriter> combined_writer;
+    TH1 * combined_pot(nullptr);
+    TH1 * combined_events(nullptr);
+    TTree * combined_genie(nullptr);
+    dlp::KeyValueTable combined_env("env", "envtree");
+    dlp::KeyValueTable combined_metadata("metadata", "metatree");
+    std::string global_source;
+    std::string global_entries;
+    size_t combined_inputs(0);
+    if(combined)
+    {
+        combined_caf = new TFile(options.get("combined").c_str(), "recreate");
+        dlp::apply_output_profile(*combined_caf, profile);
+        combined_writer.reset(new dlp::RecordWriter(&rec, profile));
+        if(matcher)
+            combined_writer->AttachMatches(&matcher->record());
+    }
+
+    /**
+     * @brief Begin main loop over the input CAF files.
+     */
+    dlp::MergeResult total;
+    size_t merged_inputs(0);
+    for(size_t c(0); c < cafs.size(); ++c)
+    {
+        TFile input_caf(cafs[c].c_str(), "read");
+        if(input_caf.IsZombie())
+        {
+            dlp::Logger::get().log(dlp::LogLevel::kError, "open_file", "Unable to open input CAF file: ", cafs[c]);
+            continue;
+        }
+        TTree *input_tree = (TTree*)input_caf.Get("recTree");
+        if(!input_tree)
+        {
+            dlp::Logger::get().log(dlp::LogLevel::kError, "open_file", "No recTree in input CAF file: ", cafs[c]);
+            continue;
+        }
+        input_tree->SetBranchAddress("rec", &rec);
+        dlp::apply_input_profile(input_tree, input_profile);
+        TH1 * total_pot(input_caf.Get<TH1>("TotalPOT"));
+        TH1 * total_events(input_caf.Get<TH1>("TotalEvents"));
+
+        dlp::MergeResult result;
+        if(combined)
+        {
+            /**
+             * @brief Merge the records into the combined output CAF file.
+             * @details The GENIE entries of this input CAF file are appended
+             * after those of the preceding ones, whose number is the offset
+             * of its GENIE indices.
+             */
+            Long64_t genie_offset(combined_genie ? combined_genie->GetEntries() : 0);
+            result = dlp::merge_records(input_tree, *combined_writer, rec, event_map, pool, keep_unmatched, selection, skim, pruning, voxels.get(), matcher.get(), nullptr, genie_offset);
+            combined_env.add(*combined_caf, input_caf);
+            combined_metadata.add(*combined_caf, input_caf);
+            combined_caf->cd();
+            if(!total_pot || !total_events)
+            {
+                dlp::Logger::get().log(dlp::LogLevel::kWarning, "exposure", "No TotalPOT or TotalEvents histogram in ", cafs[c], ". Its exposure is missing from the combined output CAF file.");
+            }
+            else
+            {
+                if(selection.active())
+                    dlp::set_selected_exposure(total_pot, total_events, result);
+                if(!combined_pot)
+                {
+                    combined_pot = (TH1*)total_pot->Clone();
+                    combined_pot->SetDirectory(combined_caf);
+                    combined_events = (TH1*)total_events->Clone();
+                    combined_events->SetDirectory(combined_caf);
+                }
+                else
+                {
+                    combined_pot->Add(total_pot);
+                    combined_events->Add(total_events);
+                }
+            }
+            #ifdef MC_NOT_DATA
+            TTree * genie_tree = (TTree*)input_caf.Get("GenieEvtRecTree");
+            if(genie_tree)
+            {
+                combined_caf->cd();
+                if(!combined_genie)
+                    combined_genie = genie_tree->CloneTree(-1, "fast");
+                else
+                    combined_genie->CopyEntries(genie_tree, -1, "fast");
+            }
+            TTree * global_tree = (TTree*)input_caf.Get("globalTree");
+            if(global_tree && global_source.empty())
+            {
+                dlp::Logger::get().log(dlp::LogLevel::kInfo, "global_tree", "Copying globalTree from ", cafs[c], ".");
+                global_source = cafs[c];
+                global_entries = serialize_entries(global_tree);
+                combined_caf->cd();
+                TTree * clone = global_tree->CloneTree(-1, "fast");
+                clone->Write();
+                delete clone;
+            }
+            else if(global_tree && serialize_entries(global_tree) != global_entries)
+            {
+                dlp::Logger::get().log(dlp::LogLevel::kWarning, "global_tree", "Dropped the globalTree of ", cafs[c], ", which differs from that of ", global_source, ".");
+            }
+            #endif
+            ++combined_inputs;
+        }
+        else
+        {
+            /**
+             * @brief Merge the records into a dedicated output CAF file.
+             * @details The layout of the output CAF file is the same as that
+             * produced by the single-file merging code: the auxiliary
+             * objects are copied with @ref copy_directory. Unlike in the
+             * single-file merging code, the copy is made synchronously from
+             * the already open input CAF file rather than by an
+             * @ref AuxCopier: the event index is shared by all input CAF
+             * files and built before the loop, so there is nothing left for
+             * a concurrent copy to overlap with (a TFile cannot be written
+             * from two threads, so it cannot overlap with the event loop).
+             */
+            std::string output_name(args[1] + "/" + base_name(cafs[c]));
+            TFile output_caf(output_name.c_str(), "recreate");
+            dlp::apply_output_profile(output_caf, profile);
+            {
+                dlp::ScopedTimer timer("aux_copy");
+                std::set<std::string> skip(dlp::recomputed_objects(selection));
+                skip.insert("recTree");
+                dlp::copy_directory(&output_caf, &input_caf, skip);
+                output_caf.cd();
+            }
+            dlp::RecordWriter writer(&rec, profile);
+            if(matcher)
+                writer.AttachMatches(&matcher->record());
+            result = dlp::merge_records(input_tree, writer, rec, event_map, pool, keep_unmatched, selection, skim, pruning, voxels.get(), matcher.get());
+
+            writer.Write();
+            if(selection.active())
+                dlp::write_selected_exposure(output_caf, input_caf, result);
+            output_caf.Close();
+        }
+        dlp::print_read_statistics(input_caf);
+        input_caf.Close();
+
+        total.matched += result.matched;
+        total.unmatched += result.unmatched;
+        total.skimmed += result.skimmed;
+        ++merged_inputs;
+        dlp::Logger::get().log(dlp::LogLevel::kInfo, "merged", "Merged ", result.matched, " / ", result.matched+result.unmatched, " events of ", cafs[c], " (", c+1, "/", cafs.size(), ").");
+    }
+
+    /**
+     * @brief Write and close the combined output CAF file (if requested).
+     */
+    if(combined)
+    {
+        combined_caf->cd();
+        if(combined_pot)
+        {
+            combined_pot->Write();
+            combined_events->Write();
+        }
+        combined_writer->Write();
+        if(combined_genie)
+            combined_genie->Write();
+        combined_env.Write(*combined_caf);
+        combined_metadata.Write(*combined_caf);
+        combined_caf->Close();
+        delete combined_caf;
+    }
+
+    /**
+     * @brief Close the input HDF5 files.
+     */
+    voxels.reset();
+    pool.close_all();
+    delete rec;
+
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "merged", "Merged ", total.matched, " / ", total.matched+total.unmatched, " events from the input HDF5 file(s) into the output CAF file(s).");
+    if(skim.active())
+        dlp::Logger::get().log(dlp::LogLevel::kInfo, "skim", "Dropped ", total.skimmed, " record(s) which did not pass the skim.");
+    if(merged_inputs != cafs.size())
+    {
+        dlp::Logger::get().log(dlp::LogLevel::kError, "open_file", "Merged ", merged_inputs, " / ", cafs.size(), " input CAF file(s); the others could not be read.");
+        return 1;
+    }
+    return 0;
+}
+
+#ifndef DLP_DAEMON
+int main(int argc, char const * argv[])
+{
+    return merge_sources_batch_main(argc, argv);
+}
+#endif
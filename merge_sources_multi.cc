@@ -11,7 +11,8 @@
  */
 #include <iostream>
 #include <vector>
-#include <tuple>
+#include <string>
+#include <memory>
 #include <ctype.h>
 #include "H5Cpp.h"
 
@@ -22,6 +23,21 @@
 #include "include/true_interaction.h"
 #include "include/true_particle.h"
 #include "include/record_fillers.h"
+#include "include/file_pool.h"
+#include "include/options.h"
+#include "include/instrumentation.h"
+#include "include/logger.h"
+#include "include/output_profile.h"
+#include "include/input_profile.h"
+#include "include/aux_copier.h"
+#include "include/event_selection.h"
+#include "include/skim.h"
+#include "include/truth_pruning.h"
+#include "include/voxel_index.h"
+#include "include/matching.h"
+#include "include/merge.h"
+#include "include/record_writer.h"
+#include "include/jobs.h"
 
 #include "sbnanaobj/StandardRecord/StandardRecord.h"
 #include "sbnanaobj/StandardRecord/SRInteractionDLP.h"
@@ -34,9 +50,7 @@
 #include "TTree.h"
 #include "TH1D.h"
 
-typedef std::tuple<size_t, size_t, size_t> index_t;
-
-int main(int argc, char const * argv[])
+int merge_sources_multi_main(int argc, char const * argv[])
 {
     /**
      * @brief Check that the required arguments are present.
@@ -49,67 +63,123 @@ int main(int argc, char const * argv[])
      * set of events. The merging code will match the events in the input CAF
      * file to the events in the input HDF5 file by (Run, Subrun, Event No.).
      */
-    if(argc < 3)
+    dlp::Options options(argc, argv);
+    const std::vector<std::string> & args(options.positional());
+    if(args.size() < 3)
     {
-        std::cerr << "Usage: ./merge_sources <output_file> <input_caf_file> <input_h5_file(s)>" << std::endl;
+        std::cerr << "Usage: ./merge_sources <output_file> <input_caf_file> <input_h5_file(s)> [--max-open-files=N] [--flat] [--threads=N] [--entries=<first>:<last>] [--shard=<i>/<N>] [--sample=<fraction>] [--seed=<seed>] [--skim=<cut>[,<cut>...]] [--skim-truth] [--skim-plugin=<library>] [--prune-truth=<policy>[,<policy>...]] [--voxel-sidecar=<file>] [--rematch=<metric>[:<threshold>]] [input options] [output options] [--report=<file>] [--progress=<seconds>] [logging options]" << std::endl;
         return 0;
     }
 
-    if(argc > 28)
-    {
-        std::cerr << "You passed more than 25 input HDF5 files! Absolutely not!" << std::endl;
-        return 0;
-    }
+    /**
+     * @brief Configure the instrumentation (if requested) and the logging of
+     * the job.
+     */
+    dlp::Instrumentation::get().configure(options);
+    dlp::Logger::get().configure(options);
+
+    /**
+     * @brief Configure the output profile.
+     * @details The output profile holds the compression and layout settings
+     * of the output CAF file. ROOT implicit multithreading (if requested) is
+     * enabled before any TTree is created so that both the input and output
+     * TTrees make use of it.
+     */
+    dlp::OutputProfile profile(dlp::parse_output_profile(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "output_profile", "Output profile: ", dlp::describe_output_profile(profile));
+    dlp::enable_implicit_mt(profile);
+
+    /**
+     * @brief Configure the selection of the input CAF records.
+     * @details Only the records in the selected range, shard and sample (see
+     * @ref EventSelection) are read and merged.
+     */
+    dlp::EventSelection selection(dlp::parse_event_selection(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "selection", "Event selection: ", dlp::describe_event_selection(selection));
+
+    /**
+     * @brief Configure the skim of the merged records.
+     * @details Records which do not pass the skim (see @ref Skim) are not
+     * written, but remain counted in the exposure.
+     */
+    dlp::Skim skim(dlp::parse_skim(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "skim", "Skim: ", skim.describe());
+
+    /**
+     * @brief Configure the pruning of the true particles.
+     * @details Pruned particles (see @ref TruthPruning) are never converted.
+     */
+    dlp::TruthPruning pruning(dlp::parse_truth_pruning(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "pruning", "Truth pruning: ", dlp::describe_truth_pruning(pruning));
+
+    /**
+     * @brief Configure the voxel index sidecar file.
+     * @details If "--voxel-sidecar" is passed, the voxel index arrays of the
+     * matched events are written (encoded) to a separate HDF5 file, keyed by
+     * (Run, Subrun, Event No.). See @ref VoxelIndexWriter.
+     */
+    std::unique_ptr<dlp::VoxelIndexWriter> voxels;
+    if(options.has("voxel-sidecar"))
+        voxels = std::make_unique<dlp::VoxelIndexWriter>(options.get("voxel-sidecar"));
+
+    /**
+     * @brief Configure the recomputation of the reco/truth matches.
+     * @details If "--rematch" is passed, the interaction matches are
+     * recomputed from the voxel index arrays of the matched events with the
+     * requested metric (see @ref Matcher) and written to the "dlpMatchTree"
+     * TTree of the output CAF file.
+     */
+    dlp::MatchConfig match_config(dlp::parse_match_config(options));
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "rematch", "Recomputed matches: ", dlp::describe_match_config(match_config));
+    std::unique_ptr<dlp::Matcher> matcher;
+    if(match_config.active())
+        matcher = std::make_unique<dlp::Matcher>(match_config);
+
+    /**
+     * @brief Configure the maximum number of open input HDF5 files.
+     * @details The value is checked before the output CAF file is created.
+     */
+    size_t max_open_files(dlp::parse_max_open_files(options));
+
+    /**
+     * @brief Open the output CAF file and start copying the auxiliary objects
+     * of the input CAF file.
+     * @details Everything other than the "recTree" TTree is copied as-is by
+     * the @ref AuxCopier on a separate thread while the input files are
+     * opened and indexed, which does not touch the output CAF file. If an
+     * event selection is active, the exposure histograms are recomputed from
+     * the selected records instead of being copied.
+     */
+    TFile output_caf(args[0].c_str(), "recreate");
+    dlp::apply_output_profile(output_caf, profile);
+    dlp::AuxCopier aux(args[1], output_caf, dlp::recomputed_objects(selection));
 
     /**
      * @brief Configure the input HDF5 file(s).
      * @details The merging code will need to access the event records in the
      * file once it has been matched to an event from the input CAF file. This
-     * is done by building a map between (Run, Event No.) and the @ref 
-     * dlp::types::Event object. This class contains only references to the
-     * actual SPINE data products, so it is not overly heavy. Because the input
-     * HDF5 dataset in general is a list of files, the code will maintain a map
-     * of events for each file.
-     */
-    std::map<index_t, std::pair<size_t, size_t> > event_map;
-    std::map<size_t, H5::H5File> input_files;
-    std::map<size_t, std::vector<dlp::types::Event> > events;
-    for(size_t f(3); f < argc; ++f)
-    {
-        input_files.insert(std::make_pair(f, H5::H5File(argv[f], H5F_ACC_RDONLY)));
-        events.insert(std::make_pair(f, get_all_events(input_files[f])));
-        for(size_t e(0); e < events[f].size(); ++e)
-        {
-            try
-            {
-                /**
-                 * @brief Retrieve the run info for the event.
-                 * @details For each event in the input HDF5 file, the run info is
-                 * retrieved and emplaced in a map that will allow for efficient
-                 * lookup later when copying data into the output CAF file.
-                 * @note The index is a tuple of (Run, Subrun, Event No.).
-                 */
-                std::vector<dlp::types::RunInfo> run_info(get_product<dlp::types::RunInfo>(input_files[f], events[f][e]));
-                index_t index(run_info.back().run, run_info.back().subrun, run_info.back().event);
-                event_map.insert(std::make_pair(index, std::make_pair(f, e)));
-            }
-            catch(const H5::ReferenceException & e)
-            {
-                std::cerr << "Found incomplete entry for event." << std::endl;
-            }
-        }
-    }
+     * is done by building a global index between (Run, Subrun, Event No.) and
+     * the location of the @ref dlp::types::Event object in the input files.
+     * The input files themselves are managed by a pool which keeps at most
+     * "--max-open-files" files (and their lists of events) open at once, so
+     * the number of input files is not limited by file descriptors or memory.
+     */
+    dlp::FilePool pool(std::vector<std::string>(args.begin() + 2, args.end()), max_open_files);
+    dlp::EventIndex event_map(dlp::build_event_index(pool));
 
     /**
      * @brief Configure the output CAF file.
      * @details The merging code will need to attach to the "recTree.rec"
      * branch (StandardRecord) in order to copy them over to a new file and
-     * simultaneously copy in the SPINE reconstruction outputs.
+     * simultaneously copy in the SPINE reconstruction outputs. The read
+     * caching of the input TTree is configured by the input options (see
+     * @ref InputProfile).
      */
-    TFile input_caf(argv[2], "read");
+    TFile input_caf(args[1].c_str(), "read");
     TTree *input_tree = (TTree*)input_caf.Get("recTree");
     caf::StandardRecord *rec = new caf::StandardRecord;
     input_tree->SetBranchAddress("rec", &rec);
+    dlp::apply_input_profile(input_tree, dlp::parse_input_profile(options));
 
     /**
      * @brief Configure the output CAF file.
@@ -117,93 +187,55 @@ int main(int argc, char const * argv[])
      * StandardRecord entries. Since the code is modifying in-place the "rec"
      * object, the output TTree is set to track this same object. This means
      * that calling TTree::GetEntry() and TTree::Fill() with no intermediate
-     * changes will effectively copy the StandardRecord entry.
+     * changes will effectively copy the StandardRecord entry. If the "--flat"
+     * option is passed, the entries are written directly in the flat CAF
+     * layout. The compression and layout of the output are configured by
+     * the output options (see @ref OutputProfile). The output TTree is only
+     * created once the auxiliary objects have been copied.
      */
-    TFile output_caf(argv[1], "recreate");
-    TTree *output_tree = new TTree("recTree", "records");
-    output_tree->Branch("rec", &rec);
+    aux.Wait();
+    dlp::RecordWriter writer(&rec, profile);
+    if(matcher)
+        writer.AttachMatches(&matcher->record());
 
     /**
      * @brief Begin main loop over records within the input CAF file.
      * @details At each step, check that there is a matching event in the HDF5
-     * input file.
+     * input file(s). Only matched records are written to the output CAF file.
      */
-    size_t current_file(3);
-    size_t matched(0), unmatched(0);
-    for(size_t n(0); n < input_tree->GetEntries(); ++n)
-    {
-        input_tree->GetEntry(n);
-        /**
-         * @brief Reset the ML reconstruction output branches.
-         * @details It is safest to reset the ML reconstruction output
-         * branches to prevent old products from remaining in the case
-         * where something unexpected happens.
-         */  
-        rec->dlp.clear();
-        rec->ndlp = 0;
-        rec->dlp_true.clear();
-        rec->ndlp_true = 0;
-
-        index_t index(rec->hdr.run, rec->hdr.subrun, rec->hdr.evt);
-        if(event_map.find(index) != event_map.end())
-        {
-            ++matched;
-	        std::cout << "Matched Event " << std::get<2>(index) << " in (Run, Subrun) = (" << std::get<0>(index) << ", " << std::get<1>(index) << ") of CAF input to HDF5 event."
-                      << " Found in file " << std::get<0>(event_map[index]) << " at index " << std::get<1>(event_map[index])
-                      << " (" << argv[std::get<0>(event_map[index])] << ")"
-                      << "."
-                      << std::endl;
-            /**
-             * @brief Package the event data products.
-             * @details The @ref package_event() function is responsible
-             * for copying the data products from the event into the proper
-             * CAF class within the StandardRecord.
-             * @throw H5::ReferenceException if the event is incom
-             */
-            try
-            {
-                package_event(rec, input_files[std::get<0>(event_map[index])], events[std::get<0>(event_map[index])][std::get<1>(event_map[index])]);
-            }
-            catch(const H5::ReferenceException & e)
-            {
-                std::cerr << "Found incomplete entry for event." << std::endl;
-            }
-            output_tree->Fill();
-        }
-        else
-        {
-            ++unmatched;
-            std::cerr << "No matching event found for (Run, Subrun, Event No.) = (" << rec->hdr.run << ", " << rec->hdr.subrun << ", " << rec->hdr.evt << ")." << std::endl;
-        }
-    }
+    dlp::MergeResult result(dlp::merge_records(input_tree, writer, rec, event_map, pool, false, selection, skim, pruning, voxels.get(), matcher.get()));
 
     /**
      * @brief Write the data into the output CAF file.
      * @details In addition to the TTree containing the StandardRecord entries,
      * there are also histograms for storing the total POT and the total number
-     * of events and some other TTrees storing environment stuff and metadata.
-     * The order probably doesn't matter, but this maintains the same exact
-     * order as in the input CAF file.
-     */
-    TDirectoryFile *env = (TDirectoryFile*)input_caf.Get("env");
-    env->Write();
-    TH1D *total_pot = (TH1D*)input_caf.Get("TotalPOT");
-    total_pot->Write();
-    TH1D *total_events = (TH1D*)input_caf.Get("TotalEvents");
-    total_events->Write();
-    output_tree->Write();
-    TDirectoryFile *metadata = (TDirectoryFile*)input_caf.Get("metadata");
-    metadata->Write();
-    
+     * of events and some other TTrees storing environment stuff, metadata and
+     * (for simulation) the "globalTree" and "GenieEvtRecTree". These have
+     * already been written by the @ref AuxCopier.
+     */
+    writer.Write();
+    if(selection.active())
+        dlp::write_selected_exposure(output_caf, input_caf, result);
+    if(skim.active())
+        dlp::Logger::get().log(dlp::LogLevel::kInfo, "skim", "Dropped ", result.skimmed, " record(s) which did not pass the skim.");
+
     /**
      * @brief Close the input and output files. 
      */
-    for(auto &f : input_files)
-        f.second.close();
+    dlp::print_read_statistics(input_caf);
+    voxels.reset();
+    pool.close_all();
     input_caf.Close();
     output_caf.Close();
 
-    std::cout << "Merged " << matched << " / " << matched+unmatched << " events from the input HDF5 file(s) into the output CAF file." << std::endl;
+    dlp::Logger::get().log(dlp::LogLevel::kInfo, "merged", "Merged ", result.matched, " / ", result.matched+result.unmatched, " events from the input HDF5 file(s) into the output CAF file.");
 
     return 0;
 }
+
+#ifndef DLP_DAEMON
+int main(int argc, char const * argv[])
+{
+    return merge_sources_multi_main(argc, argv);
+}
+#endif
@@ -0,0 +1,110 @@
+/**
+ * @file aux_copier.cc
+ * @brief Implementation of the AuxCopier class for copying the auxiliary
+ * objects of an input CAF file to the output CAF file.
+ * @author mueller@fnal.gov
+*/
+#include <set>
+#include <string>
+#include <memory>
+#include <future>
+#include <stdexcept>
+#include "aux_copier.h"
+#include "instrumentation.h"
+
+#include "TROOT.h"
+#include "TFile.h"
+#include "TDirectory.h"
+#include "TKey.h"
+#include "TClass.h"
+#include "TTree.h"
+
+namespace dlp
+{
+    /**
+     * @brief Copy all objects of a directory (except the skipped ones) to
+     * another directory.
+     * @param output The output directory.
+     * @param input The input directory.
+     * @param skip The names of the objects which are not copied.
+    */
+    void copy_directory(TDirectory * output, TDirectory * input, const std::set<std::string> & skip)
+    {
+        std::set<std::string> copied(skip);
+        TIter next(input->GetListOfKeys());
+        while(TKey * key = (TKey *)next())
+        {
+            /**
+             * @brief Keys are ordered by decreasing cycle, so the first key
+             * with a given name is the one to copy.
+             */
+            if(!copied.insert(key->GetName()).second)
+                continue;
+            TClass * type(TClass::GetClass(key->GetClassName()));
+            if(type && type->InheritsFrom(TDirectory::Class()))
+            {
+                TDirectory * directory = output->mkdir(key->GetName(), key->GetTitle());
+                copy_directory(directory, input->GetDirectory(key->GetName()));
+            }
+            else if(type && type->InheritsFrom(TTree::Class()))
+            {
+                TTree * tree = input->Get<TTree>(key->GetName());
+                output->cd();
+                TTree * clone = tree->CloneTree(-1, "fast");
+                clone->Write();
+                delete clone;
+                delete tree;
+            }
+            else
+            {
+                TObject * object = key->ReadObj();
+                output->WriteTObject(object, key->GetName());
+                delete object;
+            }
+        }
+    }
+
+    /**
+     * @brief A constructor for the AuxCopier class.
+     * @param input_path The path of the input CAF file.
+     * @param output The output CAF file.
+     * @param skip The names of additional top-level objects which are not
+     * copied.
+    */
+    AuxCopier::AuxCopier(const std::string & input_path, TFile & output, const std::set<std::string> & skip)
+        : fOutput(output)
+    {
+        ROOT::EnableThreadSafety();
+        std::set<std::string> skipped(skip);
+        skipped.insert("recTree");
+        fResult = std::async(std::launch::async, [this, input_path, skipped]()
+        {
+            ScopedTimer timer("aux_copy");
+            std::unique_ptr<TFile> input(TFile::Open(input_path.c_str(), "read"));
+            if(!input || input->IsZombie())
+                throw std::runtime_error("Unable to open input CAF file: " + input_path);
+            copy_directory(&fOutput, input.get(), skipped);
+            input->Close();
+        });
+    }
+
+    /**
+     * @brief A destructor for the AuxCopier class.
+    */
+    AuxCopier::~AuxCopier()
+    {
+        if(fResult.valid())
+            fResult.wait();
+    }
+
+    /**
+     * @brief Wait for the copy to finish.
+     * @throw std::runtime_error if the input CAF file could not be read.
+    */
+    void AuxCopier::Wait()
+    {
+        ScopedTimer timer("aux_wait");
+        fResult.get();
+        fOutput.cd();
+    }
+} // namespace dlp
@@ -0,0 +1,236 @@
+/**
+ * @file cross_references.cc
+ * @brief Implementation of the CrossReferenceBuilder class for resolving the
+ * ID references between the ML objects of a StandardRecord into positions.
+ * @author mueller@fnal.gov
+*/
+#include <limits>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include "cross_references.h"
+#include "particle_hierarchy.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+#include "sbnanaobj/StandardRecord/SRInteractionDLP.h"
+#include "sbnanaobj/StandardRecord/SRInteractionTruthDLP.h"
+#include "sbnanaobj/StandardRecord/SRParticleDLP.h"
+#include "sbnanaobj/StandardRecord/SRParticleTruthDLP.h"
+
+namespace
+{
+    /**
+     * @brief The key marking an empty slot of a FlatIdMap.
+     */
+    constexpr int64_t kEmptyKey = std::numeric_limits<int64_t>::min();
+
+    /**
+     * @brief Hash an object ID.
+     * @param id The object ID.
+     * @return The hash of the ID.
+     */
+    inline size_t hash_id(int64_t id)
+    {
+        uint64_t h(uint64_t(id) * 0x9E3779B97F4A7C15ull);
+        return h ^ (h >> 32);
+    }
+
+    /**
+     * @brief Index the interactions and particles of one side of the record.
+     * @param interactions The interactions ("rec.dlp" or "rec.dlp_true").
+     * @param interaction_map The ID to position map of the interactions.
+     * @param particle_map The ID to position map of the particles.
+     * @param offset The position of the first particle of each interaction.
+     * @param owner The position of the interaction of each particle.
+     */
+    template <class Interaction>
+    void index_side(const std::vector<Interaction> & interactions, dlp::FlatIdMap & interaction_map, dlp::FlatIdMap & particle_map,
+                    std::vector<int32_t> & offset, std::vector<int32_t> & owner)
+    {
+        size_t nparticles(0);
+        for(const Interaction & interaction : interactions)
+            nparticles += interaction.particles.size();
+        interaction_map.reset(interactions.size());
+        particle_map.reset(nparticles);
+        for(size_t i(0); i < interactions.size(); ++i)
+        {
+            interaction_map.insert(interactions[i].id, i);
+            offset.push_back(owner.size());
+            for(const auto & particle : interactions[i].particles)
+            {
+                particle_map.insert(particle.id, owner.size());
+                owner.push_back(i);
+            }
+        }
+    }
+
+    /**
+     * @brief Resolve a list of IDs.
+     * @param ids The list of IDs.
+     * @param map The ID to position map of the referenced objects.
+     * @param out The positions of the referenced objects (appended).
+     */
+    template <class Ids>
+    void resolve(const Ids & ids, const dlp::FlatIdMap & map, std::vector<int32_t> & out)
+    {
+        for(int64_t id : ids)
+            out.push_back(map.find(id));
+    }
+
+    /**
+     * @brief Resolve the list of IDs of one object and record where its
+     * positions begin.
+     * @param ids The list of IDs.
+     * @param map The ID to position map of the referenced objects.
+     * @param begin The offset of the positions of each object (appended).
+     * @param out The positions of the referenced objects (appended).
+     */
+    template <class Ids>
+    void resolve(const Ids & ids, const dlp::FlatIdMap & map, std::vector<int32_t> & begin, std::vector<int32_t> & out)
+    {
+        begin.push_back(out.size());
+        resolve(ids, map, out);
+    }
+} // namespace
+
+namespace dlp
+{
+    /**
+     * @brief Remove all keys and prepare the map for a number of keys.
+     * @param count The number of keys which will be inserted.
+    */
+    void FlatIdMap::reset(size_t count)
+    {
+        size_t size(16);
+        while(size < 2 * count)
+            size *= 2;
+        if(fKeys.size() < size)
+        {
+            fKeys.resize(size);
+            fValues.resize(size);
+        }
+        fMask = size - 1;
+        std::fill(fKeys.begin(), fKeys.begin() + size, kEmptyKey);
+    }
+
+    /**
+     * @brief Insert a key (the first position of a key is kept).
+     * @param id The key.
+     * @param position The value.
+    */
+    void FlatIdMap::insert(int64_t id, int32_t position)
+    {
+        if(id == kEmptyKey)
+            return;
+        for(size_t slot(hash_id(id) & fMask); ; slot = (slot + 1) & fMask)
+        {
+            if(fKeys[slot] == id)
+                return;
+            if(fKeys[slot] == kEmptyKey)
+            {
+                fKeys[slot] = id;
+                fValues[slot] = position;
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Find a key.
+     * @param id The key.
+     * @return The value of the key, or -1 if the key is not in the map.
+    */
+    int32_t FlatIdMap::find(int64_t id) const
+    {
+        if(fKeys.empty() || id == kEmptyKey)
+            return -1;
+        for(size_t slot(hash_id(id) & fMask); ; slot = (slot + 1) & fMask)
+        {
+            if(fKeys[slot] == id)
+                return fValues[slot];
+            if(fKeys[slot] == kEmptyKey)
+                return -1;
+        }
+    }
+
+    /**
+     * @brief Remove all cross-references.
+    */
+    void CrossReferenceRecord::clear()
+    {
+        dlp_particle_offset.clear();
+        dlp_particle_interaction.clear();
+        dlp_match_begin.clear();
+        dlp_match_index.clear();
+        dlp_particle_match_begin.clear();
+        dlp_particle_match_index.clear();
+        dlp_true_particle_offset.clear();
+        dlp_true_particle_interaction.clear();
+        dlp_true_match_begin.clear();
+        dlp_true_match_index.clear();
+        dlp_true_particle_match_begin.clear();
+        dlp_true_particle_match_index.clear();
+        dlp_true_particle_parent_index.clear();
+        dlp_true_particle_children_begin.clear();
+        dlp_true_particle_children_index.clear();
+    }
+
+    /**
+     * @brief Resolve the cross-references of a StandardRecord.
+     * @param rec The StandardRecord.
+    */
+    void CrossReferenceBuilder::Build(const caf::StandardRecord & rec)
+    {
+        fRecord.clear();
+
+        /**
+         * @brief Build the ID to position maps of both sides.
+         */
+        index_side(rec.dlp, fRecoInteractions, fRecoParticles, fRecord.dlp_particle_offset, fRecord.dlp_particle_interaction);
+        index_side(rec.dlp_true, fTrueInteractions, fTrueParticles, fRecord.dlp_true_particle_offset, fRecord.dlp_true_particle_interaction);
+
+        /**
+         * @brief Resolve the references of the reconstructed objects.
+         */
+        for(const caf::SRInteractionDLP & interaction : rec.dlp)
+        {
+            resolve(interaction.match_ids, fTrueInteractions, fRecord.dlp_match_begin, fRecord.dlp_match_index);
+            for(const caf::SRParticleDLP & particle : interaction.particles)
+                resolve(particle.match_ids, fTrueParticles, fRecord.dlp_particle_match_begin, fRecord.dlp_particle_match_index);
+        }
+        fRecord.dlp_match_begin.push_back(fRecord.dlp_match_index.size());
+        fRecord.dlp_particle_match_begin.push_back(fRecord.dlp_particle_match_index.size());
+
+        /**
+         * @brief Resolve the references of the true objects.
+         */
+        for(const caf::SRInteractionTruthDLP & interaction : rec.dlp_true)
+        {
+            resolve(interaction.match_ids, fRecoInteractions, fRecord.dlp_true_match_begin, fRecord.dlp_true_match_index);
+            for(const caf::SRParticleTruthDLP & particle : interaction.particles)
+            {
+                resolve(particle.match_ids, fRecoParticles, fRecord.dlp_true_particle_match_begin, fRecord.dlp_true_particle_match_index);
+                fRecord.dlp_true_particle_parent_index.push_back(particle.parent_id >= 0 ? fTrueParticles.find(particle.parent_id) : -1);
+                resolve(particle.children_id, fTrueParticles, fRecord.dlp_true_particle_children_begin, fRecord.dlp_true_particle_children_index);
+            }
+        }
+        fRecord.dlp_true_match_begin.push_back(fRecord.dlp_true_match_index.size());
+        fRecord.dlp_true_particle_match_begin.push_back(fRecord.dlp_true_particle_match_index.size());
+        fRecord.dlp_true_particle_children_begin.push_back(fRecord.dlp_true_particle_children_index.size());
+
+        /**
+         * @brief Build the hierarchy of the true particles.
+         */
+        fPrimary.clear();
+        fVisible.clear();
+        for(const caf::SRInteractionTruthDLP & interaction : rec.dlp_true)
+        {
+            for(const caf::SRParticleTruthDLP & particle : interaction.particles)
+            {
+                fPrimary.push_back(particle.is_primary);
+                fVisible.push_back(particle.size > 0);
+            }
+        }
+        fHierarchy.Build(fRecord.dlp_true_particle_parent_index, fPrimary, fVisible);
+    }
+} // namespace dlp
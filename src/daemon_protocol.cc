@@ -0,0 +1,390 @@
+/**
+ * @file daemon_protocol.cc
+ * @brief Implementation of the functions for exchanging job requests between
+ * the CAF maker daemon and its client over a local UNIX domain socket.
+ * @details A request is a fixed header (magic number and payload size) sent
+ * together with the three standard file descriptors of the client, followed
+ * by the payload: the NUL-terminated program name, working directory and
+ * arguments. The reply is the 32-bit exit status of the job.
+ * @author mueller@fnal.gov
+*/
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "daemon_protocol.h"
+
+namespace
+{
+    /**
+     * @brief The magic number starting each request ("DLPJ").
+     */
+    constexpr uint32_t kMagic = 0x444C504A;
+
+    /**
+     * @brief The largest accepted payload of a request.
+     */
+    constexpr uint32_t kMaxPayload = 1 << 20;
+
+    /**
+     * @brief The header of a request.
+     */
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t size;
+    };
+
+    /**
+     * @brief Build the address of a socket.
+     * @param path The path of the socket.
+     * @return The address of the socket.
+     * @throw std::runtime_error if the path is too long.
+     */
+    sockaddr_un make_address(const std::string & path)
+    {
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if(path.size() >= sizeof(address.sun_path))
+            throw std::runtime_error("Socket path is too long: " + path);
+        std::memcpy(address.sun_path, path.c_str(), path.size());
+        return address;
+    }
+
+    /**
+     * @brief Create a UNIX stream socket which is not inherited by executed
+     * programs.
+     * @return The file descriptor of the socket.
+     * @throw std::runtime_error if the socket cannot be created.
+     */
+    int make_socket()
+    {
+        int fd(socket(AF_UNIX, SOCK_STREAM, 0));
+        if(fd < 0)
+            throw std::runtime_error(std::string("Unable to create socket: ") + std::strerror(errno));
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        return fd;
+    }
+
+    /**
+     * @brief Read exactly a number of bytes.
+     * @param fd The file descriptor.
+     * @param data The buffer.
+     * @param size The number of bytes.
+     * @return True if all bytes were read, false on end of file or error.
+     */
+    bool read_all(int fd, void * data, size_t size)
+    {
+        char * buffer(static_cast<char *>(data));
+        while(size > 0)
+        {
+            ssize_t n(read(fd, buffer, size));
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n <= 0)
+                return false;
+            buffer += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Write exactly a number of bytes.
+     * @param fd The file descriptor.
+     * @param data The buffer.
+     * @param size The number of bytes.
+     * @return True if all bytes were written.
+     */
+    bool write_all(int fd, const void * data, size_t size)
+    {
+        const char * buffer(static_cast<const char *>(data));
+        while(size > 0)
+        {
+            ssize_t n(write(fd, buffer, size));
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n <= 0)
+                return false;
+            buffer += n;
+            size -= n;
+        }
+        return true;
+    }
+} // namespace
+
+namespace dlp
+{
+    /**
+     * @brief Split the name of an executable into the job and the flavor.
+     * @param program The name (or path) of the executable.
+     * @param job The name of the job (output).
+     * @param flavor The flavor of the executable (output).
+     * @return True if the name contains a flavor.
+    */
+    bool split_program(const std::string & program, std::string & job, std::string & flavor)
+    {
+        std::string name(program.substr(program.find_last_of('/') + 1));
+        for(const char * candidate : {"simulation", "data"})
+        {
+            std::string token(std::string("_") + candidate);
+            size_t position(name.find(token));
+            if(position == std::string::npos)
+                continue;
+            job = name.substr(0, position) + name.substr(position + token.size());
+            flavor = candidate;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Get the default path of the socket of the daemon of a flavor.
+     * @param flavor The flavor of the daemon ("simulation" or "data").
+     * @return The path of the socket.
+    */
+    std::string default_socket_path(const std::string & flavor)
+    {
+        std::string directory("/tmp");
+        for(const char * variable : {"XDG_RUNTIME_DIR", "CAFMAKER_SOCKET_DIR"})
+        {
+            const char * value(std::getenv(variable));
+            if(value && *value)
+                directory = value;
+        }
+        return directory + "/sbn_ml_cafmaker_" + flavor + "_" + std::to_string(getuid()) + ".sock";
+    }
+
+    /**
+     * @brief Create the listening socket of the daemon.
+     * @param path The path of the socket.
+     * @return The file descriptor of the listening socket.
+    */
+    int listen_socket(const std::string & path)
+    {
+        sockaddr_un address(make_address(path));
+        int fd(make_socket());
+        if(bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            /**
+             * @brief Replace the socket file if no daemon is listening on it.
+             */
+            int error(errno);
+            if(error == EADDRINUSE)
+            {
+                int probe(make_socket());
+                bool alive(connect(probe, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+                close(probe);
+                if(alive)
+                {
+                    close(fd);
+                    throw std::runtime_error("Another daemon is already listening on " + path);
+                }
+                unlink(path.c_str());
+                error = bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0 ? 0 : errno;
+            }
+            if(error != 0)
+            {
+                close(fd);
+                throw std::runtime_error("Unable to bind socket " + path + ": " + std::strerror(error));
+            }
+        }
+        chmod(path.c_str(), S_IRUSR | S_IWUSR);
+        if(listen(fd, SOMAXCONN) != 0)
+        {
+            int error(errno);
+            close(fd);
+            throw std::runtime_error("Unable to listen on socket " + path + ": " + std::strerror(error));
+        }
+        return fd;
+    }
+
+    /**
+     * @brief Connect to the daemon.
+     * @param path The path of the socket.
+     * @return The file descriptor of the connection.
+    */
+    int connect_socket(const std::string & path)
+    {
+        sockaddr_un address(make_address(path));
+        int fd(make_socket());
+        if(connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            int error(errno);
+            close(fd);
+            throw std::runtime_error("Unable to connect to " + path + ": " + std::strerror(error));
+        }
+        return fd;
+    }
+
+    /**
+     * @brief Check that the peer of a connection is the owner of the process.
+     * @param connection The file descriptor of the connection.
+     * @return True if the peer is run by the same user.
+    */
+    bool trusted_peer(int connection)
+    {
+        #ifdef SO_PEERCRED
+        ucred credentials;
+        socklen_t size(sizeof(credentials));
+        if(getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &credentials, &size) != 0)
+            return false;
+        return credentials.uid == getuid();
+        #else
+        return true;
+        #endif
+    }
+
+    /**
+     * @brief Send a job request to the daemon.
+     * @param connection The file descriptor of the connection.
+     * @param request The job request.
+    */
+    void send_request(int connection, const JobRequest & request)
+    {
+        std::string payload;
+        payload.append(request.program).push_back('\0');
+        payload.append(request.directory).push_back('\0');
+        for(const std::string & argument : request.arguments)
+            payload.append(argument).push_back('\0');
+        if(payload.size() > kMaxPayload)
+            throw std::runtime_error("Job request is too large.");
+
+        /**
+         * @brief Send the header with the standard file descriptors attached.
+         */
+        Header header{kMagic, static_cast<uint32_t>(payload.size())};
+        iovec vector{&header, sizeof(header)};
+        char control[CMSG_SPACE(sizeof(request.descriptors))];
+        std::memset(control, 0, sizeof(control));
+        msghdr message;
+        std::memset(&message, 0, sizeof(message));
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr * descriptors(CMSG_FIRSTHDR(&message));
+        descriptors->cmsg_level = SOL_SOCKET;
+        descriptors->cmsg_type = SCM_RIGHTS;
+        descriptors->cmsg_len = CMSG_LEN(sizeof(request.descriptors));
+        std::memcpy(CMSG_DATA(descriptors), request.descriptors, sizeof(request.descriptors));
+        ssize_t sent;
+        do
+            sent = sendmsg(connection, &message, 0);
+        while(sent < 0 && errno == EINTR);
+        if(sent < 0 || !write_all(connection, reinterpret_cast<const char *>(&header) + sent, sizeof(header) - sent))
+            throw std::runtime_error(std::string("Unable to send job request: ") + std::strerror(errno));
+        if(!write_all(connection, payload.data(), payload.size()))
+            throw std::runtime_error(std::string("Unable to send job request: ") + std::strerror(errno));
+    }
+
+    /**
+     * @brief Receive a job request from a client.
+     * @param connection The file descriptor of the connection.
+     * @param request The job request (output).
+    */
+    void receive_request(int connection, JobRequest & request)
+    {
+        /**
+         * @brief Receive the header and the standard file descriptors.
+         */
+        Header header;
+        iovec vector{&header, sizeof(header)};
+        char control[CMSG_SPACE(sizeof(request.descriptors))];
+        msghdr message;
+        std::memset(&message, 0, sizeof(message));
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        ssize_t received;
+        do
+            received = recvmsg(connection, &message, 0);
+        while(received < 0 && errno == EINTR);
+        for(cmsghdr * c(CMSG_FIRSTHDR(&message)); received > 0 && c; c = CMSG_NXTHDR(&message, c))
+        {
+            if(c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS && c->cmsg_len == CMSG_LEN(sizeof(request.descriptors)))
+                std::memcpy(request.descriptors, CMSG_DATA(c), sizeof(request.descriptors));
+        }
+        for(int fd : request.descriptors)
+        {
+            if(fd >= 0)
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+
+        /**
+         * @brief Receive the rest of the header and the payload.
+         */
+        std::string payload;
+        bool complete(received > 0 && read_all(connection, reinterpret_cast<char *>(&header) + received, sizeof(header) - received));
+        if(complete && header.magic == kMagic && header.size <= kMaxPayload)
+        {
+            payload.resize(header.size);
+            complete = read_all(connection, payload.data(), payload.size());
+        }
+        else
+            complete = false;
+        std::vector<std::string> fields;
+        if(complete && !payload.empty() && payload.back() == '\0')
+        {
+            /**
+             * @brief Split the payload into the program name, the working
+             * directory and the arguments.
+             */
+            for(size_t begin(0), end; begin < payload.size(); begin = end + 1)
+            {
+                end = payload.find('\0', begin);
+                fields.emplace_back(payload, begin, end - begin);
+            }
+        }
+        for(int fd : request.descriptors)
+            complete = complete && fd >= 0;
+        if(!complete || (message.msg_flags & MSG_CTRUNC) || fields.size() < 2)
+        {
+            for(int & fd : request.descriptors)
+            {
+                if(fd >= 0)
+                    close(fd);
+                fd = -1;
+            }
+            throw std::runtime_error("Received a malformed job request.");
+        }
+        request.program = fields[0];
+        request.directory = fields[1];
+        request.arguments.assign(fields.begin() + 2, fields.end());
+    }
+
+    /**
+     * @brief Send the exit status of a job to the client.
+     * @param connection The file descriptor of the connection.
+     * @param status The exit status of the job.
+     * @return True if the status was sent.
+    */
+    bool send_status(int connection, int status)
+    {
+        int32_t value(status);
+        return write_all(connection, &value, sizeof(value));
+    }
+
+    /**
+     * @brief Wait for the exit status of the job.
+     * @param connection The file descriptor of the connection.
+     * @return The exit status of the job.
+    */
+    int receive_status(int connection)
+    {
+        int32_t value;
+        if(!read_all(connection, &value, sizeof(value)))
+            throw std::runtime_error("The daemon closed the connection before the job finished.");
+        return value;
+    }
+} // namespace dlp
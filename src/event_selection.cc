@@ -0,0 +1,162 @@
+/**
+ * @file event_selection.cc
+ * @brief Implementation of the functions for processing a range, a shard or
+ * a deterministic sample of the input events.
+ * @author mueller@fnal.gov
+*/
+#include <set>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include "event_selection.h"
+#include "options.h"
+
+namespace
+{
+    /**
+     * @brief Parse an unsigned integer.
+     * @param value The string to parse.
+     * @param option The name of the option (for the error message).
+     * @return The integer.
+     * @throw std::runtime_error if the value is not an unsigned integer.
+     */
+    uint64_t parse_unsigned(const std::string & value, const std::string & option)
+    {
+        size_t end(0);
+        uint64_t result(0);
+        try
+        {
+            result = std::stoull(value, &end);
+        }
+        catch(const std::exception & e)
+        {
+            end = 0;
+        }
+        if(value.empty() || end != value.size() || value[0] == '-')
+            throw std::runtime_error("Invalid value for --" + option + ": " + value);
+        return result;
+    }
+
+    /**
+     * @brief Mix the bits of a 64-bit integer (the SplitMix64 finalizer).
+     * @param x The integer.
+     * @return The mixed integer.
+     */
+    uint64_t mix(uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+} // namespace
+
+namespace dlp
+{
+    /**
+     * @brief Get the range of entries of the shard.
+     * @param nentries The total number of entries of the input.
+     * @return The first and one past the last entry of the shard.
+    */
+    std::pair<uint64_t, uint64_t> EventSelection::range(uint64_t nentries) const
+    {
+        uint64_t begin(std::min(first, nentries));
+        uint64_t end(std::max(begin, std::min(last, nentries)));
+        uint64_t size(end - begin);
+        return std::make_pair(begin + size * shard / nshards, begin + size * (shard + 1) / nshards);
+    }
+
+    /**
+     * @brief Check if an entry is kept by the sampling.
+     * @param entry The (global) entry number.
+     * @return True if the entry is kept.
+    */
+    bool EventSelection::sampled(uint64_t entry) const
+    {
+        if(fraction >= 1)
+            return true;
+        return (mix(seed ^ mix(entry)) >> 11) * 0x1.0p-53 < fraction;
+    }
+
+    /**
+     * @brief Build the event selection from the command line options.
+     * @param options The command line options.
+     * @return The event selection.
+     * @throw std::runtime_error if an option has an invalid value.
+    */
+    EventSelection parse_event_selection(const Options & options)
+    {
+        EventSelection selection;
+        if(options.has("entries"))
+        {
+            std::string value(options.get("entries"));
+            size_t colon(value.find(':'));
+            if(colon == std::string::npos)
+                throw std::runtime_error("Invalid value for --entries (expected <first>:<last>): " + value);
+            if(colon > 0)
+                selection.first = parse_unsigned(value.substr(0, colon), "entries");
+            if(colon + 1 < value.size())
+                selection.last = parse_unsigned(value.substr(colon + 1), "entries");
+            if(selection.last < selection.first)
+                throw std::runtime_error("Invalid value for --entries (last < first): " + value);
+            selection.requested = true;
+        }
+        if(options.has("shard"))
+        {
+            std::string value(options.get("shard"));
+            size_t slash(value.find('/'));
+            if(slash == std::string::npos)
+                throw std::runtime_error("Invalid value for --shard (expected <i>/<N>): " + value);
+            selection.shard = parse_unsigned(value.substr(0, slash), "shard");
+            selection.nshards = parse_unsigned(value.substr(slash + 1), "shard");
+            if(selection.nshards == 0 || selection.shard >= selection.nshards)
+                throw std::runtime_error("Invalid value for --shard (expected 0 <= i < N): " + value);
+            selection.requested = true;
+        }
+        if(options.has("sample"))
+        {
+            selection.fraction = options.get_double("sample", 1);
+            if(selection.fraction <= 0 || selection.fraction > 1)
+                throw std::runtime_error("Sample fraction must be in (0, 1].");
+            selection.requested = true;
+        }
+        if(options.has("seed"))
+            selection.seed = parse_unsigned(options.get("seed"), "seed");
+        return selection;
+    }
+
+    /**
+     * @brief Get the names of the auxiliary objects of the input CAF file
+     * which must be recomputed for the selected entries.
+     * @param selection The event selection.
+     * @return The names of the objects (empty if the selection is inactive).
+    */
+    std::set<std::string> recomputed_objects(const EventSelection & selection)
+    {
+        if(!selection.active())
+            return {};
+        return {"TotalPOT", "TotalEvents"};
+    }
+
+    /**
+     * @brief Get a human-readable description of the event selection.
+     * @param selection The event selection.
+     * @return The description of the event selection.
+    */
+    std::string describe_event_selection(const EventSelection & selection)
+    {
+        if(!selection.active())
+            return "all entries";
+        std::ostringstream description;
+        description << "entries [" << selection.first << ", ";
+        if(selection.last == std::numeric_limits<uint64_t>::max())
+            description << "end)";
+        else
+            description << selection.last << ")";
+        description << ", shard " << selection.shard << "/" << selection.nshards;
+        if(selection.fraction < 1)
+            description << ", sample " << selection.fraction << " (seed " << selection.seed << ")";
+        return description.str();
+    }
+} // namespace dlp
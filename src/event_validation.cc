@@ -0,0 +1,122 @@
+/**
+ * @file event_validation.cc
+ * @brief Implementation of the EventValidity class and the function for
+ * validating the region references of the events of an HDF5 file.
+ * @author mueller@fnal.gov
+*/
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include "H5Cpp.h"
+#include "event_validation.h"
+#include "event.h"
+#include "runinfo.h"
+#include "reco_interaction.h"
+#include "reco_particle.h"
+#include "true_interaction.h"
+#include "true_particle.h"
+#include "instrumentation.h"
+
+namespace
+{
+    /**
+     * @brief Check if a region reference is null (all bytes zero).
+     * @param ref The region reference.
+     * @return True if the reference is null.
+     */
+    bool is_null(const hdset_reg_ref_t & ref)
+    {
+        static const hdset_reg_ref_t null_ref = {};
+        return std::memcmp(&ref, &null_ref, sizeof(hdset_reg_ref_t)) == 0;
+    }
+
+    /**
+     * @brief Validate the references of all events to one data product.
+     * @details The extent of the referenced dataset is read once (from the
+     * first reference with a retrievable region), and the selection of each
+     * reference is checked against it. The HDF5 error stack is not printed
+     * for the references that fail to resolve.
+     * @tparam T The type of the data product.
+     * @param file The HDF5 file.
+     * @param events The events of the file.
+     * @param bit The bit of the data product.
+     * @param counter The name of the counter of invalid references.
+     * @param validity The validity of the events (updated).
+     */
+    template <class T>
+    void validate_product(H5::H5File & file, const std::vector<dlp::types::Event> & events, dlp::ProductBit bit, const char * counter, dlp::EventValidity & validity)
+    {
+        hid_t fid(file.getId());
+        hsize_t extent(0);
+        bool have_extent(false);
+        uint64_t ninvalid(0);
+        H5E_BEGIN_TRY
+        {
+            for(size_t e(0); e < events.size(); ++e)
+            {
+                const hdset_reg_ref_t & ref(events[e].GetRef<T>());
+                bool valid(!is_null(ref));
+                hid_t space(valid ? H5Rget_region(fid, H5R_DATASET_REGION, &ref) : -1);
+                valid = space >= 0 && H5Sselect_valid(space) > 0;
+                if(valid && !have_extent)
+                {
+                    hid_t dataset(H5Rdereference2(fid, H5P_DEFAULT, H5R_DATASET_REGION, &ref));
+                    hid_t dataset_space(dataset >= 0 ? H5Dget_space(dataset) : -1);
+                    have_extent = dataset_space >= 0 && H5Sget_simple_extent_dims(dataset_space, &extent, nullptr) == 1;
+                    if(dataset_space >= 0)
+                        H5Sclose(dataset_space);
+                    if(dataset >= 0)
+                        H5Dclose(dataset);
+                    valid = have_extent;
+                }
+                if(valid && H5Sget_select_npoints(space) > 0)
+                {
+                    hsize_t start(0), end(0);
+                    valid = H5Sget_select_bounds(space, &start, &end) >= 0 && end < extent;
+                }
+                if(space >= 0)
+                    H5Sclose(space);
+                if(!valid)
+                {
+                    validity.invalidate(e, bit);
+                    ++ninvalid;
+                }
+            }
+        }
+        H5E_END_TRY;
+        if(ninvalid > 0)
+            dlp::Instrumentation::get().add_count(counter, ninvalid);
+    }
+} // namespace
+
+namespace dlp
+{
+    /**
+     * @brief Get the number of invalid events.
+     * @return The number of events with at least one invalid reference.
+    */
+    size_t EventValidity::invalid_count() const
+    {
+        return fInvalid.size() - std::count(fInvalid.begin(), fInvalid.end(), 0);
+    }
+
+    /**
+     * @brief Validate the region references of all events of a file.
+     * @param file The HDF5 file.
+     * @param events The events of the file.
+     * @return The validity of the events.
+    */
+    EventValidity validate_events(H5::H5File & file, const std::vector<types::Event> & events)
+    {
+        ScopedTimer timer("validate_events");
+        EventValidity validity(events.size());
+        validate_product<types::RunInfo>(file, events, kRunInfoBit, "invalid_ref<RunInfo>", validity);
+        validate_product<types::RecoInteraction>(file, events, kRecoInteractionBit, "invalid_ref<RecoInteraction>", validity);
+        validate_product<types::RecoParticle>(file, events, kRecoParticleBit, "invalid_ref<RecoParticle>", validity);
+        #ifdef MC_NOT_DATA
+        validate_product<types::TruthInteraction>(file, events, kTruthInteractionBit, "invalid_ref<TruthInteraction>", validity);
+        validate_product<types::TruthParticle>(file, events, kTruthParticleBit, "invalid_ref<TruthParticle>", validity);
+        #endif
+        return validity;
+    }
+} // namespace dlp
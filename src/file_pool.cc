@@ -0,0 +1,400 @@
+/**
+ * @file file_pool.cc
+ * @brief Implementation of the FilePool and EventIndex classes for managing a
+ * large number of input HDF5 files.
+ * @author mueller@fnal.gov
+*/
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <tuple>
+#include <stdexcept>
+#include "H5Cpp.h"
+#include "file_pool.h"
+#include "products.h"
+#include "product_reader.h"
+#include "event.h"
+#include "instrumentation.h"
+#include "logger.h"
+
+namespace
+{
+    /**
+     * @brief Insert the events of a file into the global event index.
+     * @param index The global event index (not sorted).
+     * @param pool The pool of input HDF5 files.
+     * @param f The index of the file in the pool.
+     * @param first The first event of the file to insert.
+     * @param reader The reader of the run info products.
+    */
+    void index_file(dlp::EventIndex & index, dlp::FilePool & pool, size_t f, size_t first, dlp::ProductReader & reader)
+    {
+        std::vector<dlp::types::Event> & events(pool.events(f));
+        const dlp::EventValidity & validity(pool.validity(f));
+        for(size_t e(first); e < events.size(); ++e)
+        {
+            /**
+             * @brief Skip the events without a valid run info reference.
+             * @details These events cannot be matched to a CAF record, so
+             * they are left out of the index.
+             */
+            if(validity.invalid_products(e) & dlp::kRunInfoBit)
+            {
+                dlp::Logger::get().log(dlp::LogLevel::kWarning, "invalid_event", "Skipping event ", e, " of ", pool.path(f), " with an invalid run info reference.");
+                continue;
+            }
+            try
+            {
+                /**
+                 * @brief Retrieve the run info for the event.
+                 * @details The run info is used to build the global
+                 * (Run, Subrun, Event No.) index of the events.
+                 */
+                std::vector<dlp::types::RunInfo> & run_info(reader.read<dlp::types::RunInfo>(pool.file(f), events[e]));
+                if(run_info.empty())
+                {
+                    dlp::Logger::get().log(dlp::LogLevel::kWarning, "invalid_event", "Skipping event ", e, " of ", pool.path(f), " with an empty run info region.");
+                    continue;
+                }
+                index.insert(run_info.back().run, run_info.back().subrun, run_info.back().event, dlp::EventLocation{static_cast<uint32_t>(f), static_cast<uint32_t>(e)});
+            }
+            catch(const H5::ReferenceException & error)
+            {
+                dlp::Logger::get().log(dlp::LogLevel::kWarning, "incomplete_event", "Found incomplete entry for event ", e, " of ", pool.path(f), ".");
+            }
+        }
+    }
+} // namespace
+
+namespace dlp
+{
+    /**
+     * @brief Insert an event into the index.
+     * @param run The run number of the event.
+     * @param subrun The subrun number of the event.
+     * @param event The event number of the event.
+     * @param location The location of the event in the input files.
+    */
+    void EventIndex::insert(int64_t run, int64_t subrun, int64_t event, EventLocation location)
+    {
+        fRecords.push_back(Record{static_cast<uint32_t>(run), static_cast<uint32_t>(subrun), static_cast<uint32_t>(event), location});
+    }
+
+    /**
+     * @brief Sort the index so that it may be searched.
+     * @details A stable sort is used so that the first insertion of a
+     * duplicated key is the one found by @ref find().
+    */
+    void EventIndex::build()
+    {
+        std::stable_sort(fRecords.begin(), fRecords.end(), [](const Record & a, const Record & b)
+        {
+            return std::tie(a.run, a.subrun, a.event) < std::tie(b.run, b.subrun, b.event);
+        });
+        fRecords.shrink_to_fit();
+    }
+
+    /**
+     * @brief Find the location of an event in the index.
+     * @param run The run number of the event.
+     * @param subrun The subrun number of the event.
+     * @param event The event number of the event.
+     * @return A pointer to the location of the event, or nullptr if the
+     * event is not present in the index.
+    */
+    const EventLocation * EventIndex::find(int64_t run, int64_t subrun, int64_t event) const
+    {
+        Record key{static_cast<uint32_t>(run), static_cast<uint32_t>(subrun), static_cast<uint32_t>(event), EventLocation{0, 0}};
+        auto it = std::lower_bound(fRecords.begin(), fRecords.end(), key, [](const Record & a, const Record & b)
+        {
+            return std::tie(a.run, a.subrun, a.event) < std::tie(b.run, b.subrun, b.event);
+        });
+        if(it == fRecords.end() || it->run != key.run || it->subrun != key.subrun || it->event != key.event)
+            return nullptr;
+        return &it->location;
+    }
+
+    /**
+     * @brief Check if the index holds an event which comes after the given
+     * one.
+     * @details The index is sorted, so only its last record is compared.
+     * @param run The run number of the event.
+     * @param subrun The subrun number of the event.
+     * @param event The event number of the event.
+     * @return True if an event with a larger (Run, Subrun, Event No.) is
+     * present in the index.
+    */
+    bool EventIndex::passed(int64_t run, int64_t subrun, int64_t event) const
+    {
+        if(fRecords.empty())
+            return false;
+        const Record & last(fRecords.back());
+        return std::make_tuple(static_cast<uint32_t>(run), static_cast<uint32_t>(subrun), static_cast<uint32_t>(event)) < std::tie(last.run, last.subrun, last.event);
+    }
+
+    /**
+     * @brief Get the number of events in the index.
+     * @return The number of events in the index.
+    */
+    size_t EventIndex::size() const
+    {
+        return fRecords.size();
+    }
+
+    /**
+     * @brief A constructor for the FilePool class.
+     * @param paths The list of input HDF5 files.
+     * @param max_open The maximum number of files to keep open at once.
+    */
+    FilePool::FilePool(const std::vector<std::string> & paths, size_t max_open, unsigned int access)
+        : fPaths(paths), fMaxOpen(std::max<size_t>(max_open, 1)), fAccess(access), fOpenCalls(0)
+    {}
+
+    /**
+     * @brief Get the handle to the requested file, opening it if needed.
+     * @param f The index of the file in the pool.
+     * @return The handle to the open H5 file.
+    */
+    H5::H5File & FilePool::file(size_t f)
+    {
+        return acquire(f).file;
+    }
+
+    /**
+     * @brief Get the list of events in the requested file, opening it if
+     * needed.
+     * @param f The index of the file in the pool.
+     * @return The list of dlp::types::Event objects in the file.
+    */
+    std::vector<types::Event> & FilePool::events(size_t f)
+    {
+        return acquire(f).events;
+    }
+
+    /**
+     * @brief Get the validity of the events in the requested file, opening it
+     * if it has not been validated yet.
+     * @param f The index of the file in the pool.
+     * @return The validity of the events in the file.
+    */
+    const EventValidity & FilePool::validity(size_t f)
+    {
+        auto it(fValidity.find(f));
+        if(it == fValidity.end())
+        {
+            acquire(f);
+            it = fValidity.find(f);
+        }
+        return it->second;
+    }
+
+    /**
+     * @brief Read the events appended to the requested file since its events
+     * were last read, opening it if needed.
+     * @details The new events are counted against the validated events,
+     * which are kept when the file is evicted, so that the events seen when
+     * an evicted file is reopened are also new.
+     * @param f The index of the file in the pool.
+     * @return The number of new events.
+    */
+    size_t FilePool::refresh(size_t f)
+    {
+        auto it(fValidity.find(f));
+        size_t known(it == fValidity.end() ? 0 : it->second.size());
+        Handle & handle(acquire(f));
+        fReader.clear();
+        get_new_events(handle.file, handle.events);
+        validate(f, handle);
+        return handle.events.size() - known;
+    }
+
+    /**
+     * @brief Get the path of the requested file.
+     * @param f The index of the file in the pool.
+     * @return The path of the file.
+    */
+    const std::string & FilePool::path(size_t f) const
+    {
+        return fPaths.at(f);
+    }
+
+    /**
+     * @brief Get the number of files managed by the pool.
+     * @return The number of files managed by the pool.
+    */
+    size_t FilePool::size() const
+    {
+        return fPaths.size();
+    }
+
+    /**
+     * @brief Get the number of files that are currently open.
+     * @return The number of files that are currently open.
+    */
+    size_t FilePool::open_count() const
+    {
+        return fOpen.size();
+    }
+
+    /**
+     * @brief Get the number of times any file has been opened.
+     * @return The number of times any file has been opened.
+    */
+    size_t FilePool::open_calls() const
+    {
+        return fOpenCalls;
+    }
+
+    /**
+     * @brief Get the reader of the products of the files of the pool.
+     * @return The reader of the pool.
+    */
+    ProductReader & FilePool::reader()
+    {
+        return fReader;
+    }
+
+    /**
+     * @brief Close all open files and release their event lists.
+    */
+    void FilePool::close_all()
+    {
+        fReader.clear();
+        for(auto & h : fOpen)
+            h.second->file.close();
+        fOpen.clear();
+        fRecent.clear();
+    }
+
+    /**
+     * @brief Retrieve the handle for the requested file, opening it and
+     * evicting the least-recently-used file if needed.
+     * @param f The index of the file in the pool.
+     * @return The handle for the file.
+    */
+    FilePool::Handle & FilePool::acquire(size_t f)
+    {
+        auto it(fOpen.find(f));
+        if(it != fOpen.end())
+        {
+            /**
+             * @brief The file is already open.
+             * @details Move the file to the front of the recently-used list
+             * so that it is the last candidate for eviction.
+             */
+            fRecent.splice(fRecent.begin(), fRecent, it->second->position);
+            return *it->second;
+        }
+
+        if(f >= fPaths.size())
+            throw std::out_of_range("FilePool: requested file index " + std::to_string(f) + " out of range.");
+
+        /**
+         * @brief Evict the least-recently-used file(s).
+         * @details Closing the file and destroying the handle releases both
+         * the file descriptor and the list of events belonging to the file.
+         * The reader is cleared first, as its open datasets would keep the
+         * file open.
+         */
+        if(fOpen.size() >= fMaxOpen)
+            fReader.clear();
+        while(fOpen.size() >= fMaxOpen)
+        {
+            size_t victim(fRecent.back());
+            fRecent.pop_back();
+            fOpen[victim]->file.close();
+            fOpen.erase(victim);
+        }
+
+        /**
+         * @brief Open the requested file and page in its list of events.
+         */
+        ScopedTimer timer("hdf5_open");
+        std::unique_ptr<Handle> handle(new Handle);
+        handle->file.openFile(fPaths[f], fAccess);
+        handle->events = get_all_events(handle->file);
+        validate(f, *handle);
+        fRecent.push_front(f);
+        handle->position = fRecent.begin();
+        ++fOpenCalls;
+        return *fOpen.emplace(f, std::move(handle)).first->second;
+    }
+
+    /**
+     * @brief Validate the events of a file which have not been validated yet.
+     * @details A file which is still being written may have more events when
+     * it is reopened (or refreshed) than when it was first validated, so only
+     * the events beyond those already validated are checked.
+     * @param f The index of the file in the pool.
+     * @param handle The handle for the file.
+    */
+    void FilePool::validate(size_t f, Handle & handle)
+    {
+        auto it(fValidity.find(f));
+        if(it == fValidity.end())
+        {
+            fValidity.emplace(f, validate_events(handle.file, handle.events));
+            return;
+        }
+        if(it->second.size() < handle.events.size())
+        {
+            std::vector<types::Event> events(handle.events.begin() + it->second.size(), handle.events.end());
+            it->second.append(validate_events(handle.file, events));
+        }
+    }
+
+    /**
+     * @brief Build the global event index over all files in the pool.
+     * @param pool The pool of input HDF5 files.
+     * @return The global event index.
+    */
+    EventIndex build_event_index(FilePool & pool)
+    {
+        ScopedTimer timer("index_build");
+        EventIndex index;
+        for(size_t f(0); f < pool.size(); ++f)
+            index_file(index, pool, f, 0, pool.reader());
+        index.build();
+        return index;
+    }
+
+    /**
+     * @brief Add the events appended to the files of the pool to the global
+     * event index.
+     * @param index The global event index (updated).
+     * @param pool The pool of input HDF5 files.
+     * @return The number of new events.
+    */
+    size_t refresh_event_index(EventIndex & index, FilePool & pool)
+    {
+        size_t added(0);
+        for(size_t f(0); f < pool.size(); ++f)
+        {
+            size_t n(pool.refresh(f));
+            if(n == 0)
+                continue;
+            index_file(index, pool, f, pool.events(f).size() - n, pool.reader());
+            added += n;
+        }
+        if(added > 0)
+            index.build();
+        return added;
+    }
+
+    /**
+     * @brief Read the maximum number of open files of a @ref FilePool from the
+     * command line options.
+     * @param options The command line options.
+     * @return The maximum number of files to keep open at once.
+     * @throw std::runtime_error if the value is less than 1.
+    */
+    size_t parse_max_open_files(const Options & options)
+    {
+        int64_t max_open(options.get_int("max-open-files", 16));
+        if(max_open < 1)
+            throw std::runtime_error("Maximum number of open files must be at least 1.");
+        return max_open;
+    }
+} // namespace dlp
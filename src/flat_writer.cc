@@ -0,0 +1,318 @@
+/**
+ * @file flat_writer.cc
+ * @brief Implementation of the FlatMLRecord class for writing the ML
+ * reconstruction branches of the StandardRecord in the flat CAF layout.
+ * @author mueller@fnal.gov
+*/
+#include <memory>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <functional>
+#include <type_traits>
+
+#include "flat_writer.h"
+#include "caf_fields.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+#include "sbnanaobj/StandardRecord/SRInteractionDLP.h"
+#include "sbnanaobj/StandardRecord/SRInteractionTruthDLP.h"
+#include "sbnanaobj/StandardRecord/SRParticleDLP.h"
+#include "sbnanaobj/StandardRecord/SRParticleTruthDLP.h"
+
+#include "TTree.h"
+
+namespace
+{
+    /**
+     * @brief Type trait identifying std::vector members.
+     */
+    template <class M> struct is_vector : std::false_type {};
+    template <class E> struct is_vector<std::vector<E>> : std::true_type {};
+
+    /**
+     * @brief Base class of a single flat branch.
+     */
+    class FlatColumn
+    {
+        public:
+        virtual ~FlatColumn() {}
+        virtual void Clear() = 0;
+    };
+
+    /**
+     * @brief A single flat branch holding the values of one field for all
+     * objects in the event.
+     * @tparam V The type of the values.
+     */
+    template <class V>
+    class FlatValues : public FlatColumn
+    {
+        public:
+        FlatValues(TTree * tree, const std::string & name)
+        {
+            tree->Branch(name.c_str(), &fData);
+        }
+        void Clear() override { fData.clear(); }
+        std::vector<V> fData;
+    };
+
+    /**
+     * @brief A table of the flat branches representing one CAF class.
+     * @details Each field is registered with a pointer to the corresponding
+     * member of the CAF class, and a branch (or set of branches) is created
+     * based on the type of the member. Filling the table with an object
+     * appends the values of all registered fields to their branches.
+     * @tparam T The CAF class represented by the table.
+     */
+    template <class T>
+    class FlatTable
+    {
+        public:
+        FlatTable(TTree * tree, const std::string & prefix)
+            : fTree(tree), fPrefix(prefix)
+        {}
+
+        /**
+         * @brief Register a field of the CAF class.
+         * @param name The name of the field.
+         * @param member The pointer to the member of the CAF class.
+         */
+        template <class M>
+        void Add(const std::string & name, M T::* member)
+        {
+            std::string branch(fPrefix + "." + name);
+            if constexpr(std::is_array_v<M>)
+            {
+                FlatValues<std::remove_extent_t<M>> * values(Column<std::remove_extent_t<M>>(branch));
+                fFillers.push_back([values, member](const T & obj)
+                {
+                    values->fData.insert(values->fData.end(), std::begin(obj.*member), std::end(obj.*member));
+                });
+            }
+            else if constexpr(is_vector<M>::value)
+            {
+                FlatValues<int> * length(Column<int>(branch + "..length"));
+                FlatValues<int> * idx(Column<int>(branch + "..idx"));
+                FlatValues<typename M::value_type> * values(Column<typename M::value_type>(branch));
+                fFillers.push_back([length, idx, values, member](const T & obj)
+                {
+                    length->fData.push_back((obj.*member).size());
+                    idx->fData.push_back(values->fData.size());
+                    values->fData.insert(values->fData.end(), (obj.*member).begin(), (obj.*member).end());
+                });
+            }
+            else
+            {
+                FlatValues<M> * values(Column<M>(branch));
+                fFillers.push_back([values, member](const T & obj)
+                {
+                    values->fData.push_back(obj.*member);
+                });
+            }
+        }
+
+        /**
+         * @brief Register a nested collection of another CAF class.
+         * @param name The name of the field holding the collection.
+         * @param member The pointer to the member of the CAF class.
+         * @param child The field table of the nested CAF class.
+         */
+        template <class C>
+        void AddNested(const std::string & name, std::vector<C> T::* member, FlatTable<C> & child)
+        {
+            std::string branch(fPrefix + "." + name);
+            FlatValues<int> * length(Column<int>(branch + "..length"));
+            FlatValues<int> * idx(Column<int>(branch + "..idx"));
+            fFillers.push_back([length, idx, member, &child](const T & obj)
+            {
+                length->fData.push_back((obj.*member).size());
+                idx->fData.push_back(child.Size());
+                for(const C & c : obj.*member)
+                    child.Fill(c);
+            });
+        }
+
+        /**
+         * @brief Append the fields of an object to the branches.
+         * @param obj The object to append.
+         */
+        void Fill(const T & obj)
+        {
+            for(auto & f : fFillers)
+                f(obj);
+            ++fSize;
+        }
+
+        /**
+         * @brief Clear the contents of all branches.
+         */
+        void Clear()
+        {
+            for(auto & c : fColumns)
+                c->Clear();
+            fSize = 0;
+        }
+
+        /**
+         * @brief Get the number of objects appended since the last Clear().
+         * @return The number of objects in the table.
+         */
+        int Size() const { return fSize; }
+
+        private:
+        template <class V>
+        FlatValues<V> * Column(const std::string & name)
+        {
+            FlatValues<V> * column(new FlatValues<V>(fTree, name));
+            fColumns.emplace_back(column);
+            return column;
+        }
+
+        TTree * fTree;
+        std::string fPrefix;
+        int fSize = 0;
+        std::vector<std::unique_ptr<FlatColumn>> fColumns;
+        std::vector<std::function<void(const T &)>> fFillers;
+    };
+
+    /**
+     * @brief Register the fields of the reconstructed interaction (caf::SRInteractionDLP) in its field table.
+     * @details The fields are those copied by @ref fill_interaction() (see
+     * caf_fields.h).
+     * @param table The field table to populate.
+     */
+    void describe(FlatTable<caf::SRInteractionDLP> & table)
+    {
+        #define DLP_FLAT_FIELD(name) table.Add(#name, &caf::SRInteractionDLP::name);
+        DLP_RECO_INTERACTION_FIELDS(DLP_FLAT_FIELD)
+        #undef DLP_FLAT_FIELD
+    }
+
+    /**
+     * @brief Register the fields of the reconstructed particle (caf::SRParticleDLP) in its field table.
+     * @details The fields are those copied by @ref fill_particle() (see
+     * caf_fields.h).
+     * @param table The field table to populate.
+     */
+    void describe(FlatTable<caf::SRParticleDLP> & table)
+    {
+        #define DLP_FLAT_FIELD(name) table.Add(#name, &caf::SRParticleDLP::name);
+        DLP_RECO_PARTICLE_FIELDS(DLP_FLAT_FIELD)
+        #undef DLP_FLAT_FIELD
+    }
+
+    /**
+     * @brief Register the fields of the truth interaction (caf::SRInteractionTruthDLP) in its field table.
+     * @details The fields are those copied by @ref fill_truth_interaction() (see
+     * caf_fields.h).
+     * @param table The field table to populate.
+     */
+    void describe(FlatTable<caf::SRInteractionTruthDLP> & table)
+    {
+        #define DLP_FLAT_FIELD(name) table.Add(#name, &caf::SRInteractionTruthDLP::name);
+        DLP_TRUE_INTERACTION_FIELDS(DLP_FLAT_FIELD)
+        #undef DLP_FLAT_FIELD
+    }
+
+    /**
+     * @brief Register the fields of the truth particle (caf::SRParticleTruthDLP) in its field table.
+     * @details The fields are those copied by @ref fill_truth_particle() (see
+     * caf_fields.h).
+     * @param table The field table to populate.
+     */
+    void describe(FlatTable<caf::SRParticleTruthDLP> & table)
+    {
+        #define DLP_FLAT_FIELD(name) table.Add(#name, &caf::SRParticleTruthDLP::name);
+        DLP_TRUE_PARTICLE_FIELDS(DLP_FLAT_FIELD)
+        #undef DLP_FLAT_FIELD
+    }
+} // namespace
+
+namespace dlp
+{
+    /**
+     * @brief The field tables of the ML reconstruction outputs.
+     */
+    struct FlatMLRecord::Tables
+    {
+        Tables(TTree * tree, const std::string & prefix)
+            : dlp(tree, prefix + ".dlp"),
+              dlp_particles(tree, prefix + ".dlp.particles"),
+              dlp_true(tree, prefix + ".dlp_true"),
+              dlp_true_particles(tree, prefix + ".dlp_true.particles")
+        {
+            /**
+             * @brief Like the top-level vectors of sbnanaobj's flat::Flat,
+             * the interactions of each entry are described by a "..length"
+             * and an "..idx" branch. The values of each entry start at the
+             * beginning of its branches, so the "..idx" is always zero.
+             */
+            std::string ndlp_name(prefix + ".dlp..length");
+            std::string idlp_name(prefix + ".dlp..idx");
+            std::string ndlp_true_name(prefix + ".dlp_true..length");
+            std::string idlp_true_name(prefix + ".dlp_true..idx");
+            tree->Branch(ndlp_name.c_str(), &ndlp, (ndlp_name + "/I").c_str());
+            tree->Branch(idlp_name.c_str(), &idlp, (idlp_name + "/I").c_str());
+            tree->Branch(ndlp_true_name.c_str(), &ndlp_true, (ndlp_true_name + "/I").c_str());
+            tree->Branch(idlp_true_name.c_str(), &idlp_true, (idlp_true_name + "/I").c_str());
+            describe(dlp);
+            describe(dlp_particles);
+            describe(dlp_true);
+            describe(dlp_true_particles);
+            dlp.AddNested("particles", &caf::SRInteractionDLP::particles, dlp_particles);
+            dlp_true.AddNested("particles", &caf::SRInteractionTruthDLP::particles, dlp_true_particles);
+        }
+
+        int ndlp = 0;
+        int idlp = 0;
+        int ndlp_true = 0;
+        int idlp_true = 0;
+        FlatTable<caf::SRInteractionDLP> dlp;
+        FlatTable<caf::SRParticleDLP> dlp_particles;
+        FlatTable<caf::SRInteractionTruthDLP> dlp_true;
+        FlatTable<caf::SRParticleTruthDLP> dlp_true_particles;
+    };
+
+    /**
+     * @brief A constructor for the FlatMLRecord class.
+     * @param tree The output TTree on which to create the branches.
+     * @param prefix The prefix of the branch names (e.g. "rec").
+    */
+    FlatMLRecord::FlatMLRecord(TTree * tree, const std::string & prefix)
+        : fTables(new Tables(tree, prefix))
+    {}
+
+    /**
+     * @brief A destructor for the FlatMLRecord class.
+    */
+    FlatMLRecord::~FlatMLRecord() = default;
+
+    /**
+     * @brief Clear the contents of all branches.
+    */
+    void FlatMLRecord::Clear()
+    {
+        fTables->ndlp = 0;
+        fTables->ndlp_true = 0;
+        fTables->dlp.Clear();
+        fTables->dlp_particles.Clear();
+        fTables->dlp_true.Clear();
+        fTables->dlp_true_particles.Clear();
+    }
+
+    /**
+     * @brief Fill the branches with the ML reconstruction outputs of the
+     * StandardRecord.
+     * @param rec The StandardRecord containing the ML outputs.
+    */
+    void FlatMLRecord::Fill(const caf::StandardRecord & rec)
+    {
+        fTables->ndlp = rec.dlp.size();
+        for(const caf::SRInteractionDLP & i : rec.dlp)
+            fTables->dlp.Fill(i);
+        fTables->ndlp_true = rec.dlp_true.size();
+        for(const caf::SRInteractionTruthDLP & i : rec.dlp_true)
+            fTables->dlp_true.Fill(i);
+    }
+} // namespace dlp
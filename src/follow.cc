@@ -0,0 +1,166 @@
+/**
+ * @file follow.cc
+ * @brief Implementation of the FollowConfig struct and the Follower class for
+ * converting the events of input HDF5 files while they are being written.
+ * @author mueller@fnal.gov
+*/
+#include <string>
+#include <chrono>
+#include <thread>
+#include <sstream>
+#include <stdexcept>
+#include <functional>
+#include "H5Cpp.h"
+#include "follow.h"
+#include "options.h"
+#include "logger.h"
+
+namespace dlp
+{
+    /**
+     * @brief Build the follow configuration from the command line options.
+     * @param options The command line options.
+     * @return The follow configuration.
+     * @throw std::runtime_error if an option has an invalid value.
+    */
+    FollowConfig parse_follow_config(const Options & options)
+    {
+        FollowConfig config;
+        config.active = options.has("follow");
+        if(!options.get("follow").empty())
+            config.idle = options.get_double("follow", config.idle);
+        config.poll = options.get_double("poll", config.poll);
+        config.autosave = options.get_double("autosave", config.autosave);
+
+        if(config.poll <= 0 || config.idle < 0 || config.autosave < 0)
+            throw std::runtime_error("The poll interval must be positive and the idle timeout and autosave interval must not be negative.");
+        return config;
+    }
+
+    /**
+     * @brief Describe the follow configuration.
+     * @param config The follow configuration.
+     * @return A short description of the follow configuration.
+    */
+    std::string describe_follow_config(const FollowConfig & config)
+    {
+        if(!config.active)
+            return "disabled";
+        std::ostringstream description;
+        description << "poll every " << config.poll << " s, stop after " << config.idle << " s without new events, save every " << config.autosave << " s";
+        return description.str();
+    }
+
+    /**
+     * @brief Get the access flags of the input HDF5 files.
+     * @param config The follow configuration.
+     * @return The flags passed to H5::H5File.
+    */
+    unsigned int input_access_flags(const FollowConfig & config)
+    {
+        return config.active ? H5F_ACC_RDONLY | H5F_ACC_SWMR_READ : H5F_ACC_RDONLY;
+    }
+
+    /**
+     * @brief A constructor for the Follower class.
+     * @param config The follow configuration.
+     * @param refresh The function refreshing the input and returning the
+     * number of new events.
+     * @param save The function saving the output.
+    */
+    Follower::Follower(const FollowConfig & config, std::function<size_t()> refresh, std::function<void()> save)
+        : fConfig(config), fRefresh(std::move(refresh)), fSave(std::move(save)), fLastGrowth(Clock::now()), fLastSave(Clock::now()), fUnsaved(false), fFinished(false)
+    {}
+
+    /**
+     * @brief Wait for new events.
+     * @return True if new events have appeared, false if the input has been
+     * idle for the idle timeout.
+    */
+    bool Follower::wait()
+    {
+        while(!fFinished)
+        {
+            save_if_due();
+            if(fRefresh() > 0)
+            {
+                fLastGrowth = Clock::now();
+                return true;
+            }
+            std::chrono::duration<double> idle(Clock::now() - fLastGrowth);
+            if(idle.count() >= fConfig.idle)
+            {
+                Logger::get().log(LogLevel::kInfo, "follow", "No new events for ", idle.count(), " s, stopping to follow the input.");
+                fFinished = true;
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::duration<double>(fConfig.poll));
+        }
+        return false;
+    }
+
+    /**
+     * @brief Wait for new events until a condition holds.
+     * @param condition The condition, evaluated after each refresh.
+     * @return True if the condition holds, false if the input has been idle
+     * for the idle timeout.
+    */
+    bool Follower::wait_for(const std::function<bool()> & condition)
+    {
+        if(condition())
+            return true;
+        while(true)
+        {
+            save_if_due();
+            if(fRefresh() > 0)
+            {
+                fLastGrowth = Clock::now();
+                fFinished = false;
+                if(condition())
+                    return true;
+                continue;
+            }
+            std::chrono::duration<double> idle(Clock::now() - fLastGrowth);
+            if(idle.count() >= fConfig.idle)
+            {
+                if(!fFinished)
+                    Logger::get().log(LogLevel::kInfo, "follow", "No new events for ", idle.count(), " s, polling the input once per missing event from now on.");
+                fFinished = true;
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::duration<double>(fConfig.poll));
+        }
+    }
+
+    /**
+     * @brief Record that an entry has been filled into the output.
+    */
+    void Follower::filled()
+    {
+        fUnsaved = true;
+        save_if_due();
+    }
+
+    /**
+     * @brief Check if the follower is finished.
+     * @return True if the input has been idle for the idle timeout.
+    */
+    bool Follower::finished() const
+    {
+        return fFinished;
+    }
+
+    /**
+     * @brief Save the unsaved entries of the output if the autosave interval
+     * has elapsed since the last save.
+    */
+    void Follower::save_if_due()
+    {
+        Clock::time_point now(Clock::now());
+        if(!fUnsaved || std::chrono::duration<double>(now - fLastSave).count() < fConfig.autosave)
+            return;
+        fSave();
+        fLastSave = now;
+        fUnsaved = false;
+    }
+} // namespace dlp
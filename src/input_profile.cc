@@ -0,0 +1,86 @@
+/**
+ * @file input_profile.cc
+ * @brief Implementation of the functions for configuring the reading of the
+ * input CAF file.
+ * @author mueller@fnal.gov
+*/
+#include <stdexcept>
+#include "input_profile.h"
+#include "options.h"
+#include "instrumentation.h"
+#include "logger.h"
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TTreeCacheUnzip.h"
+
+namespace dlp
+{
+    /**
+     * @brief Build the input profile from the command line options.
+     * @param options The command line options.
+     * @return The input profile.
+     * @throw std::runtime_error if an option has an invalid value.
+    */
+    InputProfile parse_input_profile(const Options & options)
+    {
+        InputProfile profile;
+        profile.cache_bytes = options.get_double("cache-mb", profile.cache_bytes / (1024.0 * 1024.0)) * 1024 * 1024;
+        profile.learn_entries = options.get_int("cache-learn-entries", profile.learn_entries);
+        profile.parallel_unzip = options.has("parallel-unzip");
+
+        if(profile.cache_bytes < 0 || profile.learn_entries < 0)
+            throw std::runtime_error("Cache size and learning entries must not be negative.");
+        return profile;
+    }
+
+    /**
+     * @brief Configure the reading of the "recTree" TTree of an input CAF
+     * file.
+     * @param tree The "recTree" TTree of the input CAF file.
+     * @param profile The input profile.
+    */
+    void apply_input_profile(TTree * tree, const InputProfile & profile)
+    {
+        /**
+         * @brief Disable the ML reconstruction branches.
+         * @details The "found" counter suppresses the warning for input CAF
+         * files which do not have the ML reconstruction branches.
+         */
+        UInt_t found(0);
+        tree->SetBranchStatus("rec.dlp*", false, &found);
+
+        /**
+         * @brief Configure the TTreeCache.
+         * @details The parallel unzipping mode must be chosen before the
+         * cache is created. Unless a learning phase is requested, all
+         * enabled branches are added to the cache up front so that the first
+         * entries are prefetched as well.
+         */
+        if(profile.parallel_unzip)
+            TTreeCacheUnzip::SetParallelUnzip(TTreeCacheUnzip::kEnable);
+        tree->SetCacheSize(profile.cache_bytes);
+        if(profile.cache_bytes == 0)
+            return;
+        if(profile.learn_entries > 0)
+            tree->SetCacheLearnEntries(profile.learn_entries);
+        else
+        {
+            tree->AddBranchToCache("*", true);
+            tree->DropBranchFromCache("rec.dlp*", true);
+            tree->StopCacheLearningPhase();
+        }
+    }
+
+    /**
+     * @brief Print the number of read calls and bytes read from an input
+     * file.
+     * @param file The input file.
+    */
+    void print_read_statistics(TFile & file)
+    {
+        Instrumentation::get().add_count("caf_bytes_read", file.GetBytesRead());
+        Instrumentation::get().add_count("caf_read_calls", file.GetReadCalls());
+        Logger::get().log(LogLevel::kInfo, "read_statistics", "Read ", file.GetBytesRead(), " bytes in ", file.GetReadCalls(), " read calls from ", file.GetName(), ".");
+    }
+} // namespace dlp
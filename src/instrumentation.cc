@@ -0,0 +1,160 @@
+/**
+ * @file instrumentation.cc
+ * @brief Implementation of the Instrumentation class for measuring the time
+ * spent in each stage of a job.
+ * @author mueller@fnal.gov
+*/
+#include <map>
+#include <mutex>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include "instrumentation.h"
+#include "logger.h"
+#include "options.h"
+
+namespace dlp
+{
+    /**
+     * @brief Get the instrumentation of the job.
+     * @return The (single) instance of the Instrumentation class.
+    */
+    Instrumentation & Instrumentation::get()
+    {
+        static Instrumentation instrumentation;
+        return instrumentation;
+    }
+
+    /**
+     * @brief Configure the instrumentation from the command line options.
+     * @param options The command line options.
+    */
+    void Instrumentation::configure(const Options & options)
+    {
+        fReportPath = options.get("report");
+        fProgressInterval = options.get_double("progress", 0);
+        if(fReportPath.empty() && fProgressInterval <= 0)
+            return;
+        fStart = Clock::now();
+        fLastProgress = fStart;
+        if(!fRegistered)
+            std::atexit([](){ Instrumentation::get().write_report(); });
+        fRegistered = true;
+        fEnabled = true;
+    }
+
+    /**
+     * @brief Add the time spent in one call of a stage.
+     * @param stage The name of the stage.
+     * @param seconds The time spent in the stage.
+    */
+    void Instrumentation::add_time(const char * stage, double seconds)
+    {
+        if(!fEnabled)
+            return;
+        std::lock_guard<std::mutex> lock(fMutex);
+        Stage & s(fStages[stage]);
+        ++s.calls;
+        s.seconds += seconds;
+    }
+
+    /**
+     * @brief Add to the value of a counter.
+     * @param counter The name of the counter.
+     * @param value The value to add to the counter.
+    */
+    void Instrumentation::add_count(const char * counter, uint64_t value)
+    {
+        if(!fEnabled)
+            return;
+        std::lock_guard<std::mutex> lock(fMutex);
+        fCounters[counter] += value;
+    }
+
+    /**
+     * @brief Count one processed event.
+    */
+    void Instrumentation::count_event()
+    {
+        if(!fEnabled)
+            return;
+        std::lock_guard<std::mutex> lock(fMutex);
+        ++fEvents;
+        if(fProgressInterval <= 0)
+            return;
+        Clock::time_point now(Clock::now());
+        if(std::chrono::duration<double>(now - fLastProgress).count() < fProgressInterval)
+            return;
+        fLastProgress = now;
+        double seconds(elapsed());
+        Logger::get().log(LogLevel::kInfo, "progress", "Processed ", fEvents, " events in ", seconds, " s (", fEvents / seconds, " events/s).");
+    }
+
+    /**
+     * @brief Get the time elapsed since the instrumentation was enabled.
+     * @return The elapsed time in seconds.
+    */
+    double Instrumentation::elapsed() const
+    {
+        return std::chrono::duration<double>(Clock::now() - fStart).count();
+    }
+
+    /**
+     * @brief Write the JSON report (if configured).
+     * @details The report is written only once, even if this is called
+     * explicitly before the program exits.
+    */
+    void Instrumentation::write_report()
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        if(!fEnabled || fWritten || fReportPath.empty())
+            return;
+        fWritten = true;
+        std::ofstream report(fReportPath);
+        if(!report.is_open())
+        {
+            std::cerr << "Unable to open report file: " << fReportPath << std::endl;
+            return;
+        }
+        double seconds(elapsed());
+        report << "{\n"
+               << "  \"wall_seconds\": " << seconds << ",\n"
+               << "  \"events\": " << fEvents << ",\n"
+               << "  \"events_per_second\": " << (seconds > 0 ? fEvents / seconds : 0) << ",\n"
+               << "  \"stages\": {";
+        const char * separator("\n");
+        for(const auto & [name, stage] : fStages)
+        {
+            report << separator << "    \"" << name << "\": {\"calls\": " << stage.calls << ", \"seconds\": " << stage.seconds << "}";
+            separator = ",\n";
+        }
+        report << "\n  },\n  \"counters\": {";
+        separator = "\n";
+        for(const auto & [name, value] : fCounters)
+        {
+            report << separator << "    \"" << name << "\": " << value;
+            separator = ",\n";
+        }
+        report << "\n  }\n}\n";
+        std::cout << "Wrote job report to " << fReportPath << "." << std::endl;
+    }
+
+    /**
+     * @brief Reset the instrumentation to its unconfigured (disabled) state.
+     * @details The exit handler stays registered if it was, so it is not
+     * registered twice by the next call of configure().
+    */
+    void Instrumentation::reset()
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fEnabled = false;
+        fWritten = false;
+        fReportPath.clear();
+        fProgressInterval = 0;
+        fEvents = 0;
+        fStages.clear();
+        fCounters.clear();
+    }
+} // namespace dlp
@@ -0,0 +1,176 @@
+/**
+ * @file logger.cc
+ * @brief Implementation of the Logger class for buffered, leveled and
+ * rate-limited logging.
+ * @author mueller@fnal.gov
+*/
+#include <map>
+#include <mutex>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include "H5Cpp.h"
+#include "logger.h"
+#include "instrumentation.h"
+#include "options.h"
+
+namespace
+{
+    /**
+     * @brief The size of the buffer above which it is flushed to the sink.
+     */
+    const size_t buffer_limit(1 << 16);
+
+    /**
+     * @brief The names of the verbosity levels, in order.
+     */
+    const char * level_names[] = {"error", "warning", "info", "debug"};
+} // namespace
+
+namespace dlp
+{
+    /**
+     * @brief Get the logger of the job.
+     * @return The (single) instance of the Logger class.
+    */
+    Logger & Logger::get()
+    {
+        static Logger logger;
+        return logger;
+    }
+
+    /**
+     * @brief A destructor for the Logger class.
+    */
+    Logger::~Logger()
+    {
+        flush();
+        if(fSink != stdout)
+            std::fclose(fSink);
+    }
+
+    /**
+     * @brief Configure the logger from the command line options.
+     * @param options The command line options.
+     * @throw std::runtime_error if an option has an invalid value.
+    */
+    void Logger::configure(const Options & options)
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        if(options.has("verbosity"))
+        {
+            std::string verbosity(options.get("verbosity"));
+            bool found(false);
+            for(int level(0); level < 4; ++level)
+            {
+                if(verbosity == level_names[level])
+                {
+                    fVerbosity = static_cast<LogLevel>(level);
+                    found = true;
+                }
+            }
+            if(!found)
+                throw std::runtime_error("Unknown verbosity: " + verbosity);
+        }
+        int64_t limit(options.get_int("log-limit", fLimit));
+        if(limit < 0)
+            throw std::runtime_error("Log limit must not be negative.");
+        fLimit = limit;
+        if(options.has("log-file"))
+        {
+            fSink = std::fopen(options.get("log-file").c_str(), "w");
+            if(!fSink)
+                throw std::runtime_error("Unable to open log file: " + options.get("log-file"));
+        }
+        H5::Exception::dontPrint();
+        if(!fConfigured)
+            std::atexit([](){ Logger::get().summarize(); });
+        fConfigured = true;
+    }
+
+    /**
+     * @brief Count a warning and check whether it should be printed.
+     * @param type The type of the warning.
+     * @return True if the warning is within the limit of its type.
+    */
+    bool Logger::count(const char * type)
+    {
+        Instrumentation::get().add_count(type);
+        std::lock_guard<std::mutex> lock(fMutex);
+        uint64_t n(++fCounts[type]);
+        if(n == fLimit + 1 && enabled(LogLevel::kWarning))
+            fBuffer += std::string("[warning] Further '") + type + "' messages are suppressed.\n";
+        return n <= fLimit;
+    }
+
+    /**
+     * @brief Write a formatted message to the buffer.
+     * @param level The level of the message.
+     * @param message The message.
+    */
+    void Logger::write(LogLevel level, const std::string & message)
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        if(level != LogLevel::kInfo)
+            fBuffer += std::string("[") + level_names[static_cast<int>(level)] + "] ";
+        fBuffer += message;
+        fBuffer += '\n';
+        if(level == LogLevel::kError || level == LogLevel::kInfo || fBuffer.size() > buffer_limit)
+        {
+            std::fwrite(fBuffer.data(), 1, fBuffer.size(), fSink);
+            std::fflush(fSink);
+            fBuffer.clear();
+        }
+    }
+
+    /**
+     * @brief Flush the buffered messages to the sink.
+    */
+    void Logger::flush()
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        std::fwrite(fBuffer.data(), 1, fBuffer.size(), fSink);
+        std::fflush(fSink);
+        fBuffer.clear();
+    }
+
+    /**
+     * @brief Print the number of warnings of each type and flush.
+    */
+    void Logger::summarize()
+    {
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            if(fSummarized)
+                return;
+            fSummarized = true;
+            for(const auto & [type, n] : fCounts)
+            {
+                fBuffer += "Logged " + std::to_string(n) + " '" + type + "' warning(s)";
+                if(n > fLimit)
+                    fBuffer += " (" + std::to_string(n - fLimit) + " suppressed)";
+                fBuffer += ".\n";
+            }
+        }
+        flush();
+    }
+
+    /**
+     * @brief Reset the logger to its unconfigured state.
+     * @details The exit handler stays registered if it was, so it is not
+     * registered twice by the next call of configure().
+    */
+    void Logger::reset()
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fBuffer.clear();
+        fCounts.clear();
+        fVerbosity = LogLevel::kInfo;
+        fLimit = 10;
+        fSummarized = false;
+        if(fSink != stdout)
+            std::fclose(fSink);
+        fSink = stdout;
+    }
+} // namespace dlp
@@ -0,0 +1,391 @@
+/**
+ * @file matching.cc
+ * @brief Implementation of the Matcher class for recomputing the matches
+ * between the reconstructed and the true interactions from their voxel index
+ * arrays.
+ * @author mueller@fnal.gov
+*/
+#include <span>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "matching.h"
+#include "options.h"
+#include "buffer.h"
+
+namespace
+{
+    /**
+     * @brief Count the common values of two blocks of four values.
+     * @param a The first block.
+     * @param b The second block.
+     * @return The number of equal pairs.
+     */
+    inline size_t block_matches(const int64_t * a, const int64_t * b)
+    {
+        size_t count(0);
+        for(size_t i(0); i < 4; ++i)
+        {
+            for(size_t j(0); j < 4; ++j)
+                count += a[i] == b[j];
+        }
+        return count;
+    }
+
+    #if defined(__x86_64__)
+    /**
+     * @brief Count the common values of two blocks of four values with AVX2
+     * instructions.
+     * @details This is only called if the CPU supports AVX2 (see
+     * intersection_size), so the build does not need to enable AVX2.
+     * @param a The first block.
+     * @param b The second block.
+     * @return The number of equal pairs.
+     */
+    __attribute__((target("avx2"))) inline size_t block_matches_avx2(const int64_t * a, const int64_t * b)
+    {
+        __m256i va(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a)));
+        __m256i vb(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(b)));
+        __m256i eq(_mm256_cmpeq_epi64(va, vb));
+        vb = _mm256_permute4x64_epi64(vb, 0x39);
+        eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(va, vb));
+        vb = _mm256_permute4x64_epi64(vb, 0x39);
+        eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(va, vb));
+        vb = _mm256_permute4x64_epi64(vb, 0x39);
+        eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(va, vb));
+        return __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(eq)));
+    }
+    #endif
+
+    /**
+     * @brief Count the common values of two sorted sets with a given block
+     * comparison.
+     * @details The function is inlined into each caller, so that the block
+     * comparison is inlined into the loop of the AVX2 variant as well.
+     * @param a The first set (sorted, no duplicates).
+     * @param b The second set (sorted, no duplicates).
+     * @param block The comparison of two blocks of four values.
+     * @return The number of values in both sets.
+     */
+    template <class Block>
+    __attribute__((always_inline)) inline size_t intersect(std::span<const int64_t> a, std::span<const int64_t> b, Block block)
+    {
+        if(a.empty() || b.empty() || a.back() < b.front() || b.back() < a.front())
+            return 0;
+
+        /**
+         * @brief Intersect the full blocks of four values.
+         * @details Since each value appears at most once in each set, every
+         * equal pair is found in exactly one pair of blocks.
+         */
+        size_t count(0), i(0), j(0);
+        while(i + 4 <= a.size() && j + 4 <= b.size())
+        {
+            count += block(&a[i], &b[j]);
+            int64_t last_a(a[i + 3]), last_b(b[j + 3]);
+            i += last_a <= last_b ? 4 : 0;
+            j += last_b <= last_a ? 4 : 0;
+        }
+
+        /**
+         * @brief Intersect the remaining values.
+         */
+        while(i < a.size() && j < b.size())
+        {
+            count += a[i] == b[j];
+            int64_t x(a[i]), y(b[j]);
+            i += x <= y;
+            j += y <= x;
+        }
+        return count;
+    }
+
+    /**
+     * @brief Count the common values of two sorted sets with the portable
+     * block comparison.
+     * @param a The first set (sorted, no duplicates).
+     * @param b The second set (sorted, no duplicates).
+     * @return The number of values in both sets.
+     */
+    size_t intersection_size_scalar(std::span<const int64_t> a, std::span<const int64_t> b)
+    {
+        return intersect(a, b, block_matches);
+    }
+
+    #if defined(__x86_64__)
+    /**
+     * @brief Count the common values of two sorted sets with the AVX2 block
+     * comparison.
+     * @param a The first set (sorted, no duplicates).
+     * @param b The second set (sorted, no duplicates).
+     * @return The number of values in both sets.
+     */
+    __attribute__((target("avx2"))) size_t intersection_size_avx2(std::span<const int64_t> a, std::span<const int64_t> b)
+    {
+        return intersect(a, b, [](const int64_t * x, const int64_t * y) __attribute__((target("avx2"))) { return block_matches_avx2(x, y); });
+    }
+    #endif
+
+    /**
+     * @brief Check (once) whether the CPU supports AVX2.
+     * @return True if the AVX2 variant of the intersection is used.
+     */
+    bool use_avx2()
+    {
+        #if defined(__x86_64__)
+        static const bool supported(__builtin_cpu_supports("avx2"));
+        return supported;
+        #else
+        return false;
+        #endif
+    }
+
+    /**
+     * @brief Sort a voxel set and remove its duplicates.
+     * @param voxels The voxel set.
+     */
+    void normalize(std::vector<int64_t> & voxels)
+    {
+        std::sort(voxels.begin(), voxels.end());
+        voxels.erase(std::unique(voxels.begin(), voxels.end()), voxels.end());
+    }
+
+    /**
+     * @brief Append the match list of one interaction.
+     * @param candidates The overlap of the interaction with each candidate.
+     * @param stride The distance between consecutive candidates in
+     * @p candidates.
+     * @param count The number of candidates.
+     * @param ids The "id" of each candidate.
+     * @param threshold The minimum overlap of a match.
+     * @param order The scratch buffer for sorting the matches.
+     * @param nmatch The number of matches of each interaction (appended).
+     * @param match_ids The matched IDs (appended).
+     * @param match_overlaps The matched overlaps (appended).
+     */
+    template <class Ids>
+    void append_matches(const float * candidates, size_t stride, size_t count, const Ids & ids, double threshold, std::vector<size_t> & order,
+                        std::vector<int32_t> & nmatch, std::vector<int64_t> & match_ids, std::vector<float> & match_overlaps)
+    {
+        order.clear();
+        for(size_t c(0); c < count; ++c)
+        {
+            float overlap(candidates[c * stride]);
+            if(overlap > 0 && overlap >= threshold)
+                order.push_back(c);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) { return candidates[x * stride] > candidates[y * stride]; });
+        nmatch.push_back(order.size());
+        for(size_t c : order)
+        {
+            match_ids.push_back(ids[c].id);
+            match_overlaps.push_back(candidates[c * stride]);
+        }
+    }
+} // namespace
+
+namespace dlp
+{
+    /**
+     * @brief Build the match configuration from the command line options.
+     * @param options The command line options.
+     * @return The match configuration.
+     * @throw std::runtime_error if the option has an invalid value.
+    */
+    MatchConfig parse_match_config(const Options & options)
+    {
+        MatchConfig config;
+        if(!options.has("rematch"))
+            return config;
+        #ifndef MC_NOT_DATA
+        throw std::runtime_error("--rematch requires the simulation version of the executable.");
+        #endif
+        std::string value(options.get("rematch"));
+        std::string metric(value.substr(0, value.find(':')));
+        if(metric == "iou")
+            config.metric = MatchMetric::kIoU;
+        else if(metric == "efficiency")
+            config.metric = MatchMetric::kEfficiency;
+        else if(metric == "purity")
+            config.metric = MatchMetric::kPurity;
+        else
+            throw std::runtime_error("Unknown match metric: " + metric);
+        if(metric.size() < value.size())
+        {
+            std::string threshold(value.substr(metric.size() + 1));
+            size_t end(0);
+            try
+            {
+                config.threshold = std::stod(threshold, &end);
+            }
+            catch(const std::exception & e)
+            {
+                end = 0;
+            }
+            if(end == 0 || end != threshold.size() || config.threshold < 0 || config.threshold > 1)
+                throw std::runtime_error("Invalid value for --rematch: " + value);
+        }
+        config.enabled = true;
+        return config;
+    }
+
+    /**
+     * @brief Get a human-readable description of the match configuration.
+     * @param config The match configuration.
+     * @return The description of the match configuration.
+    */
+    std::string describe_match_config(const MatchConfig & config)
+    {
+        if(!config.active())
+            return "disabled";
+        std::ostringstream description;
+        switch(config.metric)
+        {
+            case MatchMetric::kIoU: description << "IoU"; break;
+            case MatchMetric::kEfficiency: description << "efficiency"; break;
+            case MatchMetric::kPurity: description << "purity"; break;
+        }
+        if(config.threshold > 0)
+            description << " >= " << config.threshold;
+        else
+            description << " > 0";
+        return description.str();
+    }
+
+    /**
+     * @brief Count the common values of two sorted sets.
+     * @param a The first set (sorted, no duplicates).
+     * @param b The second set (sorted, no duplicates).
+     * @return The number of values in both sets.
+    */
+    size_t intersection_size(std::span<const int64_t> a, std::span<const int64_t> b)
+    {
+        #if defined(__x86_64__)
+        if(use_avx2())
+            return intersection_size_avx2(a, b);
+        #endif
+        return intersection_size_scalar(a, b);
+    }
+
+    /**
+     * @brief Get the name of the block comparison used by intersection_size.
+     * @return "avx2" or "scalar".
+    */
+    const char * intersection_kernel()
+    {
+        return use_avx2() ? "avx2" : "scalar";
+    }
+
+    /**
+     * @brief Remove all matches.
+    */
+    void MatchRecord::clear()
+    {
+        dlp_nmatch.clear();
+        dlp_match_ids.clear();
+        dlp_match_overlaps.clear();
+        dlp_true_nmatch.clear();
+        dlp_true_match_ids.clear();
+        dlp_true_match_overlaps.clear();
+    }
+
+    /**
+     * @brief A constructor for the Matcher class.
+     * @param config The match configuration.
+    */
+    Matcher::Matcher(const MatchConfig & config)
+        : fConfig(config) { }
+
+    /**
+     * @brief Remove the matches of the previous event.
+    */
+    void Matcher::clear()
+    {
+        fRecord.clear();
+    }
+
+    /**
+     * @brief Recompute the matches of an event.
+     * @param reco_particles The reconstructed particles of the event.
+     * @param reco_interactions The reconstructed interactions of the event.
+     * @param true_interactions The true interactions of the event.
+    */
+    void Matcher::match(const std::vector<types::RecoParticle> & reco_particles, const std::vector<types::RecoInteraction> & reco_interactions, const std::vector<types::TruthInteraction> & true_interactions)
+    {
+        fRecord.clear();
+        size_t nreco(reco_interactions.size()), ntrue(true_interactions.size());
+
+        /**
+         * @brief Build the (sorted) voxel set of each interaction.
+         * @details The particles of an event are stored in the order of their
+         * "id", so the particles of a reconstructed interaction are looked up
+         * by position. The arrays are read through their handles, as the
+         * BufferView members of the products may not have been synchronized.
+         */
+        if(fRecoVoxels.size() < nreco)
+            fRecoVoxels.resize(nreco);
+        for(size_t r(0); r < nreco; ++r)
+        {
+            std::vector<int64_t> & voxels(fRecoVoxels[r]);
+            voxels.clear();
+            BufferView<int64_t> particle_ids(&reco_interactions[r].particle_ids_handle);
+            for(int64_t id : particle_ids)
+            {
+                if(id < 0 || size_t(id) >= reco_particles.size())
+                    continue;
+                BufferView<int64_t> index(&reco_particles[id].index_handle);
+                voxels.insert(voxels.end(), index.begin(), index.end());
+            }
+            normalize(voxels);
+        }
+        if(fTrueVoxels.size() < ntrue)
+            fTrueVoxels.resize(ntrue);
+        for(size_t t(0); t < ntrue; ++t)
+        {
+            std::vector<int64_t> & voxels(fTrueVoxels[t]);
+            BufferView<int64_t> index(&true_interactions[t].index_adapt_handle);
+            voxels.assign(index.begin(), index.end());
+            normalize(voxels);
+        }
+
+        /**
+         * @brief Compute the overlap of each pair of interactions.
+         */
+        fOverlaps.assign(nreco * ntrue, 0);
+        for(size_t r(0); r < nreco; ++r)
+        {
+            const std::vector<int64_t> & reco(fRecoVoxels[r]);
+            for(size_t t(0); t < ntrue; ++t)
+            {
+                const std::vector<int64_t> & truth(fTrueVoxels[t]);
+                size_t common(intersection_size(reco, truth));
+                if(common == 0)
+                    continue;
+                double denominator(0);
+                switch(fConfig.metric)
+                {
+                    case MatchMetric::kIoU: denominator = reco.size() + truth.size() - common; break;
+                    case MatchMetric::kEfficiency: denominator = truth.size(); break;
+                    case MatchMetric::kPurity: denominator = reco.size(); break;
+                }
+                fOverlaps[r * ntrue + t] = common / denominator;
+            }
+        }
+
+        /**
+         * @brief Build the match lists in both directions.
+         */
+        for(size_t r(0); r < nreco; ++r)
+            append_matches(fOverlaps.data() + r * ntrue, 1, ntrue, true_interactions, fConfig.threshold, fOrder,
+                           fRecord.dlp_nmatch, fRecord.dlp_match_ids, fRecord.dlp_match_overlaps);
+        for(size_t t(0); t < ntrue; ++t)
+            append_matches(fOverlaps.data() + t, ntrue, nreco, reco_interactions, fConfig.threshold, fOrder,
+                           fRecord.dlp_true_nmatch, fRecord.dlp_true_match_ids, fRecord.dlp_true_match_overlaps);
+    }
+} // namespace dlp
@@ -0,0 +1,358 @@
+/**
+ * @file merge.cc
+ * @brief Implementation of the functions used for merging the SPINE
+ * reconstruction outputs into existing CAF files.
+ * @details This file contains the implementation of the functions that are
+ * shared between the various merging executables. These handle the main loop
+ * over the records of an input CAF file and the copying of the auxiliary
+ * objects (histograms, key/value trees, etc.) into the output CAF file.
+ * @author mueller@fnal.gov
+ */
+#include <set>
+#include <string>
+#include <vector>
+#include <utility>
+#include "H5Cpp.h"
+
+#include "merge.h"
+#include "file_pool.h"
+#include "record_writer.h"
+#include "record_fillers.h"
+#include "instrumentation.h"
+#include "logger.h"
+#include "event_selection.h"
+#include "skim.h"
+#include "truth_pruning.h"
+#include "voxel_index.h"
+#include "matching.h"
+#include "follow.h"
+#include "product_reader.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+#include "TFile.h"
+#include "TDirectory.h"
+#include "TTree.h"
+#include "TBranch.h"
+#include "TH1D.h"
+
+namespace dlp
+{
+    /**
+     * @brief Copy the key/val products from an event in the CAF file to the
+     * output CAF file.
+     * @param output The output TDirectory to copy to.
+     * @param input The input TDirectory to copy from.
+     * @param name The name of the TTree to copy.
+     */
+    void copy_keyval_tree(TDirectory * output, TDirectory * input, const char * name)
+    {
+        output->cd();
+        if(input)
+        {
+            TDirectory * dir = output->mkdir(input->GetName());
+            dir->cd();
+            TTree * tree = static_cast<TTree *>(input->Get(name));
+            TTree * new_tree = tree->CloneTree(-1, "fast");
+            new_tree->Write();
+            delete new_tree;
+            output->cd();
+        }
+    }
+
+    /**
+     * @brief Constructor of the @ref KeyValueTable class.
+     * @param directory The name of the directory (e.g. "env").
+     * @param tree The name of the key/value TTree (e.g. "envtree").
+     */
+    KeyValueTable::KeyValueTable(const std::string & directory, const std::string & tree)
+        : fDirectory(directory), fTree(tree), fInputs(0), fVerbatim(false) { }
+
+    /**
+     * @brief Add the key/value pairs of an input CAF file.
+     * @param output The output CAF file (for a verbatim copy).
+     * @param input The input CAF file.
+     */
+    void KeyValueTable::add(TFile & output, TFile & input)
+    {
+        TDirectory * directory(input.GetDirectory(fDirectory.c_str()));
+        TTree * tree(directory ? directory->Get<TTree>(fTree.c_str()) : nullptr);
+        if(!tree)
+            return;
+        ++fInputs;
+        if(!tree->GetBranch("key") || !tree->GetBranch("value"))
+        {
+            if(fInputs == 1)
+            {
+                Logger::get().log(LogLevel::kWarning, "keyval_layout", "Unexpected layout of ", fDirectory, "/", fTree, " in ", input.GetName(), ". Copying it from the first input only.");
+                copy_keyval_tree(&output, directory, fTree.c_str());
+                fVerbatim = true;
+            }
+            else
+                Logger::get().log(LogLevel::kWarning, "keyval_dropped", "Dropped ", fDirectory, "/", fTree, " of ", input.GetName(), " (unexpected layout).");
+            return;
+        }
+        if(fVerbatim)
+        {
+            Logger::get().log(LogLevel::kWarning, "keyval_dropped", "Dropped ", fDirectory, "/", fTree, " of ", input.GetName(), " (the first input was copied verbatim).");
+            return;
+        }
+
+        std::string * key(nullptr);
+        std::string * value(nullptr);
+        tree->SetBranchAddress("key", &key);
+        tree->SetBranchAddress("value", &value);
+        size_t added(0);
+        for(Long64_t n(0); n < tree->GetEntries(); ++n)
+        {
+            tree->GetEntry(n);
+            if(fSeen.insert(std::make_pair(*key, *value)).second)
+            {
+                fPairs.emplace_back(*key, *value);
+                ++added;
+            }
+        }
+        tree->ResetBranchAddresses();
+        if(fInputs > 1 && added > 0)
+            Logger::get().log(LogLevel::kWarning, "keyval_mismatch", "Found ", added, " new key/value pair(s) in ", fDirectory, "/", fTree, " of ", input.GetName(), ".");
+    }
+
+    /**
+     * @brief Write the combined key/value TTree to the output CAF file.
+     * @param output The output CAF file.
+     */
+    void KeyValueTable::Write(TFile & output)
+    {
+        if(fVerbatim || fInputs == 0)
+            return;
+        TDirectory * directory(output.mkdir(fDirectory.c_str()));
+        directory->cd();
+        std::string key, value;
+        TTree tree(fTree.c_str(), fTree.c_str());
+        tree.Branch("key", &key);
+        tree.Branch("value", &value);
+        for(const auto & [k, v] : fPairs)
+        {
+            key = k;
+            value = v;
+            tree.Fill();
+        }
+        tree.Write();
+        output.cd();
+    }
+
+    /**
+     * @brief Loop over the records of an input CAF file and merge the matching
+     * SPINE reconstruction outputs into them.
+     * @param input_tree The "recTree" of the input CAF file.
+     * @param writer The writer of the output CAF file.
+     * @param rec The StandardRecord attached to the input and output.
+     * @param index The global (Run, Subrun, Event No.) index of HDF5 events.
+     * @param pool The pool of input HDF5 files.
+     * @param keep_unmatched Whether to write records with no matching event.
+     * @param selection The selection of the records to process.
+     * @param skim The skim applied to the merged records.
+     * @param pruning The policy for pruning the true particles.
+     * @param voxels The sidecar file for the voxel index arrays (optional).
+     * @param matcher The matcher recomputing the matches (optional).
+     * @param follower The follower of the input HDF5 files (optional).
+     * @param genie_offset The offset added to the GENIE indices.
+     * @return The number of matched and unmatched records.
+     */
+    MergeResult merge_records(TTree * input_tree, RecordWriter & writer, caf::StandardRecord * rec, const EventIndex & index, FilePool & pool, bool keep_unmatched, const EventSelection & selection, const Skim & skim, const TruthPruning & pruning, VoxelIndexWriter * voxels, Matcher * matcher, Follower * follower, Long64_t genie_offset)
+    {
+        /**
+         * @brief Restrict the loop to the selected range of entries.
+         * @details The read cache is restricted to the same range, so that
+         * no basket outside of it is read.
+         */
+        MergeResult result;
+        ProductReader & reader(pool.reader());
+        auto [first, last] = selection.range(input_tree->GetEntries());
+        if(selection.active())
+            input_tree->SetCacheEntryRange(first, last);
+        for(Long64_t n(first); n < Long64_t(last); ++n)
+        {
+            if(!selection.sampled(n))
+                continue;
+            {
+                ScopedTimer timer("caf_read");
+                input_tree->GetEntry(n);
+            }
+            Instrumentation::get().count_event();
+            ++result.selected;
+            result.selected_pot += rec->hdr.pot;
+            /**
+             * @brief Reset the ML reconstruction output branches.
+             * @details It is safest to reset the ML reconstruction output
+             * branches to prevent old products from remaining in the case
+             * where something unexpected happens.
+             */
+            rec->dlp.clear();
+            rec->ndlp = 0;
+            rec->dlp_true.clear();
+            rec->ndlp_true = 0;
+            if(matcher)
+                matcher->clear();
+
+            /**
+             * @brief Find the matching event.
+             * @details When following the input HDF5 files, the index is
+             * refreshed by the follower until the event has been appended, a
+             * later event has been appended (so the event is missing from
+             * the input) or the input has been idle for the idle timeout. A missing event does not end the follow mode:
+             * once the input is idle, each missing event polls the input
+             * once, and the follower resumes waiting if the input grows. The
+             * pool clears its reader before it reopens a file.
+             */
+            const EventLocation * location(index.find(rec->hdr.run, rec->hdr.subrun, rec->hdr.evt));
+            if(!location && follower)
+            {
+                follower->wait_for([&]()
+                {
+                    location = index.find(rec->hdr.run, rec->hdr.subrun, rec->hdr.evt);
+                    return location || index.passed(rec->hdr.run, rec->hdr.subrun, rec->hdr.evt);
+                });
+            }
+            if(location)
+            {
+                ++result.matched;
+                Logger::get().log(LogLevel::kDebug, "matched_event", "Matched Event ", rec->hdr.evt, " in (Run, Subrun) = (", rec->hdr.run, ", ", rec->hdr.subrun, ") of CAF input to HDF5 event.",
+                                  " Found in file ", location->file, " at index ", location->entry, " (", pool.path(location->file), ").");
+                /**
+                 * @brief Package the event data products.
+                 * @details The @ref package_event() function is responsible
+                 * for copying the data products from the event into the proper
+                 * CAF class within the StandardRecord. The file is opened by
+                 * the pool if it is not already open. Events with invalid
+                 * references (see @ref validate_events) are written without
+                 * ML reconstruction outputs, without reading any product.
+                 * @throw H5::ReferenceException if the event is incomplete.
+                 */
+                if(!pool.validity(location->file).valid(location->entry))
+                {
+                    Logger::get().log(LogLevel::kWarning, "invalid_event", "Skipping ML products of event (", rec->hdr.run, ", ", rec->hdr.subrun, ", ", rec->hdr.evt, ") with invalid references.");
+                }
+                else
+                {
+                    try
+                    {
+                        ScopedTimer timer("package_event");
+                        package_event(rec, pool.file(location->file), pool.events(location->file)[location->entry], 0, pruning, voxels, matcher, &reader);
+                    }
+                    catch(const H5::ReferenceException & e)
+                    {
+                        Logger::get().log(LogLevel::kWarning, "incomplete_event", "Found incomplete entry for event (", rec->hdr.run, ", ", rec->hdr.subrun, ", ", rec->hdr.evt, ").");
+                    }
+                }
+            }
+            else
+            {
+                ++result.unmatched;
+                Logger::get().log(LogLevel::kWarning, "unmatched_event", "No matching event found for (Run, Subrun, Event No.) = (", rec->hdr.run, ", ", rec->hdr.subrun, ", ", rec->hdr.evt, ").");
+                if(!keep_unmatched)
+                    continue;
+            }
+
+            /**
+             * @brief Apply the skim to the merged record.
+             * @details The record has already been counted in the exposure
+             * above, so dropping it does not change the POT accounting.
+             */
+            if(skim.active() && !skim.pass(rec))
+            {
+                ++result.skimmed;
+                Instrumentation::get().add_count("skimmed_event");
+                continue;
+            }
+            if(genie_offset != 0)
+                shift_genie_index(rec, genie_offset);
+            writer.Fill();
+            if(follower)
+                follower->filled();
+        }
+        /**
+         * @brief Count the exposure of all records of the input CAF file.
+         * @details Only the selection holding the first record does this
+         * (see @ref set_selected_exposure). The "hdr.pot" branch alone is
+         * read for the skipped records, unless the record is not split.
+         */
+        if(selection.active() && first == 0 && first < last && selection.sampled(0))
+        {
+            ScopedTimer timer("caf_read_pot");
+            result.holds_first = true;
+            result.records = input_tree->GetEntries();
+            result.record_pot = result.selected_pot;
+            TBranch * pot_branch(input_tree->GetBranch("rec.hdr.pot"));
+            for(Long64_t n(0); n < input_tree->GetEntries(); ++n)
+            {
+                if(n >= Long64_t(first) && n < Long64_t(last) && selection.sampled(n))
+                    continue;
+                if(pot_branch)
+                    pot_branch->GetEntry(n);
+                else
+                    input_tree->GetEntry(n);
+                result.record_pot += rec->hdr.pot;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief Shift the GENIE indices of the true neutrino interactions of a
+     * record.
+     * @param rec The record.
+     * @param offset The offset added to the GENIE indices.
+     */
+    void shift_genie_index(caf::StandardRecord * rec, Long64_t offset)
+    {
+        for(auto & nu : rec->mc.nu)
+        {
+            if(nu.genieIdx >= 0)
+                nu.genieIdx += offset;
+        }
+    }
+
+    /**
+     * @brief Set the exposure histograms to the exposure of the selected
+     * records.
+     * @param total_pot The "TotalPOT" histogram.
+     * @param total_events The "TotalEvents" histogram.
+     * @param result The result of merging the selected records.
+     */
+    void set_selected_exposure(TH1 * total_pot, TH1 * total_events, const MergeResult & result)
+    {
+        double pot(result.selected_pot);
+        double events(result.selected);
+        if(result.holds_first)
+        {
+            pot += total_pot->Integral(0, total_pot->GetNbinsX() + 1) - result.record_pot;
+            events += total_events->Integral(0, total_events->GetNbinsX() + 1) - result.records;
+        }
+        total_pot->Reset();
+        total_pot->SetBinContent(1, pot);
+        total_events->Reset();
+        total_events->SetBinContent(1, events);
+    }
+
+    /**
+     * @brief Write the exposure histograms of the selected records.
+     * @param output The output CAF file.
+     * @param input The input CAF file.
+     * @param result The result of merging the selected records.
+     */
+    void write_selected_exposure(TFile & output, TFile & input, const MergeResult & result)
+    {
+        TH1 * total_pot(input.Get<TH1>("TotalPOT"));
+        TH1 * total_events(input.Get<TH1>("TotalEvents"));
+        if(!total_pot || !total_events)
+        {
+            Logger::get().log(LogLevel::kError, "exposure", "No TotalPOT or TotalEvents histogram in ", input.GetName(), ". The output CAF file has no exposure.");
+            return;
+        }
+        set_selected_exposure(total_pot, total_events, result);
+        output.cd();
+        total_pot->Write();
+        total_events->Write();
+    }
+} // namespace dlp
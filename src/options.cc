@@ -0,0 +1,118 @@
+/**
+ * @file options.cc
+ * @brief Implementation of the Options class for parsing command line
+ * arguments.
+ * @author mueller@fnal.gov
+*/
+#include <map>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "options.h"
+
+namespace dlp
+{
+    /**
+     * @brief A constructor for the Options class.
+     * @param argc The number of command line arguments.
+     * @param argv The command line arguments (including the program name).
+    */
+    Options::Options(int argc, char const * argv[])
+    {
+        for(int i(1); i < argc; ++i)
+        {
+            std::string arg(argv[i]);
+            if(arg.size() > 2 && arg.compare(0, 2, "--") == 0)
+            {
+                size_t eq(arg.find('='));
+                if(eq == std::string::npos)
+                    fFlags[arg.substr(2)] = "";
+                else
+                    fFlags[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+            }
+            else
+                fPositional.push_back(arg);
+        }
+    }
+
+    /**
+     * @brief Get the list of positional arguments.
+     * @return The list of positional arguments.
+    */
+    const std::vector<std::string> & Options::positional() const
+    {
+        return fPositional;
+    }
+
+    /**
+     * @brief Check if a flag was passed on the command line.
+     * @param key The name of the flag (without the leading "--").
+     * @return True if the flag was passed, false otherwise.
+    */
+    bool Options::has(const std::string & key) const
+    {
+        return fFlags.find(key) != fFlags.end();
+    }
+
+    /**
+     * @brief Get the value of a flag as a string.
+     * @param key The name of the flag (without the leading "--").
+     * @param def The default value to return if the flag is not present.
+     * @return The value of the flag, or the default value.
+    */
+    std::string Options::get(const std::string & key, const std::string & def) const
+    {
+        auto it(fFlags.find(key));
+        return it != fFlags.end() ? it->second : def;
+    }
+
+    /**
+     * @brief Get the value of a flag as an integer.
+     * @param key The name of the flag (without the leading "--").
+     * @param def The default value to return if the flag is not present.
+     * @return The value of the flag, or the default value.
+    */
+    int64_t Options::get_int(const std::string & key, int64_t def) const
+    {
+        auto it(fFlags.find(key));
+        if(it == fFlags.end())
+            return def;
+        try
+        {
+            size_t pos(0);
+            int64_t value(std::stoll(it->second, &pos));
+            if(pos != it->second.size())
+                throw std::invalid_argument(it->second);
+            return value;
+        }
+        catch(const std::logic_error & e)
+        {
+            throw std::runtime_error("Invalid integer value for option --" + key + ": '" + it->second + "'");
+        }
+    }
+
+    /**
+     * @brief Get the value of a flag as a floating point number.
+     * @param key The name of the flag (without the leading "--").
+     * @param def The default value to return if the flag is not present.
+     * @return The value of the flag, or the default value.
+    */
+    double Options::get_double(const std::string & key, double def) const
+    {
+        auto it(fFlags.find(key));
+        if(it == fFlags.end())
+            return def;
+        try
+        {
+            size_t pos(0);
+            double value(std::stod(it->second, &pos));
+            if(pos != it->second.size())
+                throw std::invalid_argument(it->second);
+            return value;
+        }
+        catch(const std::logic_error & e)
+        {
+            throw std::runtime_error("Invalid numeric value for option --" + key + ": '" + it->second + "'");
+        }
+    }
+} // namespace dlp
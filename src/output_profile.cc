@@ -0,0 +1,165 @@
+/**
+ * @file output_profile.cc
+ * @brief Implementation of the functions for configuring the layout and
+ * compression of the output CAF file.
+ * @author mueller@fnal.gov
+*/
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include "output_profile.h"
+#include "options.h"
+
+#include "TFile.h"
+#include "TROOT.h"
+#include "Compression.h"
+
+namespace
+{
+    /**
+     * @brief A compression algorithm known to ROOT.
+     */
+    struct Algorithm
+    {
+        const char * name;                      //!< The name of the algorithm on the command line.
+        int code;                               //!< The ROOT code of the algorithm.
+        int level;                              //!< The level recommended by ROOT for the algorithm.
+    };
+
+    const Algorithm algorithms[] = {
+        {"zlib", ROOT::RCompressionSetting::EAlgorithm::kZLIB, 1},
+        {"lzma", ROOT::RCompressionSetting::EAlgorithm::kLZMA, 7},
+        {"lz4", ROOT::RCompressionSetting::EAlgorithm::kLZ4, 4},
+        {"zstd", ROOT::RCompressionSetting::EAlgorithm::kZSTD, 5}
+    };
+
+    /**
+     * @brief Parse a compression setting of the form "<algorithm>[:<level>]".
+     * @param value The value of the "--compression" option.
+     * @return The ROOT compression setting (100 * algorithm + level).
+     * @throw std::runtime_error if the value is invalid.
+     */
+    int parse_compression(const std::string & value)
+    {
+        if(value == "none" || value == "0")
+            return 0;
+        size_t colon(value.find(':'));
+        std::string name(value.substr(0, colon));
+        for(const Algorithm & algorithm : algorithms)
+        {
+            if(name != algorithm.name)
+                continue;
+            int level(algorithm.level);
+            if(colon != std::string::npos)
+            {
+                try
+                {
+                    size_t end(0);
+                    level = std::stoi(value.substr(colon + 1), &end);
+                    if(end != value.size() - colon - 1)
+                        throw std::invalid_argument(value);
+                }
+                catch(const std::exception & e)
+                {
+                    throw std::runtime_error("Invalid compression level: " + value);
+                }
+                if(level < 1 || level > 9)
+                    throw std::runtime_error("Compression level must be between 1 and 9: " + value);
+            }
+            return 100 * algorithm.code + level;
+        }
+        throw std::runtime_error("Unknown compression algorithm: " + value);
+    }
+} // namespace
+
+namespace dlp
+{
+    /**
+     * @brief Build the output profile from the command line options.
+     * @param options The command line options.
+     * @return The output profile.
+     * @throw std::runtime_error if an option has an invalid value.
+    */
+    OutputProfile parse_output_profile(const Options & options)
+    {
+        OutputProfile profile;
+        profile.flat = options.has("flat");
+        if(options.has("compression"))
+            profile.compression = parse_compression(options.get("compression"));
+        profile.split_level = options.get_int("split-level", profile.split_level);
+        profile.basket_size = options.get_int("basket-size", profile.basket_size);
+        profile.autoflush_bytes = options.get_double("autoflush-mb", 0) * 1024 * 1024;
+        profile.adaptive_entries = options.get_int("adaptive-baskets", 0);
+        if(options.has("threads"))
+        {
+            profile.threads = options.get("threads").empty() ? 0 : options.get_int("threads", 0);
+            if(profile.threads == 0)
+                profile.threads = -1;
+        }
+        if(options.has("precision"))
+            profile.precision = parse_precision_policy(options.get("precision"));
+        profile.cross_references = options.has("xref");
+
+        if(profile.split_level < 0 || profile.split_level > 99)
+            throw std::runtime_error("Split level must be between 0 and 99.");
+        if(profile.basket_size < 1024)
+            throw std::runtime_error("Basket size must be at least 1024 bytes.");
+        if(profile.threads < -1)
+            throw std::runtime_error("Number of threads must not be negative.");
+        if(profile.autoflush_bytes < 0 || profile.adaptive_entries < 0)
+            throw std::runtime_error("Auto-flush interval and adaptive basket entries must not be negative.");
+        return profile;
+    }
+
+    /**
+     * @brief Apply the file-level settings of the output profile.
+     * @param file The output CAF file.
+     * @param profile The output profile.
+    */
+    void apply_output_profile(TFile & file, const OutputProfile & profile)
+    {
+        if(profile.compression)
+            file.SetCompressionSettings(*profile.compression);
+    }
+
+    /**
+     * @brief Enable ROOT implicit multithreading if requested by the output
+     * profile.
+     * @param profile The output profile.
+    */
+    void enable_implicit_mt(const OutputProfile & profile)
+    {
+        if(profile.threads != 0 && !ROOT::IsImplicitMTEnabled())
+            ROOT::EnableImplicitMT(profile.threads > 0 ? profile.threads : 0);
+    }
+
+    /**
+     * @brief Get a human-readable description of the output profile.
+     * @param profile The output profile.
+     * @return The description of the output profile.
+    */
+    std::string describe_output_profile(const OutputProfile & profile)
+    {
+        std::ostringstream description;
+        description << (profile.flat ? "flat" : "standard") << " layout"
+                    << ", compression " << (profile.compression ? std::to_string(*profile.compression) : "default")
+                    << ", split level " << profile.split_level
+                    << ", basket size " << profile.basket_size << " B"
+                    << ", auto-flush ";
+        if(profile.autoflush_bytes > 0)
+            description << profile.autoflush_bytes << " B";
+        else
+            description << "default";
+        if(profile.adaptive_entries > 0)
+            description << ", adaptive baskets after " << profile.adaptive_entries << " entries";
+        if(profile.threads > 0)
+            description << ", " << profile.threads << " threads";
+        else if(profile.threads < 0)
+            description << ", all available threads";
+        if(profile.precision.active())
+            description << ", reduced precision (" << describe_precision_policy(profile.precision) << ")";
+        if(profile.cross_references)
+            description << ", cross-references";
+        return description.str();
+    }
+} // namespace dlp
@@ -0,0 +1,106 @@
+/**
+ * @file particle_hierarchy.cc
+ * @brief Implementation of the ParticleHierarchy class for flattening the
+ * parent/child hierarchy of the true particles of an event.
+ * @author mueller@fnal.gov
+*/
+#include <vector>
+#include <cstdint>
+#include "particle_hierarchy.h"
+
+namespace dlp
+{
+    /**
+     * @brief Build the hierarchy of an event.
+     * @param parent The position of the parent of each particle (-1 if none).
+     * @param is_primary Whether each particle is a primary particle.
+     * @param is_visible Whether each particle is visible.
+    */
+    void ParticleHierarchy::Build(const std::vector<int32_t> & parent, const std::vector<uint8_t> & is_primary, const std::vector<uint8_t> & is_visible)
+    {
+        int32_t n(parent.size());
+        auto has_parent([&](int32_t k) { return parent[k] >= 0 && parent[k] < n && parent[k] != k; });
+
+        /**
+         * @brief Group the children of each particle (in increasing order of
+         * position) with a counting sort.
+         */
+        fChildBegin.assign(n + 1, 0);
+        for(int32_t k(0); k < n; ++k)
+        {
+            if(has_parent(k))
+                ++fChildBegin[parent[k] + 1];
+        }
+        for(int32_t k(0); k < n; ++k)
+            fChildBegin[k + 1] += fChildBegin[k];
+        fChildren.resize(fChildBegin[n]);
+        fStack.assign(fChildBegin.begin(), fChildBegin.end() - 1);
+        for(int32_t k(0); k < n; ++k)
+        {
+            if(has_parent(k))
+                fChildren[fStack[parent[k]]++] = k;
+        }
+
+        /**
+         * @brief Walk the forest depth-first.
+         * @details The roots are the particles without a parent. Particles
+         * which are not reached from a root (cycles) are used as additional
+         * roots afterwards. The stack holds (particle, next child) pairs.
+         */
+        order.clear();
+        rank.assign(n, -1);
+        subtree_end.assign(n, 0);
+        depth.assign(n, 0);
+        primary.assign(n, -1);
+        visible.assign(n, -1);
+        auto visit([&](int32_t k, int32_t up)
+        {
+            rank[k] = order.size();
+            order.push_back(k);
+            depth[k] = up < 0 ? 0 : depth[up] + 1;
+            primary[k] = is_primary[k] ? k : (up < 0 ? -1 : primary[up]);
+            visible[k] = up < 0 ? -1 : (is_visible[up] ? up : visible[up]);
+            fStack.push_back(k);
+            fStack.push_back(fChildBegin[k]);
+        });
+        fStack.clear();
+        for(int pass(0); pass < 2; ++pass)
+        {
+            for(int32_t root(0); root < n; ++root)
+            {
+                if(rank[root] >= 0 || (pass == 0 && has_parent(root)))
+                    continue;
+                visit(root, -1);
+                while(!fStack.empty())
+                {
+                    int32_t k(fStack[fStack.size() - 2]);
+                    int32_t & next(fStack.back());
+                    if(next < fChildBegin[k + 1])
+                    {
+                        int32_t child(fChildren[next++]);
+                        if(rank[child] < 0)
+                            visit(child, k);
+                    }
+                    else
+                    {
+                        subtree_end[k] = order.size();
+                        fStack.resize(fStack.size() - 2);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Remove all particles.
+    */
+    void ParticleHierarchy::clear()
+    {
+        order.clear();
+        rank.clear();
+        subtree_end.clear();
+        depth.clear();
+        primary.clear();
+        visible.clear();
+    }
+} // namespace dlp
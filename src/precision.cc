@@ -0,0 +1,574 @@
+/**
+ * @file precision.cc
+ * @brief Implementation of the PrecisionPolicy struct and the classes for
+ * storing the floating point ML fields with a reduced precision and for
+ * validating the result.
+ * @author mueller@fnal.gov
+*/
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+#include "precision.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+#include "sbnanaobj/StandardRecord/SRInteractionDLP.h"
+#include "sbnanaobj/StandardRecord/SRInteractionTruthDLP.h"
+#include "sbnanaobj/StandardRecord/SRParticleDLP.h"
+#include "sbnanaobj/StandardRecord/SRParticleTruthDLP.h"
+
+namespace
+{
+    /**
+     * @brief Type trait identifying std::vector members.
+     */
+    template <class M> struct is_vector : std::false_type {};
+    template <class E> struct is_vector<std::vector<E>> : std::true_type {};
+
+    /**
+     * @brief Round the bits of a floating point value to a given number of
+     * mantissa bits (ties to even).
+     * @tparam F The floating point type.
+     * @tparam U The unsigned integer type of the same size.
+     * @param value The value.
+     * @param bits The number of explicit mantissa bits to keep.
+     * @return The rounded value.
+     */
+    template <class F, class U>
+    F round_mantissa(F value, int bits)
+    {
+        constexpr int mantissa(std::numeric_limits<F>::digits - 1);
+        if(bits >= mantissa || !std::isfinite(value))
+            return value;
+        U u;
+        std::memcpy(&u, &value, sizeof(F));
+        int drop(mantissa - std::max(bits, 0));
+        u += ((U(1) << (drop - 1)) - 1) + ((u >> drop) & 1);
+        u &= ~((U(1) << drop) - 1);
+        F result;
+        std::memcpy(&result, &u, sizeof(F));
+        return std::isfinite(result) ? result : value;
+    }
+
+    /**
+     * @brief Add a pair of values to the deviation of a field.
+     * @param deviation The deviation of the field.
+     * @param reference The reference value.
+     * @param reduced The value to validate.
+     */
+    void accumulate(dlp::FieldDeviation & deviation, double reference, double reduced)
+    {
+        ++deviation.values;
+        if(!std::isfinite(reference) || !std::isfinite(reduced))
+        {
+            bool same(reference == reduced || (std::isnan(reference) && std::isnan(reduced)));
+            if(!same)
+                deviation.max_abs = std::numeric_limits<double>::infinity();
+            return;
+        }
+        double difference(std::abs(reference - reduced));
+        deviation.max_abs = std::max(deviation.max_abs, difference);
+        if(reference != 0)
+            deviation.max_rel = std::max(deviation.max_rel, difference / std::abs(reference));
+    }
+
+    /**
+     * @brief A table of the floating point fields of one CAF class.
+     * @details Each field is registered with a pointer to the corresponding
+     * member of the CAF class. Scalar, fixed-size array and std::vector
+     * members are supported.
+     * @tparam T The CAF class represented by the table.
+     */
+    template <class T>
+    class PrecisionTable
+    {
+        public:
+        /**
+         * @brief A registered field.
+         */
+        struct Field
+        {
+            std::string name;
+            std::function<void(T &, int)> reduce;
+            std::function<void(const T &, const T &, dlp::FieldDeviation &)> compare;
+        };
+
+        /**
+         * @brief Register a field of the CAF class.
+         * @param name The name of the field.
+         * @param member The pointer to the member of the CAF class.
+         */
+        template <class M>
+        void Add(const std::string & name, M T::* member)
+        {
+            Field field;
+            field.name = name;
+            if constexpr(std::is_array_v<M> || is_vector<M>::value)
+            {
+                field.reduce = [member](T & obj, int bits)
+                {
+                    for(auto & value : obj.*member)
+                        value = dlp::reduce_precision(value, bits);
+                };
+                field.compare = [member](const T & reference, const T & reduced, dlp::FieldDeviation & deviation)
+                {
+                    if(std::size(reference.*member) != std::size(reduced.*member))
+                    {
+                        ++deviation.mismatched;
+                        return;
+                    }
+                    for(size_t i(0); i < std::size(reference.*member); ++i)
+                        accumulate(deviation, (reference.*member)[i], (reduced.*member)[i]);
+                };
+            }
+            else
+            {
+                static_assert(std::is_floating_point_v<M>, "Only floating point fields can be registered.");
+                field.reduce = [member](T & obj, int bits) { obj.*member = dlp::reduce_precision(obj.*member, bits); };
+                field.compare = [member](const T & reference, const T & reduced, dlp::FieldDeviation & deviation)
+                {
+                    accumulate(deviation, reference.*member, reduced.*member);
+                };
+            }
+            fFields.push_back(field);
+        }
+
+        /**
+         * @brief Get the registered fields.
+         * @return The registered fields.
+         */
+        const std::vector<Field> & fields() const { return fFields; }
+
+        /**
+         * @brief Check if a field is registered.
+         * @param name The name of the field.
+         * @return True if the field is registered.
+         */
+        bool has(const std::string & name) const
+        {
+            return std::any_of(fFields.begin(), fFields.end(), [&name](const Field & field) { return field.name == name; });
+        }
+
+        private:
+        std::vector<Field> fFields;
+    };
+
+    /**
+     * @brief The field tables of the four ML CAF classes.
+     * @details The registered fields are the floating point fields copied by
+     * the record fillers which hold measured or reconstructed quantities.
+     */
+    struct Tables
+    {
+        PrecisionTable<caf::SRInteractionDLP> reco_interaction;
+        PrecisionTable<caf::SRParticleDLP> reco_particle;
+        PrecisionTable<caf::SRInteractionTruthDLP> truth_interaction;
+        PrecisionTable<caf::SRParticleTruthDLP> truth_particle;
+
+        Tables()
+        {
+            using I = caf::SRInteractionDLP;
+            reco_interaction.Add("depositions_sum", &I::depositions_sum);
+            reco_interaction.Add("flash_hypo_pe", &I::flash_hypo_pe);
+            reco_interaction.Add("flash_scores", &I::flash_scores);
+            reco_interaction.Add("flash_times", &I::flash_times);
+            reco_interaction.Add("flash_total_pe", &I::flash_total_pe);
+            reco_interaction.Add("match_overlaps", &I::match_overlaps);
+            reco_interaction.Add("vertex", &I::vertex);
+
+            using P = caf::SRParticleDLP;
+            reco_particle.Add("axial_spread", &P::axial_spread);
+            reco_particle.Add("calo_ke", &P::calo_ke);
+            reco_particle.Add("chi2_per_pid", &P::chi2_per_pid);
+            reco_particle.Add("csda_ke", &P::csda_ke);
+            reco_particle.Add("csda_ke_per_pid", &P::csda_ke_per_pid);
+            reco_particle.Add("depositions_sum", &P::depositions_sum);
+            reco_particle.Add("directional_spread", &P::directional_spread);
+            reco_particle.Add("end_dir", &P::end_dir);
+            reco_particle.Add("end_point", &P::end_point);
+            reco_particle.Add("ke", &P::ke);
+            reco_particle.Add("length", &P::length);
+            reco_particle.Add("match_overlaps", &P::match_overlaps);
+            reco_particle.Add("mcs_ke", &P::mcs_ke);
+            reco_particle.Add("mcs_ke_per_pid", &P::mcs_ke_per_pid);
+            reco_particle.Add("momentum", &P::momentum);
+            reco_particle.Add("p", &P::p);
+            reco_particle.Add("pid_scores", &P::pid_scores);
+            reco_particle.Add("primary_scores", &P::primary_scores);
+            reco_particle.Add("start_dedx", &P::start_dedx);
+            reco_particle.Add("start_dir", &P::start_dir);
+            reco_particle.Add("start_point", &P::start_point);
+            reco_particle.Add("start_straightness", &P::start_straightness);
+            reco_particle.Add("vertex_distance", &P::vertex_distance);
+
+            using TI = caf::SRInteractionTruthDLP;
+            truth_interaction.Add("depositions_sum", &TI::depositions_sum);
+            truth_interaction.Add("energy_init", &TI::energy_init);
+            truth_interaction.Add("energy_transfer", &TI::energy_transfer);
+            truth_interaction.Add("flash_hypo_pe", &TI::flash_hypo_pe);
+            truth_interaction.Add("flash_scores", &TI::flash_scores);
+            truth_interaction.Add("flash_times", &TI::flash_times);
+            truth_interaction.Add("flash_total_pe", &TI::flash_total_pe);
+            truth_interaction.Add("match_overlaps", &TI::match_overlaps);
+            truth_interaction.Add("momentum", &TI::momentum);
+            truth_interaction.Add("position", &TI::position);
+            truth_interaction.Add("reco_vertex", &TI::reco_vertex);
+            truth_interaction.Add("vertex", &TI::vertex);
+
+            using TP = caf::SRParticleTruthDLP;
+            truth_particle.Add("ancestor_position", &TP::ancestor_position);
+            truth_particle.Add("calo_ke", &TP::calo_ke);
+            truth_particle.Add("csda_ke", &TP::csda_ke);
+            truth_particle.Add("csda_ke_per_pid", &TP::csda_ke_per_pid);
+            truth_particle.Add("depositions_sum", &TP::depositions_sum);
+            truth_particle.Add("distance_travel", &TP::distance_travel);
+            truth_particle.Add("end_dir", &TP::end_dir);
+            truth_particle.Add("end_momentum", &TP::end_momentum);
+            truth_particle.Add("end_p", &TP::end_p);
+            truth_particle.Add("end_point", &TP::end_point);
+            truth_particle.Add("end_position", &TP::end_position);
+            truth_particle.Add("energy_deposit", &TP::energy_deposit);
+            truth_particle.Add("energy_init", &TP::energy_init);
+            truth_particle.Add("first_step", &TP::first_step);
+            truth_particle.Add("ke", &TP::ke);
+            truth_particle.Add("last_step", &TP::last_step);
+            truth_particle.Add("length", &TP::length);
+            truth_particle.Add("match_overlaps", &TP::match_overlaps);
+            truth_particle.Add("mcs_ke", &TP::mcs_ke);
+            truth_particle.Add("mcs_ke_per_pid", &TP::mcs_ke_per_pid);
+            truth_particle.Add("momentum", &TP::momentum);
+            truth_particle.Add("p", &TP::p);
+            truth_particle.Add("parent_position", &TP::parent_position);
+            truth_particle.Add("position", &TP::position);
+            truth_particle.Add("reco_end_dir", &TP::reco_end_dir);
+            truth_particle.Add("reco_ke", &TP::reco_ke);
+            truth_particle.Add("reco_length", &TP::reco_length);
+            truth_particle.Add("reco_momentum", &TP::reco_momentum);
+            truth_particle.Add("reco_start_dir", &TP::reco_start_dir);
+            truth_particle.Add("start_dir", &TP::start_dir);
+            truth_particle.Add("start_point", &TP::start_point);
+        }
+
+        /**
+         * @brief Check if any table has a field with the given name.
+         * @param name The name of the field.
+         * @return True if the field is registered in any table.
+         */
+        bool has(const std::string & name) const
+        {
+            return reco_interaction.has(name) || reco_particle.has(name) || truth_interaction.has(name) || truth_particle.has(name);
+        }
+    };
+
+    /**
+     * @brief Get the (shared) field tables.
+     * @return The field tables.
+     */
+    const Tables & tables()
+    {
+        static const Tables instance;
+        return instance;
+    }
+
+    /**
+     * @brief The default "reduced" policy.
+     * @details Positions are kept to ~1e-5 relative precision (below 0.01 cm
+     * over the size of the detectors), directions, momenta and per-PID
+     * arrays to ~1e-4 and scores and overlaps to ~1e-3.
+     */
+    const std::pair<const char *, int> reduced_policy[] = {
+        {"start_point", 16}, {"end_point", 16}, {"vertex", 16}, {"reco_vertex", 16}, {"position", 16},
+        {"end_position", 16}, {"first_step", 16}, {"last_step", 16}, {"ancestor_position", 16}, {"parent_position", 16},
+        {"start_dir", 12}, {"end_dir", 12}, {"reco_start_dir", 12}, {"reco_end_dir", 12},
+        {"momentum", 12}, {"end_momentum", 12}, {"reco_momentum", 12},
+        {"chi2_per_pid", 12}, {"csda_ke_per_pid", 12}, {"mcs_ke_per_pid", 12},
+        {"pid_scores", 10}, {"primary_scores", 10}, {"match_overlaps", 10}, {"flash_scores", 10}
+    };
+
+    /**
+     * @brief Resolve a precision policy against a field table.
+     * @tparam T The CAF class.
+     * @param table The field table of the CAF class.
+     * @param policy The precision policy.
+     * @return The fields of the table with a reduced precision, and their
+     * number of mantissa bits.
+     */
+    template <class T>
+    std::vector<std::pair<const typename PrecisionTable<T>::Field *, int>> resolve(const PrecisionTable<T> & table, const dlp::PrecisionPolicy & policy)
+    {
+        std::vector<std::pair<const typename PrecisionTable<T>::Field *, int>> result;
+        for(const auto & field : table.fields())
+        {
+            auto entry(policy.bits.find(field.name));
+            if(entry != policy.bits.end())
+                result.emplace_back(&field, entry->second);
+        }
+        return result;
+    }
+
+    /**
+     * @brief Create the (empty) deviations of the fields of a table.
+     * @tparam T The CAF class.
+     * @param table The field table of the CAF class.
+     * @param prefix The prefix of the field names (e.g. "dlp.particles").
+     * @return The deviations, in the order of the fields of the table.
+     */
+    template <class T>
+    std::vector<dlp::FieldDeviation> make_deviations(const PrecisionTable<T> & table, const std::string & prefix)
+    {
+        std::vector<dlp::FieldDeviation> result(table.fields().size());
+        for(size_t i(0); i < result.size(); ++i)
+            result[i].name = prefix + "." + table.fields()[i].name;
+        return result;
+    }
+
+    /**
+     * @brief Compare the interactions (and their particles) of two records.
+     * @tparam I The interaction class.
+     * @tparam P The particle class.
+     * @return True if the numbers of interactions and particles match.
+     */
+    template <class I, class P>
+    bool compare_interactions(const std::vector<I> & reference, const std::vector<I> & reduced,
+                              const PrecisionTable<I> & interaction_table, std::vector<dlp::FieldDeviation> & interaction_deviations,
+                              const PrecisionTable<P> & particle_table, std::vector<dlp::FieldDeviation> & particle_deviations)
+    {
+        bool matched(reference.size() == reduced.size());
+        for(size_t i(0); i < std::min(reference.size(), reduced.size()); ++i)
+        {
+            for(size_t f(0); f < interaction_table.fields().size(); ++f)
+                interaction_table.fields()[f].compare(reference[i], reduced[i], interaction_deviations[f]);
+            const std::vector<P> & reference_particles(reference[i].particles);
+            const std::vector<P> & reduced_particles(reduced[i].particles);
+            matched = matched && reference_particles.size() == reduced_particles.size();
+            for(size_t p(0); p < std::min(reference_particles.size(), reduced_particles.size()); ++p)
+            {
+                for(size_t f(0); f < particle_table.fields().size(); ++f)
+                    particle_table.fields()[f].compare(reference_particles[p], reduced_particles[p], particle_deviations[f]);
+            }
+        }
+        return matched;
+    }
+} // namespace
+
+namespace dlp
+{
+    /**
+     * @brief Build a precision policy from the value of the "--precision"
+     * option.
+     * @param value The value of the "--precision" option.
+     * @return The precision policy.
+     * @throw std::runtime_error if an entry is invalid or names an unknown
+     * field.
+    */
+    PrecisionPolicy parse_precision_policy(const std::string & value)
+    {
+        PrecisionPolicy policy;
+        std::istringstream entries(value);
+        std::string entry;
+        while(std::getline(entries, entry, ','))
+        {
+            if(entry.empty())
+                continue;
+            if(entry == "reduced")
+            {
+                for(const auto & [name, bits] : reduced_policy)
+                    policy.bits[name] = bits;
+                continue;
+            }
+            size_t colon(entry.find(':'));
+            std::string name(entry.substr(0, colon));
+            if(colon == std::string::npos || !tables().has(name))
+                throw std::runtime_error("Invalid precision entry (expected \"reduced\" or <field>:<bits>): " + entry);
+            std::string bits(entry.substr(colon + 1));
+            if(bits == "full")
+            {
+                policy.bits.erase(name);
+                continue;
+            }
+            size_t end(0);
+            int count(-1);
+            try
+            {
+                count = std::stoi(bits, &end);
+            }
+            catch(const std::exception & e)
+            {
+                end = 0;
+            }
+            if(end == 0 || end != bits.size() || count < 0 || count > 23)
+                throw std::runtime_error("Number of mantissa bits must be between 0 and 23 (or \"full\"): " + entry);
+            if(count == 23)
+                policy.bits.erase(name);
+            else
+                policy.bits[name] = count;
+        }
+        return policy;
+    }
+
+    /**
+     * @brief Get a human-readable description of the precision policy.
+     * @param policy The precision policy.
+     * @return The description of the precision policy.
+    */
+    std::string describe_precision_policy(const PrecisionPolicy & policy)
+    {
+        if(!policy.active())
+            return "full precision";
+        std::ostringstream description;
+        std::string separator("");
+        for(const auto & [name, bits] : policy.bits)
+        {
+            description << separator << name << ":" << bits;
+            separator = ",";
+        }
+        return description.str();
+    }
+
+    /**
+     * @brief Round a value to a given number of mantissa bits.
+     * @param value The value.
+     * @param bits The number of explicit mantissa bits to keep.
+     * @return The rounded value.
+    */
+    float reduce_precision(float value, int bits)
+    {
+        return round_mantissa<float, uint32_t>(value, bits);
+    }
+
+    /**
+     * @brief Round a value to a given number of mantissa bits.
+     * @param value The value.
+     * @param bits The number of explicit mantissa bits to keep.
+     * @return The rounded value.
+    */
+    double reduce_precision(double value, int bits)
+    {
+        return round_mantissa<double, uint64_t>(value, bits);
+    }
+
+    /**
+     * @brief The fields of each CAF class with a reduced precision.
+    */
+    struct PrecisionReducer::Fields
+    {
+        std::vector<std::pair<const PrecisionTable<caf::SRInteractionDLP>::Field *, int>> reco_interaction;
+        std::vector<std::pair<const PrecisionTable<caf::SRParticleDLP>::Field *, int>> reco_particle;
+        std::vector<std::pair<const PrecisionTable<caf::SRInteractionTruthDLP>::Field *, int>> truth_interaction;
+        std::vector<std::pair<const PrecisionTable<caf::SRParticleTruthDLP>::Field *, int>> truth_particle;
+    };
+
+    /**
+     * @brief A constructor for the PrecisionReducer class.
+     * @param policy The precision policy.
+    */
+    PrecisionReducer::PrecisionReducer(const PrecisionPolicy & policy)
+        : fFields(new Fields)
+    {
+        fFields->reco_interaction = resolve(tables().reco_interaction, policy);
+        fFields->reco_particle = resolve(tables().reco_particle, policy);
+        fFields->truth_interaction = resolve(tables().truth_interaction, policy);
+        fFields->truth_particle = resolve(tables().truth_particle, policy);
+    }
+
+    /**
+     * @brief A destructor for the PrecisionReducer class.
+    */
+    PrecisionReducer::~PrecisionReducer() {}
+
+    /**
+     * @brief Reduce the precision of the ML fields of the StandardRecord
+     * (in place).
+     * @param rec The StandardRecord.
+    */
+    void PrecisionReducer::Apply(caf::StandardRecord & rec) const
+    {
+        for(caf::SRInteractionDLP & interaction : rec.dlp)
+        {
+            for(const auto & [field, bits] : fFields->reco_interaction)
+                field->reduce(interaction, bits);
+            for(caf::SRParticleDLP & particle : interaction.particles)
+            {
+                for(const auto & [field, bits] : fFields->reco_particle)
+                    field->reduce(particle, bits);
+            }
+        }
+        for(caf::SRInteractionTruthDLP & interaction : rec.dlp_true)
+        {
+            for(const auto & [field, bits] : fFields->truth_interaction)
+                field->reduce(interaction, bits);
+            for(caf::SRParticleTruthDLP & particle : interaction.particles)
+            {
+                for(const auto & [field, bits] : fFields->truth_particle)
+                    field->reduce(particle, bits);
+            }
+        }
+    }
+
+    /**
+     * @brief The deviations of the fields of each CAF class.
+    */
+    struct PrecisionValidator::Fields
+    {
+        std::vector<FieldDeviation> reco_interaction;
+        std::vector<FieldDeviation> reco_particle;
+        std::vector<FieldDeviation> truth_interaction;
+        std::vector<FieldDeviation> truth_particle;
+    };
+
+    /**
+     * @brief A constructor for the PrecisionValidator class.
+    */
+    PrecisionValidator::PrecisionValidator()
+        : fFields(new Fields), fMismatched(0)
+    {
+        fFields->reco_interaction = make_deviations(tables().reco_interaction, "dlp");
+        fFields->reco_particle = make_deviations(tables().reco_particle, "dlp.particles");
+        fFields->truth_interaction = make_deviations(tables().truth_interaction, "dlp_true");
+        fFields->truth_particle = make_deviations(tables().truth_particle, "dlp_true.particles");
+    }
+
+    /**
+     * @brief A destructor for the PrecisionValidator class.
+    */
+    PrecisionValidator::~PrecisionValidator() {}
+
+    /**
+     * @brief Compare the ML fields of two StandardRecords.
+     * @param reference The reference StandardRecord.
+     * @param reduced The StandardRecord to validate.
+    */
+    void PrecisionValidator::Compare(const caf::StandardRecord & reference, const caf::StandardRecord & reduced)
+    {
+        bool matched(compare_interactions(reference.dlp, reduced.dlp, tables().reco_interaction, fFields->reco_interaction, tables().reco_particle, fFields->reco_particle));
+        matched = compare_interactions(reference.dlp_true, reduced.dlp_true, tables().truth_interaction, fFields->truth_interaction, tables().truth_particle, fFields->truth_particle) && matched;
+        if(!matched)
+            ++fMismatched;
+    }
+
+    /**
+     * @brief Get the deviation of each field.
+     * @return The deviation of each field (fields with no values are
+     * omitted).
+    */
+    std::vector<FieldDeviation> PrecisionValidator::Deviations() const
+    {
+        std::vector<FieldDeviation> result;
+        for(const std::vector<FieldDeviation> * deviations : {&fFields->reco_interaction, &fFields->reco_particle, &fFields->truth_interaction, &fFields->truth_particle})
+        {
+            for(const FieldDeviation & deviation : *deviations)
+            {
+                if(deviation.values > 0 || deviation.mismatched > 0)
+                    result.push_back(deviation);
+            }
+        }
+        return result;
+    }
+} // namespace dlp
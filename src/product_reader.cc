@@ -0,0 +1,173 @@
+/**
+ * @file product_reader.cc
+ * @brief Implementation of the ProductReader class for reading the data
+ * products of consecutive events into reused buffers.
+ * @author mueller@fnal.gov
+*/
+#include <tuple>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include "H5Cpp.h"
+#include "product_reader.h"
+#include "products.h"
+#include "event.h"
+
+namespace dlp
+{
+    /**
+     * @brief Allocate memory from the arena.
+     * @details The sizes are rounded up to the alignment of the blocks. A
+     * new block is at least as large as all of the previous blocks together,
+     * so the number of blocks stays logarithmic in the size of the event.
+     * @param size The size of the allocation (bytes).
+     * @return The allocated memory.
+    */
+    void * VlenArena::allocate(size_t size)
+    {
+        constexpr size_t align(alignof(std::max_align_t));
+        size = (size + align - 1) / align * align;
+        if(fBlocks.empty() || fUsed + size > fBlocks.back().size)
+        {
+            size_t capacity(0);
+            for(const Block & block : fBlocks)
+                capacity += block.size;
+            size_t block_size(std::max<size_t>({size, capacity, 64 * 1024}));
+            fBlocks.push_back(Block{std::make_unique<std::max_align_t[]>(block_size / align), block_size});
+            fUsed = 0;
+            ++fAllocations;
+        }
+        void * pointer(reinterpret_cast<char *>(fBlocks.back().data.get()) + fUsed);
+        fUsed += size;
+        return pointer;
+    }
+
+    /**
+     * @brief Release all of the memory allocated from the arena.
+     * @details If the last event needed more than one block, the blocks are
+     * replaced by a single block of their total size.
+    */
+    void VlenArena::reset()
+    {
+        if(fBlocks.size() > 1)
+        {
+            size_t capacity(0);
+            for(const Block & block : fBlocks)
+                capacity += block.size;
+            fBlocks.clear();
+            fBlocks.push_back(Block{std::make_unique<std::max_align_t[]>(capacity / alignof(std::max_align_t)), capacity});
+            ++fAllocations;
+        }
+        fUsed = 0;
+    }
+
+    /**
+     * @brief The allocation function of H5Pset_vlen_mem_manager.
+     * @param size The size of the allocation (bytes).
+     * @param info The arena.
+     * @return The allocated memory.
+    */
+    void * VlenArena::hdf5_allocate(size_t size, void * info)
+    {
+        return static_cast<VlenArena *>(info)->allocate(size);
+    }
+
+    /**
+     * @brief The free function of H5Pset_vlen_mem_manager.
+     * @param pointer The memory to free (unused).
+     * @param info The arena (unused).
+    */
+    void VlenArena::hdf5_free(void *, void *) { }
+
+    /**
+     * @brief Reclaim the variable-length memory of the products.
+     * @details The memory of all products is in the arena, so the arena is
+     * reset instead of freeing each array.
+    */
+    template <class T>
+    void ProductBuffer<T>::reclaim()
+    {
+        if(loaded)
+            arena.reset();
+        loaded = false;
+    }
+
+    /**
+     * @brief A destructor for the ProductReader class.
+    */
+    ProductReader::~ProductReader()
+    {
+        clear();
+    }
+
+    /**
+     * @brief Read all products of a certain type of an event.
+     * @details The transfer property list of the buffer, which allocates
+     * the variable-length arrays from the arena of the buffer, is created on
+     * first use. The buffer is not moved afterwards, as the reader can be
+     * neither copied nor moved.
+     * @tparam T the type of product to retrieve.
+     * @param file the input H5 file.
+     * @param evt the dlp::types::Event object containing the references to
+     * the requested products.
+     * @return the products of the event.
+    */
+    template <class T>
+    std::vector<T> & ProductReader::read(H5::H5File & file, types::Event & evt)
+    {
+        ProductBuffer<T> & buffer(std::get<ProductBuffer<T>>(fBuffers));
+        if(!buffer.ctype)
+        {
+            buffer.ctype.emplace(types::BuildCompType<T>());
+            buffer.memspace.emplace(H5S_SIMPLE);
+            buffer.transfer.emplace();
+            H5Pset_vlen_mem_manager(buffer.transfer->getId(), &VlenArena::hdf5_allocate, &buffer.arena, &VlenArena::hdf5_free, &buffer.arena);
+        }
+        buffer.reclaim();
+        if(!buffer.dataset || buffer.file != file.getId())
+        {
+            buffer.dataset.reset();
+            buffer.dataset.emplace(open_product_dataset<T>(file, evt));
+            buffer.file = file.getId();
+        }
+        buffer.loaded = true;
+        read_product(file, *buffer.dataset, evt, *buffer.ctype, *buffer.memspace, buffer.products, fStrings, *buffer.transfer);
+        return buffer.products;
+    }
+
+    /**
+     * @brief Reclaim the variable-length memory of all buffers, release
+     * their HDF5 objects (including the open datasets) and empty the string
+     * pool.
+    */
+    void ProductReader::clear()
+    {
+        std::apply([](auto & ... buffer)
+        {
+            ((buffer.reclaim(), buffer.memspace.reset(), buffer.ctype.reset(), buffer.transfer.reset(), buffer.dataset.reset(), buffer.file = H5I_INVALID_HID), ...);
+        }, fBuffers);
+        fStrings.clear();
+    }
+
+    /**
+     * @brief Get the number of blocks allocated by the arenas of the buffers
+     * so far.
+     * @return The number of blocks.
+    */
+    uint64_t ProductReader::vlen_allocations() const
+    {
+        return std::apply([](const auto & ... buffer) { return (buffer.arena.allocations() + ...); }, fBuffers);
+    }
+
+    /**
+     * Explicit instantiation of the read method for the types of products
+     * that we expect to use.
+    */
+    template std::vector<types::RunInfo> & ProductReader::read<types::RunInfo>(H5::H5File & file, types::Event & evt);
+    template std::vector<types::RecoInteraction> & ProductReader::read<types::RecoInteraction>(H5::H5File & file, types::Event & evt);
+    template std::vector<types::RecoParticle> & ProductReader::read<types::RecoParticle>(H5::H5File & file, types::Event & evt);
+    #ifdef MC_NOT_DATA
+    template std::vector<types::TruthInteraction> & ProductReader::read<types::TruthInteraction>(H5::H5File & file, types::Event & evt);
+    template std::vector<types::TruthParticle> & ProductReader::read<types::TruthParticle>(H5::H5File & file, types::Event & evt);
+    #endif
+} // namespace dlp
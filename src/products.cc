@@ -5,11 +5,87 @@
  * @author mueller@fnal.gov
 */
 #include <vector>
+#include <cstring>
 #include <iostream>
 #include "H5Cpp.h"
 #include "products.h"
 #include "event.h"
 #include "composites.h"
+#include "instrumentation.h"
+
+namespace
+{
+    /**
+     * @brief Get the name of the instrumentation stage for retrieving a
+     * product of a certain type.
+     * @tparam T the type of product.
+     * @return the name of the stage.
+    */
+    template <class T> const char * product_stage();
+    template <> const char * product_stage<dlp::types::RunInfo>() { return "get_product<RunInfo>"; }
+    template <> const char * product_stage<dlp::types::RecoInteraction>() { return "get_product<RecoInteraction>"; }
+    template <> const char * product_stage<dlp::types::RecoParticle>() { return "get_product<RecoParticle>"; }
+    template <> const char * product_stage<dlp::types::TruthInteraction>() { return "get_product<TruthInteraction>"; }
+    template <> const char * product_stage<dlp::types::TruthParticle>() { return "get_product<TruthParticle>"; }
+
+    /**
+     * @brief A variable-length member of the HDF5 compound type of a product.
+     */
+    struct VlenMember
+    {
+        size_t offset;                          //!< The offset of the member in the product.
+        size_t element_size;                    //!< The size of one element (zero for a string).
+    };
+
+    /**
+     * @brief Find the variable-length members (arrays and strings) of the
+     * HDF5 compound type of a product.
+     * @param ctype the HDF5 compound type of the product.
+     * @return the variable-length members of the compound type.
+    */
+    std::vector<VlenMember> vlen_members(const H5::CompType & ctype)
+    {
+        std::vector<VlenMember> members;
+        for(int i(0); i < ctype.getNmembers(); ++i)
+        {
+            H5T_class_t type_class(ctype.getMemberClass(i));
+            if(type_class == H5T_VLEN)
+                members.push_back({ctype.getMemberOffset(i), ctype.getMemberVarLenType(i).getSuper().getSize()});
+            else if(type_class == H5T_STRING && ctype.getMemberStrType(i).isVariableStr())
+                members.push_back({ctype.getMemberOffset(i), 0});
+        }
+        return members;
+    }
+
+    /**
+     * @brief Count the bytes of the variable-length data of the products
+     * returned by a read.
+     * @details The lengths are taken from the handles filled by the read
+     * (the strings are counted with their terminating null character), so
+     * that the count does not read the data again.
+     * @tparam T the type of product.
+     * @param members the variable-length members of the compound type.
+     * @param products the products just read.
+     * @return the number of bytes of variable-length data.
+    */
+    template <class T>
+    size_t vlen_bytes(const std::vector<VlenMember> & members, const std::vector<T> & products)
+    {
+        size_t bytes(0);
+        for(const T & product : products)
+        {
+            const char * record(reinterpret_cast<const char *>(&product));
+            for(const VlenMember & member : members)
+            {
+                if(member.element_size > 0)
+                    bytes += reinterpret_cast<const hvl_t *>(record + member.offset)->len * member.element_size;
+                else if(const char * string = *reinterpret_cast<char * const *>(record + member.offset))
+                    bytes += std::strlen(string) + 1;
+            }
+        }
+        return bytes;
+    }
+} // namespace
 
 /**
  * @brief Checks the dimensions of the H5 DataSpace and calculates the number
@@ -76,44 +152,165 @@ std::vector<dlp::types::Event> get_all_events(H5::H5File & file)
 }
 
 /**
- * @brief Retrieves all products of a certain type from the H5 file.
+ * @brief Appends the dlp::types::Event objects written to the H5 file since
+ * they were last read.
+ * @param file the input H5 file.
+ * @param events the events already read from the file (extended).
+ * @return the number of new events.
+*/
+size_t get_new_events(H5::H5File & file, std::vector<dlp::types::Event> & events)
+{
+    size_t nevents(0);
+    {
+        H5::DataSet dataset(file.openDataSet("events"));
+        H5Drefresh(dataset.getId());
+        H5::DataSpace dsp(dataset.getSpace());
+        nevents = get_nevents(dsp);
+    }
+    if(nevents <= events.size())
+        return 0;
+
+    /**
+     * @brief Reopen the file.
+     * @details Refreshing a dataset only updates its own metadata. The
+     * selections of the region references of the new events are stored in
+     * the global heap, possibly beyond the end of the file known to the
+     * reader, so the file is reopened to drop all of the cached metadata.
+     * The file must not have any other open object.
+     */
+    std::string name(file.getFileName());
+    unsigned int flags(H5F_ACC_RDONLY);
+    H5Fget_intent(file.getId(), &flags);
+    file.close();
+    file.openFile(name, flags);
+
+    H5::DataSet dataset(file.openDataSet("events"));
+    H5::DataSpace dsp(dataset.getSpace());
+    hsize_t start[1] = {events.size()};
+    hsize_t count[1] = {get_nevents(dsp) - events.size()};
+    dsp.selectHyperslab(H5S_SELECT_SET, count, start);
+    H5::DataSpace memspace(1, count);
+    events.resize(start[0] + count[0]);
+    H5::CompType ctype(dlp::types::BuildCompType<dlp::types::Event>());
+    dataset.read(events.data() + start[0], ctype, memspace, dsp);
+    return count[0];
+}
+
+/**
+ * @brief Opens the dataset holding the products of a certain type.
+ * @tparam T the type of product.
+ * @param file the input H5 file.
+ * @param evt the dlp::types::Event object containing a reference to the
+ * products.
+ * @return the dataset referenced by the event.
+*/
+template <class T>
+H5::DataSet open_product_dataset(H5::H5File & file, dlp::types::Event & evt)
+{
+    H5::DataSet dataset;
+    dataset.dereference(file, &(evt.GetRef<T>()), H5R_DATASET_REGION);
+    return dataset;
+}
+
+/**
+ * @brief Reads all products of a certain type from the H5 file into a
+ * caller-owned buffer.
  * @tparam T the type of product to retrieve.
  * @param file the input H5 file.
+ * @param dataset the dataset holding the products (see open_product_dataset).
  * @param evt the dlp::types::Event object containing the references to the
  * requested products.
+ * @param ctype the HDF5 compound type of the product.
+ * @param memspace the memory DataSpace (reset by the call).
+ * @param data_product the buffer receiving the products (resized).
+ * @param strings the pool of the string fields of the products.
+ * @param transfer the dataset transfer property list of the read.
 */
 template <class T>
-std::vector<T> get_product(H5::H5File & file, dlp::types::Event & evt)
+void read_product(H5::H5File & file, const H5::DataSet & dataset, dlp::types::Event & evt, const H5::CompType & ctype, H5::DataSpace & memspace, std::vector<T> & data_product, dlp::StringPool & strings, const H5::DSetMemXferPropList & transfer)
 {
-    H5::DataSet ds_ref(file.openDataSet("events"));
-
-    const void *buff_ref_const(&(evt.GetRef<T>()));
-    ds_ref.dereference(file, buff_ref_const, H5R_DATASET_REGION);
+    dlp::ScopedTimer timer(product_stage<T>());
     void *buff_ref(&(const_cast<hdset_reg_ref_t&>(evt.GetRef<T>())));
     H5::DataSpace ref_region = file.getRegion(buff_ref);
 
-    H5::DataSpace memspace(H5S_SIMPLE);
-    std::vector<hsize_t> dims(ref_region.getSimpleExtentNdims());
-    std::vector<hsize_t> dims_max(ref_region.getSimpleExtentNdims(), H5S_UNLIMITED);
-    ref_region.getSimpleExtentDims(dims.data());
-    memspace.setExtentSimple(1, dims.data(), dims_max.data());
-    std::vector<hsize_t> start(1, 0);
-    std::vector<hsize_t> count(1, static_cast<hsize_t>(ref_region.getSelectNpoints()));
-    memspace.selectHyperslab(H5S_SELECT_SET, count.data(), start.data());
+    /**
+     * @brief Select the referenced records in the memory DataSpace.
+     * @details The dimensions are kept in fixed-size arrays so that no heap
+     * memory is allocated when the DataSpace and the buffer are reused.
+     */
+    hsize_t dims[H5S_MAX_RANK];
+    hsize_t dims_max[1] = {H5S_UNLIMITED};
+    ref_region.getSimpleExtentDims(dims);
+    memspace.setExtentSimple(1, dims, dims_max);
+    hsize_t start[1] = {0};
+    hsize_t count[1] = {static_cast<hsize_t>(ref_region.getSelectNpoints())};
+    memspace.selectHyperslab(H5S_SELECT_SET, count, start);
+
+    data_product.resize(count[0]);
+    dataset.read(data_product.data(), ctype, memspace, ref_region, transfer);
+
+    /**
+     * @brief Count the bytes read (if instrumentation is enabled).
+     * @details The variable-length bytes are counted from the handles of the
+     * products before the strings are interned. The members are looked up
+     * once per product type, as the compound type is always the same.
+     */
+    dlp::Instrumentation & instrumentation(dlp::Instrumentation::get());
+    if(instrumentation.enabled())
+    {
+        static const std::vector<VlenMember> members(vlen_members(ctype));
+        instrumentation.add_count("hdf5_record_bytes", data_product.size() * ctype.getSize());
+        instrumentation.add_count("vlen_bytes", vlen_bytes(members, data_product));
+    }
+
+    /**
+     * @brief Replace the variable-length strings read by HDF5 with their
+     * interned copies (see dlp::StringPool).
+     * @details The strings are released through the free function of the
+     * transfer property list, which allocated them.
+     */
+    if constexpr (requires(T & product, const dlp::VlenRelease & release) { product.InternStrings(strings, release); })
+    {
+        dlp::VlenRelease release(transfer);
+        for(T & product : data_product)
+            product.InternStrings(strings, release);
+    }
+}
 
-    std::vector<T> data_product(static_cast<hsize_t>(ref_region.getSelectNpoints()));
-    H5::CompType ctype(dlp::types::BuildCompType<T>());
-    ds_ref.read(data_product.data(), ctype, memspace, ref_region);
+/**
+ * @brief Retrieves all products of a certain type from the H5 file.
+ * @tparam T the type of product to retrieve.
+ * @param file the input H5 file.
+ * @param evt the dlp::types::Event object containing the references to the
+ * requested products.
+ * @param strings the pool of the string fields of the products.
+*/
+template <class T>
+std::vector<T> get_product(H5::H5File & file, dlp::types::Event & evt, dlp::StringPool & strings)
+{
+    H5::DataSpace memspace(H5S_SIMPLE);
+    std::vector<T> data_product;
+    read_product(file, open_product_dataset<T>(file, evt), evt, dlp::types::BuildCompType<T>(), memspace, data_product, strings);
     return data_product;
 }
 /**
  * Explicit instantiation of the get_product function for the types of products
  * that we expect to use.
 */
-template std::vector<dlp::types::RunInfo> get_product<dlp::types::RunInfo>(H5::H5File & file, dlp::types::Event & evt);
-template std::vector<dlp::types::RecoInteraction> get_product<dlp::types::RecoInteraction>(H5::H5File & file, dlp::types::Event & evt);
-template std::vector<dlp::types::RecoParticle> get_product<dlp::types::RecoParticle>(H5::H5File & file, dlp::types::Event & evt);
+template std::vector<dlp::types::RunInfo> get_product<dlp::types::RunInfo>(H5::H5File & file, dlp::types::Event & evt, dlp::StringPool & strings);
+template std::vector<dlp::types::RecoInteraction> get_product<dlp::types::RecoInteraction>(H5::H5File & file, dlp::types::Event & evt, dlp::StringPool & strings);
+template std::vector<dlp::types::RecoParticle> get_product<dlp::types::RecoParticle>(H5::H5File & file, dlp::types::Event & evt, dlp::StringPool & strings);
+template H5::DataSet open_product_dataset<dlp::types::RunInfo>(H5::H5File & file, dlp::types::Event & evt);
+template void read_product<dlp::types::RunInfo>(H5::H5File & file, const H5::DataSet & dataset, dlp::types::Event & evt, const H5::CompType & ctype, H5::DataSpace & memspace, std::vector<dlp::types::RunInfo> & data_product, dlp::StringPool & strings, const H5::DSetMemXferPropList & transfer);
+template H5::DataSet open_product_dataset<dlp::types::RecoInteraction>(H5::H5File & file, dlp::types::Event & evt);
+template void read_product<dlp::types::RecoInteraction>(H5::H5File & file, const H5::DataSet & dataset, dlp::types::Event & evt, const H5::CompType & ctype, H5::DataSpace & memspace, std::vector<dlp::types::RecoInteraction> & data_product, dlp::StringPool & strings, const H5::DSetMemXferPropList & transfer);
+template H5::DataSet open_product_dataset<dlp::types::RecoParticle>(H5::H5File & file, dlp::types::Event & evt);
+template void read_product<dlp::types::RecoParticle>(H5::H5File & file, const H5::DataSet & dataset, dlp::types::Event & evt, const H5::CompType & ctype, H5::DataSpace & memspace, std::vector<dlp::types::RecoParticle> & data_product, dlp::StringPool & strings, const H5::DSetMemXferPropList & transfer);
 #ifdef MC_NOT_DATA
-template std::vector<dlp::types::TruthInteraction> get_product<dlp::types::TruthInteraction>(H5::H5File & file, dlp::types::Event & evt);
-template std::vector<dlp::types::TruthParticle> get_product<dlp::types::TruthParticle>(H5::H5File & file, dlp::types::Event & evt);
+template std::vector<dlp::types::TruthInteraction> get_product<dlp::types::TruthInteraction>(H5::H5File & file, dlp::types::Event & evt, dlp::StringPool & strings);
+template std::vector<dlp::types::TruthParticle> get_product<dlp::types::TruthParticle>(H5::H5File & file, dlp::types::Event & evt, dlp::StringPool & strings);
+template H5::DataSet open_product_dataset<dlp::types::TruthInteraction>(H5::H5File & file, dlp::types::Event & evt);
+template void read_product<dlp::types::TruthInteraction>(H5::H5File & file, const H5::DataSet & dataset, dlp::types::Event & evt, const H5::CompType & ctype, H5::DataSpace & memspace, std::vector<dlp::types::TruthInteraction> & data_product, dlp::StringPool & strings, const H5::DSetMemXferPropList & transfer);
+template H5::DataSet open_product_dataset<dlp::types::TruthParticle>(H5::H5File & file, dlp::types::Event & evt);
+template void read_product<dlp::types::TruthParticle>(H5::H5File & file, const H5::DataSet & dataset, dlp::types::Event & evt, const H5::CompType & ctype, H5::DataSpace & memspace, std::vector<dlp::types::TruthParticle> & data_product, dlp::StringPool & strings, const H5::DSetMemXferPropList & transfer);
 #endif
\ No newline at end of file
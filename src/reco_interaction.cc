@@ -27,6 +27,17 @@ namespace dlp::types
         module_ids.reset(&module_ids_handle);
     }
 
+    /**
+     * @brief Intern the string fields and release the strings read by HDF5.
+     * @param pool The string pool of the reader.
+     * @param release The function releasing the strings read by HDF5.
+    */
+    void RecoInteraction::InternStrings(StringPool & pool, const VlenRelease & release)
+    {
+        topology = pool.adopt(topology_handle, release);
+        units = pool.adopt(units_handle, release);
+    }
+
     /**
      * @brief Build the HDF5 compound type for the RecoInteraction class.
      * 
@@ -72,8 +83,8 @@ namespace dlp::types
 	    ctype.insertMember("primary_particle_counts", HOFFSET(RecoInteraction, primary_particle_counts), H5::ArrayType(H5::PredType::STD_I64LE, 1, &std::array<hsize_t,1>{6}[0]));
         ctype.insertMember("primary_particle_ids", HOFFSET(RecoInteraction, primary_particle_ids_handle), H5::VarLenType(H5::PredType::STD_I64LE));
 	    ctype.insertMember("size", HOFFSET(RecoInteraction, size), H5::PredType::STD_I64LE);
-        ctype.insertMember("topology", HOFFSET(RecoInteraction, topology), string_type);
-        ctype.insertMember("units", HOFFSET(RecoInteraction, units), string_type);
+        ctype.insertMember("topology", HOFFSET(RecoInteraction, topology_handle), string_type);
+        ctype.insertMember("units", HOFFSET(RecoInteraction, units_handle), string_type);
         ctype.insertMember("vertex", HOFFSET(RecoInteraction, vertex), H5::ArrayType(H5::PredType::IEEE_F32LE, 1, &std::array<hsize_t, 1>{3}[0]));
 
         return ctype;
@@ -30,6 +30,16 @@ namespace dlp::types
         ppn_ids.reset(&ppn_ids_handle);
     }
 
+    /**
+     * @brief Intern the string fields and release the strings read by HDF5.
+     * @param pool The string pool of the reader.
+     * @param release The function releasing the strings read by HDF5.
+    */
+    void RecoParticle::InternStrings(StringPool & pool, const VlenRelease & release)
+    {
+        units = pool.adopt(units_handle, release);
+    }
+
     /**
      * @brief Build the HDF5 compound type for the RecoParticle class.
      * 
@@ -98,7 +108,7 @@ namespace dlp::types
         ctype.insertMember("start_dir", HOFFSET(RecoParticle, start_dir), H5::ArrayType(H5::PredType::IEEE_F32LE, 1, &std::array<hsize_t, 1>{3}[0]));
         ctype.insertMember("start_point", HOFFSET(RecoParticle, start_point), H5::ArrayType(H5::PredType::IEEE_F32LE, 1, &std::array<hsize_t, 1>{3}[0]));
         ctype.insertMember("start_straightness", HOFFSET(RecoParticle, start_straightness), H5::PredType::IEEE_F32LE);
-        ctype.insertMember("units", HOFFSET(RecoParticle, units), string_type);
+        ctype.insertMember("units", HOFFSET(RecoParticle, units_handle), string_type);
         ctype.insertMember("vertex_distance", HOFFSET(RecoParticle, vertex_distance), H5::PredType::IEEE_F32LE);
 
         return ctype;
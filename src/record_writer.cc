@@ -0,0 +1,228 @@
+/**
+ * @file record_writer.cc
+ * @brief Implementation of the RecordWriter class for writing StandardRecord
+ * entries to the output CAF file.
+ * @author mueller@fnal.gov
+*/
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "record_writer.h"
+#include "flat_writer.h"
+#include "output_profile.h"
+#include "precision.h"
+#include "matching.h"
+#include "cross_references.h"
+#include "instrumentation.h"
+#include "logger.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+#include "sbnanaobj/StandardRecord/Flat/FlatRecord.h"
+
+#include "TTree.h"
+#include "TDirectory.h"
+
+namespace
+{
+    /**
+     * @brief A branch policy excluding the ML reconstruction branches.
+     * @details The ML reconstruction branches are written separately from
+     * the field tables of the record fillers, so they are excluded from the
+     * flat record classes of sbnanaobj to avoid duplicate branches.
+     */
+    class ExcludeMLPolicy : public flat::IBranchPolicy
+    {
+        public:
+        bool Include(const std::string & name) const override
+        {
+            for(const std::string & ml : {std::string("rec.dlp"), std::string("rec.dlp_true")})
+            {
+                if(name == ml || name.compare(0, ml.size() + 1, ml + ".") == 0)
+                    return false;
+            }
+            return true;
+        }
+    };
+} // namespace
+
+namespace dlp
+{
+    /**
+     * @brief A constructor for the RecordWriter class.
+     * @param rec The address of the pointer to the StandardRecord.
+     * @param profile The output profile.
+     * @param title The title of the output TTree.
+    */
+    RecordWriter::RecordWriter(caf::StandardRecord ** rec, const OutputProfile & profile, const char * title)
+        : fRecord(rec), fProfile(profile), fTree(new TTree("recTree", title))
+    {
+        if(fProfile.flat)
+        {
+            /**
+             * @brief The flat branches are created by sbnanaobj with the
+             * default basket size, so they are resized afterwards.
+             */
+            fPolicy.reset(new ExcludeMLPolicy);
+            fFlatRecord.reset(new flat::Flat<caf::StandardRecord>(fTree, "rec", "", fPolicy.get()));
+            fFlatML.reset(new FlatMLRecord(fTree, "rec"));
+            if(fProfile.basket_size != OutputProfile().basket_size)
+                fTree->SetBasketSize("*", fProfile.basket_size);
+        }
+        else
+            fTree->Branch("rec", fRecord, fProfile.basket_size, fProfile.split_level);
+
+        if(fProfile.autoflush_bytes > 0)
+            fTree->SetAutoFlush(-fProfile.autoflush_bytes);
+        if(fProfile.precision.active())
+            fPrecision.reset(new PrecisionReducer(fProfile.precision));
+        if(fProfile.cross_references)
+        {
+            fCrossReferences.reset(new CrossReferenceBuilder);
+            CrossReferenceRecord * xref(const_cast<CrossReferenceRecord *>(&fCrossReferences->record()));
+            TTree * tree(AddCompanion("dlpXrefTree", "Resolved ML cross-references"));
+            tree->Branch("dlp_particle_offset", &xref->dlp_particle_offset);
+            tree->Branch("dlp_particle_interaction", &xref->dlp_particle_interaction);
+            tree->Branch("dlp_match_begin", &xref->dlp_match_begin);
+            tree->Branch("dlp_match_index", &xref->dlp_match_index);
+            tree->Branch("dlp_particle_match_begin", &xref->dlp_particle_match_begin);
+            tree->Branch("dlp_particle_match_index", &xref->dlp_particle_match_index);
+            tree->Branch("dlp_true_particle_offset", &xref->dlp_true_particle_offset);
+            tree->Branch("dlp_true_particle_interaction", &xref->dlp_true_particle_interaction);
+            tree->Branch("dlp_true_match_begin", &xref->dlp_true_match_begin);
+            tree->Branch("dlp_true_match_index", &xref->dlp_true_match_index);
+            tree->Branch("dlp_true_particle_match_begin", &xref->dlp_true_particle_match_begin);
+            tree->Branch("dlp_true_particle_match_index", &xref->dlp_true_particle_match_index);
+            tree->Branch("dlp_true_particle_parent_index", &xref->dlp_true_particle_parent_index);
+            tree->Branch("dlp_true_particle_children_begin", &xref->dlp_true_particle_children_begin);
+            tree->Branch("dlp_true_particle_children_index", &xref->dlp_true_particle_children_index);
+            ParticleHierarchy * hierarchy(const_cast<ParticleHierarchy *>(&fCrossReferences->hierarchy()));
+            tree->Branch("dlp_true_particle_dfs_order", &hierarchy->order);
+            tree->Branch("dlp_true_particle_dfs_rank", &hierarchy->rank);
+            tree->Branch("dlp_true_particle_subtree_end", &hierarchy->subtree_end);
+            tree->Branch("dlp_true_particle_depth", &hierarchy->depth);
+            tree->Branch("dlp_true_particle_primary_index", &hierarchy->primary);
+            tree->Branch("dlp_true_particle_visible_ancestor_index", &hierarchy->visible);
+        }
+    }
+
+    /**
+     * @brief A destructor for the RecordWriter class.
+    */
+    RecordWriter::~RecordWriter() = default;
+
+    /**
+     * @brief Write the recomputed matches alongside the records.
+     * @param matches The recomputed matches.
+    */
+    void RecordWriter::AttachMatches(const MatchRecord * matches)
+    {
+        MatchRecord * record(const_cast<MatchRecord *>(matches));
+        TTree * tree(AddCompanion("dlpMatchTree", "Recomputed ML reco/truth matches"));
+        tree->Branch("dlp_nmatch", &record->dlp_nmatch);
+        tree->Branch("dlp_match_ids", &record->dlp_match_ids);
+        tree->Branch("dlp_match_overlaps", &record->dlp_match_overlaps);
+        tree->Branch("dlp_true_nmatch", &record->dlp_true_nmatch);
+        tree->Branch("dlp_true_match_ids", &record->dlp_true_match_ids);
+        tree->Branch("dlp_true_match_overlaps", &record->dlp_true_match_overlaps);
+    }
+
+    /**
+     * @brief Create a TTree filled and written together with the output
+     * TTree.
+     * @param name The name of the TTree.
+     * @param title The title of the TTree.
+     * @return The TTree.
+    */
+    TTree * RecordWriter::AddCompanion(const char * name, const char * title)
+    {
+        TDirectory::TContext context(fTree->GetDirectory());
+        TTree * tree(new TTree(name, title));
+        if(fProfile.autoflush_bytes > 0)
+            tree->SetAutoFlush(-fProfile.autoflush_bytes);
+        fCompanions.push_back(tree);
+        return tree;
+    }
+
+    /**
+     * @brief Write the current contents of the StandardRecord to the output
+     * TTree.
+    */
+    void RecordWriter::Fill()
+    {
+        ScopedTimer timer("tree_fill");
+        if(fPrecision)
+            fPrecision->Apply(**fRecord);
+        if(fCrossReferences)
+            fCrossReferences->Build(**fRecord);
+        if(fFlatRecord)
+        {
+            fFlatRecord->Clear();
+            fFlatRecord->Fill(**fRecord);
+            fFlatML->Clear();
+            fFlatML->Fill(**fRecord);
+        }
+        fTree->Fill();
+        for(TTree * companion : fCompanions)
+            companion->Fill();
+
+        /**
+         * @brief Resize the baskets from the observed entry sizes.
+         * @details The baskets filled so far are flushed so that the
+         * per-branch sizes are known, then the memory budget (the auto-flush
+         * interval, if set, or the ROOT default) is shared between the
+         * branches in proportion to their average (uncompressed) entry size.
+         */
+        if(fProfile.adaptive_entries > 0 && fTree->GetEntries() == fProfile.adaptive_entries)
+        {
+            fTree->FlushBaskets();
+            if(fProfile.autoflush_bytes > 0)
+                fTree->OptimizeBaskets(fProfile.autoflush_bytes, 1.1, "");
+            else
+                fTree->OptimizeBaskets();
+            Logger::get().log(LogLevel::kInfo, "optimize_baskets", "Optimized basket sizes after ", fProfile.adaptive_entries, " entries.");
+        }
+    }
+
+    /**
+     * @brief Write the output TTree to its directory.
+    */
+    void RecordWriter::Write()
+    {
+        fTree->Write("", TObject::kOverwrite);
+        for(TTree * companion : fCompanions)
+            companion->Write("", TObject::kOverwrite);
+    }
+
+    /**
+     * @brief Save the output TTree (and the TTrees filled with it) to the
+     * output file.
+     * @details The companions are saved first, so that the directory saved
+     * with the output TTree lists all of them.
+    */
+    void RecordWriter::AutoSave()
+    {
+        ScopedTimer timer("tree_autosave");
+        for(TTree * companion : fCompanions)
+            companion->AutoSave();
+        fTree->AutoSave("SaveSelf");
+    }
+
+    /**
+     * @brief Get the output TTree.
+     * @return The output TTree.
+    */
+    TTree * RecordWriter::tree() const
+    {
+        return fTree;
+    }
+
+    /**
+     * @brief Check if the writer is writing the flat CAF layout.
+     * @return True if the writer is writing the flat CAF layout.
+    */
+    bool RecordWriter::flat() const
+    {
+        return fProfile.flat;
+    }
+} // namespace dlp
@@ -0,0 +1,223 @@
+/**
+ * @file skim.cc
+ * @brief Implementation of the Skim class for dropping the events which do
+ * not pass a selection on their ML reconstruction outputs.
+ * @author mueller@fnal.gov
+*/
+#include <set>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <dlfcn.h>
+#include "skim.h"
+#include "options.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+namespace
+{
+    /**
+     * @brief Split a string at each occurrence of a separator.
+     * @param value The string to split.
+     * @param separator The separator.
+     * @return The (non-empty) pieces of the string.
+     */
+    std::vector<std::string> split(const std::string & value, char separator)
+    {
+        std::vector<std::string> pieces;
+        std::istringstream stream(value);
+        std::string piece;
+        while(std::getline(stream, piece, separator))
+        {
+            if(!piece.empty())
+                pieces.push_back(piece);
+        }
+        return pieces;
+    }
+
+    /**
+     * @brief Parse a single built-in cut.
+     * @param text The text of the cut (e.g. "min-primaries=2").
+     * @return The cut.
+     * @throw std::runtime_error if the cut is unknown or malformed.
+     */
+    dlp::SkimCut parse_cut(const std::string & text)
+    {
+        size_t equal(text.find('='));
+        std::string name(text.substr(0, equal));
+        std::string value(equal == std::string::npos ? "" : text.substr(equal + 1));
+        dlp::SkimCut cut;
+        if(name == "contained" || name == "fiducial" || name == "flash-matched")
+        {
+            if(equal != std::string::npos)
+                throw std::runtime_error("Skim cut takes no value: " + text);
+            cut.kind = name == "contained" ? dlp::SkimCut::kContained : name == "fiducial" ? dlp::SkimCut::kFiducial : dlp::SkimCut::kFlashMatched;
+            return cut;
+        }
+        if(value.empty())
+            throw std::runtime_error("Skim cut requires a value: " + text);
+        if(name == "topology")
+        {
+            cut.kind = dlp::SkimCut::kTopology;
+            std::vector<std::string> topologies(split(value, '|'));
+            cut.topologies.insert(topologies.begin(), topologies.end());
+            return cut;
+        }
+        if(name == "min-primaries")
+            cut.kind = dlp::SkimCut::kMinPrimaries;
+        else if(name == "max-primaries")
+            cut.kind = dlp::SkimCut::kMaxPrimaries;
+        else if(name == "min-flash-pe")
+            cut.kind = dlp::SkimCut::kMinFlashPE;
+        else
+            throw std::runtime_error("Unknown skim cut: " + text);
+        size_t end(0);
+        try
+        {
+            cut.value = std::stod(value, &end);
+        }
+        catch(const std::exception & e)
+        {
+            end = 0;
+        }
+        if(end != value.size())
+            throw std::runtime_error("Invalid value for skim cut: " + text);
+        return cut;
+    }
+
+    /**
+     * @brief Check if an interaction passes a cut.
+     * @details The reconstructed and true interaction classes share the
+     * fields used by the built-in cuts.
+     * @tparam T The interaction class.
+     * @param cut The cut.
+     * @param interaction The interaction.
+     * @return True if the interaction passes the cut.
+     */
+    template<class T>
+    bool pass_cut(const dlp::SkimCut & cut, const T & interaction)
+    {
+        switch(cut.kind)
+        {
+        case dlp::SkimCut::kContained:
+            return interaction.is_contained;
+        case dlp::SkimCut::kFiducial:
+            return interaction.is_fiducial;
+        case dlp::SkimCut::kFlashMatched:
+            return interaction.is_flash_matched;
+        case dlp::SkimCut::kTopology:
+            return cut.topologies.count(interaction.topology) > 0;
+        case dlp::SkimCut::kMinPrimaries:
+            return interaction.num_primary_particles >= cut.value;
+        case dlp::SkimCut::kMaxPrimaries:
+            return interaction.num_primary_particles <= cut.value;
+        case dlp::SkimCut::kMinFlashPE:
+            return interaction.flash_total_pe >= cut.value;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Check if any interaction of a list passes all of the cuts.
+     * @tparam T The interaction class.
+     * @param cuts The cuts.
+     * @param interactions The interactions.
+     * @return True if at least one interaction passes all of the cuts.
+     */
+    template<class T>
+    bool any_passes(const std::vector<dlp::SkimCut> & cuts, const std::vector<T> & interactions)
+    {
+        for(const T & interaction : interactions)
+        {
+            bool passed(true);
+            for(const dlp::SkimCut & cut : cuts)
+            {
+                if(!pass_cut(cut, interaction))
+                {
+                    passed = false;
+                    break;
+                }
+            }
+            if(passed)
+                return true;
+        }
+        return false;
+    }
+} // namespace
+
+namespace dlp
+{
+    /**
+     * @brief Check if a record passes the skim.
+     * @param rec The StandardRecord with its ML reconstruction outputs.
+     * @return True if the record is kept.
+    */
+    bool Skim::pass(const caf::StandardRecord * rec) const
+    {
+        if(!fCuts.empty())
+        {
+            bool passed(fTruth ? any_passes(fCuts, rec->dlp_true) : any_passes(fCuts, rec->dlp));
+            if(!passed)
+                return false;
+        }
+        return !fPlugin || fPlugin(rec);
+    }
+
+    /**
+     * @brief Get a human-readable description of the skim.
+     * @return The description of the skim.
+    */
+    std::string Skim::describe() const
+    {
+        if(!active())
+            return "all records";
+        std::ostringstream description;
+        if(!fCuts.empty())
+            description << fCuts.size() << " cut(s) on the " << (fTruth ? "true" : "reconstructed") << " interactions";
+        if(fPlugin)
+            description << (fCuts.empty() ? "" : ", ") << "plugin " << fPluginPath;
+        return description.str();
+    }
+
+    /**
+     * @brief Build the skim from the command line options.
+     * @param options The command line options.
+     * @return The skim.
+     * @throw std::runtime_error if an option has an invalid value or the
+     * plugin cannot be loaded.
+    */
+    Skim parse_skim(const Options & options)
+    {
+        Skim skim;
+        if(options.has("skim"))
+        {
+            for(const std::string & text : split(options.get("skim"), ','))
+                skim.fCuts.push_back(parse_cut(text));
+            if(skim.fCuts.empty())
+                throw std::runtime_error("No cut given to --skim.");
+        }
+        if(options.has("skim-truth"))
+        {
+            #ifndef MC_NOT_DATA
+            throw std::runtime_error("--skim-truth requires the simulation version of the executable.");
+            #endif
+            skim.fTruth = true;
+        }
+        if(options.has("skim-plugin"))
+        {
+            /**
+             * @brief Load the plugin.
+             * @details The library is never unloaded, since the predicate is
+             * used until the end of the job.
+             */
+            skim.fPluginPath = options.get("skim-plugin");
+            void * library(dlopen(skim.fPluginPath.c_str(), RTLD_NOW | RTLD_LOCAL));
+            if(!library)
+                throw std::runtime_error("Unable to load skim plugin: " + std::string(dlerror()));
+            skim.fPlugin = reinterpret_cast<SkimPlugin>(dlsym(library, "dlp_skim_event"));
+            if(!skim.fPlugin)
+                throw std::runtime_error("Skim plugin " + skim.fPluginPath + " does not export dlp_skim_event.");
+        }
+        return skim;
+    }
+} // namespace dlp
@@ -0,0 +1,110 @@
+/**
+ * @file string_pool.cc
+ * @brief Implementation of the StringPool class and the InternedString class
+ * for deduplicating the variable-length string fields read from the HDF5
+ * files.
+ * @author mueller@fnal.gov
+*/
+#include <string>
+#include <string_view>
+#include "H5Cpp.h"
+#include "string_pool.h"
+
+namespace dlp
+{
+    /**
+     * @brief A default constructor for the InternedString class.
+    */
+    InternedString::InternedString()
+        : fId(0), fValue(&empty()) { }
+
+    /**
+     * @brief Get the empty string shared by all empty InternedStrings.
+     * @return The empty string.
+    */
+    const std::string & InternedString::empty()
+    {
+        static const std::string value;
+        return value;
+    }
+
+    /**
+     * @brief A constructor for the VlenRelease class.
+     * @details The default property list has no allocator of its own.
+     * @param transfer The dataset transfer property list of the read.
+    */
+    VlenRelease::VlenRelease(const H5::DSetMemXferPropList & transfer)
+        : fFree(nullptr), fInfo(nullptr)
+    {
+        if(transfer.getId() != H5P_DEFAULT)
+        {
+            H5MM_allocate_t allocate(nullptr);
+            void * allocate_info(nullptr);
+            H5Pget_vlen_mem_manager(transfer.getId(), &allocate, &allocate_info, &fFree, &fInfo);
+        }
+    }
+
+    /**
+     * @brief Release a string read by HDF5.
+     * @param pointer The string.
+    */
+    void VlenRelease::operator()(void * pointer) const
+    {
+        if(fFree)
+            fFree(pointer, fInfo);
+        else
+            H5free_memory(pointer);
+    }
+
+    /**
+     * @brief Intern a string.
+     * @param value The value of the string (nullptr is the empty string).
+     * @return The interned string.
+    */
+    InternedString StringPool::intern(const char * value)
+    {
+        if(value == nullptr || *value == '\0')
+            return InternedString();
+        std::string_view key(value);
+        auto it(fIds.find(key));
+        if(it == fIds.end())
+        {
+            fStrings.emplace_back(key);
+            it = fIds.emplace(fStrings.back(), fStrings.size()).first;
+        }
+        return InternedString(it->second, &fStrings[it->second - 1]);
+    }
+
+    /**
+     * @brief Intern a variable-length string read by HDF5 and release it.
+     * @param handle The handle to the string read by HDF5.
+     * @param release The function releasing the string.
+     * @return The interned string.
+    */
+    InternedString StringPool::adopt(char *& handle, const VlenRelease & release)
+    {
+        InternedString value(intern(handle));
+        if(handle != nullptr)
+            release(handle);
+        handle = nullptr;
+        return value;
+    }
+
+    /**
+     * @brief Get the number of distinct strings in the pool.
+     * @return The number of distinct strings.
+    */
+    size_t StringPool::size() const
+    {
+        return fStrings.size() + 1;
+    }
+
+    /**
+     * @brief Remove all strings from the pool.
+    */
+    void StringPool::clear()
+    {
+        fIds.clear();
+        fStrings.clear();
+    }
+} // namespace dlp
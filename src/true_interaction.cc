@@ -33,6 +33,18 @@ namespace dlp::types
         index_g4.reset(&index_g4_handle);
     }
 
+    /**
+     * @brief Intern the string fields and release the strings read by HDF5.
+     * @param pool The string pool of the reader.
+     * @param release The function releasing the strings read by HDF5.
+    */
+    void TruthInteraction::InternStrings(StringPool & pool, const VlenRelease & release)
+    {
+        creation_process = pool.adopt(creation_process_handle, release);
+        topology = pool.adopt(topology_handle, release);
+        units = pool.adopt(units_handle, release);
+    }
+
     /**
      * @brief Build the HDF5 compound type for the TruthInteraction class.
      * 
@@ -59,7 +71,7 @@ namespace dlp::types
         // Add the members of the TruthInteraction to the compound type.
         ctype.insertMember("bjorken_x", HOFFSET(TruthInteraction, bjorken_x), H5::PredType::IEEE_F64LE);
         ctype.insertMember("cathode_offset", HOFFSET(TruthInteraction, cathode_offset), H5::PredType::IEEE_F64LE);
-        ctype.insertMember("creation_process", HOFFSET(TruthInteraction, creation_process), string_type);
+        ctype.insertMember("creation_process", HOFFSET(TruthInteraction, creation_process_handle), string_type);
         ctype.insertMember("crt_ids", HOFFSET(TruthInteraction, crt_ids_handle), H5::VarLenType(H5::PredType::STD_I32LE));
         ctype.insertMember("crt_times", HOFFSET(TruthInteraction, crt_times_handle), H5::VarLenType(H5::PredType::STD_I32LE));
         ctype.insertMember("current_type", HOFFSET(TruthInteraction, current_type), nu_current_type_enumtype);
@@ -122,9 +134,9 @@ namespace dlp::types
         ctype.insertMember("t", HOFFSET(TruthInteraction, t), H5::PredType::IEEE_F64LE);
         ctype.insertMember("target", HOFFSET(TruthInteraction, target), H5::PredType::STD_I64LE);
         ctype.insertMember("theta", HOFFSET(TruthInteraction, theta), H5::PredType::IEEE_F64LE);
-        ctype.insertMember("topology", HOFFSET(TruthInteraction, topology), string_type);
+        ctype.insertMember("topology", HOFFSET(TruthInteraction, topology_handle), string_type);
         ctype.insertMember("track_id", HOFFSET(TruthInteraction, track_id), H5::PredType::STD_I64LE);
-        ctype.insertMember("units", HOFFSET(TruthInteraction, units), string_type);
+        ctype.insertMember("units", HOFFSET(TruthInteraction, units_handle), string_type);
         ctype.insertMember("vertex", HOFFSET(TruthInteraction, vertex), H5::ArrayType(H5::PredType::IEEE_F32LE, 1, &std::array<hsize_t, 1>{3}[0]));
     
         return ctype;
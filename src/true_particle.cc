@@ -25,6 +25,19 @@ namespace dlp::types
         orig_children_id.reset(&orig_children_id_handle);
     }
 
+    /**
+     * @brief Intern the string fields and release the strings read by HDF5.
+     * @param pool The string pool of the reader.
+     * @param release The function releasing the strings read by HDF5.
+    */
+    void TruthParticle::InternStrings(StringPool & pool, const VlenRelease & release)
+    {
+        ancestor_creation_process = pool.adopt(ancestor_creation_process_handle, release);
+        creation_process = pool.adopt(creation_process_handle, release);
+        parent_creation_process = pool.adopt(parent_creation_process_handle, release);
+        units = pool.adopt(units_handle, release);
+    }
+
     /**
      * @brief Build the HDF5 compound type for the TruthParticle class.
      * 
@@ -48,7 +61,7 @@ namespace dlp::types
         H5::EnumType semantic_type_enumtype(create_shape_enumtype());
 
         // Add the members of the TruthParticle to the compound type.
-        ctype.insertMember("ancestor_creation_process", HOFFSET(TruthParticle, ancestor_creation_process), string_type);
+        ctype.insertMember("ancestor_creation_process", HOFFSET(TruthParticle, ancestor_creation_process_handle), string_type);
         ctype.insertMember("ancestor_pdg_code", HOFFSET(TruthParticle, ancestor_pdg_code), H5::PredType::STD_I64LE);
         ctype.insertMember("ancestor_position", HOFFSET(TruthParticle, ancestor_position), H5::ArrayType(H5::PredType::IEEE_F32LE,  1, &std::array<hsize_t, 1>{3}[0]));
         ctype.insertMember("ancestor_t", HOFFSET(TruthParticle, ancestor_t), H5::PredType::IEEE_F64LE);
@@ -57,7 +70,7 @@ namespace dlp::types
         ctype.insertMember("cathode_offset", HOFFSET(TruthParticle, cathode_offset), H5::PredType::STD_I64LE);
         ctype.insertMember("children_counts", HOFFSET(TruthParticle, children_counts_handle), H5::VarLenType(H5::PredType::STD_I64LE));
         ctype.insertMember("children_id", HOFFSET(TruthParticle, children_id_handle), H5::VarLenType(H5::PredType::STD_I64LE));
-        ctype.insertMember("creation_process", HOFFSET(TruthParticle, creation_process), string_type);
+        ctype.insertMember("creation_process", HOFFSET(TruthParticle, creation_process_handle), string_type);
         ctype.insertMember("csda_ke", HOFFSET(TruthParticle, csda_ke), H5::PredType::IEEE_F64LE);
         ctype.insertMember("csda_ke_per_pid", HOFFSET(TruthParticle, csda_ke_per_pid), H5::ArrayType(H5::PredType::IEEE_F64LE,  1, &std::array<hsize_t, 1>{6}[0]));
 	    ctype.insertMember("depositions_adapt_q_sum", HOFFSET(TruthParticle, depositions_adapt_q_sum), H5::PredType::IEEE_F32LE);
@@ -108,7 +121,7 @@ namespace dlp::types
         ctype.insertMember("orig_interaction_id", HOFFSET(TruthParticle, orig_interaction_id), H5::PredType::STD_I64LE);
         ctype.insertMember("orig_parent_id", HOFFSET(TruthParticle, orig_parent_id), H5::PredType::STD_I64LE);
         ctype.insertMember("p", HOFFSET(TruthParticle, p), H5::PredType::IEEE_F32LE);
-        ctype.insertMember("parent_creation_process", HOFFSET(TruthParticle, parent_creation_process), string_type);
+        ctype.insertMember("parent_creation_process", HOFFSET(TruthParticle, parent_creation_process_handle), string_type);
         ctype.insertMember("parent_id", HOFFSET(TruthParticle, parent_id), H5::PredType::STD_I64LE);
         ctype.insertMember("parent_pdg_code", HOFFSET(TruthParticle, parent_pdg_code), H5::PredType::STD_I64LE);	
         ctype.insertMember("parent_position", HOFFSET(TruthParticle, parent_position), H5::ArrayType(H5::PredType::IEEE_F32LE,  1, &std::array<hsize_t, 1>{3}[0]));
@@ -130,7 +143,7 @@ namespace dlp::types
         ctype.insertMember("start_point", HOFFSET(TruthParticle, start_point), H5::ArrayType(H5::PredType::IEEE_F32LE,  1, &std::array<hsize_t, 1>{3}[0]));
         ctype.insertMember("t", HOFFSET(TruthParticle, t), H5::PredType::IEEE_F64LE);
         ctype.insertMember("track_id", HOFFSET(TruthParticle, track_id), H5::PredType::STD_I64LE);
-        ctype.insertMember("units", HOFFSET(TruthParticle, units), string_type);
+        ctype.insertMember("units", HOFFSET(TruthParticle, units_handle), string_type);
         
         return ctype;
     }
@@ -0,0 +1,139 @@
+/**
+ * @file truth_pruning.cc
+ * @brief Implementation of the TruthPruning struct for dropping the true
+ * particles which are not needed downstream.
+ * @author mueller@fnal.gov
+*/
+#include <string>
+#include <vector>
+#include <sstream>
+#include <stdexcept>
+#include "truth_pruning.h"
+#include "options.h"
+
+namespace dlp
+{
+    /**
+     * @brief Check if a true particle is kept.
+     * @param particle The true particle.
+     * @return True if the particle passes all of the enabled criteria.
+    */
+    bool TruthPruning::keep(const types::TruthParticle & particle) const
+    {
+        if(primaries_only && !particle.is_primary)
+            return false;
+        if(valid_only && !particle.is_valid)
+            return false;
+        if(energy_cut && particle.energy_deposit < min_energy_deposit)
+            return false;
+        return true;
+    }
+
+    /**
+     * @brief Build the new index of each true particle of an event.
+     * @param particles The true particles of the event.
+     * @return The new index of each particle, or -1 if it is pruned.
+    */
+    std::vector<int64_t> TruthPruning::index(const std::vector<types::TruthParticle> & particles) const
+    {
+        std::vector<int64_t> result(particles.size(), -1);
+        int64_t next(0);
+        for(size_t i(0); i < particles.size(); ++i)
+        {
+            if(keep(particles[i]))
+                result[i] = next++;
+        }
+        return result;
+    }
+
+    /**
+     * @brief Remap a list of true particle identifiers.
+     * @param ids The list of identifiers (updated).
+     * @param index The new index of each particle.
+     * @param weights The associated list (optional, updated).
+    */
+    void remap_ids(std::vector<int64_t> & ids, const std::vector<int64_t> & index, std::vector<float> * weights)
+    {
+        size_t kept(0);
+        for(size_t i(0); i < ids.size(); ++i)
+        {
+            if(ids[i] < 0 || size_t(ids[i]) >= index.size() || index[ids[i]] < 0)
+                continue;
+            if(weights && i < weights->size())
+                (*weights)[kept] = (*weights)[i];
+            ids[kept++] = index[ids[i]];
+        }
+        ids.resize(kept);
+        if(weights && weights->size() > kept)
+            weights->resize(kept);
+    }
+
+    /**
+     * @brief Build the truth pruning from the command line options.
+     * @param options The command line options.
+     * @return The truth pruning.
+     * @throw std::runtime_error if the option has an invalid value.
+    */
+    TruthPruning parse_truth_pruning(const Options & options)
+    {
+        TruthPruning pruning;
+        if(!options.has("prune-truth"))
+            return pruning;
+        #ifndef MC_NOT_DATA
+        throw std::runtime_error("--prune-truth requires the simulation version of the executable.");
+        #endif
+        std::istringstream policies(options.get("prune-truth"));
+        std::string policy;
+        while(std::getline(policies, policy, ','))
+        {
+            if(policy == "primaries")
+                pruning.primaries_only = true;
+            else if(policy == "valid")
+                pruning.valid_only = true;
+            else if(policy.rfind("energy=", 0) == 0)
+            {
+                size_t end(0);
+                try
+                {
+                    pruning.min_energy_deposit = std::stod(policy.substr(7), &end);
+                }
+                catch(const std::exception & e)
+                {
+                    end = 0;
+                }
+                if(end == 0 || end != policy.size() - 7)
+                    throw std::runtime_error("Invalid value for --prune-truth: " + policy);
+                pruning.energy_cut = true;
+            }
+            else
+                throw std::runtime_error("Unknown truth pruning policy: " + policy);
+        }
+        return pruning;
+    }
+
+    /**
+     * @brief Get a human-readable description of the truth pruning.
+     * @param pruning The truth pruning.
+     * @return The description of the truth pruning.
+    */
+    std::string describe_truth_pruning(const TruthPruning & pruning)
+    {
+        if(!pruning.active())
+            return "all true particles";
+        std::ostringstream description;
+        std::string separator("");
+        if(pruning.primaries_only)
+        {
+            description << "primaries";
+            separator = ", ";
+        }
+        if(pruning.valid_only)
+        {
+            description << separator << "valid";
+            separator = ", ";
+        }
+        if(pruning.energy_cut)
+            description << separator << "energy deposit >= " << pruning.min_energy_deposit << " MeV";
+        return description.str();
+    }
+} // namespace dlp
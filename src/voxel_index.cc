@@ -0,0 +1,353 @@
+/**
+ * @file voxel_index.cc
+ * @brief Implementation of the codec and of the sidecar file writer and
+ * reader for the voxel index arrays of the ML data products.
+ * @author mueller@fnal.gov
+*/
+#include <bit>
+#include <span>
+#include <tuple>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "H5Cpp.h"
+
+#include "voxel_index.h"
+#include "buffer.h"
+#include "instrumentation.h"
+
+namespace
+{
+    /**
+     * @brief The number of buffered bytes after which the writer flushes.
+     */
+    constexpr size_t kFlushBytes = 4 << 20;
+
+    /**
+     * @brief The chunk size (in bytes) of the "data" dataset.
+     */
+    constexpr hsize_t kDataChunk = 1 << 16;
+
+    /**
+     * @brief The chunk size (in records) of the "objects" dataset.
+     */
+    constexpr hsize_t kObjectsChunk = 4096;
+
+    /**
+     * @brief Pack values with a fixed bit width.
+     * @details Each value is OR-ed into the (unaligned) 64-bit word starting
+     * at the byte of its first bit, so @p out must have at least
+     * @ref dlp::kVoxelPadding writable bytes after the packed bytes.
+     * @param values The values (each less than 2^width).
+     * @param count The number of values.
+     * @param width The bit width (at most 56).
+     * @param out The output bytes (zero-initialized).
+     */
+    void pack(const uint64_t * values, size_t count, unsigned width, uint8_t * out)
+    {
+        for(size_t i(0); i < count; ++i)
+        {
+            size_t bit(i * width);
+            uint64_t word;
+            std::memcpy(&word, out + (bit >> 3), sizeof(word));
+            word |= values[i] << (bit & 7);
+            std::memcpy(out + (bit >> 3), &word, sizeof(word));
+        }
+    }
+
+    /**
+     * @brief Unpack values with a fixed bit width.
+     * @param data The packed bytes (followed by @ref dlp::kVoxelPadding
+     * readable bytes).
+     * @param count The number of values.
+     * @param width The bit width (at most 56).
+     * @param out The unpacked values.
+     */
+    void unpack(const uint8_t * data, size_t count, unsigned width, uint64_t * out)
+    {
+        uint64_t mask(width == 0 ? 0 : (~uint64_t(0) >> (64 - width)));
+        for(size_t i(0); i < count; ++i)
+        {
+            size_t bit(i * width);
+            uint64_t word;
+            std::memcpy(&word, data + (bit >> 3), sizeof(word));
+            out[i] = (word >> (bit & 7)) & mask;
+        }
+    }
+
+    /**
+     * @brief Pack or unpack values wider than 56 bits, one byte at a time.
+     * @details Such differences only occur for pathological inputs, so this
+     * path is not optimized.
+     */
+    void pack_wide(const uint64_t * values, size_t count, unsigned width, uint8_t * out)
+    {
+        for(size_t i(0); i < count; ++i)
+        {
+            for(unsigned b(0); b < width; ++b)
+            {
+                size_t bit(i * width + b);
+                out[bit >> 3] |= uint8_t(((values[i] >> b) & 1) << (bit & 7));
+            }
+        }
+    }
+
+    void unpack_wide(const uint8_t * data, size_t count, unsigned width, uint64_t * out)
+    {
+        for(size_t i(0); i < count; ++i)
+        {
+            out[i] = 0;
+            for(unsigned b(0); b < width; ++b)
+            {
+                size_t bit(i * width + b);
+                out[i] |= uint64_t((data[bit >> 3] >> (bit & 7)) & 1) << b;
+            }
+        }
+    }
+
+    /**
+     * @brief Order the records by their key.
+     */
+    bool record_less(const dlp::VoxelIndexRecord & a, const dlp::VoxelIndexRecord & b)
+    {
+        return std::tie(a.run, a.subrun, a.event, a.kind, a.id) < std::tie(b.run, b.subrun, b.event, b.kind, b.id);
+    }
+} // namespace
+
+namespace dlp
+{
+    /**
+     * @brief Encode a voxel index array.
+     * @param values The values (sorted in place).
+     * @param out The buffer to which the encoded bytes are appended.
+     * @return The first (smallest) value, or zero if there are no values.
+    */
+    int64_t encode_voxel_index(std::vector<int64_t> & values, std::vector<uint8_t> & out)
+    {
+        if(values.empty())
+            return 0;
+        std::sort(values.begin(), values.end());
+        uint64_t deltas[kVoxelBlockSize];
+        for(size_t begin(1); begin < values.size(); begin += kVoxelBlockSize)
+        {
+            /**
+             * @brief Compute the differences of the block and their width.
+             */
+            size_t count(std::min(kVoxelBlockSize, values.size() - begin));
+            uint64_t bits(0);
+            for(size_t i(0); i < count; ++i)
+            {
+                deltas[i] = uint64_t(values[begin + i]) - uint64_t(values[begin + i - 1]);
+                bits |= deltas[i];
+            }
+            unsigned width(std::bit_width(bits));
+
+            /**
+             * @brief Append the width and the packed differences.
+             */
+            size_t bytes((count * width + 7) / 8);
+            size_t start(out.size());
+            out.resize(start + 1 + bytes + kVoxelPadding, 0);
+            out[start] = uint8_t(width);
+            if(width <= 56)
+                pack(deltas, count, width, &out[start + 1]);
+            else
+                pack_wide(deltas, count, width, &out[start + 1]);
+            out.resize(start + 1 + bytes);
+        }
+        return values.front();
+    }
+
+    /**
+     * @brief Decode a voxel index array.
+     * @param data The encoded bytes, followed by at least
+     * @ref kVoxelPadding readable bytes.
+     * @param count The number of values.
+     * @param first The first value.
+     * @param out The decoded (sorted) values.
+    */
+    void decode_voxel_index(const uint8_t * data, size_t count, int64_t first, int64_t * out)
+    {
+        if(count == 0)
+            return;
+        out[0] = first;
+        uint64_t deltas[kVoxelBlockSize];
+        for(size_t begin(1); begin < count; begin += kVoxelBlockSize)
+        {
+            size_t n(std::min(kVoxelBlockSize, count - begin));
+            unsigned width(*data++);
+            if(width <= 56)
+                unpack(data, n, width, deltas);
+            else
+                unpack_wide(data, n, width, deltas);
+            data += (n * width + 7) / 8;
+            for(size_t i(0); i < n; ++i)
+                out[begin + i] = int64_t(uint64_t(out[begin + i - 1]) + deltas[i]);
+        }
+    }
+
+    /**
+     * @brief Build the HDF5 compound type for the VoxelIndexRecord struct.
+     * @return The HDF5 compound type.
+    */
+    H5::CompType voxel_index_type()
+    {
+        H5::CompType ctype(sizeof(VoxelIndexRecord));
+        ctype.insertMember("run", HOFFSET(VoxelIndexRecord, run), H5::PredType::STD_U32LE);
+        ctype.insertMember("subrun", HOFFSET(VoxelIndexRecord, subrun), H5::PredType::STD_U32LE);
+        ctype.insertMember("event", HOFFSET(VoxelIndexRecord, event), H5::PredType::STD_U32LE);
+        ctype.insertMember("kind", HOFFSET(VoxelIndexRecord, kind), H5::PredType::STD_U8LE);
+        ctype.insertMember("id", HOFFSET(VoxelIndexRecord, id), H5::PredType::STD_I64LE);
+        ctype.insertMember("first", HOFFSET(VoxelIndexRecord, first), H5::PredType::STD_I64LE);
+        ctype.insertMember("count", HOFFSET(VoxelIndexRecord, count), H5::PredType::STD_U64LE);
+        ctype.insertMember("offset", HOFFSET(VoxelIndexRecord, offset), H5::PredType::STD_U64LE);
+        ctype.insertMember("bytes", HOFFSET(VoxelIndexRecord, bytes), H5::PredType::STD_U64LE);
+        return ctype;
+    }
+
+    /**
+     * @brief A constructor for the VoxelIndexWriter class.
+     * @param path The path of the sidecar file (overwritten).
+    */
+    VoxelIndexWriter::VoxelIndexWriter(const std::string & path)
+        : fFile(path, H5F_ACC_TRUNC), fType(voxel_index_type()), fObjectsSize(0), fDataSize(0)
+    {
+        hsize_t dims(0), max_dims(H5S_UNLIMITED);
+        H5::DataSpace space(1, &dims, &max_dims);
+        H5::DSetCreatPropList objects_plist;
+        objects_plist.setChunk(1, &kObjectsChunk);
+        objects_plist.setDeflate(1);
+        fObjects = fFile.createDataSet("objects", fType, space, objects_plist);
+        H5::DSetCreatPropList data_plist;
+        data_plist.setChunk(1, &kDataChunk);
+        fData = fFile.createDataSet("data", H5::PredType::STD_U8LE, space, data_plist);
+    }
+
+    /**
+     * @brief A destructor for the VoxelIndexWriter class.
+    */
+    VoxelIndexWriter::~VoxelIndexWriter()
+    {
+        flush();
+        fFile.close();
+    }
+
+    /**
+     * @brief Add a voxel index array.
+     * @param run The run number of the event.
+     * @param subrun The subrun number of the event.
+     * @param event The event number of the event.
+     * @param kind The kind of array.
+     * @param id The "id" of the particle or interaction.
+     * @param values The values of the array.
+    */
+    void VoxelIndexWriter::add(uint32_t run, uint32_t subrun, uint32_t event, VoxelIndexKind kind, int64_t id, const BufferView<int64_t> & values)
+    {
+        fScratch.assign(values.begin(), values.end());
+        VoxelIndexRecord record;
+        record.run = run;
+        record.subrun = subrun;
+        record.event = event;
+        record.kind = kind;
+        record.id = id;
+        record.count = fScratch.size();
+        record.offset = fDataSize + fBytes.size();
+        size_t start(fBytes.size());
+        record.first = encode_voxel_index(fScratch, fBytes);
+        record.bytes = fBytes.size() - start;
+        fRecords.push_back(record);
+        if(fBytes.size() >= kFlushBytes)
+            flush();
+    }
+
+    /**
+     * @brief Append the buffered arrays to the datasets.
+    */
+    void VoxelIndexWriter::flush()
+    {
+        ScopedTimer timer("voxel_index_write");
+        hsize_t count(fRecords.size());
+        if(count > 0)
+        {
+            hsize_t start(fObjectsSize);
+            fObjectsSize += count;
+            fObjects.extend(&fObjectsSize);
+            H5::DataSpace file_space(fObjects.getSpace());
+            file_space.selectHyperslab(H5S_SELECT_SET, &count, &start);
+            H5::DataSpace memory_space(1, &count);
+            fObjects.write(fRecords.data(), fType, memory_space, file_space);
+            fRecords.clear();
+        }
+        hsize_t bytes(fBytes.size());
+        if(bytes > 0)
+        {
+            hsize_t start(fDataSize);
+            fDataSize += bytes;
+            fData.extend(&fDataSize);
+            H5::DataSpace file_space(fData.getSpace());
+            file_space.selectHyperslab(H5S_SELECT_SET, &bytes, &start);
+            H5::DataSpace memory_space(1, &bytes);
+            fData.write(fBytes.data(), H5::PredType::NATIVE_UINT8, memory_space, file_space);
+            fBytes.clear();
+        }
+    }
+
+    /**
+     * @brief A constructor for the VoxelIndexReader class.
+     * @param path The path of the sidecar file.
+    */
+    VoxelIndexReader::VoxelIndexReader(const std::string & path)
+        : fFile(path, H5F_ACC_RDONLY), fData(fFile.openDataSet("data"))
+    {
+        H5::DataSet objects(fFile.openDataSet("objects"));
+        hsize_t count(0);
+        objects.getSpace().getSimpleExtentDims(&count);
+        fRecords.resize(count);
+        if(count > 0)
+            objects.read(fRecords.data(), voxel_index_type());
+        std::sort(fRecords.begin(), fRecords.end(), record_less);
+    }
+
+    /**
+     * @brief Get a voxel index array.
+     * @param run The run number of the event.
+     * @param subrun The subrun number of the event.
+     * @param event The event number of the event.
+     * @param kind The kind of array.
+     * @param id The "id" of the particle or interaction.
+     * @return The (sorted) values of the array, or an empty span if the
+     * array is not in the file.
+    */
+    std::span<const int64_t> VoxelIndexReader::get(uint32_t run, uint32_t subrun, uint32_t event, VoxelIndexKind kind, int64_t id)
+    {
+        VoxelIndexRecord key;
+        key.run = run;
+        key.subrun = subrun;
+        key.event = event;
+        key.kind = kind;
+        key.id = id;
+        auto it(std::lower_bound(fRecords.begin(), fRecords.end(), key, record_less));
+        if(it == fRecords.end() || record_less(key, *it))
+            return std::span<const int64_t>();
+
+        /**
+         * @brief Read the encoded bytes of the array (followed by the
+         * padding required by the decoder) and decode them.
+         */
+        hsize_t bytes(it->bytes);
+        hsize_t start(it->offset);
+        fBytes.assign(bytes + kVoxelPadding, 0);
+        if(bytes > 0)
+        {
+            H5::DataSpace file_space(fData.getSpace());
+            file_space.selectHyperslab(H5S_SELECT_SET, &bytes, &start);
+            H5::DataSpace memory_space(1, &bytes);
+            fData.read(fBytes.data(), H5::PredType::NATIVE_UINT8, memory_space, file_space);
+        }
+        fValues.resize(it->count);
+        decode_voxel_index(fBytes.data(), it->count, it->first, fValues.data());
+        return std::span<const int64_t>(fValues.data(), fValues.size());
+    }
+} // namespace dlp
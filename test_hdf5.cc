@@ -44,7 +44,8 @@ int main(int argc, char const * argv[])
      * @brief Get the events from the file and print out the number of events.
     */
     std::vector<dlp::types::Event> events(get_all_events(file));
-    std::vector<dlp::types::RunInfo> run_info(get_product<dlp::types::RunInfo>(file, events[event_number]));
+    dlp::StringPool strings;
+    std::vector<dlp::types::RunInfo> run_info(get_product<dlp::types::RunInfo>(file, events[event_number], strings));
     std::cout << "Number of events in file: " << events.size() << std::endl;
     
     /**
@@ -60,13 +61,13 @@ int main(int argc, char const * argv[])
      * @brief Get the reco and truth products from the file and print out the
      * number of reco and truth interactions and particles.
     */
-    std::vector<dlp::types::RecoInteraction> reco_interactions(get_product<dlp::types::RecoInteraction>(file, events[event_number]));
+    std::vector<dlp::types::RecoInteraction> reco_interactions(get_product<dlp::types::RecoInteraction>(file, events[event_number], strings));
     std::cout << "Number of reco interactions: " << reco_interactions.size() << std::endl;
-    std::vector<dlp::types::RecoParticle> reco_particles(get_product<dlp::types::RecoParticle>(file, events[event_number]));
+    std::vector<dlp::types::RecoParticle> reco_particles(get_product<dlp::types::RecoParticle>(file, events[event_number], strings));
     std::cout << "Number of reco particles: " << reco_particles.size() << std::endl;
-    std::vector<dlp::types::TruthInteraction> truth_interactions(get_product<dlp::types::TruthInteraction>(file, events[event_number]));
+    std::vector<dlp::types::TruthInteraction> truth_interactions(get_product<dlp::types::TruthInteraction>(file, events[event_number], strings));
     std::cout << "Number of truth interactions: " << truth_interactions.size() << std::endl;
-    std::vector<dlp::types::TruthParticle> truth_particles(get_product<dlp::types::TruthParticle>(file, events[event_number]));
+    std::vector<dlp::types::TruthParticle> truth_particles(get_product<dlp::types::TruthParticle>(file, events[event_number], strings));
     std::cout << "Number of truth particles: " << truth_particles.size() << std::endl;
 
     /**
@@ -0,0 +1,82 @@
+/**
+ * @file buffer_merger.cc
+ * @brief This file contains the test of the parallel conversion of
+ * "make_standalone" with "--buffer-merger".
+ * @details Three synthetic HDF5 files are converted once in order and once
+ * with "--buffer-merger" (without "--threads", so that the number of workers
+ * is the number of cores). The test checks that the parallel output holds
+ * all of the records and that its TotalPOT and TotalEvents histograms are
+ * summed over all workers.
+ * @author mueller@fnal.gov
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "harness.h"
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TH1.h"
+
+/**
+ * @brief The number of records and the exposure of a CAF file.
+ */
+struct Summary
+{
+    Long64_t entries;                           //!< The number of entries of the "recTree".
+    double pot;                                 //!< The content of the TotalPOT histogram.
+    double events;                              //!< The content of the TotalEvents histogram.
+};
+
+/**
+ * @brief Read the number of records and the exposure of a CAF file.
+ * @param path The path of the CAF file.
+ * @return The summary of the CAF file.
+ */
+Summary summarize(const std::string & path)
+{
+    TFile file(path.c_str(), "read");
+    TTree * tree(file.Get<TTree>("recTree"));
+    TH1 * pot(file.Get<TH1>("TotalPOT"));
+    TH1 * events(file.Get<TH1>("TotalEvents"));
+    dlp::test::check(tree != nullptr, "No recTree in " + path + ".");
+    dlp::test::check(pot != nullptr && events != nullptr, "No exposure histograms in " + path + ".");
+    return Summary{tree->GetEntries(), pot->Integral(), events->Integral()};
+}
+
+int main(int argc, char const * argv[])
+{
+    if(argc < 3)
+    {
+        std::cerr << "Usage: ./test_buffer_merger <build_directory> <work_directory>" << std::endl;
+        return 1;
+    }
+    const std::string bin(argv[1]);
+    const std::string base(argv[2]);
+    return dlp::test::run_test("buffer_merger", [&]()
+    {
+        const std::string work(dlp::test::work_directory(base, "buffer_merger"));
+        std::vector<std::string> inputs;
+        const std::vector<int> nevents{40, 60, 80};
+        for(size_t i(0); i < nevents.size(); ++i)
+        {
+            inputs.push_back(work + "/input_" + std::to_string(i) + ".h5");
+            dlp::test::run({bin + "/make_synthetic_simulation", inputs.back(), "--events=" + std::to_string(nevents[i]), "--seed=" + std::to_string(i + 1)});
+        }
+        std::vector<std::string> serial{bin + "/make_standalone_simulation", work + "/serial.root", "0"};
+        serial.insert(serial.end(), inputs.begin(), inputs.end());
+        dlp::test::run(serial);
+        std::vector<std::string> parallel{bin + "/make_standalone_simulation", work + "/parallel.root", "0"};
+        parallel.insert(parallel.end(), inputs.begin(), inputs.end());
+        parallel.push_back("--buffer-merger");
+        dlp::test::run(parallel);
+
+        Summary expected(summarize(work + "/serial.root"));
+        Summary merged(summarize(work + "/parallel.root"));
+        dlp::test::check(expected.entries == 180, "The serial job wrote " + std::to_string(expected.entries) + " records instead of 180.");
+        dlp::test::check(merged.entries == expected.entries, "The parallel job wrote " + std::to_string(merged.entries) + " records instead of " + std::to_string(expected.entries) + ".");
+        dlp::test::check(merged.pot == expected.pot, "The TotalPOT of the parallel job is " + std::to_string(merged.pot) + " instead of " + std::to_string(expected.pot) + ".");
+        dlp::test::check(merged.events == expected.events, "The TotalEvents of the parallel job is " + std::to_string(merged.events) + " instead of " + std::to_string(expected.events) + ".");
+    });
+}
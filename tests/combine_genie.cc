@@ -0,0 +1,212 @@
+/**
+ * @file combine_genie.cc
+ * @brief This file contains the test of the combination of sharded CAF files
+ * with GENIE records by "combine_cafs".
+ * @details Two source CAF files are written, each with its own
+ * "GenieEvtRecTree" and records whose true interactions point into it. Each
+ * source is split into two shards which, like the outputs of the CAF makers
+ * run with "--shard", carry a basket-level copy of the whole
+ * "GenieEvtRecTree" of their source. The four shards are combined, and the
+ * test checks that each "GenieEvtRecTree" is combined only once and that the
+ * GENIE index of every true interaction still points to its own GENIE entry.
+ * The shards of the first source carry TH1F exposure histograms, like the
+ * outputs of "make_standalone", and those of the second source TH1D ones,
+ * like the outputs of "merge_sources"; the test checks that the exposure of
+ * all shards is summed.
+ * @author mueller@fnal.gov
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cmath>
+
+#include "harness.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TH1F.h"
+#include "TH1D.h"
+
+/**
+ * @brief The GENIE entry identifier stored in the test "GenieEvtRecTree".
+ * @param source The index of the source CAF file.
+ * @param entry The entry of the GENIE record in its source CAF file.
+ * @return The identifier of the GENIE record.
+ */
+int genie_id(unsigned int source, int entry)
+{
+    return 1000 * source + entry;
+}
+
+/**
+ * @brief The POT stored in the "TotalPOT" histogram of a test shard.
+ * @param source The index of the source CAF file.
+ * @param shard The index of the shard.
+ * @return The POT of the shard.
+ */
+double shard_pot(unsigned int source, unsigned int shard)
+{
+    return 1e18 * (1 + source) + 1e17 * shard;
+}
+
+/**
+ * @brief Write the shards of a source CAF file.
+ * @details The records of the source are numbered by "hdr.evt", and the
+ * first true interaction of record "evt" points to GENIE entry
+ * "evt % ngenie". A second interaction without a GENIE record (index -1) is
+ * added to every other record. The exposure histograms are TH1F for the
+ * first source and TH1D for the others.
+ * @param work The work directory.
+ * @param source The index of the source CAF file (stored in "hdr.run").
+ * @param ngenie The number of GENIE records of the source.
+ * @param nrecords The number of records of the source.
+ * @param nshards The number of shards.
+ * @return The paths of the shards.
+ */
+std::vector<std::string> write_shards(const std::string & work, unsigned int source, int ngenie, unsigned int nrecords, unsigned int nshards)
+{
+    /**
+     * @brief Write the "GenieEvtRecTree" of the source.
+     */
+    std::string source_path(work + "/source_" + std::to_string(source) + ".root");
+    {
+        TFile file(source_path.c_str(), "recreate");
+        int id(0);
+        TTree * genie(new TTree("GenieEvtRecTree", "GenieEvtRecTree"));
+        genie->Branch("id", &id, "id/I");
+        for(int g(0); g < ngenie; ++g)
+        {
+            id = genie_id(source, g);
+            genie->Fill();
+        }
+        genie->Write();
+        file.Close();
+    }
+
+    /**
+     * @brief Write the shards with a basket-level copy of the
+     * "GenieEvtRecTree" of the source.
+     */
+    std::vector<std::string> shards;
+    TFile source_file(source_path.c_str(), "read");
+    TTree * genie(source_file.Get<TTree>("GenieEvtRecTree"));
+    std::unique_ptr<caf::StandardRecord> rec(new caf::StandardRecord);
+    caf::StandardRecord * address(rec.get());
+    for(unsigned int s(0); s < nshards; ++s)
+    {
+        shards.push_back(work + "/source_" + std::to_string(source) + "_shard_" + std::to_string(s) + ".root");
+        TFile shard(shards.back().c_str(), "recreate");
+        TTree * records(new TTree("recTree", "recTree"));
+        records->Branch("rec", &address);
+        for(unsigned int evt(nrecords * s / nshards); evt < nrecords * (s + 1) / nshards; ++evt)
+        {
+            rec->hdr.run = source;
+            rec->hdr.subrun = 0;
+            rec->hdr.evt = evt;
+            rec->mc.nu.clear();
+            rec->mc.nu.emplace_back();
+            rec->mc.nu.back().genieIdx = evt % ngenie;
+            if(evt % 2 == 1)
+            {
+                rec->mc.nu.emplace_back();
+                rec->mc.nu.back().genieIdx = -1;
+            }
+            rec->mc.nnu = rec->mc.nu.size();
+            records->Fill();
+        }
+        records->Write();
+        std::unique_ptr<TH1> total_pot, total_events;
+        if(source == 0)
+        {
+            total_pot.reset(new TH1F("TotalPOT", "TotalPOT", 1, 0, 1));
+            total_events.reset(new TH1F("TotalEvents", "TotalEvents", 1, 0, 1));
+        }
+        else
+        {
+            total_pot.reset(new TH1D("TotalPOT", "TotalPOT", 1, 0, 1));
+            total_events.reset(new TH1D("TotalEvents", "TotalEvents", 1, 0, 1));
+        }
+        total_pot->SetDirectory(nullptr);
+        total_events->SetDirectory(nullptr);
+        total_pot->SetBinContent(1, shard_pot(source, s));
+        total_events->SetBinContent(1, records->GetEntries());
+        total_pot->Write();
+        total_events->Write();
+        TTree * copy(genie->CloneTree(-1, "fast"));
+        copy->Write();
+        delete copy;
+        shard.Close();
+    }
+    return shards;
+}
+
+int main(int argc, char const * argv[])
+{
+    if(argc < 3)
+    {
+        std::cerr << "Usage: ./test_combine_genie <build_directory> <work_directory>" << std::endl;
+        return 1;
+    }
+    const std::string bin(argv[1]);
+    const std::string base(argv[2]);
+    return dlp::test::run_test("combine_genie", [&]()
+    {
+        const std::string work(dlp::test::work_directory(base, "combine_genie"));
+        const std::vector<int> ngenie{5, 7};
+        const unsigned int nrecords(12);
+        std::vector<std::string> command{bin + "/combine_cafs", work + "/combined.root"};
+        for(unsigned int source(0); source < ngenie.size(); ++source)
+        {
+            std::vector<std::string> shards(write_shards(work, source, ngenie[source], nrecords, 2));
+            command.insert(command.end(), shards.begin(), shards.end());
+        }
+        dlp::test::run(command);
+        double expected_pot(0);
+        for(unsigned int source(0); source < ngenie.size(); ++source)
+            expected_pot += shard_pot(source, 0) + shard_pot(source, 1);
+
+        /**
+         * @brief Check the combined "GenieEvtRecTree".
+         */
+        TFile combined((work + "/combined.root").c_str(), "read");
+        TTree * genie(combined.Get<TTree>("GenieEvtRecTree"));
+        dlp::test::check(genie != nullptr, "No GenieEvtRecTree in the combined CAF file.");
+        dlp::test::check(genie->GetEntries() == ngenie[0] + ngenie[1], "The GenieEvtRecTree has " + std::to_string(genie->GetEntries()) + " entries instead of " + std::to_string(ngenie[0] + ngenie[1]) + ".");
+        int id(0);
+        genie->SetBranchAddress("id", &id);
+
+        /**
+         * @brief Check that every GENIE index points to its own GENIE record.
+         */
+        TTree * records(combined.Get<TTree>("recTree"));
+        dlp::test::check(records != nullptr && records->GetEntries() == Long64_t(nrecords * ngenie.size()), "The combined recTree does not hold all of the records.");
+        caf::StandardRecord * rec(nullptr);
+        records->SetBranchAddress("rec", &rec);
+        for(Long64_t n(0); n < records->GetEntries(); ++n)
+        {
+            records->GetEntry(n);
+            std::string record("record (" + std::to_string(rec->hdr.run) + ", " + std::to_string(rec->hdr.evt) + ")");
+            dlp::test::check(rec->mc.nu.size() == (rec->hdr.evt % 2 == 1 ? 2u : 1u), "Unexpected number of true interactions in " + record + ".");
+            int index(rec->mc.nu[0].genieIdx);
+            dlp::test::check(index >= 0 && index < genie->GetEntries(), "GENIE index " + std::to_string(index) + " of " + record + " is out of range.");
+            genie->GetEntry(index);
+            dlp::test::check(id == genie_id(rec->hdr.run, rec->hdr.evt % ngenie[rec->hdr.run]), "GENIE index " + std::to_string(index) + " of " + record + " points to GENIE record " + std::to_string(id) + ".");
+            if(rec->mc.nu.size() > 1)
+                dlp::test::check(rec->mc.nu[1].genieIdx == -1, "The missing GENIE index of " + record + " has been shifted.");
+        }
+        records->ResetBranchAddresses();
+        delete rec;
+
+        /**
+         * @brief Check that the TH1F and TH1D exposure histograms are summed.
+         */
+        TH1 * total_pot(combined.Get<TH1>("TotalPOT"));
+        TH1 * total_events(combined.Get<TH1>("TotalEvents"));
+        dlp::test::check(total_pot != nullptr && total_events != nullptr, "No exposure histograms in the combined CAF file.");
+        dlp::test::check(std::abs(total_pot->Integral() - expected_pot) <= 1e-6 * expected_pot, "The combined TotalPOT is " + std::to_string(total_pot->Integral()) + " instead of " + std::to_string(expected_pot) + ".");
+        dlp::test::check(total_events->Integral() == double(nrecords * ngenie.size()), "The combined TotalEvents is " + std::to_string(total_events->Integral()) + " instead of " + std::to_string(nrecords * ngenie.size()) + ".");
+    });
+}
@@ -0,0 +1,189 @@
+/**
+ * @file daemon.cc
+ * @brief This file contains the test of the jobs run by the daemon.
+ * @details A synthetic HDF5 file is converted once by "make_standalone" run
+ * directly and once by the same job run through "cafmaker_client" on a
+ * "cafmaker_daemon". The test checks that both CAF files hold the same
+ * records, byte for byte once streamed, and the same exposure, and that the
+ * daemon rejects the options which it does not support.
+ * @author mueller@fnal.gov
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <csignal>
+#include <filesystem>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "harness.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TH1.h"
+#include "TClass.h"
+#include "TBufferFile.h"
+
+/**
+ * @brief A daemon running for the duration of the test.
+ * @details The daemon is stopped when the object is destroyed, so that it
+ * does not outlive a failed test.
+ */
+struct Daemon
+{
+    pid_t pid;                                  //!< The process ID of the daemon.
+
+    /**
+     * @brief Stop the daemon and wait for it.
+     * @details The daemon exits once its running jobs are finished.
+     * @throw std::runtime_error if the daemon fails.
+     */
+    void stop()
+    {
+        if(pid <= 0)
+            return;
+        kill(pid, SIGTERM);
+        pid_t stopped(pid);
+        pid = 0;
+        dlp::test::wait(stopped, "cafmaker_daemon");
+    }
+
+    /**
+     * @brief A destructor for the Daemon class.
+     */
+    ~Daemon()
+    {
+        try
+        {
+            stop();
+        }
+        catch(const std::exception & e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+};
+
+/**
+ * @brief Wait until a daemon listens on a socket.
+ * @details The socket is probed with a connection which is closed at once,
+ * which the daemon drops as a malformed request.
+ * @param path The path of the socket.
+ * @throw std::runtime_error if nothing listens on the socket within 30 s.
+ */
+void wait_for_socket(const std::string & path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+    for(int attempt(0); attempt < 300; ++attempt)
+    {
+        int probe(socket(AF_UNIX, SOCK_STREAM, 0));
+        bool listening(probe >= 0 && connect(probe, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+        if(probe >= 0)
+            close(probe);
+        if(listening)
+            return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    throw std::runtime_error("The daemon does not listen on " + path);
+}
+
+/**
+ * @brief Stream all records of a CAF file.
+ * @param path The path of the CAF file.
+ * @return The streamed bytes of each record of the "recTree".
+ */
+std::vector<std::string> stream_records(const std::string & path)
+{
+    TFile file(path.c_str(), "read");
+    TTree * tree(file.Get<TTree>("recTree"));
+    dlp::test::check(tree != nullptr, "No recTree in " + path + ".");
+    TClass * cls(TClass::GetClass("caf::StandardRecord"));
+    caf::StandardRecord * rec(nullptr);
+    tree->SetBranchAddress("rec", &rec);
+    std::vector<std::string> records;
+    for(Long64_t n(0); n < tree->GetEntries(); ++n)
+    {
+        tree->GetEntry(n);
+        TBufferFile buffer(TBuffer::kWrite);
+        cls->Streamer(rec, buffer);
+        records.emplace_back(buffer.Buffer(), buffer.Length());
+    }
+    tree->ResetBranchAddresses();
+    delete rec;
+    return records;
+}
+
+/**
+ * @brief Get the content of the exposure histograms of a CAF file.
+ * @param path The path of the CAF file.
+ * @return The total POT and the total number of events.
+ */
+std::pair<double, double> exposure(const std::string & path)
+{
+    TFile file(path.c_str(), "read");
+    TH1 * pot(file.Get<TH1>("TotalPOT"));
+    TH1 * events(file.Get<TH1>("TotalEvents"));
+    dlp::test::check(pot != nullptr && events != nullptr, "No exposure histograms in " + path + ".");
+    return {pot->Integral(), events->Integral()};
+}
+
+int main(int argc, char const * argv[])
+{
+    if(argc < 3)
+    {
+        std::cerr << "Usage: ./test_daemon <build_directory> <work_directory>" << std::endl;
+        return 1;
+    }
+    const std::string bin(argv[1]);
+    const std::string base(argv[2]);
+    return dlp::test::run_test("daemon", [&]()
+    {
+        const std::string work(dlp::test::work_directory(base, "daemon"));
+        const std::string h5(work + "/input.h5");
+        dlp::test::run({bin + "/make_synthetic_simulation", h5, "--events=200", "--seed=1"});
+        dlp::test::run({bin + "/make_standalone_simulation", work + "/standalone.root", "0", h5});
+
+        /**
+         * @brief Run the same job through the daemon.
+         * @details The socket is put in the temporary directory, as the path
+         * of a UNIX domain socket is limited to about 100 characters.
+         */
+        const std::string socket_path((std::filesystem::temp_directory_path() / ("test_daemon_" + std::to_string(getpid()) + ".sock")).string());
+        Daemon daemon{dlp::test::start({bin + "/cafmaker_daemon_simulation", "--socket=" + socket_path, "--workers=1"})};
+        wait_for_socket(socket_path);
+        setenv("CAFMAKER_SOCKET", socket_path.c_str(), 1);
+        const std::string client(bin + "/cafmaker_client");
+        dlp::test::run({client, "make_standalone_simulation", work + "/daemon.root", "0", h5});
+
+        /**
+         * @brief Check that the unsupported options are rejected.
+         */
+        for(const std::string option : {"--threads=2", "--buffer-merger"})
+        {
+            std::string output(work + "/rejected.root");
+            int status(dlp::test::exit_status(dlp::test::start({client, "make_standalone_simulation", output, "0", h5, option}), "cafmaker_client"));
+            dlp::test::check(status != 0, "The daemon accepted a job with " + option + ".");
+            dlp::test::check(!std::filesystem::exists(output), "The daemon ran a job with " + option + ".");
+        }
+        daemon.stop();
+
+        /**
+         * @brief Compare the outputs.
+         */
+        std::vector<std::string> standalone(stream_records(work + "/standalone.root"));
+        std::vector<std::string> daemon_records(stream_records(work + "/daemon.root"));
+        dlp::test::check(!standalone.empty(), "The standalone job wrote no records.");
+        dlp::test::check(standalone.size() == daemon_records.size(), "The daemon job wrote " + std::to_string(daemon_records.size()) + " records instead of " + std::to_string(standalone.size()) + ".");
+        for(size_t n(0); n < standalone.size(); ++n)
+            dlp::test::check(standalone[n] == daemon_records[n], "Record " + std::to_string(n) + " differs between the standalone and the daemon jobs.");
+        dlp::test::check(exposure(work + "/standalone.root") == exposure(work + "/daemon.root"), "The exposure differs between the standalone and the daemon jobs.");
+    });
+}
@@ -0,0 +1,200 @@
+/**
+ * @file flat_output.cc
+ * @brief This file contains the test of the flat CAF layout written by
+ * "make_standalone" with "--flat".
+ * @details A synthetic HDF5 file is converted once with "--flat" and once
+ * in the nested layout, which is then flattened with "flatten_caf" of
+ * sbnanaobj. The test checks that the "recTree" of both flat files has the
+ * same branches, and that every branch holds the same values in every entry.
+ * @author mueller@fnal.gov
+ */
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <type_traits>
+
+#include "harness.h"
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TBranch.h"
+#include "TBranchElement.h"
+#include "TLeaf.h"
+#include "TLeafC.h"
+
+/**
+ * @brief A function returning the values of a branch in the current entry of
+ * its TTree, formatted as strings.
+ */
+using BranchValues = std::function<std::vector<std::string>()>;
+
+/**
+ * @brief Format a value of a branch.
+ * @details Numbers are formatted as doubles, so that the same value compares
+ * equal regardless of the type of its branch.
+ * @param value The value.
+ * @return The formatted value.
+ */
+template <class T>
+std::string format(const T & value)
+{
+    if constexpr(std::is_same_v<T, std::string>)
+        return value;
+    else
+    {
+        std::ostringstream s;
+        s << std::setprecision(17) << static_cast<double>(value);
+        return s.str();
+    }
+}
+
+/**
+ * @brief Read a branch holding a std::vector of values.
+ * @param tree The TTree holding the branch.
+ * @param name The name of the branch.
+ * @return The function returning the values of the branch.
+ */
+template <class T>
+BranchValues vector_values(TTree * tree, const std::string & name)
+{
+    std::shared_ptr<std::vector<T> *> data(new std::vector<T> * (nullptr));
+    tree->SetBranchAddress(name.c_str(), data.get());
+    return [data]()
+    {
+        std::vector<std::string> values;
+        for(auto value : **data)
+            values.push_back(format(static_cast<T>(value)));
+        return values;
+    };
+}
+
+/**
+ * @brief Read a branch of a flat CAF file.
+ * @details Branches are either std::vector branches (the values of a field
+ * over all objects in the entry) or leaf-list branches (scalars and
+ * fixed-size arrays).
+ * @param tree The TTree holding the branch.
+ * @param branch The branch.
+ * @return The function returning the values of the branch.
+ * @throw std::runtime_error if the type of the branch is not supported.
+ */
+BranchValues branch_values(TTree * tree, TBranch * branch)
+{
+    const std::string name(branch->GetName());
+    if(dynamic_cast<TBranchElement *>(branch) != nullptr)
+    {
+        static const std::map<std::string, std::function<BranchValues(TTree *, const std::string &)>> readers
+        {
+            {"vector<bool>", vector_values<bool>},
+            {"vector<char>", vector_values<char>},
+            {"vector<unsigned char>", vector_values<unsigned char>},
+            {"vector<short>", vector_values<short>},
+            {"vector<unsigned short>", vector_values<unsigned short>},
+            {"vector<int>", vector_values<int>},
+            {"vector<unsigned int>", vector_values<unsigned int>},
+            {"vector<long>", vector_values<long>},
+            {"vector<unsigned long>", vector_values<unsigned long>},
+            {"vector<Long64_t>", vector_values<Long64_t>},
+            {"vector<long long>", vector_values<Long64_t>},
+            {"vector<ULong64_t>", vector_values<ULong64_t>},
+            {"vector<unsigned long long>", vector_values<ULong64_t>},
+            {"vector<float>", vector_values<float>},
+            {"vector<double>", vector_values<double>},
+            {"vector<string>", vector_values<std::string>}
+        };
+        auto reader(readers.find(branch->GetClassName()));
+        dlp::test::check(reader != readers.end(), "Unsupported type " + std::string(branch->GetClassName()) + " of branch " + name + ".");
+        return reader->second(tree, name);
+    }
+
+    dlp::test::check(branch->GetNleaves() == 1, "Branch " + name + " does not have exactly one leaf.");
+    TLeaf * leaf(static_cast<TLeaf *>(branch->GetListOfLeaves()->At(0)));
+    if(dynamic_cast<TLeafC *>(leaf) != nullptr)
+        return [leaf]() { return std::vector<std::string>{static_cast<const char *>(leaf->GetValuePointer())}; };
+    return [leaf]()
+    {
+        std::vector<std::string> values;
+        for(int i(0); i < leaf->GetLen(); ++i)
+            values.push_back(format(leaf->GetValue(i)));
+        return values;
+    };
+}
+
+/**
+ * @brief The "recTree" of a flat CAF file and readers of all of its branches.
+ */
+struct FlatFile
+{
+    std::unique_ptr<TFile> file;                //!< The flat CAF file.
+    TTree * tree;                               //!< The "recTree" of the file.
+    std::map<std::string, BranchValues> values; //!< The readers of the branches, by name.
+};
+
+/**
+ * @brief Open a flat CAF file and set up the readers of its branches.
+ * @param path The path of the flat CAF file.
+ * @param flat The opened file.
+ */
+void open(const std::string & path, FlatFile & flat)
+{
+    flat.file.reset(TFile::Open(path.c_str(), "read"));
+    dlp::test::check(flat.file && !flat.file->IsZombie(), "Cannot open " + path + ".");
+    flat.tree = flat.file->Get<TTree>("recTree");
+    dlp::test::check(flat.tree != nullptr, "No recTree in " + path + ".");
+    for(TObject * object : *flat.tree->GetListOfBranches())
+    {
+        TBranch * branch(static_cast<TBranch *>(object));
+        flat.values[branch->GetName()] = branch_values(flat.tree, branch);
+    }
+}
+
+int main(int argc, char const * argv[])
+{
+    if(argc < 4)
+    {
+        std::cerr << "Usage: ./test_flat_output <build_directory> <work_directory> <flatten_caf>" << std::endl;
+        return 1;
+    }
+    const std::string bin(argv[1]);
+    const std::string base(argv[2]);
+    const std::string flatten_caf(argv[3]);
+    return dlp::test::run_test("flat_output", [&]()
+    {
+        const std::string work(dlp::test::work_directory(base, "flat_output"));
+        dlp::test::run({bin + "/make_synthetic_simulation", work + "/input.h5", "--events=50", "--seed=5"});
+        dlp::test::run({bin + "/make_standalone_simulation", work + "/direct.flat.root", "0", work + "/input.h5", "--flat"});
+        dlp::test::run({bin + "/make_standalone_simulation", work + "/nested.root", "0", work + "/input.h5"});
+        dlp::test::run({flatten_caf, work + "/nested.root", work + "/flattened.flat.root"});
+
+        FlatFile direct, flattened;
+        open(work + "/direct.flat.root", direct);
+        open(work + "/flattened.flat.root", flattened);
+
+        for(const auto & [name, values] : flattened.values)
+            dlp::test::check(direct.values.count(name) == 1, "Branch " + name + " of the flattened file is missing from the --flat output.");
+        for(const auto & [name, values] : direct.values)
+            dlp::test::check(flattened.values.count(name) == 1, "Branch " + name + " of the --flat output is missing from the flattened file.");
+
+        const Long64_t entries(flattened.tree->GetEntries());
+        dlp::test::check(entries == 50, "The flattened file holds " + std::to_string(entries) + " records instead of 50.");
+        dlp::test::check(direct.tree->GetEntries() == entries, "The --flat output holds " + std::to_string(direct.tree->GetEntries()) + " records instead of " + std::to_string(entries) + ".");
+        for(Long64_t entry(0); entry < entries; ++entry)
+        {
+            direct.tree->GetEntry(entry);
+            flattened.tree->GetEntry(entry);
+            for(const auto & [name, values] : flattened.values)
+            {
+                std::vector<std::string> expected(values());
+                std::vector<std::string> written(direct.values[name]());
+                dlp::test::check(written.size() == expected.size(), "Branch " + name + " holds " + std::to_string(written.size()) + " values instead of " + std::to_string(expected.size()) + " in entry " + std::to_string(entry) + ".");
+                for(size_t i(0); i < expected.size(); ++i)
+                    dlp::test::check(written[i] == expected[i], "Value " + std::to_string(i) + " of branch " + name + " is " + written[i] + " instead of " + expected[i] + " in entry " + std::to_string(entry) + ".");
+            }
+        }
+    });
+}
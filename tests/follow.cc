@@ -0,0 +1,163 @@
+/**
+ * @file follow.cc
+ * @brief This file contains the test of the follow mode of the CAF makers.
+ * @details A SWMR writer ("make_synthetic" with "--swmr") appends events to
+ * an HDF5 file in paced batches while "make_standalone" and "merge_sources"
+ * follow it. The test checks that "make_standalone" converts every event of
+ * the file, and that "merge_sources" matches every record of the input CAF
+ * file whose event is appended, even when records without an event (one
+ * passed by the writer and one after the last event) are interleaved with
+ * them.
+ * @author mueller@fnal.gov
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <tuple>
+#include <filesystem>
+
+#include "harness.h"
+
+#include "hdf5.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+#include "TFile.h"
+#include "TTree.h"
+
+/**
+ * @brief The number of events written by the SWMR writer.
+ */
+const unsigned int kEvents(200);
+
+/**
+ * @brief The number of events per subrun written by the SWMR writer.
+ */
+const unsigned int kEventsPerSubrun(100);
+
+/**
+ * @brief Start a SWMR writer and wait until the file can be followed.
+ * @details The file can be opened by a SWMR reader once the writer has
+ * started writing in SWMR mode, which is checked by opening it as one.
+ * @param bin The build directory.
+ * @param path The path of the HDF5 file.
+ * @return The process ID of the writer.
+ * @throw std::runtime_error if the file cannot be followed within 30 s.
+ */
+pid_t start_writer(const std::string & bin, const std::string & path)
+{
+    pid_t writer(dlp::test::start({bin + "/make_synthetic_simulation", path, "--events=" + std::to_string(kEvents), "--events-per-subrun=" + std::to_string(kEventsPerSubrun), "--batch=20", "--interval=0.2", "--swmr", "--seed=1"}));
+    H5Eset_auto2(H5E_DEFAULT, nullptr, nullptr);
+    for(int attempt(0); attempt < 300; ++attempt)
+    {
+        if(std::filesystem::exists(path))
+        {
+            hid_t file(H5Fopen(path.c_str(), H5F_ACC_RDONLY | H5F_ACC_SWMR_READ, H5P_DEFAULT));
+            if(file >= 0)
+            {
+                H5Fclose(file);
+                return writer;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    dlp::test::wait(writer, "make_synthetic");
+    throw std::runtime_error("The SWMR writer did not start writing " + path);
+}
+
+/**
+ * @brief Write the input CAF file of "merge_sources".
+ * @details The records of all events of the writer are written in order.
+ * A record whose event is passed by the writer, (Run, Subrun, Event No.) =
+ * (1, 1, 0), is inserted after the 50th record, and a record which comes
+ * after the last event of the writer is inserted after the 120th record.
+ * @param path The path of the CAF file.
+ * @return The (Run, Subrun, Event No.) of the records without an event.
+ */
+std::vector<std::tuple<unsigned int, unsigned int, unsigned int>> write_caf(const std::string & path)
+{
+    std::vector<std::tuple<unsigned int, unsigned int, unsigned int>> missing{{1, 1, 0}, {1, 1 + kEvents / kEventsPerSubrun, 1}};
+    TFile file(path.c_str(), "recreate");
+    TTree * records(new TTree("recTree", "recTree"));
+    std::unique_ptr<caf::StandardRecord> rec(new caf::StandardRecord);
+    caf::StandardRecord * address(rec.get());
+    records->Branch("rec", &address);
+    auto fill([&](unsigned int run, unsigned int subrun, unsigned int event)
+    {
+        rec->hdr.run = run;
+        rec->hdr.subrun = subrun;
+        rec->hdr.evt = event;
+        records->Fill();
+    });
+    for(unsigned int event(1); event <= kEvents; ++event)
+    {
+        fill(1, 1 + (event - 1) / kEventsPerSubrun, event);
+        if(event == 50)
+            std::apply(fill, missing[0]);
+        if(event == 120)
+            std::apply(fill, missing[1]);
+    }
+    records->Write();
+    file.Close();
+    return missing;
+}
+
+int main(int argc, char const * argv[])
+{
+    if(argc < 3)
+    {
+        std::cerr << "Usage: ./test_follow <build_directory> <work_directory>" << std::endl;
+        return 1;
+    }
+    const std::string bin(argv[1]);
+    const std::string base(argv[2]);
+    return dlp::test::run_test("follow", [&]()
+    {
+        const std::string work(dlp::test::work_directory(base, "follow"));
+
+        /**
+         * @brief Follow the writer with "make_standalone".
+         */
+        {
+            const std::string h5(work + "/standalone.h5");
+            pid_t writer(start_writer(bin, h5));
+            dlp::test::run({bin + "/make_standalone_simulation", work + "/standalone.root", "0", h5, "--follow=2", "--poll=0.05", "--autosave=0.5"});
+            dlp::test::wait(writer, "make_synthetic");
+            TFile output((work + "/standalone.root").c_str(), "read");
+            TTree * records(output.Get<TTree>("recTree"));
+            dlp::test::check(records != nullptr && records->GetEntries() == Long64_t(kEvents), "make_standalone did not convert all of the events of the followed file.");
+        }
+
+        /**
+         * @brief Follow the writer with "merge_sources".
+         */
+        {
+            const std::string h5(work + "/merge.h5");
+            const std::string caf(work + "/input.root");
+            std::vector<std::tuple<unsigned int, unsigned int, unsigned int>> missing(write_caf(caf));
+            pid_t writer(start_writer(bin, h5));
+            dlp::test::run({bin + "/merge_sources_simulation", work + "/merge.root", caf, h5, "--follow=1", "--poll=0.05", "--autosave=0.5"});
+            dlp::test::wait(writer, "make_synthetic");
+
+            TFile output((work + "/merge.root").c_str(), "read");
+            TTree * records(output.Get<TTree>("recTree"));
+            dlp::test::check(records != nullptr && records->GetEntries() == Long64_t(kEvents + missing.size()), "merge_sources did not write all of the records.");
+            caf::StandardRecord * rec(nullptr);
+            records->SetBranchAddress("rec", &rec);
+            for(Long64_t n(0); n < records->GetEntries(); ++n)
+            {
+                records->GetEntry(n);
+                std::tuple<unsigned int, unsigned int, unsigned int> key(rec->hdr.run, rec->hdr.subrun, rec->hdr.evt);
+                bool expected(std::find(missing.begin(), missing.end(), key) == missing.end());
+                std::string record("record (" + std::to_string(rec->hdr.run) + ", " + std::to_string(rec->hdr.subrun) + ", " + std::to_string(rec->hdr.evt) + ")");
+                dlp::test::check(expected == (rec->ndlp > 0), expected ? "The event of " + record + " was not matched." : "The missing event of " + record + " was matched.");
+            }
+            records->ResetBranchAddresses();
+            delete rec;
+        }
+    });
+}
@@ -0,0 +1,87 @@
+/**
+ * @file follower.cc
+ * @brief This file contains the test of the waits of the Follower class.
+ * @details The input is simulated by a list of events and a script of the
+ * events appended by each refresh, so that the test does not depend on the
+ * timing of a writer. The test checks that a wait for a missing event ends
+ * as soon as a later event is appended, that the idle timeout finishes the
+ * follower, and that a finished follower still finds the events appended
+ * afterwards (and resumes waiting) without sleeping for the events which
+ * never arrive.
+ * @author mueller@fnal.gov
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <chrono>
+
+#include "harness.h"
+#include "follow.h"
+
+int main(int argc, char const * argv[])
+{
+    return dlp::test::run_test("follower", [&]()
+    {
+        dlp::FollowConfig config;
+        config.active = true;
+        config.poll = 0.01;
+        config.idle = 0.2;
+        config.autosave = 0;
+
+        /**
+         * @brief The simulated input.
+         * @details Each refresh appends the next batch of the script (an
+         * empty batch is a poll without new events).
+         */
+        std::set<int> events{1, 2};
+        std::deque<std::vector<int>> script;
+        size_t refreshes(0);
+        dlp::Follower follower(config, [&]() -> size_t
+        {
+            ++refreshes;
+            if(script.empty())
+                return 0;
+            std::vector<int> batch(script.front());
+            script.pop_front();
+            events.insert(batch.begin(), batch.end());
+            return batch.size();
+        }, [&]() { });
+        auto found([&](int event) { return events.count(event) > 0; });
+        auto passed([&](int event) { return !events.empty() && *events.rbegin() > event; });
+        auto seconds([](std::chrono::steady_clock::time_point start) { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); });
+
+        /**
+         * @brief A missing event is given up once a later event is appended.
+         */
+        script = {{}, {}, {4, 5}};
+        dlp::test::check(follower.wait_for([&]() { return found(3) || passed(3); }), "The wait for a missing event did not end when a later event was appended.");
+        dlp::test::check(!found(3) && refreshes == 3 && !follower.finished(), "The wait for a missing event polled the input " + std::to_string(refreshes) + " times instead of 3.");
+
+        /**
+         * @brief An event which does not arrive finishes the follower after
+         * the idle timeout.
+         */
+        std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+        dlp::test::check(!follower.wait_for([&]() { return found(6); }), "The wait for an event which never arrives succeeded.");
+        dlp::test::check(follower.finished() && seconds(start) >= config.idle / 2, "The follower did not wait for the idle timeout.");
+
+        /**
+         * @brief A finished follower polls the input once per wait, without
+         * sleeping.
+         */
+        refreshes = 0;
+        start = std::chrono::steady_clock::now();
+        dlp::test::check(!follower.wait_for([&]() { return found(7); }), "The wait for an event which never arrives succeeded.");
+        dlp::test::check(refreshes == 1 && seconds(start) < config.idle, "The finished follower waited for an event which never arrives.");
+
+        /**
+         * @brief The events appended after the follower is finished are still
+         * found, and the follower resumes.
+         */
+        script = {{6, 7, 8}};
+        dlp::test::check(follower.wait_for([&]() { return found(8); }), "The event appended after the idle timeout was not found.");
+        dlp::test::check(!follower.finished(), "The follower did not resume after the input grew.");
+    });
+}
@@ -0,0 +1,124 @@
+/**
+ * @file harness.cc
+ * @brief Implementation of the utilities shared by the test executables.
+ * @author mueller@fnal.gov
+*/
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <filesystem>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "harness.h"
+
+namespace dlp::test
+{
+    /**
+     * @brief Check a condition of a test.
+     * @param condition The condition.
+     * @param message The description of the failure.
+    */
+    void check(bool condition, const std::string & message)
+    {
+        if(!condition)
+            throw std::runtime_error(message);
+    }
+
+    /**
+     * @brief Start an executable as a child process.
+     * @param command The executable and its arguments.
+     * @return The process ID of the child process.
+    */
+    pid_t start(const std::vector<std::string> & command)
+    {
+        std::vector<char *> argv;
+        for(const std::string & argument : command)
+            argv.push_back(const_cast<char *>(argument.c_str()));
+        argv.push_back(nullptr);
+
+        std::cout.flush();
+        std::cerr.flush();
+        pid_t pid(fork());
+        if(pid < 0)
+            throw std::runtime_error("Cannot fork to run " + command[0]);
+        if(pid == 0)
+        {
+            if(!freopen("/dev/null", "w", stdout)) { }
+            execv(argv[0], argv.data());
+            _exit(127);
+        }
+        return pid;
+    }
+
+    /**
+     * @brief Wait for a child process started with @ref start and get its
+     * exit status.
+     * @param pid The process ID of the child process.
+     * @param name The name of the executable (for the error message).
+     * @return The exit status of the child process.
+    */
+    int exit_status(pid_t pid, const std::string & name)
+    {
+        int status(0);
+        if(waitpid(pid, &status, 0) < 0)
+            throw std::runtime_error("Cannot wait for " + name);
+        if(!WIFEXITED(status))
+            throw std::runtime_error(name + " was killed by signal " + std::to_string(WTERMSIG(status)));
+        return WEXITSTATUS(status);
+    }
+
+    /**
+     * @brief Wait for a child process started with @ref start.
+     * @param pid The process ID of the child process.
+     * @param name The name of the executable (for the error message).
+    */
+    void wait(pid_t pid, const std::string & name)
+    {
+        if(exit_status(pid, name) != 0)
+            throw std::runtime_error("Failed to run " + name);
+    }
+
+    /**
+     * @brief Run an executable as a child process and wait for it.
+     * @param command The executable and its arguments.
+    */
+    void run(const std::vector<std::string> & command)
+    {
+        wait(start(command), command[0]);
+    }
+
+    /**
+     * @brief Create an empty work directory for a test.
+     * @param base The parent directory.
+     * @param name The name of the test.
+     * @return The path of the work directory.
+    */
+    std::string work_directory(const std::string & base, const std::string & name)
+    {
+        std::filesystem::path path(std::filesystem::path(base) / name);
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directories(path);
+        return path.string();
+    }
+
+    /**
+     * @brief Run the body of a test and report its result.
+     * @param name The name of the test.
+     * @param body The body of the test.
+     * @return The exit code of the test executable.
+    */
+    int run_test(const std::string & name, const std::function<void()> & body)
+    {
+        try
+        {
+            body();
+        }
+        catch(const std::exception & e)
+        {
+            std::cerr << name << ": FAILED: " << e.what() << std::endl;
+            return 1;
+        }
+        std::cout << name << ": passed" << std::endl;
+        return 0;
+    }
+} // namespace dlp::test
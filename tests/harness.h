@@ -0,0 +1,77 @@
+/**
+ * @file harness.h
+ * @brief Declaration of the utilities shared by the test executables.
+ * @author mueller@fnal.gov
+*/
+#ifndef TEST_HARNESS_H
+#define TEST_HARNESS_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <sys/types.h>
+
+namespace dlp::test
+{
+    /**
+     * @brief Check a condition of a test.
+     * @param condition The condition.
+     * @param message The description of the failure.
+     * @throw std::runtime_error if the condition is false.
+    */
+    void check(bool condition, const std::string & message);
+
+    /**
+     * @brief Start an executable as a child process.
+     * @details The standard output of the child process is discarded, and its
+     * standard error is kept so that the failures of the executables show up
+     * in the output of the test.
+     * @param command The executable and its arguments.
+     * @return The process ID of the child process.
+     * @throw std::runtime_error if the child process cannot be started.
+    */
+    pid_t start(const std::vector<std::string> & command);
+
+    /**
+     * @brief Wait for a child process started with @ref start and get its
+     * exit status.
+     * @param pid The process ID of the child process.
+     * @param name The name of the executable (for the error message).
+     * @return The exit status of the child process.
+     * @throw std::runtime_error if the child process cannot be waited for or
+     * is killed by a signal.
+    */
+    int exit_status(pid_t pid, const std::string & name);
+
+    /**
+     * @brief Wait for a child process started with @ref start.
+     * @param pid The process ID of the child process.
+     * @param name The name of the executable (for the error message).
+     * @throw std::runtime_error if the child process fails.
+    */
+    void wait(pid_t pid, const std::string & name);
+
+    /**
+     * @brief Run an executable as a child process and wait for it.
+     * @param command The executable and its arguments.
+     * @throw std::runtime_error if the executable cannot be run or fails.
+    */
+    void run(const std::vector<std::string> & command);
+
+    /**
+     * @brief Create an empty work directory for a test.
+     * @param base The parent directory.
+     * @param name The name of the test.
+     * @return The path of the work directory.
+    */
+    std::string work_directory(const std::string & base, const std::string & name);
+
+    /**
+     * @brief Run the body of a test and report its result.
+     * @param name The name of the test.
+     * @param body The body of the test, which throws on failure.
+     * @return The exit code of the test executable: zero if the test passed.
+    */
+    int run_test(const std::string & name, const std::function<void()> & body);
+} // namespace dlp::test
+#endif // TEST_HARNESS_H
@@ -0,0 +1,160 @@
+/**
+ * @file shard_exposure.cc
+ * @brief This file contains the test of the exposure of the shards written
+ * by "merge_sources" with "--shard".
+ * @details A synthetic HDF5 file is converted with "make_standalone", and its
+ * records are rewritten into an input CAF file in which, as in the outputs of
+ * the CAFMaker, "hdr.pot" is only filled in the first record of each subrun.
+ * The "TotalPOT" and "TotalEvents" histograms of the input also count some
+ * exposure which no record carries (subruns and events without a record).
+ * The input is merged once without a selection and once for every shard of
+ * "--shard=<i>/<N>", and the shards are combined with "combine_cafs". The
+ * test checks that the combined shards hold the same records as the
+ * unsharded output, and that both exposure histograms are equal to those of
+ * the unsharded output and of the input.
+ * @author mueller@fnal.gov
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <tuple>
+
+#include "harness.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TH1D.h"
+
+/**
+ * @brief The POT of each subrun of the input CAF file.
+ */
+const double subrun_pot(1e17);
+
+/**
+ * @brief The exposure of the input CAF file which no record carries.
+ */
+const double missing_pot(3e17);
+const double missing_events(4);
+
+/**
+ * @brief The records and the exposure of a CAF file.
+ */
+struct Summary
+{
+    std::vector<std::tuple<unsigned int, unsigned int, unsigned int, double, int>> records; //!< The (run, subrun, evt, hdr.pot, ndlp) of each record.
+    double pot;                                 //!< The content of the TotalPOT histogram.
+    double events;                              //!< The content of the TotalEvents histogram.
+};
+
+/**
+ * @brief Read the records and the exposure of a CAF file.
+ * @param path The path of the CAF file.
+ * @return The summary of the CAF file.
+ */
+Summary summarize(const std::string & path)
+{
+    TFile file(path.c_str(), "read");
+    TTree * tree(file.Get<TTree>("recTree"));
+    TH1 * pot(file.Get<TH1>("TotalPOT"));
+    TH1 * events(file.Get<TH1>("TotalEvents"));
+    dlp::test::check(tree != nullptr, "No recTree in " + path + ".");
+    dlp::test::check(pot != nullptr && events != nullptr, "No exposure histograms in " + path + ".");
+
+    Summary summary{{}, pot->Integral(0, pot->GetNbinsX() + 1), events->Integral(0, events->GetNbinsX() + 1)};
+    std::unique_ptr<caf::StandardRecord> rec(new caf::StandardRecord);
+    caf::StandardRecord * address(rec.get());
+    tree->SetBranchAddress("rec", &address);
+    for(Long64_t n(0); n < tree->GetEntries(); ++n)
+    {
+        tree->GetEntry(n);
+        summary.records.emplace_back(rec->hdr.run, rec->hdr.subrun, rec->hdr.evt, rec->hdr.pot, rec->ndlp);
+    }
+    tree->ResetBranchAddresses();
+    return summary;
+}
+
+/**
+ * @brief Rewrite the output of "make_standalone" into an input CAF file with
+ * the POT of each subrun in its first record.
+ * @param standalone The path of the output of "make_standalone".
+ * @param path The path of the input CAF file.
+ */
+void write_input(const std::string & standalone, const std::string & path)
+{
+    TFile source(standalone.c_str(), "read");
+    TTree * records(source.Get<TTree>("recTree"));
+    dlp::test::check(records != nullptr, "No recTree in " + standalone + ".");
+    std::unique_ptr<caf::StandardRecord> rec(new caf::StandardRecord);
+    caf::StandardRecord * address(rec.get());
+    records->SetBranchAddress("rec", &address);
+
+    TFile file(path.c_str(), "recreate");
+    TTree * tree(new TTree("recTree", "recTree"));
+    tree->Branch("rec", &address);
+    double pot(0);
+    bool first(true);
+    std::pair<unsigned int, unsigned int> subrun(0, 0);
+    for(Long64_t n(0); n < records->GetEntries(); ++n)
+    {
+        records->GetEntry(n);
+        rec->hdr.first_in_subrun = first || subrun != std::make_pair(rec->hdr.run, rec->hdr.subrun);
+        rec->hdr.pot = rec->hdr.first_in_subrun ? subrun_pot : 0;
+        pot += rec->hdr.pot;
+        subrun = std::make_pair(rec->hdr.run, rec->hdr.subrun);
+        first = false;
+        tree->Fill();
+    }
+    tree->Write();
+    TH1D total_pot("TotalPOT", "TotalPOT", 1, 0, 1);
+    TH1D total_events("TotalEvents", "TotalEvents", 1, 0, 1);
+    total_pot.SetBinContent(1, pot + missing_pot);
+    total_events.SetBinContent(1, tree->GetEntries() + missing_events);
+    total_pot.Write();
+    total_events.Write();
+    file.Close();
+}
+
+int main(int argc, char const * argv[])
+{
+    if(argc < 3)
+    {
+        std::cerr << "Usage: ./test_shard_exposure <build_directory> <work_directory>" << std::endl;
+        return 1;
+    }
+    const std::string bin(argv[1]);
+    const std::string base(argv[2]);
+    return dlp::test::run_test("shard_exposure", [&]()
+    {
+        const std::string work(dlp::test::work_directory(base, "shard_exposure"));
+        const std::string h5(work + "/input.h5");
+        dlp::test::run({bin + "/make_synthetic_simulation", h5, "--events=90", "--events-per-subrun=7", "--seed=2"});
+        dlp::test::run({bin + "/make_standalone_simulation", work + "/standalone.root", "0", h5});
+        write_input(work + "/standalone.root", work + "/input.root");
+
+        dlp::test::run({bin + "/merge_sources_simulation", work + "/unsharded.root", work + "/input.root", h5});
+        const unsigned int nshards(4);
+        std::vector<std::string> combine{bin + "/combine_cafs", work + "/combined.root"};
+        for(unsigned int s(0); s < nshards; ++s)
+        {
+            combine.push_back(work + "/shard_" + std::to_string(s) + ".root");
+            dlp::test::run({bin + "/merge_sources_simulation", combine.back(), work + "/input.root", h5, "--shard=" + std::to_string(s) + "/" + std::to_string(nshards)});
+        }
+        dlp::test::run(combine);
+
+        Summary input(summarize(work + "/input.root"));
+        Summary unsharded(summarize(work + "/unsharded.root"));
+        Summary combined(summarize(work + "/combined.root"));
+        dlp::test::check(unsharded.records.size() == 90, "The unsharded job wrote " + std::to_string(unsharded.records.size()) + " records instead of 90.");
+        dlp::test::check(combined.records.size() == unsharded.records.size(), "The combined shards hold " + std::to_string(combined.records.size()) + " records instead of " + std::to_string(unsharded.records.size()) + ".");
+        for(size_t n(0); n < unsharded.records.size(); ++n)
+            dlp::test::check(combined.records[n] == unsharded.records[n], "Record " + std::to_string(n) + " of the combined shards differs from that of the unsharded job.");
+
+        dlp::test::check(unsharded.pot == input.pot, "The TotalPOT of the unsharded job is " + std::to_string(unsharded.pot) + " instead of " + std::to_string(input.pot) + ".");
+        dlp::test::check(unsharded.events == input.events, "The TotalEvents of the unsharded job is " + std::to_string(unsharded.events) + " instead of " + std::to_string(input.events) + ".");
+        dlp::test::check(combined.pot == unsharded.pot, "The TotalPOT of the combined shards is " + std::to_string(combined.pot) + " instead of " + std::to_string(unsharded.pot) + ".");
+        dlp::test::check(combined.events == unsharded.events, "The TotalEvents of the combined shards is " + std::to_string(combined.events) + " instead of " + std::to_string(unsharded.events) + ".");
+    });
+}
@@ -0,0 +1,85 @@
+/**
+ * @file voxel_sidecar.cc
+ * @brief This file contains the test of the voxel index sidecar file.
+ * @details A synthetic HDF5 file is converted by "make_standalone" with
+ * "--voxel-sidecar". The test reads the sidecar file back and checks that
+ * each "index" array of the reconstructed particles and each "index",
+ * "index_adapt" and "index_g4" array of the true interactions matches the
+ * (sorted) array of the input file.
+ * @author mueller@fnal.gov
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "harness.h"
+#include "H5Cpp.h"
+#include "event.h"
+#include "products.h"
+#include "voxel_index.h"
+
+/**
+ * @brief Check that an array of the sidecar file matches an array of the
+ * input file.
+ * @param sidecar The reader of the sidecar file.
+ * @param run The run information of the event.
+ * @param kind The kind of array.
+ * @param id The "id" of the particle or interaction.
+ * @param handle The variable-length array read from the input file.
+ */
+void check_array(dlp::VoxelIndexReader & sidecar, const dlp::types::RunInfo & run, dlp::VoxelIndexKind kind, int64_t id, const hvl_t & handle)
+{
+    dlp::BufferView<int64_t> view(&handle);
+    std::vector<int64_t> expected(view.begin(), view.end());
+    std::sort(expected.begin(), expected.end());
+    std::span<const int64_t> values(sidecar.get(run.run, run.subrun, run.event, kind, id));
+    const std::string name("Array " + std::to_string(int(kind)) + " of object " + std::to_string(id) + " of event " + std::to_string(run.event));
+    dlp::test::check(values.size() == expected.size(), name + " has " + std::to_string(values.size()) + " values instead of " + std::to_string(expected.size()) + ".");
+    dlp::test::check(std::equal(values.begin(), values.end(), expected.begin()), name + " differs from the input file.");
+}
+
+int main(int argc, char const * argv[])
+{
+    if(argc < 3)
+    {
+        std::cerr << "Usage: ./test_voxel_sidecar <build_directory> <work_directory>" << std::endl;
+        return 1;
+    }
+    const std::string bin(argv[1]);
+    const std::string base(argv[2]);
+    return dlp::test::run_test("voxel_sidecar", [&]()
+    {
+        const std::string work(dlp::test::work_directory(base, "voxel_sidecar"));
+        const std::string h5(work + "/input.h5");
+        const std::string sidecar_path(work + "/voxels.h5");
+        dlp::test::run({bin + "/make_synthetic_simulation", h5, "--events=50", "--seed=3"});
+        dlp::test::run({bin + "/make_standalone_simulation", work + "/output.root", "0", h5, "--voxel-sidecar=" + sidecar_path});
+
+        dlp::VoxelIndexReader sidecar(sidecar_path);
+        dlp::test::check(sidecar.size() > 0, "The sidecar file holds no arrays.");
+        H5::H5File file(h5, H5F_ACC_RDONLY);
+        std::vector<dlp::types::Event> events(get_all_events(file));
+        dlp::StringPool strings;
+        size_t arrays(0);
+        for(dlp::types::Event & evt : events)
+        {
+            std::vector<dlp::types::RunInfo> run_info(get_product<dlp::types::RunInfo>(file, evt, strings));
+            if(run_info.empty())
+                continue;
+            for(const dlp::types::RecoParticle & p : get_product<dlp::types::RecoParticle>(file, evt, strings))
+            {
+                check_array(sidecar, run_info[0], dlp::kRecoParticleIndex, p.id, p.index_handle);
+                ++arrays;
+            }
+            for(const dlp::types::TruthInteraction & i : get_product<dlp::types::TruthInteraction>(file, evt, strings))
+            {
+                check_array(sidecar, run_info[0], dlp::kTruthInteractionIndex, i.id, i.index_handle);
+                check_array(sidecar, run_info[0], dlp::kTruthInteractionIndexAdapt, i.id, i.index_adapt_handle);
+                check_array(sidecar, run_info[0], dlp::kTruthInteractionIndexG4, i.id, i.index_g4_handle);
+                arrays += 3;
+            }
+        }
+        dlp::test::check(arrays > 0, "The input file holds no voxel index arrays.");
+    });
+}
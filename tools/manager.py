@@ -45,7 +45,10 @@ def command(curs, comm, vals=None):
     except Exception as e:
         print(e)
 
-def main(definition, update, hdf5, flat):
+def main(definition, update, hdf5, flat, client=None):
+    # Run the jobs on the warm daemon (see "cafmaker_client") if requested.
+    executable = [client, os.path.basename(EXEC)] if client is not None else [EXEC]
+
     # Connect to the database.
     db_name = f'db/{definition}.db'
     conn = sqlite3.connect(db_name)
@@ -98,8 +101,7 @@ def main(definition, update, hdf5, flat):
             hdf5_name = hdf5 + f[0]
             caf_name = samweb.locateFile(f[1])[0]['full_path'].split(':')[1] + '/' + f[1]
             flat_name = flat + f[0][:-len(SUFF)]+'_flat.root'
-            subprocess.run([EXEC, './tmp.root', caf_name, hdf5_name], capture_output=True)
-            subprocess.run(['flatten_caf', './tmp.root', flat_name], capture_output=True)
+            subprocess.run(executable + [flat_name, caf_name, hdf5_name, '--flat'], capture_output=True)
             time = os.path.getmtime(hdf5_name)
             command(curs, 'UPDATE dataset SET flat_name=?, flat_time=? WHERE hdf5_name=?;', (flat_name, time, f[0]))
         conn.commit()
@@ -113,8 +115,7 @@ def main(definition, update, hdf5, flat):
             hdf5_name = hdf5 + f[0]
             caf_name = samweb.locateFile(f[1])[0]['full_path'].split(':')[1] + '/' + f[1]
             flat_name = flat + f[0][:-len(SUFF)]+'_flat.root'
-            subprocess.run([EXEC, './tmp.root', caf_name, hdf5_name], capture_output=True)
-            subprocess.run(['flatten_caf', './tmp.root', flat_name], capture_output=True)
+            subprocess.run(executable + [flat_name, caf_name, hdf5_name, '--flat'], capture_output=True)
             time = os.path.getmtime(hdf5_name)
             command(curs, 'UPDATE dataset SET flat_name=?, flat_time=? WHERE hdf5_name=?;', (flat_name, time, f[0]))
         conn.commit()
@@ -125,5 +126,6 @@ if __name__ == '__main__':
     parser.add_argument('--update', default=False, action='store_true')
     parser.add_argument('--hdf5', default=None)
     parser.add_argument('--flat', default=None)
+    parser.add_argument('--client', default=None)
     args = parser.parse_args()
-    main(args.definition, args.update, args.hdf5, args.flat)
+    main(args.definition, args.update, args.hdf5, args.flat, args.client)
@@ -0,0 +1,112 @@
+/**
+ * @file validate_precision.cc
+ * @brief This file contains the main function for validating a CAF file
+ * written with a reduced precision against the same CAF file written at full
+ * precision.
+ * @details The ML reconstruction outputs ("dlp" and "dlp_true") of each pair
+ * of records are compared field by field, and the maximum absolute and
+ * relative deviation of each floating point field is reported. Both CAF files
+ * must have the standard (non-flat) layout and the same records in the same
+ * order, e.g. two outputs of the same job with and without "--precision".
+ */
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+
+#include "include/options.h"
+#include "include/logger.h"
+#include "include/precision.h"
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+#include "TFile.h"
+#include "TTree.h"
+
+int main(int argc, char const * argv[])
+{
+    /**
+     * @brief Check that the required arguments are present.
+     * @details The first argument is the reference (full precision) CAF file
+     * and the second argument is the CAF file to validate. If "--tolerance"
+     * is passed, the job fails if the relative deviation of any field exceeds
+     * it.
+     */
+    dlp::Options options(argc, argv);
+    const std::vector<std::string> & args(options.positional());
+    if(args.size() < 2)
+    {
+        std::cerr << "Usage: ./validate_precision <reference_caf_file> <reduced_caf_file> [--tolerance=<relative>] [logging options]" << std::endl;
+        return 0;
+    }
+    dlp::Logger::get().configure(options);
+    double tolerance(options.get_double("tolerance", -1));
+
+    /**
+     * @brief Open the two CAF files.
+     */
+    TFile reference_file(args[0].c_str(), "read");
+    TFile reduced_file(args[1].c_str(), "read");
+    if(reference_file.IsZombie() || reduced_file.IsZombie())
+    {
+        dlp::Logger::get().log(dlp::LogLevel::kError, "open_file", "Unable to open input CAF file(s): ", args[0], ", ", args[1]);
+        return 1;
+    }
+    TTree * reference_tree((TTree*)reference_file.Get("recTree"));
+    TTree * reduced_tree((TTree*)reduced_file.Get("recTree"));
+    if(!reference_tree || !reduced_tree || !reference_tree->GetBranch("rec") || !reduced_tree->GetBranch("rec"))
+    {
+        dlp::Logger::get().log(dlp::LogLevel::kError, "open_file", "Both input CAF files must have a recTree with a \"rec\" branch (standard layout).");
+        return 1;
+    }
+    if(reference_tree->GetEntries() != reduced_tree->GetEntries())
+    {
+        dlp::Logger::get().log(dlp::LogLevel::kError, "entries", "The input CAF files have different numbers of records: ", reference_tree->GetEntries(), " and ", reduced_tree->GetEntries(), ".");
+        return 1;
+    }
+
+    /**
+     * @brief Compare the records pairwise.
+     */
+    caf::StandardRecord * reference = new caf::StandardRecord;
+    caf::StandardRecord * reduced = new caf::StandardRecord;
+    reference_tree->SetBranchAddress("rec", &reference);
+    reduced_tree->SetBranchAddress("rec", &reduced);
+    dlp::PrecisionValidator validator;
+    for(Long64_t n(0); n < reference_tree->GetEntries(); ++n)
+    {
+        reference_tree->GetEntry(n);
+        reduced_tree->GetEntry(n);
+        validator.Compare(*reference, *reduced);
+    }
+
+    /**
+     * @brief Report the deviation of each field.
+     */
+    bool failed(validator.mismatched() > 0);
+    std::cout << std::left << std::setw(40) << "field" << std::right << std::setw(14) << "values" << std::setw(16) << "max_abs" << std::setw(16) << "max_rel" << std::endl;
+    for(const dlp::FieldDeviation & deviation : validator.Deviations())
+    {
+        std::cout << std::left << std::setw(40) << deviation.name << std::right << std::setw(14) << deviation.values
+                  << std::setw(16) << std::setprecision(4) << deviation.max_abs << std::setw(16) << deviation.max_rel;
+        if(deviation.mismatched > 0)
+        {
+            std::cout << "  (" << deviation.mismatched << " length mismatch(es))";
+            failed = true;
+        }
+        if(tolerance >= 0 && deviation.max_rel > tolerance)
+        {
+            std::cout << "  (exceeds tolerance)";
+            failed = true;
+        }
+        std::cout << std::endl;
+    }
+    if(validator.mismatched() > 0)
+        dlp::Logger::get().log(dlp::LogLevel::kError, "mismatch", validator.mismatched(), " record(s) have different numbers of ML interactions or particles.");
+
+    delete reference;
+    delete reduced;
+    reference_file.Close();
+    reduced_file.Close();
+    return failed ? 1 : 0;
+}